@@ -0,0 +1,613 @@
+/**
+ * Meshes chunks of generated terrain without a window, and reports the size of the meshes and the
+ * time taken per globule: without greedy meshing, with it, and with greedy meshing output as
+ * compact face records. Quad counts and times are also given relative to meshing without greedy
+ * merging.
+ *
+ * All must cover exactly the same exposed faces; the benchmark fails if they don't.
+ *
+ * Alternatively, dense underground chunks are meshed: their faces are also checked against, and
+ * timed against, the slice-wide exposure pass the mesher used before it worked a row at a time.
+ */
+#include <io/Format.h>
+#include <render/chunk/BlockAppearance.h>
+#include <render/chunk/Mesher.h>
+#include <world/block/BlockIds.h>
+#include <world/chunk/Chunk.h>
+#include <world/chunk/ChunkSlice.h>
+#include <world/generators/Terrain.h>
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <lyra/lyra.hpp>
+
+using namespace render::chunk;
+
+/**
+ * Options as read from the command line
+ */
+static struct {
+    // print usage and exit
+    bool help = false;
+
+    // world seed for the terrain generator
+    int32_t seed = 420;
+    // number of chunks along each side of the meshed area
+    size_t size = 3;
+    // number of times each globule is meshed
+    size_t iterations = 5;
+    // whether ambient occlusion is baked into the meshes
+    bool occlusion = false;
+    // mesh dense underground chunks rather than terrain
+    bool underground = false;
+} cmdline;
+
+/// ID of the see-through block in underground chunks; it's not in the block registry
+static const uuids::uuid kGlassBlockId = uuids::uuid::from_string("5A1F0C2E-8B3D-4E6F-9A07-C4D2B81E3F65");
+
+/// number of Y layers filled in underground chunks; this is the bottom row of globules
+constexpr static const size_t kUndergroundHeight = 64;
+
+/**
+ * A block that's always drawn as a cube, with the same appearance. It's either opaque, or
+ * see-through and alpha blended.
+ */
+class CubeBlock: public BlockAppearance {
+    public:
+        CubeBlock(const uint16_t _id, const bool _seeThrough = false) : id(_id),
+            seeThrough(_seeThrough) {}
+
+        const bool isOpaque() const override {
+            return !this->seeThrough;
+        }
+        const bool needsAlphaBlending(const glm::ivec3 &) const override {
+            return this->seeThrough;
+        }
+
+        uint16_t getBlockId(const glm::ivec3 &, const BlockFlags) override {
+            return this->id;
+        }
+        uint16_t getModelId(const glm::ivec3 &, const BlockFlags) override {
+            return 0;
+        }
+
+        void blockWillDisplay(const glm::ivec3 &) override {}
+
+    private:
+        uint16_t id;
+        bool seeThrough;
+};
+
+/**
+ * Provides the blocks placed by the terrain generator, and in underground chunks.
+ */
+class TerrainBlocks: public BlockSource {
+    public:
+        BlockAppearance *getBlock(const uuids::uuid &id) override {
+            if(id == world::blocks::kStoneBlockId) {
+                return &this->stone;
+            } else if(id == world::blocks::kDirtBlockId) {
+                return &this->dirt;
+            } else if(id == kGlassBlockId) {
+                return &this->glass;
+            }
+            return nullptr;
+        }
+        bool isOpaqueBlock(const uuids::uuid &id) override {
+            return !id.is_nil() && id != world::kAirBlockId && id != kGlassBlockId;
+        }
+
+        const BlockModel *getModel(const uint16_t) override {
+            return nullptr;
+        }
+
+    private:
+        CubeBlock stone = CubeBlock(1), dirt = CubeBlock(2), glass = CubeBlock(3, true);
+};
+
+/// Number of exposed faces, by face index
+using FaceCounts = std::array<size_t, 6>;
+
+/**
+ * Finds the exposed faces of a globule the way the mesher did before it worked a row at a time:
+ * the air maps cover entire 256x256 layers as bitsets, and each block's neighbors are looked up
+ * bit by bit, with bounds checks for the chunk edges.
+ *
+ * It's used as a reference to check the mesher's exposed faces against, and to time it against.
+ */
+class SliceExposure {
+    public:
+        FaceCounts count(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &,
+                const Mesher::ChunkMaps &);
+
+    private:
+        void buildAirMap(world::ChunkSlice *, const Mesher::ExposureMaps &, std::bitset<256*256> &);
+        void buildEdgeAirMaps(const Mesher::ChunkMaps &, const glm::ivec3 &, const size_t);
+        static bool isNeighborAir(const Mesher::ChunkMaps &, const size_t, const size_t,
+                const size_t, const size_t);
+
+        /// Whether the block at the given position in the current layer is air; the position
+        /// may be one block outside the chunk.
+        inline bool currentIsAir(const int x, const int z) const {
+            if(x < 0) return this->xMinus[z];
+            if(x > 255) return this->xPlus[z];
+            if(z < 0) return this->zMinus[x];
+            if(z > 255) return this->zPlus[x];
+            return this->current[(z << 8) | x];
+        }
+
+    private:
+        std::bitset<256*256> above, current, below;
+
+        /// air bits of the neighboring chunks' blocks next to the current layer; the X edges are
+        /// indexed by Z coordinate, and vice versa
+        std::bitset<256> xMinus, xPlus, zMinus, zPlus;
+};
+
+/**
+ * Counts the exposed faces of all drawn blocks in the globule at the given origin.
+ */
+FaceCounts SliceExposure::count(const std::shared_ptr<world::Chunk> &chunk,
+        const glm::ivec3 &origin, const Mesher::ChunkMaps &maps) {
+    FaceCounts faces{};
+
+    // the layer below comes from the globule below, if any
+    this->below.reset();
+    this->current.reset();
+    this->above.reset();
+    if(origin.y > 0) {
+        this->buildAirMap(chunk->slices[origin.y - 1], maps.exposure, this->below);
+    }
+    this->buildAirMap(chunk->slices[origin.y], maps.exposure, this->current);
+    this->buildAirMap(chunk->slices[origin.y + 1], maps.exposure, this->above);
+
+    const size_t yMax = origin.y + 63;
+    for(size_t y = origin.y; y <= yMax; y++) {
+        auto slice = chunk->slices[y];
+
+        if(slice) {
+            this->buildEdgeAirMaps(maps, origin, y);
+
+            for(size_t z = origin.z; z < (size_t(origin.z) + 64); z++) {
+                auto row = slice->rows[z];
+                if(!row) continue;
+
+                const auto &blockMap = maps.blocks[row->typeMap];
+
+                for(size_t x = origin.x; x < (size_t(origin.x) + 64); x++) {
+                    if(!blockMap[row->at(x)]) continue;
+
+                    // only blocks next to air are visible
+                    const size_t off = (z << 8) | x;
+                    const bool visible = this->above[off] || this->below[off] ||
+                        this->currentIsAir(int(x) - 1, z) || this->currentIsAir(int(x) + 1, z) ||
+                        this->currentIsAir(x, int(z) - 1) || this->currentIsAir(x, int(z) + 1);
+                    if(!visible) continue;
+
+                    // of those, the bottom and top of the world are always exposed
+                    faces[0] += (y == 0 || this->below[off]);
+                    faces[1] += ((y + 1) >= 255 || this->above[off]);
+                    faces[2] += this->currentIsAir(int(x) - 1, z);
+                    faces[3] += this->currentIsAir(int(x) + 1, z);
+                    faces[4] += this->currentIsAir(x, int(z) - 1);
+                    faces[5] += this->currentIsAir(x, int(z) + 1);
+                }
+            }
+        }
+
+        // set up for the next layer
+        this->below = this->current;
+        this->current = this->above;
+
+        if((y + 2) < world::Chunk::kMaxY && y != yMax) {
+            this->above.reset();
+            this->buildAirMap(chunk->slices[y + 2], maps.exposure, this->above);
+        } else {
+            this->above.set();
+        }
+    }
+
+    return faces;
+}
+
+/**
+ * Fills in the air map of an entire slice. Missing slices and rows are air.
+ */
+void SliceExposure::buildAirMap(world::ChunkSlice *slice, const Mesher::ExposureMaps &exposure,
+        std::bitset<256*256> &b) {
+    if(!slice) {
+        b.set();
+        return;
+    }
+
+    for(size_t z = 0; z < 256; z++) {
+        const size_t zOff = (z << 8);
+        auto row = slice->rows[z];
+
+        if(!row) {
+            for(size_t x = 0; x < 256; x++) {
+                b[zOff + x] = true;
+            }
+            continue;
+        }
+
+        const auto &isAir = exposure[row->typeMap];
+        for(size_t x = 0; x < 256; x++) {
+            b[zOff + x] = isAir[row->at(x)];
+        }
+    }
+}
+
+/**
+ * Fills in the air maps of the neighboring chunks' blocks next to the given layer. Only the edges
+ * that the globule touches are filled in.
+ */
+void SliceExposure::buildEdgeAirMaps(const Mesher::ChunkMaps &maps, const glm::ivec3 &origin,
+        const size_t y) {
+    if(origin.x == 0) {
+        for(size_t z = origin.z; z < (size_t(origin.z) + 64); z++) {
+            this->xMinus[z] = isNeighborAir(maps, 0, 255, y, z);
+        }
+    } else if(origin.x == 192) {
+        for(size_t z = origin.z; z < (size_t(origin.z) + 64); z++) {
+            this->xPlus[z] = isNeighborAir(maps, 1, 0, y, z);
+        }
+    }
+
+    if(origin.z == 0) {
+        for(size_t x = origin.x; x < (size_t(origin.x) + 64); x++) {
+            this->zMinus[x] = isNeighborAir(maps, 2, x, y, 255);
+        }
+    } else if(origin.z == 192) {
+        for(size_t x = origin.x; x < (size_t(origin.x) + 64); x++) {
+            this->zPlus[x] = isNeighborAir(maps, 3, x, y, 0);
+        }
+    }
+}
+
+/**
+ * Checks whether the block at the given position in a neighboring chunk is air. Blocks of chunks
+ * that aren't loaded are air.
+ */
+bool SliceExposure::isNeighborAir(const Mesher::ChunkMaps &maps, const size_t i, const size_t x,
+        const size_t y, const size_t z) {
+    const auto &chunk = maps.neighbors[i];
+    if(!chunk) return true;
+
+    auto slice = chunk->slices[y];
+    if(!slice) return true;
+    auto row = slice->rows[z];
+    if(!row) return true;
+
+    const auto &exposure = maps.neighborExposure[i];
+    if(row->typeMap >= exposure.size()) return true;
+
+    return exposure[row->typeMap][row->at(x)];
+}
+
+/**
+ * Builds a chunk of dense underground: its bottom row of globules is stone, with about 3% of the
+ * blocks air and 1% glass, scattered at random. All rows are dense.
+ */
+static std::shared_ptr<world::Chunk> GenerateUnderground(const int x, const int z,
+        std::mt19937 &random) {
+    auto chunk = std::make_shared<world::Chunk>();
+    chunk->worldPos = glm::ivec2(x, z);
+
+    // 0 = air, 1 = stone, 2 = glass
+    world::ChunkRowBlockTypeMap idMap;
+    idMap.idMap[0] = world::kAirBlockId;
+    idMap.idMap[1] = world::blocks::kStoneBlockId;
+    idMap.idMap[2] = kGlassBlockId;
+    chunk->sliceIdMaps.push_back(idMap);
+
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    for(size_t y = 0; y < kUndergroundHeight; y++) {
+        auto slice = new world::ChunkSlice;
+
+        for(size_t rz = 0; rz < 256; rz++) {
+            auto row = chunk->allocRowDense();
+            row->typeMap = 0;
+
+            for(size_t rx = 0; rx < 256; rx++) {
+                const auto p = percent(random);
+                row->set(rx, (p < 3) ? 0 : ((p < 4) ? 2 : 1));
+            }
+
+            row->prepare();
+            slice->rows[rz] = row;
+        }
+
+        chunk->slices[y] = slice;
+    }
+
+    return chunk;
+}
+
+/// Totals over all meshed globules
+struct Stats {
+    size_t globules = 0;
+    size_t faces = 0;
+    size_t quads = 0;
+    size_t bytes = 0;
+    std::chrono::nanoseconds time{0};
+};
+
+/// Names of the meshing modes, in the order they're run
+static const std::array<const char *, 3> kModeNames = {"simple", "greedy", "compact"};
+
+/**
+ * Adds up the faces covered by the quads of a mesh, by face index. Each quad is a slot of four
+ * vertices, and the vertex with ID 2 holds the number of blocks along both of its edges; unused
+ * slots are zero.
+ *
+ * In the compact format, each quad is a face record instead, which holds the same counts.
+ */
+static FaceCounts CoveredFaces(const Mesher::Result &result) {
+    FaceCounts faces{};
+
+    if(!result.faces.empty()) {
+        for(const auto &record : result.faces) {
+            if(!(record.info & 0xFFFF)) continue;
+            faces[(record.info >> 28) & 0x7] += size_t(((record.info >> 16) & 0x3F) + 1) *
+                (((record.info >> 22) & 0x3F) + 1);
+        }
+        return faces;
+    }
+
+    for(const auto &vertex : result.vertices) {
+        if(vertex.vertexId == 2) {
+            faces[vertex.face] += size_t(vertex.tile.x) * vertex.tile.y;
+        }
+    }
+
+    return faces;
+}
+
+/**
+ * Adds up the faces in all directions.
+ */
+static size_t TotalFaces(const FaceCounts &faces) {
+    size_t total = 0;
+    for(const auto n : faces) {
+        total += n;
+    }
+    return total;
+}
+
+/**
+ * Prints the totals of one meshing mode, along with its quad count and meshing time relative to
+ * those of the baseline mode.
+ */
+static void Report(const std::string &what, const Stats &stats, const Stats &baseline) {
+    const double n = stats.globules ? stats.globules : 1;
+    const double quads = baseline.quads ? double(stats.quads) / baseline.quads : 0;
+    const double time = baseline.time.count() ? double(stats.time.count()) / baseline.time.count() : 0;
+
+    std::cout << f("  {:<10} {:>8.1f} faces {:>8.1f} quads {:>10.1f} bytes {:>10.1f} us/globule"
+            " {:>6.1f}% quads {:>5.2f}x time", what, stats.faces / n, stats.quads / n,
+            stats.bytes / n, double(stats.time.count()) / n / 1000. / cmdline.iterations,
+            quads * 100., time) << std::endl;
+}
+
+/**
+ * Meshes all globules of the given chunk with each of the meshers. For underground chunks, only
+ * the filled globules are meshed, and their exposed faces are also found with the slice-wide
+ * exposure pass.
+ *
+ * @return Whether all meshes cover the same faces
+ */
+static bool MeshChunk(TerrainBlocks &blocks, const std::array<Mesher *, 3> &meshers,
+        const std::shared_ptr<world::Chunk> &chunk,
+        const std::array<std::shared_ptr<world::Chunk>, 4> &neighbors,
+        std::array<Stats, 3> &stats, SliceExposure &reference, Stats &referenceStats) {
+    using Clock = std::chrono::high_resolution_clock;
+    bool ok = true;
+
+    Mesher::ChunkMaps maps;
+    Mesher::buildChunkMaps(&blocks, chunk, neighbors, maps);
+
+    const int height = cmdline.underground ? kUndergroundHeight : 256;
+
+    for(int y = 0; y < height; y += 64) {
+        for(int z = 0; z < 256; z += 64) {
+            for(int x = 0; x < 256; x += 64) {
+                const glm::ivec3 origin(x, y, z);
+                std::array<FaceCounts, 3> faces;
+
+                for(size_t m = 0; m < meshers.size(); m++) {
+                    auto &mesher = *meshers[m];
+                    auto &modeStats = stats[m];
+
+                    const auto start = Clock::now();
+                    for(size_t i = 1; i < cmdline.iterations; i++) {
+                        mesher.generate(chunk, origin, maps);
+                    }
+                    const auto &result = mesher.generate(chunk, origin, maps);
+                    modeStats.time += Clock::now() - start;
+
+                    // same index size as the buffers uploaded by the vertex generator
+                    const size_t indexBytes = (result.vertices.size() < 65536) ? 2 : 4;
+
+                    modeStats.globules++;
+                    modeStats.faces += result.numFaces;
+                    modeStats.quads += result.numQuads;
+                    modeStats.bytes += (result.vertices.size() * sizeof(Mesher::BlockVertex)) +
+                        (result.indices.size() * indexBytes) +
+                        (result.faces.size() * sizeof(Mesher::FaceRecord));
+
+                    // the quads must cover each exposed face exactly once
+                    faces[m] = CoveredFaces(result);
+
+                    if(TotalFaces(faces[m]) != result.numFaces) {
+                        std::cerr << f("chunk {} globule {}: {} quads cover {} faces, expected {}",
+                                chunk->worldPos, origin, kModeNames[m], TotalFaces(faces[m]),
+                                result.numFaces) << std::endl;
+                        ok = false;
+                    }
+                }
+
+                for(size_t m = 1; m < meshers.size(); m++) {
+                    if(faces[m] != faces[0]) {
+                        std::cerr << f("chunk {} globule {}: {} mesh covers {} faces, simple {}",
+                                chunk->worldPos, origin, kModeNames[m], TotalFaces(faces[m]),
+                                TotalFaces(faces[0])) << std::endl;
+                        ok = false;
+                    }
+                }
+
+                // the slice-wide pass must find the same faces in every direction
+                if(cmdline.underground) {
+                    const auto start = Clock::now();
+                    for(size_t i = 1; i < cmdline.iterations; i++) {
+                        reference.count(chunk, origin, maps);
+                    }
+                    const auto expected = reference.count(chunk, origin, maps);
+                    referenceStats.time += Clock::now() - start;
+
+                    referenceStats.globules++;
+                    referenceStats.faces += TotalFaces(expected);
+
+                    for(size_t face = 0; face < 6; face++) {
+                        if(faces[0][face] == expected[face]) continue;
+
+                        std::cerr << f("chunk {} globule {}: {} exposed faces with index {}, "
+                                "slice-wide pass found {}", chunk->worldPos, origin,
+                                faces[0][face], face, expected[face]) << std::endl;
+                        ok = false;
+                    }
+                }
+            }
+        }
+    }
+
+    return ok;
+}
+
+/**
+ * Parse the command line.
+ *
+ * @return 0 if program should continue, positive to exit (but return 0), negative if error.
+ */
+static int ParseCommandLine(const int argc, const char **argv) {
+    auto cli = lyra::cli()
+        | lyra::opt(cmdline.seed, "seed")
+          ["-s"]["--seed"]
+          (f("World seed for the terrain generator. (Default: {})", cmdline.seed))
+        | lyra::opt(cmdline.size, "chunks")
+          ["--size"]
+          (f("Number of chunks along each side of the meshed area. (Default: {})", cmdline.size))
+        | lyra::opt(cmdline.iterations, "count")
+          ["-n"]["--iterations"]
+          (f("Number of times each globule is meshed. (Default: {})", cmdline.iterations))
+        | lyra::opt(cmdline.occlusion)
+          ["-o"]["--occlusion"]
+          ("Bake ambient occlusion into the meshes.")
+        | lyra::opt(cmdline.underground)
+          ["-u"]["--underground"]
+          ("Mesh dense underground chunks (stone with 3% air and 1% glass) instead of terrain, and check their exposed faces against the old slice-wide exposure pass.")
+        | lyra::help(cmdline.help);
+
+    auto result = cli.parse( { argc, argv } );
+
+    if(!result) {
+        std::cerr << "Failed to parse command line: " << result.errorMessage() << std::endl;
+        return -1;
+    }
+
+    if(cmdline.help) {
+        std::cout << cli;
+        return 1;
+    }
+
+    if(!cmdline.size || !cmdline.iterations) {
+        std::cerr << "Size and iterations must be at least 1" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Entry point for the chunk mesher benchmark.
+ */
+int main(int argc, const char **argv) {
+    int err;
+
+    err = ParseCommandLine(argc, argv);
+    if(err < 0) {
+        return err;
+    } else if(err > 0) {
+        return 0;
+    }
+
+    // generate the terrain; chunks are stored row by row (Z major)
+    const int size = cmdline.size;
+    world::Terrain terrain(cmdline.seed);
+    std::mt19937 random(cmdline.seed);
+    std::vector<std::shared_ptr<world::Chunk>> chunks;
+
+    for(int z = 0; z < size; z++) {
+        for(int x = 0; x < size; x++) {
+            if(cmdline.underground) {
+                chunks.push_back(GenerateUnderground(x, z, random));
+            } else {
+                chunks.push_back(terrain.generateChunk(x, z));
+            }
+        }
+    }
+
+    auto chunkAt = [&](const int x, const int z) -> std::shared_ptr<world::Chunk> {
+        if(x < 0 || z < 0 || x >= size || z >= size) return nullptr;
+        return chunks[(z * size) + x];
+    };
+
+    // mesh each chunk, culling against its neighbors in the area
+    TerrainBlocks blocks;
+    const bool ao = cmdline.occlusion;
+    Mesher simple(&blocks, false, false, ao), greedy(&blocks, true, false, ao),
+           compact(&blocks, true, true, ao);
+    const std::array<Mesher *, 3> meshers = {&simple, &greedy, &compact};
+    std::array<Stats, 3> stats;
+    SliceExposure reference;
+    Stats referenceStats;
+    bool ok = true;
+
+    for(int z = 0; z < size; z++) {
+        for(int x = 0; x < size; x++) {
+            const std::array<std::shared_ptr<world::Chunk>, 4> neighbors = {
+                chunkAt(x - 1, z), chunkAt(x + 1, z), chunkAt(x, z - 1), chunkAt(x, z + 1),
+            };
+
+            ok &= MeshChunk(blocks, meshers, chunkAt(x, z), neighbors, stats, reference,
+                    referenceStats);
+        }
+    }
+
+    std::cout << f("{} {}chunks, {} globules (seed {}{})", chunks.size(),
+            cmdline.underground ? "underground " : "", stats[0].globules, cmdline.seed,
+            ao ? ", baked occlusion" : "") << std::endl;
+
+    // compare against meshing without greedy merging
+    for(size_t m = 0; m < meshers.size(); m++) {
+        Report(kModeNames[m], stats[m], stats[0]);
+    }
+
+    if(referenceStats.globules) {
+        const double n = referenceStats.globules;
+        std::cout << f("  {:<10} {:>8.1f} faces {:>10.1f} us/globule (slice-wide exposure pass only)",
+                "reference", referenceStats.faces / n,
+                double(referenceStats.time.count()) / n / 1000. / cmdline.iterations) << std::endl;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,272 @@
+/**
+ * Measures packet encode and decode throughput, comparing serialization through string streams
+ * (and Cereal's portable binary archives) with the span archives and pooled packet buffers the
+ * network code uses.
+ *
+ * Both paths must produce identical bytes; the benchmark fails if they don't. The speedup of the
+ * span archives over the string streams is printed next to their throughput.
+ */
+#include <io/Format.h>
+#include <io/SpanArchive.h>
+#include <net/Framing.h>
+#include <net/PacketTypes.h>
+#include <net/EPBlockChange.h>
+#include <net/EPChunk.h>
+#include <net/EPPlayerMovement.h>
+
+#include <cereal/archives/portable_binary.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <lyra/lyra.hpp>
+
+using namespace net::message;
+
+/**
+ * Options as read from the command line
+ */
+static struct {
+    // print usage and exit
+    bool help = false;
+
+    // number of times each message is encoded and decoded
+    size_t iterations = 20000;
+    // size of the (compressed) data in a chunk slice message, in bytes
+    size_t sliceSize = 12 * 1024;
+    // number of players in a position broadcast
+    size_t numPlayers = 32;
+    // number of changes in a block change broadcast
+    size_t numChanges = 16;
+} cmdline;
+
+/// random source for message contents; seeded the same every run
+static std::mt19937 gRandom(420);
+
+/**
+ * Builds a chunk slice message with random data.
+ */
+static ChunkSliceData MakeSlice() {
+    ChunkSliceData msg;
+    msg.chunkPos = glm::ivec2(-12, 34);
+    msg.y = 64;
+    msg.version = 0x1234567890ULL;
+
+    uuids::uuid_random_generator gen(gRandom);
+    for(uint16_t i = 0; i < 6; i++) {
+        msg.typeMap[gen()] = i;
+    }
+
+    msg.data.resize(cmdline.sliceSize);
+    for(auto &b : msg.data) {
+        b = static_cast<std::byte>(gRandom());
+    }
+
+    return msg;
+}
+
+/**
+ * Builds a position broadcast, where every fourth player is sent with its ID.
+ */
+static PlayerPositionBroadcast MakeBroadcast() {
+    PlayerPositionBroadcast msg;
+    uuids::uuid_random_generator gen(gRandom);
+
+    for(size_t i = 0; i < cmdline.numPlayers; i++) {
+        PlayerPositionEntry entry;
+        entry.playerIndex = i;
+        if(!(i % 4)) {
+            entry.playerId = gen();
+        }
+        entry.movement.pos = {1, -2, 3};
+        entry.movement.angles = {static_cast<uint16_t>(gRandom()), 0, 0};
+
+        msg.players.push_back(entry);
+    }
+
+    return msg;
+}
+
+/**
+ * Builds a block change broadcast.
+ */
+static BlockChangeBroadcast MakeBlockChanges() {
+    BlockChangeBroadcast msg;
+    uuids::uuid_random_generator gen(gRandom);
+
+    for(size_t i = 0; i < cmdline.numChanges; i++) {
+        BlockChangeInfo info;
+        info.chunkPos = glm::ivec2(3, -7);
+        info.blockPos = glm::ivec3(i % 256, 70, (i * 7) % 256);
+        info.newId = gen();
+
+        msg.changes.push_back(info);
+    }
+
+    return msg;
+}
+
+/**
+ * Prints the throughput of one benchmark run. If the time of the string stream path is given, the
+ * speedup over it is printed as well.
+ */
+static void Report(const std::string &what, const std::chrono::nanoseconds time,
+        const size_t bytes, const std::chrono::nanoseconds baseline = {}) {
+    using namespace std::chrono;
+
+    const auto secs = duration_cast<duration<double>>(time).count();
+    std::cout << f("  {:<28} {:>10.1f} ns/msg {:>10.1f} MB/s", what,
+            double(time.count()) / cmdline.iterations,
+            (double(bytes) * cmdline.iterations) / secs / 1024. / 1024.);
+
+    if(baseline.count() && time.count()) {
+        std::cout << f(" {:>6.2f}x", double(baseline.count()) / time.count());
+    }
+    std::cout << std::endl;
+}
+
+/**
+ * Encodes and decodes the given message with both methods.
+ *
+ * @return Whether both methods produced the same bytes
+ */
+template<class T>
+static bool Benchmark(const std::string &name, const T &msg) {
+    using Clock = std::chrono::high_resolution_clock;
+
+    // check that both produce the same output first
+    std::stringstream refStream;
+    {
+        cereal::PortableBinaryOutputArchive arc(refStream);
+        arc(msg);
+    }
+    const auto ref = refStream.str();
+
+    auto packet = net::GetPacketBuffer();
+    {
+        io::BufferOutputArchive arc(*packet);
+        arc(msg);
+    }
+
+    const auto payloadLen = packet->size() - sizeof(net::PacketHeader);
+    if(payloadLen != ref.size() || memcmp(ref.data(), packet->data() + sizeof(net::PacketHeader),
+                payloadLen)) {
+        std::cerr << f("{}: span archive output differs from portable binary archive", name)
+            << std::endl;
+        return false;
+    }
+    packet.reset();
+
+    std::cout << f("{} ({} bytes)", name, ref.size()) << std::endl;
+
+    // encode via string stream, then build the frame
+    auto start = Clock::now();
+    for(size_t i = 0; i < cmdline.iterations; i++) {
+        std::stringstream oStream;
+        cereal::PortableBinaryOutputArchive oArc(oStream);
+        oArc(msg);
+
+        const auto str = oStream.str();
+        size_t frameLen;
+        auto frames = net::BuildFrames(1, 1, 1, str.data(), str.size(), frameLen);
+        delete[] frames;
+    }
+    const auto encodeStream = Clock::now() - start;
+    Report("encode (stringstream)", encodeStream, ref.size());
+
+    // encode into a pooled packet buffer
+    start = Clock::now();
+    for(size_t i = 0; i < cmdline.iterations; i++) {
+        auto buf = net::GetPacketBuffer();
+        io::BufferOutputArchive oArc(*buf);
+        oArc(msg);
+
+        net::FinishPacketBuffer(*buf, 1, 1, 1);
+    }
+    Report("encode (packet buffer)", Clock::now() - start, ref.size(), encodeStream);
+
+    // decode by copying into a string stream
+    start = Clock::now();
+    for(size_t i = 0; i < cmdline.iterations; i++) {
+        std::stringstream stream(std::string(ref.data(), ref.size()));
+        cereal::PortableBinaryInputArchive iArc(stream);
+
+        T out;
+        iArc(out);
+    }
+    const auto decodeStream = Clock::now() - start;
+    Report("decode (stringstream)", decodeStream, ref.size());
+
+    // decode in place
+    start = Clock::now();
+    for(size_t i = 0; i < cmdline.iterations; i++) {
+        io::SpanInputArchive iArc(ref.data(), ref.size());
+
+        T out;
+        iArc(out);
+    }
+    Report("decode (span)", Clock::now() - start, ref.size(), decodeStream);
+
+    return true;
+}
+
+/**
+ * Parse the command line.
+ *
+ * @return 0 if program should continue, positive to exit (but return 0), negative if error.
+ */
+static int ParseCommandLine(const int argc, const char **argv) {
+    auto cli = lyra::cli()
+        | lyra::opt(cmdline.iterations, "count")
+          ["-n"]["--iterations"]
+          (f("Number of times each message is encoded and decoded. (Default: {})", cmdline.iterations))
+        | lyra::opt(cmdline.sliceSize, "bytes")
+          ["--slice-size"]
+          (f("Size of the data in a chunk slice message. (Default: {})", cmdline.sliceSize))
+        | lyra::opt(cmdline.numPlayers, "count")
+          ["--players"]
+          (f("Number of players in a position broadcast. (Default: {})", cmdline.numPlayers))
+        | lyra::opt(cmdline.numChanges, "count")
+          ["--changes"]
+          (f("Number of changes in a block change broadcast. (Default: {})", cmdline.numChanges))
+        | lyra::help(cmdline.help);
+    auto result = cli.parse( { argc, argv } );
+    if(!result) {
+        std::cerr << "Failed to parse command line: " << result.errorMessage() << std::endl;
+        return -1;
+    }
+
+    if(cmdline.help) {
+        std::cout << cli;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Entry point for the packet codec benchmark.
+ */
+int main(int argc, const char **argv) {
+    int err;
+
+    err = ParseCommandLine(argc, argv);
+    if(err < 0) {
+        return err;
+    } else if(err > 0) {
+        return 0;
+    }
+
+    bool ok = true;
+
+    ok &= Benchmark("ChunkSliceData", MakeSlice());
+    ok &= Benchmark("PlayerPositionBroadcast", MakeBroadcast());
+    ok &= Benchmark("BlockChangeBroadcast", MakeBlockChanges());
+
+    return ok ? 0 : 1;
+}
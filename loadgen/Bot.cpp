@@ -0,0 +1,371 @@
+#include "Bot.h"
+
+#include "net/ServerConnection.h"
+#include "net/handlers/PlayerMovement.h"
+
+#include <Logging.h>
+#include <io/Format.h>
+#include <util/Thread.h>
+#include <world/block/BlockIds.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace loadgen;
+
+/// set while a bot changes a block itself, so its own change callback can ignore it
+static thread_local bool gLocalChange = false;
+
+/**
+ * Sets up the bot and starts its worker thread.
+ */
+Bot::Bot(const size_t _index, const Config &_config, const net::handler::Auth::Identity &_identity,
+        Stats *_stats, util::ThreadPool<std::function<void(void)>> *_pool) : index(_index),
+    config(_config), identity(_identity), stats(_stats), pool(_pool), random(_index) {
+    // pick a spot to walk around
+    std::uniform_real_distribution<float> spread(-this->config.spread, this->config.spread);
+    std::uniform_real_distribution<float> angle(0, glm::two_pi<float>());
+
+    this->center = glm::vec2(spread(this->random), spread(this->random));
+    this->walkAngle = angle(this->random);
+
+    this->run = true;
+    this->worker = std::make_unique<std::thread>(&Bot::main, this);
+}
+
+/**
+ * Stops the worker thread, which disconnects from the server.
+ */
+Bot::~Bot() {
+    this->run = false;
+    this->worker->join();
+}
+
+
+
+/**
+ * Bot main loop: connect to the server, then simulate the player at the movement rate until we're
+ * asked to stop.
+ */
+void Bot::main() {
+    util::Thread::setName(f("Bot {}", this->index));
+
+    try {
+        this->connect();
+    } catch(std::exception &e) {
+        Logging::error("Bot {} failed to connect: {}", this->index, e.what());
+        this->stats->botsDropped++;
+        this->done = true;
+        return;
+    }
+
+    if(this->config.floodChunks) {
+        this->flood();
+        this->disconnect();
+        this->done = true;
+        return;
+    }
+
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(1. / this->config.moveRate));
+    auto next = Clock::now();
+
+    while(this->run) {
+        if(!this->server->isConnected()) {
+            Logging::error("Bot {} lost connection: {}", this->index,
+                    this->server->getErrorDetail().value_or("(unknown)"));
+            this->stats->botsDropped++;
+            break;
+        }
+
+        const float dt = 1. / this->config.moveRate;
+        this->move(dt);
+        this->updateChunks();
+
+        this->blockTimer -= dt;
+        if(this->blockTimer <= 0 && this->config.blockRate > 0) {
+            this->changeBlock();
+            this->blockTimer += 1. / this->config.blockRate;
+        }
+
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+
+    this->disconnect();
+    this->done = true;
+}
+
+/**
+ * Connects to the server and authenticates as this bot's player.
+ */
+void Bot::connect() {
+    // each bot keeps its own session, as separate clients would
+    const auto sessionTag = this->config.resumeSessions ? f("bot-{}", this->index) : "";
+    this->server = std::make_shared<net::ServerConnection>(this->config.host, sessionTag,
+            this->config.compress);
+
+    this->stats->handshake.record(this->server->getHandshakeTime());
+    if(this->server->wasSessionResumed()) {
+        this->stats->resumedHandshakes++;
+    }
+
+    this->server->setWorkPool(this->pool);
+    this->server->setIdentity(this->identity);
+
+    this->server->authenticate();
+
+    // time how long other bots' movement takes to get to us
+    this->movementToken = this->server->getMovement()->addCallback([this](const auto &id, const auto &state) {
+        this->stats->movementReceived(id, state);
+    });
+
+    this->stats->botsConnected++;
+    Logging::debug("Bot {} ({}) connected", this->index, this->identity.id);
+}
+
+/**
+ * Unloads all chunks and closes the connection.
+ */
+void Bot::disconnect() {
+    if(!this->server) return;
+
+    this->server->getMovement()->removeCallback(this->movementToken);
+
+    for(auto &[pos, info] : this->loaded) {
+        info.chunk->unregisterChangeCallback(info.token);
+        this->server->didUnloadChunk(info.chunk);
+    }
+    this->loaded.clear();
+
+    for(auto &[pos, info] : this->pending) {
+        this->server->cancelChunk(pos);
+    }
+    this->pending.clear();
+
+    this->stats->botsConnected--;
+
+    this->server->close();
+    this->server = nullptr;
+}
+
+
+
+/**
+ * Advances the bot along its walk circle and sends the new position to the server.
+ */
+void Bot::move(const float dt) {
+    this->walkAngle += (this->config.walkSpeed / this->config.walkRadius) * dt;
+    if(this->walkAngle > glm::two_pi<float>()) {
+        this->walkAngle -= glm::two_pi<float>();
+    }
+
+    const glm::vec2 offset(cos(this->walkAngle), sin(this->walkAngle));
+    const auto xz = this->center + (offset * this->config.walkRadius);
+
+    this->position = glm::vec3(xz.x, kBuildHeight, xz.y);
+
+    // look along the direction we're walking (tangent to the circle)
+    const auto yaw = glm::degrees(this->walkAngle) + 90.;
+    this->angles = glm::vec3(0, fmod(yaw + 180., 360.) - 180., 0);
+
+    // time its arrival at other bots
+    const auto state = net::message::MovementState::quantize(this->position, this->angles);
+    this->stats->movementSent(this->identity.id, state);
+
+    this->server->sendPlayerPosUpdate(this->position, this->angles);
+}
+
+/**
+ * Requests chunks that have come in range, cancels requests for those that are no longer needed,
+ * and unloads chunks we've walked away from.
+ */
+void Bot::updateChunks() {
+    const glm::ivec2 center(floor(this->position.x / 256.), floor(this->position.z / 256.));
+    const auto r = this->config.chunkRadius;
+
+    auto inRange = [&](const glm::ivec2 &pos, const int range) {
+        const auto d = glm::abs(pos - center);
+        return std::max(d.x, d.y) <= range;
+    };
+
+    // request any chunks in range we don't have
+    for(int x = -r; x <= r; x++) {
+        for(int z = -r; z <= r; z++) {
+            const auto pos = center + glm::ivec2(x, z);
+            if(this->loaded.contains(pos) || this->pending.contains(pos)) continue;
+
+            PendingChunk p;
+            p.requested = Clock::now();
+            p.future = this->server->getChunk(pos);
+
+            this->pending.emplace(pos, std::move(p));
+        }
+    }
+
+    // check up on outstanding requests
+    for(auto it = this->pending.begin(); it != this->pending.end();) {
+        const auto &pos = it->first;
+        auto &p = it->second;
+
+        if(!inRange(pos, r)) {
+            this->server->cancelChunk(pos);
+            this->stats->chunksCancelled++;
+            it = this->pending.erase(it);
+            continue;
+        }
+
+        if(p.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            it++;
+            continue;
+        }
+
+        try {
+            auto chunk = p.future.get();
+            this->stats->chunkDelivery.record(Clock::now() - p.requested);
+            this->chunkLoaded(pos, chunk);
+        } catch(std::exception &e) {
+            Logging::warn("Bot {} failed to load chunk {}: {}", this->index, pos, e.what());
+            this->stats->chunkFailures++;
+        }
+
+        it = this->pending.erase(it);
+    }
+
+    // unload chunks that are out of range, with a little bit of hysteresis
+    for(auto it = this->loaded.begin(); it != this->loaded.end();) {
+        if(inRange(it->first, r + 1)) {
+            it++;
+            continue;
+        }
+
+        auto &info = it->second;
+        info.chunk->unregisterChangeCallback(info.token);
+        this->server->didUnloadChunk(info.chunk);
+
+        it = this->loaded.erase(it);
+    }
+}
+
+/**
+ * Requests a square of chunks around the bot's spawn point all at once, then waits for every one
+ * of them. The client decodes slices of all of them on the shared work pool at the same time, so
+ * with more chunks than work threads, this checks that no chunk's completion waits on another's
+ * slices: each request must either complete or fail within the flood timeout.
+ *
+ * Requests that don't are counted as stalled, and cancelled when we disconnect.
+ */
+void Bot::flood() {
+    const glm::ivec2 center(floor(this->center.x / 256.), floor(this->center.y / 256.));
+    const size_t side = std::ceil(std::sqrt(this->config.floodChunks));
+    const glm::ivec2 origin = center - glm::ivec2(side / 2);
+
+    const auto requested = Clock::now();
+    for(size_t i = 0; i < this->config.floodChunks; i++) {
+        const auto pos = origin + glm::ivec2(i % side, i / side);
+
+        PendingChunk p;
+        p.requested = requested;
+        p.future = this->server->getChunk(pos);
+
+        this->pending.emplace(pos, std::move(p));
+    }
+
+    const auto deadline = requested + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(this->config.floodTimeout));
+
+    for(auto it = this->pending.begin(); it != this->pending.end();) {
+        const auto &pos = it->first;
+        auto &p = it->second;
+
+        if(p.future.wait_until(deadline) != std::future_status::ready) {
+            it++;
+            continue;
+        }
+
+        try {
+            auto chunk = p.future.get();
+            if(!chunk || chunk->worldPos != pos) {
+                throw std::runtime_error("wrong chunk delivered");
+            }
+
+            this->stats->chunkDelivery.record(Clock::now() - p.requested);
+            this->chunkLoaded(pos, chunk);
+        } catch(std::exception &e) {
+            Logging::warn("Bot {} failed to load chunk {}: {}", this->index, pos, e.what());
+            this->stats->chunkFailures++;
+        }
+
+        it = this->pending.erase(it);
+    }
+
+    if(!this->pending.empty()) {
+        Logging::error("Bot {}: {} of {} chunks not received after {} s", this->index,
+                this->pending.size(), this->config.floodChunks, this->config.floodTimeout);
+        this->stats->chunksStalled += this->pending.size();
+    }
+    if(!this->server->isConnected()) {
+        Logging::error("Bot {} lost connection during flood: {}", this->index,
+                this->server->getErrorDetail().value_or("(unknown)"));
+        this->stats->botsDropped++;
+    }
+}
+
+/**
+ * A chunk has been received; register for change notifications so we can time block changes
+ * made by other bots.
+ */
+void Bot::chunkLoaded(const glm::ivec2 &pos, const std::shared_ptr<world::Chunk> &chunk) {
+    LoadedChunk info;
+    info.chunk = chunk;
+    info.token = chunk->registerChangeCallback(std::bind(&Bot::chunkChanged, this,
+                std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+                std::placeholders::_4));
+
+    this->server->didLoadChunk(chunk);
+    this->loaded.emplace(pos, std::move(info));
+}
+
+/**
+ * A block in one of our chunks changed. Unless we made that change ourselves, it came from the
+ * server.
+ */
+void Bot::chunkChanged(world::Chunk *chunk, const glm::ivec3 &pos, const world::Chunk::ChangeHints,
+        const uuids::uuid &id) {
+    if(gLocalChange) return;
+    this->stats->blockReceived(this->index, chunk->worldPos, pos, id);
+}
+
+/**
+ * Places or breaks a block just above the bot in the chunk it's standing in.
+ */
+void Bot::changeBlock() {
+    const glm::ivec2 chunkPos(floor(this->position.x / 256.), floor(this->position.z / 256.));
+    if(!this->loaded.contains(chunkPos)) return;
+
+    auto &chunk = this->loaded[chunkPos].chunk;
+
+    // pick a block near us
+    std::uniform_int_distribution<int> height(0, 7);
+
+    glm::ivec3 pos(floor(this->position.x), kBuildHeight + 2 + height(this->random),
+            floor(this->position.z));
+    pos.x -= chunkPos.x * 256;
+    pos.z -= chunkPos.y * 256;
+
+    // toggle between stone and air
+    const auto current = chunk->getBlock(pos);
+    const auto id = (!current || *current == world::kAirBlockId) ?
+        world::blocks::kStoneBlockId : world::kAirBlockId;
+
+    this->stats->blockSent(this->index, chunkPos, pos, id);
+
+    gLocalChange = true;
+    chunk->setBlock(pos, id, true);
+    gLocalChange = false;
+}
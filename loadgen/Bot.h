@@ -0,0 +1,139 @@
+#ifndef LOADGEN_BOT_H
+#define LOADGEN_BOT_H
+
+#include "Stats.h"
+
+#include "net/handlers/Auth.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <util/ThreadPool.h>
+#include <world/chunk/Chunk.h>
+
+namespace net {
+class ServerConnection;
+}
+
+namespace loadgen {
+/**
+ * A simulated player. Each bot has its own server connection and thread; it walks around in a
+ * circle, keeps the chunks around it loaded, and every so often places or breaks a block.
+ */
+class Bot {
+    public:
+        /// behavior parameters shared by all bots
+        struct Config {
+            /// server to connect to
+            std::string host;
+            /// whether to save TLS sessions and resume them on the next run
+            bool resumeSessions = true;
+            /// whether to offer compressing the connection
+            bool compress = true;
+
+            /// how many blocks around the origin bots are spawned
+            float spread = 64.;
+            /// radius of the circle each bot walks along, in blocks
+            float walkRadius = 48.;
+            /// walking speed, in blocks per second
+            float walkSpeed = 4.3;
+
+            /// chunks within this (Chebyshev) distance of the bot are kept loaded
+            int chunkRadius = 1;
+            /// movement updates sent per second
+            float moveRate = 20.;
+            /// blocks placed or broken per second
+            float blockRate = 1.;
+
+            /// if nonzero, request this many chunks at once after connecting, then disconnect
+            size_t floodChunks = 0;
+            /// how long flooded chunk requests may take before they're considered stalled
+            float floodTimeout = 30.;
+        };
+
+    public:
+        Bot(const size_t index, const Config &config, const net::handler::Auth::Identity &identity,
+                Stats *stats, util::ThreadPool<std::function<void(void)>> *pool);
+        ~Bot();
+
+        /// whether the bot has stopped on its own, i.e. it finished a flood or lost its connection
+        const bool isDone() const {
+            return this->done;
+        }
+
+    private:
+        void main();
+
+        void connect();
+        void disconnect();
+
+        void move(const float dt);
+        void updateChunks();
+        void changeBlock();
+        void flood();
+
+        void chunkLoaded(const glm::ivec2 &pos, const std::shared_ptr<world::Chunk> &chunk);
+        void chunkChanged(world::Chunk *, const glm::ivec3 &, const world::Chunk::ChangeHints,
+                const uuids::uuid &);
+
+    private:
+        /// height above which bots build
+        constexpr static const int kBuildHeight = 200;
+
+        /// a chunk we've received from the server
+        struct LoadedChunk {
+            std::shared_ptr<world::Chunk> chunk;
+            /// token for our change callback
+            world::Chunk::ChangeToken token;
+        };
+        /// a chunk we've requested but not yet received
+        struct PendingChunk {
+            std::future<std::shared_ptr<world::Chunk>> future;
+            Clock::time_point requested;
+        };
+
+        /// index of this bot
+        size_t index;
+        Config config;
+        net::handler::Auth::Identity identity;
+
+        Stats *stats = nullptr;
+        util::ThreadPool<std::function<void(void)>> *pool = nullptr;
+
+        std::shared_ptr<net::ServerConnection> server;
+        /// token for the other players' movement callback
+        uint32_t movementToken = 0;
+
+        std::atomic_bool run;
+        std::atomic_bool done = false;
+        std::unique_ptr<std::thread> worker;
+
+        std::mt19937 random;
+
+        /// center of the circle we walk along
+        glm::vec2 center;
+        /// current angle along the walk circle, in radians
+        float walkAngle = 0;
+        /// current position and view angles
+        glm::vec3 position, angles;
+
+        /// time until the next block change, in seconds
+        float blockTimer = 0;
+
+        std::unordered_map<glm::ivec2, LoadedChunk> loaded;
+        std::unordered_map<glm::ivec2, PendingChunk> pending;
+};
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "Identity.h"
+
+#include <Logging.h>
+#include <io/Format.h>
+#include <util/SSLHelpers.h>
+
+#include <openssl/bio.h>
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+using namespace loadgen;
+
+/// namespace for deriving bot player ids
+static const uuids::uuid kBotNamespace = uuids::uuid::from_string("A4B3C5D2-8F0E-4C61-9B7A-2E5D41F3C8A9");
+
+/**
+ * Gets the identity for the bot with the given index. Its keys are read from the key directory,
+ * or generated and written there if this is the first time we see this bot.
+ */
+net::handler::Auth::Identity Identity::load(const std::string &keyDir, const size_t index) {
+    net::handler::Auth::Identity identity;
+
+    const auto name = f("bot-{}", index);
+    uuids::uuid_name_generator gen(kBotNamespace);
+
+    identity.id = gen(name);
+    identity.displayName = name;
+
+    // get its keys
+    std::filesystem::path dir(keyDir);
+    std::filesystem::create_directories(dir);
+
+    const auto privPath = (dir / f("{}.key", identity.id)).string();
+    const auto pubPath = (dir / f("{}.pem", identity.id)).string();
+
+    if(std::filesystem::exists(privPath)) {
+        identity.key = readKey(privPath);
+    } else {
+        identity.key = generateKey(privPath, pubPath);
+    }
+
+    return identity;
+}
+
+/**
+ * Releases the key held by an identity.
+ */
+void Identity::release(net::handler::Auth::Identity &identity) {
+    if(identity.key) {
+        EVP_PKEY_free(identity.key);
+        identity.key = nullptr;
+    }
+}
+
+/**
+ * Reads a PEM encoded private key from disk.
+ */
+evp_pkey_st *Identity::readKey(const std::string &path) {
+    auto fp = fopen(path.c_str(), "r");
+    if(!fp) {
+        throw std::runtime_error(f("Failed to open key '{}'", path));
+    }
+
+    auto key = PEM_read_PrivateKey(fp, nullptr, nullptr, nullptr);
+    fclose(fp);
+
+    if(!key) {
+        throw std::runtime_error(f("Failed to read key '{}': {}", path,
+                    util::SSLHelpers::getErrorStr()));
+    }
+
+    return key;
+}
+
+/**
+ * Generates a new keypair on the same curve the auth manager uses, and writes the private and
+ * public keys to the given paths.
+ */
+evp_pkey_st *Identity::generateKey(const std::string &privPath, const std::string &pubPath) {
+    int err;
+
+    err = OBJ_txt2nid("brainpoolP384t1");
+    XASSERT(err != NID_undef, "Failed to find ECDSA curve");
+
+    auto curve = EC_KEY_new_by_curve_name(err);
+    XASSERT(curve, "Failed to create ECDSA curve: {}", util::SSLHelpers::getErrorStr());
+
+    EC_KEY_set_asn1_flag(curve, OPENSSL_EC_NAMED_CURVE);
+
+    err = EC_KEY_generate_key(curve);
+    XASSERT(err == 1, "Failed to generate ECDSA key: {}", util::SSLHelpers::getErrorStr());
+
+    auto pkey = EVP_PKEY_new();
+    err = EVP_PKEY_assign_EC_KEY(pkey, curve);
+    XASSERT(err == 1, "Failed to assign ECDSA key: {}", util::SSLHelpers::getErrorStr());
+
+    // write out both halves
+    auto fp = fopen(privPath.c_str(), "w");
+    if(!fp) {
+        throw std::runtime_error(f("Failed to open '{}' for writing", privPath));
+    }
+    err = PEM_write_PrivateKey(fp, pkey, nullptr, nullptr, 0, nullptr, nullptr);
+    fclose(fp);
+    XASSERT(err == 1, "Failed to write private key: {}", util::SSLHelpers::getErrorStr());
+
+    fp = fopen(pubPath.c_str(), "w");
+    if(!fp) {
+        throw std::runtime_error(f("Failed to open '{}' for writing", pubPath));
+    }
+    err = PEM_write_PUBKEY(fp, pkey);
+    fclose(fp);
+    XASSERT(err == 1, "Failed to write public key: {}", util::SSLHelpers::getErrorStr());
+
+    Logging::debug("Generated keys for bot: {}", pubPath);
+    return pkey;
+}
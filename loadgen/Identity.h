@@ -0,0 +1,29 @@
+#ifndef LOADGEN_IDENTITY_H
+#define LOADGEN_IDENTITY_H
+
+#include <cstddef>
+#include <string>
+
+#include "net/handlers/Auth.h"
+
+namespace loadgen {
+/**
+ * Provides the player identities bots log in with.
+ *
+ * Each bot gets a stable player id derived from its index, and a keypair that's stored in the key
+ * directory. The server is pointed at the same directory (via `auth.localKeyDir`) so it can pick
+ * up the public keys without going through the web API; only debug builds of the server support
+ * this.
+ */
+class Identity {
+    public:
+        static net::handler::Auth::Identity load(const std::string &keyDir, const size_t index);
+        static void release(net::handler::Auth::Identity &identity);
+
+    private:
+        static evp_pkey_st *readKey(const std::string &path);
+        static evp_pkey_st *generateKey(const std::string &privPath, const std::string &pubPath);
+};
+}
+
+#endif
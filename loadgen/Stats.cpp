@@ -0,0 +1,156 @@
+#include "Stats.h"
+
+#include <Logging.h>
+#include <io/Format.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace loadgen;
+
+/**
+ * Records a latency sample.
+ */
+void Histogram::record(const Clock::duration &d) {
+    const auto ms = std::chrono::duration<float, std::milli>(d).count();
+
+    std::lock_guard<std::mutex> lg(this->lock);
+    this->samples.push_back(ms);
+}
+
+/**
+ * Calculates the median, 99th percentile and maximum of all samples recorded so far.
+ */
+Histogram::Summary Histogram::summarize() {
+    std::vector<float> sorted;
+    {
+        std::lock_guard<std::mutex> lg(this->lock);
+        sorted = this->samples;
+    }
+
+    Summary s;
+    s.count = sorted.size();
+    if(sorted.empty()) return s;
+
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&](const double p) -> double {
+        const size_t i = std::min(sorted.size() - 1, static_cast<size_t>(std::ceil(p * sorted.size())) - 1);
+        return sorted[i];
+    };
+
+    s.p50 = percentile(.5);
+    s.p99 = percentile(.99);
+    s.max = sorted.back();
+
+    return s;
+}
+
+
+
+/**
+ * A bot changed a block; remember when, so we can time when others see it.
+ */
+void Stats::blockSent(const size_t bot, const glm::ivec2 &chunk, const glm::ivec3 &pos,
+        const uuids::uuid &id) {
+    const BlockKey key(chunk.x, chunk.y, pos.x, pos.y, pos.z);
+
+    std::lock_guard<std::mutex> lg(this->blocksLock);
+    this->blocks[key] = BlockProbe{bot, id, Clock::now()};
+}
+
+/**
+ * A bot received a block change from the server. If another bot made that change, record how
+ * long it took to arrive.
+ */
+void Stats::blockReceived(const size_t bot, const glm::ivec2 &chunk, const glm::ivec3 &pos,
+        const uuids::uuid &id) {
+    const auto now = Clock::now();
+    const BlockKey key(chunk.x, chunk.y, pos.x, pos.y, pos.z);
+
+    std::lock_guard<std::mutex> lg(this->blocksLock);
+    auto it = this->blocks.find(key);
+    if(it == this->blocks.end()) return;
+
+    const auto &probe = it->second;
+    if(probe.bot == bot || probe.id != id) return;
+
+    this->blockEcho.record(now - probe.sent);
+}
+
+/**
+ * A bot is about to send its movement state.
+ */
+void Stats::movementSent(const uuids::uuid &player, const net::message::MovementState &state) {
+    std::lock_guard<std::mutex> lg(this->movementLock);
+
+    auto &probes = this->movement[player];
+    probes.emplace_back(state, Clock::now());
+
+    while(probes.size() > kMaxMovementProbes) {
+        probes.pop_front();
+    }
+}
+
+/**
+ * A bot received another player's movement. The server only forwards the most recent state it
+ * has, so we look for the matching state among the last few that were sent.
+ */
+void Stats::movementReceived(const uuids::uuid &player, const net::message::MovementState &state) {
+    const auto now = Clock::now();
+
+    std::lock_guard<std::mutex> lg(this->movementLock);
+    auto it = this->movement.find(player);
+    if(it == this->movement.end()) return;
+
+    const auto &probes = it->second;
+    for(auto p = probes.rbegin(); p != probes.rend(); p++) {
+        if(p->first == state) {
+            this->movementFanout.record(now - p->second);
+            return;
+        }
+    }
+}
+
+
+
+/**
+ * Logs the current statistics.
+ */
+void Stats::report(const std::string &title) {
+    this->prune();
+
+    Logging::info("{}: {} bots connected, {} chunk failures, {} chunks cancelled", title,
+            this->botsConnected.load(), this->chunkFailures.load(), this->chunksCancelled.load());
+    Logging::info("    {} chunks stalled, {} bots dropped", this->chunksStalled.load(),
+            this->botsDropped.load());
+
+    auto print = [](const std::string &name, Histogram &h) {
+        const auto s = h.summarize();
+        Logging::info("    {:<16} n = {:>8}  p50 = {:>9.2f} ms  p99 = {:>9.2f} ms  max = {:>9.2f} ms",
+                name, s.count, s.p50, s.p99, s.max);
+    };
+
+    print("chunk delivery", this->chunkDelivery);
+    print("block echo", this->blockEcho);
+    print("movement fan-out", this->movementFanout);
+    print("TLS handshake", this->handshake);
+    Logging::info("    {} of {} handshakes resumed a session", this->resumedHandshakes.load(),
+            this->handshake.summarize().count);
+}
+
+/**
+ * Removes block change probes old enough that nobody's going to receive them anymore.
+ */
+void Stats::prune() {
+    const auto cutoff = Clock::now() - kProbeTimeout;
+
+    std::lock_guard<std::mutex> lg(this->blocksLock);
+    for(auto it = this->blocks.begin(); it != this->blocks.end();) {
+        if(it->second.sent < cutoff) {
+            it = this->blocks.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef LOADGEN_STATS_H
+#define LOADGEN_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <uuid.h>
+
+#include <net/EPPlayerMovement.h>
+
+namespace loadgen {
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Collects latency samples and computes percentiles over them.
+ */
+class Histogram {
+    public:
+        struct Summary {
+            size_t count = 0;
+            /// all values in milliseconds
+            double p50 = 0, p99 = 0, max = 0;
+        };
+
+    public:
+        void record(const Clock::duration &d);
+        Summary summarize();
+
+    private:
+        std::mutex lock;
+        /// samples, in milliseconds
+        std::vector<float> samples;
+};
+
+/**
+ * Latency statistics shared between all bots.
+ *
+ * Since all bots live in the same process, they can share the time at which something was sent;
+ * when another bot sees it come back from the server, we know how long it took to get there.
+ */
+class Stats {
+    public:
+        /// time from requesting a chunk to it being available
+        Histogram chunkDelivery;
+        /// time from one bot changing a block to another bot receiving the change
+        Histogram blockEcho;
+        /// time from one bot sending movement to another bot receiving it
+        Histogram movementFanout;
+        /// time taken by the TLS handshake when connecting
+        Histogram handshake;
+
+        /// number of bots that are connected and authenticated
+        std::atomic_size_t botsConnected = 0;
+        /// chunk requests that failed (not including cancelled ones)
+        std::atomic_size_t chunkFailures = 0;
+        /// chunk requests we cancelled because the bot moved away
+        std::atomic_size_t chunksCancelled = 0;
+        /// flooded chunk requests that didn't complete in time
+        std::atomic_size_t chunksStalled = 0;
+        /// bots that failed to connect, or lost their connection
+        std::atomic_size_t botsDropped = 0;
+        /// connections that resumed an earlier TLS session
+        std::atomic_size_t resumedHandshakes = 0;
+
+    public:
+        void blockSent(const size_t bot, const glm::ivec2 &chunk, const glm::ivec3 &pos,
+                const uuids::uuid &id);
+        void blockReceived(const size_t bot, const glm::ivec2 &chunk, const glm::ivec3 &pos,
+                const uuids::uuid &id);
+
+        void movementSent(const uuids::uuid &player, const net::message::MovementState &state);
+        void movementReceived(const uuids::uuid &player, const net::message::MovementState &state);
+
+        void report(const std::string &title);
+
+    private:
+        void prune();
+
+    private:
+        /// sends older than this are assumed to never arrive
+        constexpr static const auto kProbeTimeout = std::chrono::seconds(10);
+        /// number of recent movement states remembered per player
+        constexpr static const size_t kMaxMovementProbes = 64;
+
+        /// a block change that's been sent
+        struct BlockProbe {
+            /// index of the bot that made the change
+            size_t bot;
+            /// id of the block it was changed to
+            uuids::uuid id;
+            Clock::time_point sent;
+        };
+        /// chunk x/z, block x/y/z
+        using BlockKey = std::tuple<int, int, int, int, int>;
+
+        std::mutex blocksLock;
+        std::map<BlockKey, BlockProbe> blocks;
+
+        std::mutex movementLock;
+        std::unordered_map<uuids::uuid, std::deque<std::pair<net::message::MovementState, Clock::time_point>>> movement;
+};
+}
+
+#endif
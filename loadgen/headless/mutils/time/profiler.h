@@ -0,0 +1,19 @@
+/**
+ * Stand-in for the MUtils profiler, for building client code without the UI. It takes precedence
+ * over the real header in the load generator's (and mesh benchmark's) include path; all profiling
+ * macros compile to nothing, except lock guards, which still have to lock.
+ */
+#pragma once
+
+#include <mutex>
+
+#define PROFILE_COL_LOCK 0xFF0000FF
+
+#define LOCK_GUARD(var, name) \
+std::lock_guard name##_lock(var)
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_SCOPE_STR(str, col)
+#define PROFILE_REGION(name)
+#define PROFILE_NAME_THREAD(name)
+#define PROFILE_HIDE_THREAD()
@@ -0,0 +1,219 @@
+#include <io/PathHelper.h>
+#include <io/Format.h>
+#include <logging/Logging.h>
+
+#include "Bot.h"
+#include "Identity.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+
+#include <lyra/lyra.hpp>
+
+/// run flag; cleared by the Ctrl+C signal handler, or once the test duration elapses
+static std::atomic_bool keepRunning = true;
+
+/**
+ * Options as read from the command line
+ */
+static struct {
+    // print usage and exit
+    bool help = false;
+
+    // server to connect to
+    std::string host = "localhost";
+    // directory holding bot keys; the server's `auth.localKeyDir` must point here too
+    std::string keyDir = io::PathHelper::appDataDir() + "/loadgen_keys";
+
+    // number of bots to simulate
+    size_t numBots = 16;
+    // how long to run the test for, in seconds
+    size_t duration = 60;
+    // interval between intermediate reports, in seconds
+    size_t reportInterval = 10;
+    // delay between connecting bots, in milliseconds
+    size_t rampDelay = 50;
+    // number of threads used for client network work
+    size_t workThreads = 4;
+    // perform full TLS handshakes rather than resuming sessions saved by earlier runs
+    bool noResume = false;
+    // don't offer compression to the server
+    bool noCompress = false;
+
+    loadgen::Bot::Config bot;
+} cmdline;
+
+/**
+ * Signal handler; stops the test early.
+ */
+static void CtrlCHandler(int sig) {
+    keepRunning = false;
+}
+
+/**
+ * Parse the command line.
+ *
+ * @return 0 if program should continue, positive to exit (but return 0), negative if error.
+ */
+static int ParseCommandLine(const int argc, const char **argv) {
+    auto cli = lyra::cli()
+        | lyra::opt(cmdline.host, "host")
+          ["-s"]["--server"]
+          (f("Server to connect to. (Default: {})", cmdline.host))
+        | lyra::opt(cmdline.keyDir, "path")
+          ["-k"]["--keys"]
+          (f("Directory bot keys are stored in; configure the (debug) server's auth.localKeyDir to the same path. (Default: {})", cmdline.keyDir))
+        | lyra::opt(cmdline.numBots, "count")
+          ["-n"]["--bots"]
+          (f("Number of simulated players. (Default: {})", cmdline.numBots))
+        | lyra::opt(cmdline.duration, "seconds")
+          ["-d"]["--duration"]
+          (f("How long to run the test. (Default: {})", cmdline.duration))
+        | lyra::opt(cmdline.reportInterval, "seconds")
+          ["--report-interval"]
+          (f("Interval between intermediate reports; 0 to disable. (Default: {})", cmdline.reportInterval))
+        | lyra::opt(cmdline.rampDelay, "ms")
+          ["--ramp"]
+          (f("Delay between connecting bots. (Default: {})", cmdline.rampDelay))
+        | lyra::opt(cmdline.workThreads, "count")
+          ["--work-threads"]
+          (f("Threads for client network work. (Default: {})", cmdline.workThreads))
+        | lyra::opt(cmdline.noResume)
+          ["--no-resume"]
+          ("Don't resume TLS sessions saved by earlier runs; each bot performs a full handshake.")
+        | lyra::opt(cmdline.noCompress)
+          ["--no-compress"]
+          ("Don't compress connections, even if the server supports it.")
+        | lyra::opt(cmdline.bot.chunkRadius, "chunks")
+          ["-r"]["--chunk-radius"]
+          (f("Radius of chunks each bot keeps loaded. (Default: {})", cmdline.bot.chunkRadius))
+        | lyra::opt(cmdline.bot.walkRadius, "blocks")
+          ["--walk-radius"]
+          (f("Radius of the circle each bot walks along. (Default: {})", cmdline.bot.walkRadius))
+        | lyra::opt(cmdline.bot.moveRate, "hz")
+          ["--move-rate"]
+          (f("Movement updates per second. (Default: {})", cmdline.bot.moveRate))
+        | lyra::opt(cmdline.bot.blockRate, "hz")
+          ["--block-rate"]
+          (f("Block changes per second per bot. (Default: {})", cmdline.bot.blockRate))
+        | lyra::opt(cmdline.bot.floodChunks, "count")
+          ["--flood"]
+          ("Instead of walking around, each bot requests this many chunks at once and disconnects once they've arrived. Fails if any of them don't.")
+        | lyra::opt(cmdline.bot.floodTimeout, "seconds")
+          ["--flood-timeout"]
+          (f("How long flooded chunks may take to arrive. (Default: {})", cmdline.bot.floodTimeout))
+        | lyra::help(cmdline.help);
+    auto result = cli.parse( { argc, argv } );
+    if(!result) {
+        std::cerr << "Failed to parse command line: " << result.errorMessage() << std::endl;
+        return -1;
+    }
+
+    if(cmdline.help) {
+        std::cout << cli;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Entry point for the load generator.
+ */
+int main(int argc, const char **argv) {
+    int err;
+
+    err = ParseCommandLine(argc, argv);
+    if(err < 0) {
+        return err;
+    } else if(err > 0) {
+        return 0;
+    }
+
+    io::PathHelper::init();
+    Logging::start();
+
+    cmdline.bot.host = cmdline.host;
+    cmdline.bot.resumeSessions = !cmdline.noResume;
+    cmdline.bot.compress = !cmdline.noCompress;
+
+    // set up bot identities
+    std::vector<net::handler::Auth::Identity> identities;
+    for(size_t i = 0; i < cmdline.numBots; i++) {
+        identities.push_back(loadgen::Identity::load(cmdline.keyDir, i));
+    }
+
+    Logging::info("Starting {} bots against {} (keys in {})", cmdline.numBots, cmdline.host,
+            cmdline.keyDir);
+
+    // we really, really do not care about SIGPIPE signals
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sigaction sigIntHandler;
+    sigIntHandler.sa_handler = CtrlCHandler;
+    sigemptyset(&sigIntHandler.sa_mask);
+    sigIntHandler.sa_flags = 0;
+    sigaction(SIGINT, &sigIntHandler, nullptr);
+
+    // start bots, spread out over a bit of time so we don't just benchmark the TLS handshake
+    loadgen::Stats stats;
+    auto pool = new util::ThreadPool<std::function<void(void)>>("Bot Worker", cmdline.workThreads);
+
+    std::vector<std::unique_ptr<loadgen::Bot>> bots;
+    for(size_t i = 0; i < cmdline.numBots && keepRunning; i++) {
+        bots.push_back(std::make_unique<loadgen::Bot>(i, cmdline.bot, identities[i], &stats, pool));
+        std::this_thread::sleep_for(std::chrono::milliseconds(cmdline.rampDelay));
+    }
+
+    // run the test
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + std::chrono::seconds(cmdline.duration);
+    auto nextReport = start + std::chrono::seconds(cmdline.reportInterval);
+
+    while(keepRunning && std::chrono::steady_clock::now() < end) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // when flooding, we're done as soon as all bots are
+        if(cmdline.bot.floodChunks && std::all_of(bots.begin(), bots.end(),
+                    [](const auto &bot) { return bot->isDone(); })) {
+            break;
+        }
+
+        if(cmdline.reportInterval && std::chrono::steady_clock::now() >= nextReport) {
+            const auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+                    std::chrono::steady_clock::now() - start);
+            stats.report(f("After {} s", elapsed.count()));
+
+            nextReport += std::chrono::seconds(cmdline.reportInterval);
+        }
+    }
+
+    // stop the bots and print the final results
+    bots.clear();
+    delete pool;
+
+    stats.report("Final results");
+
+    for(auto &identity : identities) {
+        loadgen::Identity::release(identity);
+    }
+
+    Logging::stop();
+
+    // a flood fails if any request failed or never completed, or a bot got disconnected
+    if(cmdline.bot.floodChunks && (stats.chunkFailures || stats.chunksStalled ||
+                stats.botsDropped)) {
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
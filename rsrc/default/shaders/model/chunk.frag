@@ -12,21 +12,24 @@ layout (location = 2) out vec4 gMatSpec;
 in VS_OUT {
     /// world space position of vertex
     vec3 WorldPos;
-    /// diffuse texture coordinate
-    vec2 DiffuseUv;
-    /// material info texture coordinate
-    vec2 MaterialUv;
-    /// normal texture atlas coordinate
-    vec2 NormalUv;
+    /// texture repeat coordinate; the face's texture is tiled once per unit
+    vec2 TileCoord;
     /// tangent-bitangent-normal matrix for per block normal mapping
     mat3 TBN;
     /// surface normal
     vec3 Normal;
+    /// baked ambient occlusion; the albedo is multiplied by this
+    float Occlusion;
 } fs_in;
 
 // info needed to sample the block data texture
 flat in ivec2 BlockInfoPos;
 
+/// diffuse/material texture atlas coordinates of the face's corners: (uv0, uv1), (uv2, uv3)
+flat in vec4 DiffuseCorners[2];
+/// normal texture atlas coordinates of the face's corners
+flat in vec4 NormalCorners[2];
+
 /// normal mode: 0 for vertex interpolated, 1 for sampled
 flat in ivec2 NormalFlags;
 
@@ -37,21 +40,42 @@ uniform sampler2D blockTexAtlas;
 uniform sampler2D materialTexAtlas;
 uniform sampler2D normalTexAtlas;
 
+/**
+ * Interpolates between the atlas coordinates of a face's corners.
+ */
+vec2 cornerUv(vec4 corners[2], vec2 st) {
+    return mix(mix(corners[0].st, corners[0].pq, st.x), mix(corners[1].pq, corners[1].st, st.x), st.y);
+}
+
+/**
+ * Samples an atlas such that the face's texture repeats once per unit of the tile coordinate.
+ */
+vec4 sampleTiled(sampler2D atlas, vec4 corners[2]) {
+    vec2 tile = fs_in.TileCoord;
+
+    // unlike fract(), this maps the far edge of each tile to 1 rather than 0
+    vec2 st = tile - max(ceil(tile) - 1., vec2(0));
+
+    // take gradients from the unwrapped coordinate, so tile seams don't select the smallest mip
+    vec2 unwrapped = cornerUv(corners, tile);
+    return textureGrad(atlas, cornerUv(corners, st), dFdx(unwrapped), dFdy(unwrapped));
+}
+
 void main() {
     // sample textures
-    vec4 diffuse = texture(blockTexAtlas, fs_in.DiffuseUv);
+    vec4 diffuse = sampleTiled(blockTexAtlas, DiffuseCorners);
     if(diffuse.a == 0) {
         discard;
     }
 
-    vec2 matProps = texture(materialTexAtlas, fs_in.MaterialUv).rg;
+    vec2 matProps = sampleTiled(materialTexAtlas, DiffuseCorners).rg;
 
     // handle normals
     gNormal = vec4(normalize(fs_in.Normal), 1);
 
     // calculate normal mapping, if needed
     if(NormalFlags.x == 1) {
-        vec3 normal = texture(normalTexAtlas, fs_in.NormalUv).rgb;
+        vec3 normal = sampleTiled(normalTexAtlas, NormalCorners).rgb;
         normal = normalize(normal * 2.0 - 1.0);
 
         normal = normalize(fs_in.TBN * normal);
@@ -59,7 +83,7 @@ void main() {
     }
 
     // Store material properties
-    gDiffuse = diffuse;
+    gDiffuse = vec4(diffuse.rgb * fs_in.Occlusion, diffuse.a);
     gMatSpec = vec4(matProps, 0, 1);
 }
 
@@ -1,24 +1,23 @@
 // VERTEX
 #version 400 core
 layout (location = 0) in ivec3 position;
-layout (location = 1) in uint blockId;
-layout (location = 2) in uint faceId;
-layout (location = 3) in uint vertexId;
-
+layout (location = 1) in uint inBlockId;
+layout (location = 2) in uint inFaceId;
+layout (location = 3) in uint inVertexId;
+layout (location = 4) in uvec2 inTileCoord;
+layout (location = 5) in uint inOcclusion;
 
 out VS_OUT {
     /// world space position of vertex
     vec3 WorldPos;
-    /// diffuse texture coordinate
-    vec2 DiffuseUv;
-    /// material info texture coordinate
-    vec2 MaterialUv;
-    /// normal texture atlas coordinate
-    vec2 NormalUv;
+    /// texture repeat coordinate; the face's texture is tiled once per unit
+    vec2 TileCoord;
     /// tangent-bitangent-normal matrix for per block normal mapping
     mat3 TBN;
     /// surface normal (interpolated)
     vec3 Normal;
+    /// baked ambient occlusion; the albedo is multiplied by this
+    float Occlusion;
 } vs_out;
 
 /// normal mode: 0 for vertex interpolated, 1 for sampled
@@ -26,6 +25,11 @@ flat out ivec2 NormalFlags;
 
 flat out ivec2 BlockInfoPos;
 
+/// diffuse/material texture atlas coordinates of the face's corners: (uv0, uv1), (uv2, uv3)
+flat out vec4 DiffuseCorners[2];
+/// normal texture atlas coordinates of the face's corners
+flat out vec4 NormalCorners[2];
+
 uniform mat4 model;
 uniform mat4 projectionView; // projection * view
 uniform mat3 normalMatrix; // transpose(inverse(mat3(model)))
@@ -35,27 +39,97 @@ uniform sampler2D vtxNormalTex;
 // block type data sampler (X = data type, Y = block type ID)
 uniform sampler2D blockTypeDataTex;
 
+/// when set, the face is read from the face records, rather than the vertex attributes
+uniform bool pullFaces;
+/// face records, two words each: (x | y << 8 | z << 16 | occlusion << 24,
+/// blockId | (s - 1) << 16 | (t - 1) << 22 | face << 28)
+uniform usamplerBuffer faceDataTex;
+
+// corners of each face of a unit cube, in vertex ID order
+const ivec3 kFaceCorners[24] = ivec3[24](
+    ivec3(0,0,0), ivec3(1,0,0), ivec3(1,0,1), ivec3(0,0,1),
+    ivec3(0,1,1), ivec3(1,1,1), ivec3(1,1,0), ivec3(0,1,0),
+    ivec3(0,0,1), ivec3(0,1,1), ivec3(0,1,0), ivec3(0,0,0),
+    ivec3(1,0,0), ivec3(1,1,0), ivec3(1,1,1), ivec3(1,0,1),
+    ivec3(0,1,0), ivec3(1,1,0), ivec3(1,0,0), ivec3(0,0,0),
+    ivec3(0,0,1), ivec3(1,0,1), ivec3(1,1,1), ivec3(0,1,1)
+);
+// axes along the edges of each face, from vertex 0 to 1, and from vertex 1 to 2
+const ivec2 kTileAxes[6] = ivec2[6](
+    ivec2(0, 2), ivec2(0, 2), ivec2(1, 2), ivec2(1, 2), ivec2(0, 1), ivec2(0, 1)
+);
+// vertex IDs of the two triangles of a face
+const uint kFaceVertices[6] = uint[6](0u, 1u, 2u, 2u, 3u, 0u);
+
+// brightness for each baked occlusion level, from fully occluded to unoccluded
+const float kOcclusionLevels[4] = float[4](0.4, 0.6, 0.8, 1.0);
+
+/**
+ * Decodes the vertex from the face record of the face it belongs to. Unused records have no
+ * extent, so they turn into degenerate triangles.
+ */
+void pullVertex(out vec3 pos, out uint block, out uint face, out uint vtx, out uvec2 tile,
+        out uint occlusion) {
+    uvec2 record = texelFetch(faceDataTex, gl_VertexID / 6).xy;
+
+    face = (record.y >> 28) & 0x7u;
+    block = record.y & 0xFFFFu;
+
+    // split along the diagonal between the less occluded corners (see GlobuleMesh::writeQuad())
+    uint corners = record.x >> 24;
+    uvec4 ao = uvec4(corners, corners >> 2, corners >> 4, corners >> 6) & uvec4(0x3u);
+
+    vtx = (kFaceVertices[gl_VertexID % 6] + ((ao.x + ao.z) < (ao.y + ao.w) ? 1u : 0u)) & 0x3u;
+    occlusion = ao[vtx];
+
+    uvec2 tiles = uvec2((record.y >> 16) & 0x3Fu, (record.y >> 22) & 0x3Fu) + uvec2(1u);
+    if(block == 0u) {
+        tiles = uvec2(0u);
+    }
+    tile = tiles * uvec2(vtx == 1u || vtx == 2u, vtx >= 2u);
+
+    ivec3 extent = ivec3(1);
+    extent[kTileAxes[face].x] = int(tiles.x);
+    extent[kTileAxes[face].y] = int(tiles.y);
+
+    ivec3 origin = ivec3(record.x & 0xFFu, (record.x >> 8) & 0xFFu, (record.x >> 16) & 0xFFu);
+    pos = vec3(origin + (kFaceCorners[(face * 4u) + vtx] * extent));
+}
+
 void main() {
+    // get the vertex, either from the attributes or the face records
+    vec3 posConverted;
+    uint blockId, faceId, vertexId, occlusion;
+    uvec2 tileCoord;
+
+    if(pullFaces) {
+        pullVertex(posConverted, blockId, faceId, vertexId, tileCoord, occlusion);
+    } else {
+        posConverted = vec3(position) / vec3(0x7F);
+        blockId = inBlockId;
+        faceId = inFaceId;
+        vertexId = inVertexId;
+        tileCoord = inTileCoord;
+        occlusion = inOcclusion;
+    }
+
+    vs_out.Occlusion = kOcclusionLevels[min(occlusion, 3u)];
+
     // sample normals
     vec3 normal = texelFetch(vtxNormalTex, ivec2(vertexId, faceId), 0).rgb;
 
     // read the texture coordinates. see block registry docs on how this texture is formatted
     BlockInfoPos = ivec2(0, blockId);
 
-    uint faceTexId = min(2, faceId);
-    ivec2 uvInfoCoords = ivec2((faceId * 2) + vertexId/2, BlockInfoPos.y);
+    // all four corners are read, so the fragment shader can tile the texture across merged faces
+    ivec2 uvInfoCoords = ivec2(faceId * 2, BlockInfoPos.y);
 
-    if(vertexId == 0 || vertexId == 2) { // odd indices are the first two components
-        vs_out.DiffuseUv = texelFetch(blockTypeDataTex, uvInfoCoords, 0).st;
-        vs_out.MaterialUv = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(12, 0), 0).st;
-        vs_out.NormalUv = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(25, 0), 0).st;
-    } else {
-        vs_out.DiffuseUv = texelFetch(blockTypeDataTex, uvInfoCoords, 0).pq;
-        vs_out.MaterialUv = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(12, 0), 0).pq;
-        vs_out.NormalUv = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(25, 0), 0).pq;
-    }
-    vs_out.MaterialUv = vec2(0, 0);
-    vs_out.MaterialUv = vs_out.DiffuseUv;
+    DiffuseCorners[0] = texelFetch(blockTypeDataTex, uvInfoCoords, 0);
+    DiffuseCorners[1] = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(1, 0), 0);
+    NormalCorners[0] = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(25, 0), 0);
+    NormalCorners[1] = texelFetch(blockTypeDataTex, uvInfoCoords + ivec2(26, 0), 0);
+
+    vs_out.TileCoord = vec2(tileCoord);
 
     // read the "normal map enabled" flag
     vec3 normFlags = texelFetch(blockTypeDataTex, ivec2(24, BlockInfoPos.y), 0).xyz;
@@ -79,7 +153,6 @@ void main() {
     }
 
     // Forward the world position and texture coordinates
-    vec3 posConverted = vec3(position) / vec3(0x7F);
     vec4 worldPos = model * vec4(posConverted, 1);
     vs_out.WorldPos = worldPos.xyz;
 
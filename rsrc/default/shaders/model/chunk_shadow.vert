@@ -8,9 +8,73 @@ layout (location = 3) in uint vertexId;
 uniform mat4 model;
 uniform mat4 projectionView; // projection * view
 
+/// when set, the face is read from the face records, rather than the vertex attributes
+uniform bool pullFaces;
+/// face records, two words each: (x | y << 8 | z << 16 | occlusion << 24,
+/// blockId | (s - 1) << 16 | (t - 1) << 22 | face << 28)
+uniform usamplerBuffer faceDataTex;
+
+// corners of each face of a unit cube, in vertex ID order
+const ivec3 kFaceCorners[24] = ivec3[24](
+    ivec3(0,0,0), ivec3(1,0,0), ivec3(1,0,1), ivec3(0,0,1),
+    ivec3(0,1,1), ivec3(1,1,1), ivec3(1,1,0), ivec3(0,1,0),
+    ivec3(0,0,1), ivec3(0,1,1), ivec3(0,1,0), ivec3(0,0,0),
+    ivec3(1,0,0), ivec3(1,1,0), ivec3(1,1,1), ivec3(1,0,1),
+    ivec3(0,1,0), ivec3(1,1,0), ivec3(1,0,0), ivec3(0,0,0),
+    ivec3(0,0,1), ivec3(1,0,1), ivec3(1,1,1), ivec3(0,1,1)
+);
+// axes along the edges of each face, from vertex 0 to 1, and from vertex 1 to 2
+const ivec2 kTileAxes[6] = ivec2[6](
+    ivec2(0, 2), ivec2(0, 2), ivec2(1, 2), ivec2(1, 2), ivec2(0, 1), ivec2(0, 1)
+);
+// vertex IDs of the two triangles of a face
+const uint kFaceVertices[6] = uint[6](0u, 1u, 2u, 2u, 3u, 0u);
+
+/**
+ * Decodes the vertex from the face record of the face it belongs to. Unused records have no
+ * extent, so they turn into degenerate triangles.
+ */
+void pullVertex(out vec3 pos, out uint block, out uint face, out uint vtx, out uvec2 tile,
+        out uint occlusion) {
+    uvec2 record = texelFetch(faceDataTex, gl_VertexID / 6).xy;
+
+    face = (record.y >> 28) & 0x7u;
+    block = record.y & 0xFFFFu;
+
+    // split along the diagonal between the less occluded corners (see GlobuleMesh::writeQuad())
+    uint corners = record.x >> 24;
+    uvec4 ao = uvec4(corners, corners >> 2, corners >> 4, corners >> 6) & uvec4(0x3u);
+
+    vtx = (kFaceVertices[gl_VertexID % 6] + ((ao.x + ao.z) < (ao.y + ao.w) ? 1u : 0u)) & 0x3u;
+    occlusion = ao[vtx];
+
+    uvec2 tiles = uvec2((record.y >> 16) & 0x3Fu, (record.y >> 22) & 0x3Fu) + uvec2(1u);
+    if(block == 0u) {
+        tiles = uvec2(0u);
+    }
+    tile = tiles * uvec2(vtx == 1u || vtx == 2u, vtx >= 2u);
+
+    ivec3 extent = ivec3(1);
+    extent[kTileAxes[face].x] = int(tiles.x);
+    extent[kTileAxes[face].y] = int(tiles.y);
+
+    ivec3 origin = ivec3(record.x & 0xFFu, (record.x >> 8) & 0xFFu, (record.x >> 16) & 0xFFu);
+    pos = vec3(origin + (kFaceCorners[(face * 4u) + vtx] * extent));
+}
+
 void main() {
-    // Forward the world position and texture coordinates
-    vec3 posConverted = vec3(position) / vec3(0x7F);
+    // get the vertex position, either from the attributes or the face records
+    vec3 posConverted;
+
+    if(pullFaces) {
+        uint block, face, vtx, occlusion;
+        uvec2 tile;
+        pullVertex(posConverted, block, face, vtx, tile, occlusion);
+    } else {
+        posConverted = vec3(position) / vec3(0x7F);
+    }
+
+    // Forward the world position
     vec4 worldPos = model * vec4(posConverted, 1);
 
     // Set position of the vertex pls
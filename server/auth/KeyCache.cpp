@@ -1,10 +1,13 @@
 #include "KeyCache.h"
 
 #include <Logging.h>
+#include <io/ConfigManager.h>
 #include <io/PathHelper.h>
+#include <util/Metrics.h>
 #include <util/REST.h>
 #include <util/SSLHelpers.h>
 #include <util/SQLite.h>
+#include <util/Thread.h>
 
 #include <cmrc/cmrc.hpp>
 
@@ -13,8 +16,13 @@
 #include <openssl/evp.h>
 #include <openssl/pem.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
 #include <stdexcept>
+#include <unordered_set>
 
 CMRC_DECLARE(server_sql);
 
@@ -55,135 +63,455 @@ KeyCache::KeyCache() {
         }
     }
 
-    // set up the REST handler
+    /*
+     * Local key directory; this is used by the load generator to stand in for the web API. Since
+     * it lets anyone with write access to the directory log in as any player, it's only available
+     * in debug builds.
+     */
+#ifdef NDEBUG
+    if(!io::ConfigManager::get("auth.localKeyDir", "").empty()) {
+        Logging::error("Ignoring auth.localKeyDir; local keys are only supported in debug builds");
+    }
+#else
+    this->localKeyDir = io::ConfigManager::get("auth.localKeyDir", "");
+    if(!this->localKeyDir.empty()) {
+        Logging::warn("Accepting player keys from local directory '{}'", this->localKeyDir);
+    }
+#endif
+
+    // API endpoint; can be pointed at a local stand-in
 #ifdef NDEBUG
     #error "TODO: define API endpoint for prod"
 #else
-    this->api = new util::REST("http://cubeland-api.test");
+    this->apiUrl = io::ConfigManager::get("auth.apiUrl", "http://cubeland-api.test");
 #endif
+
+    // cache lifetimes
+    this->keyTtl = std::chrono::seconds(io::ConfigManager::getUnsigned("auth.keyTtl", 60*60*24*7));
+    this->refreshWindow = std::chrono::seconds(io::ConfigManager::getUnsigned("auth.keyRefreshWindow",
+                60*60*24));
+    this->negativeTtl = std::chrono::seconds(io::ConfigManager::getUnsigned("auth.negativeTtl", 60*5));
+    this->errorTtl = std::chrono::seconds(io::ConfigManager::getUnsigned("auth.errorTtl", 10));
+
+    // start the workers
+    const auto fetchThreads = io::ConfigManager::getUnsigned("auth.fetchThreads", 4);
+    this->fetchPool = new util::ThreadPool<std::function<void(void)>>("Key Fetcher", fetchThreads);
+
+    this->dbRun = true;
+    this->dbThread = std::make_unique<std::thread>(&KeyCache::dbMain, this);
 }
 
 /**
  * Tears down all of our resources.
+ *
+ * Lookups that are still in progress fail, as if the key couldn't be found.
  */
 KeyCache::~KeyCache() {
     int err;
 
+    // stop the database thread first, since it queues fetches
+    this->dbRun = false;
+    this->dbQueue.enqueue(DbRequest());
+    this->dbThread->join();
+
+    // then the fetchers; the database writes they queue are dropped
+    delete this->fetchPool;
+    this->fetchPool = nullptr;
+
+    // fail all lookups that haven't completed
+    std::vector<Callback> callbacks;
+
+    for(auto &shard : this->shards) {
+        std::lock_guard<std::mutex> lg(shard.lock);
+
+        for(auto &[id, waiting] : shard.pending) {
+            std::move(waiting.begin(), waiting.end(), std::back_inserter(callbacks));
+        }
+        shard.pending.clear();
+    }
+
+    if(!callbacks.empty()) {
+        Logging::debug("Failing {} outstanding key lookups", callbacks.size());
+    }
+
+    for(const auto &callback : callbacks) {
+        try {
+            callback(nullptr);
+        } catch(std::exception &e) {
+            Logging::error("Key lookup callback failed: {}", e.what());
+        }
+    }
+
     // close db
     err = sqlite3_close(this->db);
     if(err != SQLITE_OK) {
         Logging::warn("Failed to close key cache: {}", err);
     }
+}
+
 
-    // release keys
-    std::lock_guard<std::mutex> lg(this->decodedLock);
-    for(const auto &[id, key] : this->decoded) {
-        EVP_PKEY_free(key);
-    }
 
-    // clean up the remaining stuff
-    delete this->api;
+/**
+ * Counts a key lookup that was satisfied by the given source.
+ */
+static void countLookup(const std::string &source) {
+    util::Metrics::counter("cubeland_key_cache_lookups_total", "Player key lookups, by where the key was found",
+            {{"source", source}})->inc();
 }
 
+/**
+ * Looks up the public key for the given player.
+ *
+ * If the key is in memory, the callback is invoked right away; keys that are due for a refresh
+ * are then refreshed in the background. Otherwise, the lookup is handed to the database thread,
+ * unless one for the same player is already in progress, in which case we'll simply be notified
+ * along with it.
+ */
+void KeyCache::getKey(const uuids::uuid &id, const Callback &callback) {
+    auto &shard = this->shardFor(id);
+    const auto now = Clock::now();
+
+    Key key = nullptr;
+    bool cached = false, refresh = false;
+
+    {
+        std::lock_guard<std::mutex> lg(shard.lock);
+
+        auto it = shard.entries.find(id);
+        if(it != shard.entries.end() && it->second.expires > now) {
+            auto &entry = it->second;
+
+            cached = true;
+            key = entry.key;
+
+            if(key && now >= entry.refreshAt && !entry.refreshing) {
+                entry.refreshing = true;
+                refresh = true;
+            }
+        } else {
+            // drop the expired entry; it's replaced once the lookup completes
+            if(it != shard.entries.end()) {
+                shard.entries.erase(it);
+            }
+
+            auto &waiting = shard.pending[id];
+            waiting.push_back(callback);
+
+            if(waiting.size() > 1) {
+                countLookup("joined");
+                return;
+            }
+        }
+    }
 
+    // not in memory, so look it up
+    if(!cached) {
+        DbRequest req;
+        req.id = id;
+        this->dbQueue.enqueue(req);
+        return;
+    }
+
+    countLookup(key ? "memory" : "negative");
+    if(refresh) {
+        this->refresh(id);
+    }
+
+    callback(key);
+}
 
 /**
- * Attempt to retrieve the public key for the given player.
- *
- * We'll first check our cache of already decoded keys and return it, then the on-disk cache, and
- * if neither of those contains the key, we'll make a trip to the REST service and save it to
- * the disk cache.
- *
- * TODO: We need to investigate better locking so that multiple concurrent clients don't race
+ * Stores the result of a lookup in the in-memory cache, and notifies everyone waiting for it.
  */
-evp_pkey_st *KeyCache::getKey(const uuids::uuid &id) {
-    using namespace rapidjson;
+void KeyCache::complete(const uuids::uuid &id, const Key &key, const Clock::time_point expires,
+        const std::string &source) {
+    auto &shard = this->shardFor(id);
+    std::vector<Callback> callbacks;
 
-    // try to get it out of the cache
     {
-        std::lock_guard<std::mutex> lg(this->decodedLock);
-        if(this->decoded.contains(id)) {
-            return this->decoded[id];
+        std::lock_guard<std::mutex> lg(shard.lock);
+
+        auto &entry = shard.entries[id];
+        entry.key = key;
+        entry.expires = expires;
+        entry.refreshAt = key ? (expires - this->refreshWindow) : expires;
+        entry.refreshing = false;
+
+        auto it = shard.pending.find(id);
+        if(it != shard.pending.end()) {
+            callbacks = std::move(it->second);
+            shard.pending.erase(it);
         }
     }
 
-    // query the database
-    auto dbKey = this->readDbKey(id);
-    if(dbKey) {
-        auto key = this->decodePem(*dbKey);
+    countLookup(source);
 
-        std::lock_guard<std::mutex> lg(this->decodedLock);
-        this->decoded[id] = key;
-        return key;
+    for(const auto &callback : callbacks) {
+        try {
+            callback(key);
+        } catch(std::exception &e) {
+            Logging::error("Key lookup callback for {} failed: {}", id, e.what());
+        }
     }
+}
+
+/**
+ * Fetches a new copy of a key from the web API in the background.
+ */
+void KeyCache::refresh(const uuids::uuid &id) {
+    this->fetchPool->queueWorkItem([&, id] {
+        this->fetchKey(id, true);
+    });
+}
 
-    // make REST request
-    Document response;
-    this->api->request(f("/user/{}/pubkey", id), response, false);
 
-    // interpret response
-    if(!response["success"].GetBool()) {
-        throw std::runtime_error("REST request failed");
+
+/**
+ * Removes all expired entries from the in-memory cache, so keys of players that don't come back
+ * don't stay in memory forever.
+ */
+void KeyCache::purgeExpired() {
+    const auto now = Clock::now();
+    size_t removed = 0;
+
+    for(auto &shard : this->shards) {
+        std::lock_guard<std::mutex> lg(shard.lock);
+        removed += std::erase_if(shard.entries, [&](const auto &entry) {
+            return entry.second.expires <= now;
+        });
     }
 
-    // store the key in our db and store it for later
-    const auto apiKey = response["key"].GetString();
-    auto key = this->decodePem(apiKey);
+    if(removed) {
+        Logging::trace("Purged {} expired keys from cache", removed);
+    }
+}
 
-    this->writeDbKey(id, apiKey);
+/**
+ * Main loop of the database thread.
+ *
+ * We dequeue as many requests as are available at once; all writes are performed, and the reads
+ * are then satisfied by a single query. Every so often, expired entries are purged from the
+ * in-memory cache afterwards.
+ */
+void KeyCache::dbMain() {
+    util::Thread::setName("Key Cache DB");
+
+    std::vector<DbRequest> requests(kMaxDbBatch);
+    std::vector<uuids::uuid> reads;
+    auto nextPurge = Clock::now() + kPurgeInterval;
+
+    while(this->dbRun) {
+        // wake up at least once per purge interval, even if there are no requests
+        const auto num = this->dbQueue.wait_dequeue_bulk_timed(requests.begin(), kMaxDbBatch,
+                kPurgeInterval);
+        reads.clear();
+
+        for(size_t i = 0; i < num; i++) {
+            const auto &req = requests[i];
+
+            if(req.pem) {
+                try {
+                    this->writeDbKey(req.id, *req.pem, req.expires);
+                } catch(std::exception &e) {
+                    Logging::error("Failed to cache key for {}: {}", req.id, e.what());
+                }
+            } else if(!req.id.is_nil()) {
+                reads.push_back(req.id);
+            }
+        }
 
-    std::lock_guard<std::mutex> lg(this->decodedLock);
-    this->decoded[id] = key;
-    return key;
+        if(!reads.empty()) {
+            this->readDbKeys(reads);
+        }
+
+        if(Clock::now() >= nextPurge) {
+            this->purgeExpired();
+            nextPurge = Clock::now() + kPurgeInterval;
+        }
+    }
 }
 
 /**
- * Searches the key cache for a key with the given UUID. If found, we return the PEM-encoded public
- * key string.
+ * Resolves a batch of lookups from the local key directory (if configured) and the database. Any
+ * keys not found there are fetched from the web API.
  */
-std::optional<std::string> KeyCache::readDbKey(const uuids::uuid &id) {
+void KeyCache::readDbKeys(const std::vector<uuids::uuid> &ids) {
     using namespace util;
 
-    int err;
+    const auto now = Clock::now();
+    std::vector<uuids::uuid> toQuery;
+
+    // check the local key directory
+    for(const auto &id : ids) {
+        try {
+            auto localKey = this->readLocalKey(id);
+            if(localKey) {
+                this->complete(id, this->decodePem(*localKey), now + this->keyTtl, "local");
+                continue;
+            }
+        } catch(std::exception &e) {
+            Logging::error("Failed to read local key for {}: {}", id, e.what());
+        }
+
+        toQuery.push_back(id);
+    }
+    if(toQuery.empty()) return;
+
+    // query the database for all remaining keys at once
+    std::unordered_set<uuids::uuid> found;
     sqlite3_stmt *stmt = nullptr;
 
-    // prepare query and bind the key
-    SQLite::prepare(this->db, "SELECT id,pubkey FROM keys_v1 WHERE uuid=?", &stmt);
-    SQLite::bindColumn(stmt, 1, id);
+    try {
+        std::string query = "SELECT uuid,pubkey,expires FROM keys_v1 WHERE uuid IN (?";
+        for(size_t i = 1; i < toQuery.size(); i++) {
+            query.append(",?");
+        }
+        query.append(")");
 
-    // execute it
-    err = sqlite3_step(stmt);
-    if(err != SQLITE_ROW && err != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
-        throw std::runtime_error(f("failed to step ({}): {}", err, sqlite3_errmsg(this->db)));
+        SQLite::prepare(this->db, query, &stmt);
+        for(size_t i = 0; i < toQuery.size(); i++) {
+            SQLite::bindColumn(stmt, i + 1, toQuery[i]);
+        }
+
+        int err;
+        while((err = sqlite3_step(stmt)) == SQLITE_ROW) {
+            uuids::uuid id;
+            std::string pem;
+            int64_t expiresSecs;
+
+            if(!SQLite::getColumn(stmt, 0, id)) continue;
+            SQLite::getColumn(stmt, 1, pem);
+            SQLite::getColumn(stmt, 2, expiresSecs);
+
+            // use stale keys for a little while, but refresh them on their next use
+            auto expires = Clock::time_point(std::chrono::seconds(expiresSecs));
+            expires = std::max(expires, now + this->refreshWindow);
+
+            try {
+                this->complete(id, this->decodePem(pem), expires, "db");
+                found.insert(id);
+            } catch(std::exception &e) {
+                Logging::error("Failed to decode cached key for {}: {}", id, e.what());
+            }
+        }
+
+        if(err != SQLITE_DONE) {
+            throw std::runtime_error(f("failed to step ({}): {}", err, sqlite3_errmsg(this->db)));
+        }
+    } catch(std::exception &e) {
+        Logging::error("Failed to read cached keys: {}", e.what());
     }
 
-    if(err != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
-        return std::nullopt;
+    sqlite3_finalize(stmt);
+
+    // fetch the rest from the API
+    for(const auto &id : toQuery) {
+        if(found.contains(id)) continue;
+
+        this->fetchPool->queueWorkItem([&, id] {
+            this->fetchKey(id, false);
+        });
     }
+}
 
-    // extract the key string
-    std::string keyStr;
-    SQLite::getColumn(stmt, 1, keyStr);
+/**
+ * Fetches a player's key from the web API, and writes it to the database. Players unknown to the
+ * API are negatively cached.
+ *
+ * If this is a background refresh and it fails, we'll keep using the current key (until it
+ * expires) and retry later.
+ */
+void KeyCache::fetchKey(const uuids::uuid &id, const bool isRefresh) {
+    using namespace rapidjson;
 
-    sqlite3_finalize(stmt);
-    return keyStr;
+    // each fetcher thread gets its own handle, since they can't be shared
+    thread_local std::unique_ptr<util::REST> api;
+    if(!api) {
+        api = std::make_unique<util::REST>(this->apiUrl);
+    }
+
+    const auto now = Clock::now();
+
+    try {
+        Document response;
+        api->request(f("/user/{}/pubkey", id), response, false);
+
+        // interpret response
+        if(!response.IsObject() || !response.HasMember("success") || !response["success"].GetBool()) {
+            this->complete(id, nullptr, now + this->negativeTtl, "unknown");
+            return;
+        }
+
+        const std::string pem = response["key"].GetString();
+        auto key = this->decodePem(pem);
+        const auto expires = now + this->keyTtl;
+
+        this->complete(id, key, expires, isRefresh ? "refresh" : "api");
+
+        // store it in the database
+        DbRequest req;
+        req.id = id;
+        req.pem = pem;
+        req.expires = expires;
+        this->dbQueue.enqueue(req);
+    } catch(std::exception &e) {
+        Logging::error("Failed to fetch key for {}: {}", id, e.what());
+
+        if(isRefresh) {
+            auto &shard = this->shardFor(id);
+            std::lock_guard<std::mutex> lg(shard.lock);
+
+            auto &entry = shard.entries[id];
+            entry.refreshing = false;
+            entry.refreshAt = now + this->errorTtl;
+        } else {
+            this->complete(id, nullptr, now + this->errorTtl, "error");
+        }
+    }
 }
 
 /**
- * Writes a new key to the cache.
+ * Reads the PEM-encoded public key for the given player from the local key directory. Keys are
+ * stored as `<uuid>.pem` files; they are never written to the key cache.
+ *
+ * Release builds never read local keys.
  */
-void KeyCache::writeDbKey(const uuids::uuid &id, const std::string &keyStr) {
+std::optional<std::string> KeyCache::readLocalKey(const uuids::uuid &id) {
+#ifdef NDEBUG
+    return std::nullopt;
+#else
+    if(this->localKeyDir.empty()) return std::nullopt;
+
+    std::filesystem::path path(this->localKeyDir);
+    path /= f("{}.pem", id);
+
+    std::ifstream file(path);
+    if(!file.good()) return std::nullopt;
+
+    std::stringstream str;
+    str << file.rdbuf();
+    return str.str();
+#endif
+}
+
+/**
+ * Writes a key to the database, replacing any previous key for the player.
+ */
+void KeyCache::writeDbKey(const uuids::uuid &id, const std::string &keyStr,
+        const Clock::time_point expires) {
     using namespace util;
 
     int err;
     sqlite3_stmt *stmt = nullptr;
 
+    const int64_t expiresSecs = std::chrono::duration_cast<std::chrono::seconds>(
+            expires.time_since_epoch()).count();
+
     // prepare query and bind the key
-    SQLite::prepare(this->db, "INSERT INTO keys_v1 (uuid,pubkey) VALUES (?, ?)", &stmt);
+    SQLite::prepare(this->db, "INSERT OR REPLACE INTO keys_v1 (uuid,pubkey,modified,expires) VALUES (?, ?, CURRENT_TIMESTAMP, ?)", &stmt);
     SQLite::bindColumn(stmt, 1, id);
     SQLite::bindColumn(stmt, 2, keyStr);
+    SQLite::bindColumn(stmt, 3, expiresSecs);
 
     err = sqlite3_step(stmt);
     if(err != SQLITE_ROW && err != SQLITE_DONE) {
@@ -196,9 +524,9 @@ void KeyCache::writeDbKey(const uuids::uuid &id, const std::string &keyStr) {
 
 
 /**
- * Decodes a PEM encoded key.
+ * Decodes a PEM encoded key. The key is freed once the last reference to it goes away.
  */
-evp_pkey_st *KeyCache::decodePem(const std::string &keyStr) {
+KeyCache::Key KeyCache::decodePem(const std::string &keyStr) {
     int err;
 
     // load the key string into a BIO
@@ -227,5 +555,5 @@ evp_pkey_st *KeyCache::decodePem(const std::string &keyStr) {
     }
 
     BIO_free(bio);
-    return key;
+    return Key(key, EVP_PKEY_free);
 }
@@ -1,28 +1,49 @@
 #ifndef AUTH_KEYCACHE_H
 #define AUTH_KEYCACHE_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <uuid.h>
+#include <blockingconcurrentqueue.h>
+
+#include <util/ThreadPool.h>
 
 struct sqlite3;
 
 struct evp_pkey_st;
 
-namespace util {
-class REST;
-}
-
 namespace auth {
 /**
  * Loads client keys from the web API and caches them locally.
  *
- * TODO: we should handle expiring keys out of the cache. default TTL of cache keys should be
- * something like 7 days
+ * Lookups are asynchronous: the callback is invoked as soon as the key is available, either right
+ * away (if it's in memory) or from one of the cache's worker threads. Concurrent lookups for the
+ * same player share a single fetch.
+ *
+ * In memory, keys live in a sharded map so lookups for different players rarely contend. Misses
+ * go to the database thread, which reads all queued lookups in a single query; keys not in the
+ * database are fetched from the API on a small thread pool, and then written back. Players the
+ * API doesn't know are cached as such for a while, and keys are refreshed in the background
+ * before they expire.
  */
 class KeyCache {
+    public:
+        /// public key of a player
+        using Key = std::shared_ptr<evp_pkey_st>;
+        /// invoked with the player's key once it's resolved; null if it couldn't be found
+        using Callback = std::function<void(Key)>;
+
     public:
         static void init() {
             gShared = new KeyCache;
@@ -32,35 +53,107 @@ class KeyCache {
             gShared = nullptr;
         }
 
-        /// returns the public key for the given client
-        static evp_pkey_st *get(const uuids::uuid &id) {
-            return gShared->getKey(id);
+        /// looks up the public key for the given client
+        static void get(const uuids::uuid &id, const Callback &callback) {
+            gShared->getKey(id, callback);
         }
 
+    private:
+        using Clock = std::chrono::system_clock;
+
+        /// A cached key; a null key indicates the player is unknown
+        struct Entry {
+            Key key = nullptr;
+
+            /// after this time, the entry is no longer used
+            Clock::time_point expires;
+            /// after this time, the key is refreshed in the background on its next use
+            Clock::time_point refreshAt;
+            /// set while a background refresh is underway
+            bool refreshing = false;
+        };
+
+        /// A portion of the in-memory cache
+        struct Shard {
+            std::mutex lock;
+            /// cached keys
+            std::unordered_map<uuids::uuid, Entry> entries;
+            /// callbacks waiting for keys being fetched
+            std::unordered_map<uuids::uuid, std::vector<Callback>> pending;
+        };
+
+        /// Request for the database thread; it's a write if the key is set
+        struct DbRequest {
+            uuids::uuid id;
+            std::optional<std::string> pem;
+            Clock::time_point expires;
+        };
+
+        /// Number of shards in the in-memory cache
+        constexpr static const size_t kNumShards = 16;
+        /// Maximum number of keys read from the database in one query
+        constexpr static const size_t kMaxDbBatch = 32;
+        /// Minimum time between sweeps of expired entries out of the in-memory cache
+        constexpr static const std::chrono::minutes kPurgeInterval{5};
+
     private:
         KeyCache();
         ~KeyCache();
 
-        evp_pkey_st *getKey(const uuids::uuid &);
+        void getKey(const uuids::uuid &, const Callback &);
 
-        std::optional<std::string> readDbKey(const uuids::uuid &);
-        void writeDbKey(const uuids::uuid &, const std::string &);
+        Shard &shardFor(const uuids::uuid &id) {
+            return this->shards[std::hash<uuids::uuid>{}(id) % kNumShards];
+        }
+
+        void complete(const uuids::uuid &, const Key &, const Clock::time_point expires,
+                const std::string &source);
+        void refresh(const uuids::uuid &);
+
+        void purgeExpired();
+
+        void dbMain();
+        void readDbKeys(const std::vector<uuids::uuid> &);
+        void writeDbKey(const uuids::uuid &, const std::string &, const Clock::time_point);
 
-        evp_pkey_st *decodePem(const std::string &);
+        void fetchKey(const uuids::uuid &, const bool isRefresh);
+
+        std::optional<std::string> readLocalKey(const uuids::uuid &);
+        Key decodePem(const std::string &);
 
     private:
         static KeyCache *gShared;
 
     private:
-        sqlite3 *db = nullptr;
+        /// in-memory cache
+        std::array<Shard, kNumShards> shards;
 
-        /// REST handler for accessing Cubeland API
-        util::REST *api = nullptr;
-
-        /// mapping of player id -> SSL key
-        std::unordered_map<uuids::uuid, evp_pkey_st *> decoded;
-        /// lock protecting the list of decoded keys
-        std::mutex decodedLock;
+        /// database connection; only accessed from the database thread
+        sqlite3 *db = nullptr;
+        /// database thread
+        std::unique_ptr<std::thread> dbThread;
+        /// run flag for the database thread
+        std::atomic_bool dbRun;
+        /// reads and writes for the database thread
+        moodycamel::BlockingConcurrentQueue<DbRequest> dbQueue;
+
+        /// threads making requests to the web API
+        util::ThreadPool<std::function<void(void)>> *fetchPool = nullptr;
+
+        /// directory containing `<uuid>.pem` public keys to accept without asking the API; this
+        /// is only supported in debug builds
+        std::string localKeyDir;
+        /// base URL of the web API
+        std::string apiUrl;
+
+        /// how long keys are cached
+        std::chrono::seconds keyTtl;
+        /// how long before expiry keys are refreshed
+        std::chrono::seconds refreshWindow;
+        /// how long players unknown to the API are remembered as such
+        std::chrono::seconds negativeTtl;
+        /// how long failed fetches (network errors and the like) are cached
+        std::chrono::seconds errorTtl;
 };
 }
 
@@ -8,6 +8,7 @@
 #include <world/WorldSource.h>
 
 #include "auth/KeyCache.h"
+#include "metrics/Exporter.h"
 #include "net/Listener.h"
 
 #include <version.h>
@@ -142,6 +143,14 @@ int main(int argc, const char **argv) {
     auto source = LoadWorld(worldPath);
     auto listener = new net::Listener(source);
 
+    // periodically export metrics, if desired
+    metrics::Exporter *exporter = nullptr;
+    const auto metricsPath = io::ConfigManager::get("metrics.path", "");
+    if(!metricsPath.empty()) {
+        const auto interval = io::ConfigManager::getUnsigned("metrics.interval", 15);
+        exporter = new metrics::Exporter(metricsPath, interval);
+    }
+
     // we really, really do not care about SIGPIPE signals
     signal(SIGPIPE, SIG_IGN);
 
@@ -163,6 +172,7 @@ int main(int argc, const char **argv) {
     // clean up
     Logging::info("Stopping server...");
 
+    delete exporter;
     delete listener;
     delete source;
 
@@ -198,5 +208,9 @@ static world::WorldSource *LoadWorld(const std::string &path) {
     const auto numWorkers = io::ConfigManager::getUnsigned("world.sourceWorkThreads", 4);
     auto source = new world::WorldSource(file, gen, numWorkers);
 
+    // keep recently used chunks around, so players moving back and forth don't reload them
+    const auto cacheMb = io::ConfigManager::getUnsigned("world.chunkCacheSize", 256);
+    source->setCacheBudget(cacheMb * 1024 * 1024);
+
     return source;
 }
@@ -0,0 +1,59 @@
+#include "Exporter.h"
+
+#include <util/Metrics.h>
+#include <io/Format.h>
+
+#include <Logging.h>
+
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace metrics;
+
+/**
+ * Starts writing metrics at the given interval.
+ */
+Exporter::Exporter(const std::string &_path, const size_t intervalSecs) : path(_path) {
+    const auto interval = std::chrono::seconds(intervalSecs);
+
+    this->writeTimer = this->timer.add(interval, [&](auto) {
+        this->write();
+    }, interval);
+
+    Logging::info("Writing metrics to '{}' every {} sec", this->path, intervalSecs);
+}
+
+/**
+ * Stops the timer, and writes the metrics one last time.
+ */
+Exporter::~Exporter() {
+    this->timer.remove(this->writeTimer);
+    this->write();
+}
+
+/**
+ * Formats the metrics and writes them out.
+ */
+void Exporter::write() {
+    const auto tempPath = this->path + ".tmp";
+
+    try {
+        const auto data = util::Metrics::format();
+
+        std::ofstream out(tempPath, std::ios::trunc);
+        if(!out.good()) {
+            throw std::runtime_error(f("Failed to open '{}'", tempPath));
+        }
+        out << data;
+        out.close();
+
+        if(rename(tempPath.c_str(), this->path.c_str())) {
+            throw std::runtime_error(f("Failed to rename '{}': {}", tempPath, strerror(errno)));
+        }
+    } catch(std::exception &e) {
+        Logging::error("Failed to write metrics: {}", e.what());
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef METRICS_EXPORTER_H
+#define METRICS_EXPORTER_H
+
+#include <string>
+
+#include <cpptime.h>
+
+namespace metrics {
+/**
+ * Periodically writes all server metrics to a file, in the Prometheus text format, so they can be
+ * picked up by the node exporter's textfile collector (or just looked at.)
+ *
+ * The file is written to a temporary path first and then renamed into place, so readers never
+ * see a partially written file.
+ */
+class Exporter {
+    public:
+        Exporter(const std::string &path, const size_t intervalSecs);
+        ~Exporter();
+
+    private:
+        void write();
+
+    private:
+        /// path of the metrics file
+        std::string path;
+
+        CppTime::Timer timer;
+        CppTime::timer_id writeTimer;
+};
+}
+
+#endif
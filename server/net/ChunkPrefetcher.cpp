@@ -0,0 +1,158 @@
+#include "ChunkPrefetcher.h"
+#include "Listener.h"
+#include "ListenerClient.h"
+
+#include "net/handlers/Chunk.h"
+#include "net/handlers/PlayerMovement.h"
+
+#include <world/WorldSource.h>
+#include <world/chunk/Chunk.h>
+#include <io/ConfigManager.h>
+#include <util/Metrics.h>
+#include <Logging.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+using namespace net;
+
+/**
+ * Reads the prefetch configuration and registers the prefetch tick task.
+ */
+ChunkPrefetcher::ChunkPrefetcher(Listener *_listener) : listener(_listener) {
+    this->horizon = io::ConfigManager::getUnsigned("world.prefetchHorizon", 5);
+    this->budget = io::ConfigManager::getUnsigned("world.prefetchBudget", 32);
+
+    const auto interval = io::ConfigManager::getUnsigned("world.prefetchInterval", 500);
+    Logging::debug("Chunk prefetch: horizon {} sec, budget {} chunks, every {} ms", this->horizon,
+            this->budget, interval);
+
+    this->tickTask = this->listener->getTickScheduler()->addTask(TickPhase::Simulate,
+            std::chrono::milliseconds(interval), [&]() {
+        this->update();
+    });
+}
+
+/**
+ * Removes the prefetch tick task, and cancels any prefetches that are still waiting.
+ */
+ChunkPrefetcher::~ChunkPrefetcher() {
+    this->listener->getTickScheduler()->removeTask(this->tickTask);
+
+    auto world = this->listener->getWorld();
+    for(auto &[pos, request] : this->requests) {
+        world->cancelRequest(request.id);
+    }
+}
+
+/**
+ * Predicts which chunks players will need, and requests those from the world source.
+ *
+ * For each moving player, we step along the straight line extrapolated from their velocity. At
+ * each point, the client would want all chunks within its view radius; those that aren't already
+ * within view of the player's current position are prefetched. Chunks are prioritized by how soon
+ * the player will reach them.
+ *
+ * Prefetches for chunks that are no longer predicted (because the player turned, say) are
+ * cancelled if they haven't started yet.
+ */
+void ChunkPrefetcher::update() {
+    static auto issued = util::Metrics::counter("cubeland_chunk_prefetch_total",
+            "Chunk prefetch requests, by outcome", {{"result", "issued"}});
+    static auto cancelled = util::Metrics::counter("cubeland_chunk_prefetch_total",
+            "Chunk prefetch requests, by outcome", {{"result", "cancelled"}});
+
+    auto world = this->listener->getWorld();
+
+    // drop requests that have completed
+    std::erase_if(this->requests, [](auto &item) {
+        return item.second.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    });
+
+    // find chunks each player will need, and how soon (in seconds)
+    std::unordered_map<glm::ivec2, float> wanted;
+
+    this->listener->forEach([&](auto &client) {
+        if(!client->getClientId()) return;
+
+        auto movement = client->getMovement();
+        auto chunks = client->getChunkLoader();
+
+        glm::vec3 pos, velocity;
+        if(!movement->getMotion(pos, velocity)) return;
+
+        const int radius = chunks->getViewRadius();
+        if(!radius) return;
+
+        // only horizontal movement changes which chunks are needed
+        const glm::vec2 v(velocity.x, velocity.z);
+        const auto speed = glm::length(v);
+        if(speed < kMinSpeed) return;
+
+        glm::ivec2 current;
+        world::Chunk::absoluteToRelative(glm::ivec3(glm::floor(pos)), current);
+
+        const auto distance = speed * this->horizon;
+        for(float d = kPathStep; d <= distance; d += kPathStep) {
+            const auto point = pos + (velocity * (d / speed));
+
+            glm::ivec2 center;
+            world::Chunk::absoluteToRelative(glm::ivec3(glm::floor(point)), center);
+            if(center == current) continue;
+
+            for(int x = center.x - radius; x <= center.x + radius; x++) {
+                for(int z = center.y - radius; z <= center.y + radius; z++) {
+                    const glm::ivec2 chunk(x, z);
+
+                    // the client's already requested these
+                    const auto fromCurrent = glm::abs(chunk - current);
+                    if(std::max(fromCurrent.x, fromCurrent.y) <= radius) continue;
+
+                    const auto eta = d / speed;
+                    auto it = wanted.find(chunk);
+                    if(it == wanted.end() || it->second > eta) {
+                        wanted[chunk] = eta;
+                    }
+                }
+            }
+        }
+    });
+
+    // cancel prefetches we no longer want
+    for(auto it = this->requests.begin(); it != this->requests.end();) {
+        if(!wanted.contains(it->first) && world->cancelRequest(it->second.id)) {
+            cancelled->inc();
+            it = this->requests.erase(it);
+        } else {
+            it++;
+        }
+    }
+
+    // request the most urgent chunks, as far as the budget allows
+    std::vector<std::pair<glm::ivec2, float>> toFetch;
+    for(const auto &[chunk, eta] : wanted) {
+        if(!this->requests.contains(chunk)) {
+            toFetch.emplace_back(chunk, eta);
+        }
+    }
+
+    std::sort(toFetch.begin(), toFetch.end(), [](const auto &l, const auto &r) {
+        return l.second < r.second;
+    });
+
+    for(const auto &[chunk, eta] : toFetch) {
+        if(this->requests.size() >= this->budget) break;
+
+        Request req;
+        req.future = world->getChunk(chunk.x, chunk.y, kBasePriority + eta, req.id);
+
+        // skip chunks that were already in memory
+        if(req.future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) continue;
+
+        issued->inc();
+        this->requests.emplace(chunk, std::move(req));
+    }
+}
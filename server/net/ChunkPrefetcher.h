@@ -0,0 +1,72 @@
+#ifndef SERVER_NET_CHUNKPREFETCHER_H
+#define SERVER_NET_CHUNKPREFETCHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <unordered_map>
+
+#include <glm/vec2.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include "TickScheduler.h"
+
+namespace world {
+struct Chunk;
+}
+
+namespace net {
+class Listener;
+
+/**
+ * Loads chunks that players are about to need, before their clients ask for them.
+ *
+ * Clients only request chunks once they come within their view distance, so a fast moving player
+ * keeps running into chunks that still have to be read from disk or generated. Periodically, we
+ * extrapolate each player's movement a few seconds ahead, and request the chunks that will enter
+ * the client's view along the way from the world source. This happens at a priority below that of
+ * any client request, and with a bound on the number of outstanding requests.
+ *
+ * Loaded chunks aren't held on to; they're kept in memory by the world source's chunk cache, and
+ * a client request for a chunk that's still being prefetched simply joins that load.
+ */
+class ChunkPrefetcher {
+    public:
+        ChunkPrefetcher(Listener *listener);
+        ~ChunkPrefetcher();
+
+    private:
+        /// A prefetch request made to the world source
+        struct Request {
+            uint64_t id;
+            std::future<std::shared_ptr<world::Chunk>> future;
+        };
+
+        /// Base priority of prefetch requests; client requests are always more urgent than this
+        constexpr static const float kBasePriority = 1000.;
+        /// Players moving slower than this (in blocks per second) are ignored
+        constexpr static const float kMinSpeed = 2.;
+        /// Distance (in blocks) between points sampled along a player's predicted path
+        constexpr static const float kPathStep = 32.;
+
+    private:
+        void update();
+
+    private:
+        Listener *listener = nullptr;
+
+        /// how far ahead to predict player movement, in seconds
+        float horizon;
+        /// maximum number of outstanding prefetch requests
+        size_t budget;
+
+        /// outstanding prefetch requests, by chunk position. only accessed from the tick thread
+        std::unordered_map<glm::ivec2, Request> requests;
+
+        /// tick task that runs the prediction
+        TickScheduler::TaskId tickTask;
+};
+}
+
+#endif
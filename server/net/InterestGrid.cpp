@@ -0,0 +1,162 @@
+#include "InterestGrid.h"
+
+#include <world/chunk/Chunk.h>
+#include <io/ConfigManager.h>
+
+#include <Logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace net;
+
+/**
+ * Reads the interest radius from the config.
+ */
+InterestGrid::InterestGrid() {
+    this->radius = io::ConfigManager::getUnsigned("proto.interestRadius", 3);
+    Logging::debug("Interest radius: {} chunks", this->radius);
+}
+
+/**
+ * Moves the player into the cell for the chunk containing the given world position.
+ */
+void InterestGrid::updatePosition(ListenerClient *client, const glm::vec3 &pos) {
+    glm::ivec2 chunkPos;
+    world::Chunk::absoluteToRelative(glm::ivec3(glm::floor(pos)), chunkPos);
+
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    // bail if the player is still in the same chunk
+    if(this->playerCells.contains(client)) {
+        const auto oldPos = this->playerCells[client];
+        if(oldPos == chunkPos) return;
+
+        auto &cell = this->cells[oldPos];
+        cell.erase(client);
+        if(cell.empty()) {
+            this->cells.erase(oldPos);
+        }
+    }
+
+    this->playerCells[client] = chunkPos;
+    this->cells[chunkPos].insert(client);
+}
+
+/**
+ * Adds a chunk observer.
+ */
+void InterestGrid::addObserver(ListenerClient *client, const glm::ivec2 &chunkPos) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    this->observing[client].insert(chunkPos);
+    this->observers[chunkPos].insert(client);
+}
+
+/**
+ * Removes a chunk observer.
+ */
+void InterestGrid::removeObserver(ListenerClient *client, const glm::ivec2 &chunkPos) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    if(this->observing.contains(client)) {
+        this->observing[client].erase(chunkPos);
+    }
+
+    if(this->observers.contains(chunkPos)) {
+        auto &clients = this->observers[chunkPos];
+        clients.erase(client);
+
+        if(clients.empty()) {
+            this->observers.erase(chunkPos);
+        }
+    }
+}
+
+/**
+ * Removes the client's position and all of its chunk observations.
+ */
+void InterestGrid::removeClient(ListenerClient *client) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    // remove position
+    if(this->playerCells.contains(client)) {
+        const auto pos = this->playerCells[client];
+
+        auto &cell = this->cells[pos];
+        cell.erase(client);
+        if(cell.empty()) {
+            this->cells.erase(pos);
+        }
+
+        this->playerCells.erase(client);
+    }
+
+    // remove observers
+    if(this->observing.contains(client)) {
+        for(const auto &chunkPos : this->observing[client]) {
+            auto &clients = this->observers[chunkPos];
+            clients.erase(client);
+
+            if(clients.empty()) {
+                this->observers.erase(chunkPos);
+            }
+        }
+
+        this->observing.erase(client);
+    }
+}
+
+/**
+ * Invokes the callback once for each client that observes at least one of the given chunks. It
+ * receives the subset of those chunks that the client observes.
+ */
+void InterestGrid::forEachObserver(const std::vector<glm::ivec2> &chunks,
+        const std::function<void(ListenerClient *, const std::vector<glm::ivec2> &)> &cb) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    // collect the observed chunks for each client
+    std::unordered_map<ListenerClient *, std::vector<glm::ivec2>> clients;
+
+    for(const auto &pos : chunks) {
+        if(!this->observers.contains(pos)) continue;
+
+        for(auto client : this->observers[pos]) {
+            clients[client].push_back(pos);
+        }
+    }
+
+    // then invoke the callbacks
+    for(const auto &[client, observed] : clients) {
+        cb(client, observed);
+    }
+}
+
+/**
+ * Invokes the callback for each player in a chunk within the interest radius of the chunk the
+ * given client is in. The callback also receives the (Chebyshev) distance in chunks. The client
+ * itself is not included.
+ */
+void InterestGrid::forEachNearby(ListenerClient *client,
+        const std::function<void(ListenerClient *, const size_t)> &cb) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    if(!this->playerCells.contains(client)) return;
+    const auto center = this->playerCells[client];
+    const int r = this->radius;
+
+    for(int z = -r; z <= r; z++) {
+        for(int x = -r; x <= r; x++) {
+            const auto pos = center + glm::ivec2(x, z);
+            if(!this->cells.contains(pos)) continue;
+
+            const size_t distance = std::max(abs(x), abs(z));
+
+            for(auto other : this->cells[pos]) {
+                if(other == client) continue;
+                cb(other, distance);
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SERVER_NET_INTERESTGRID_H
+#define SERVER_NET_INTERESTGRID_H
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtx/hash.hpp>
+
+namespace net {
+class ListenerClient;
+
+/**
+ * Spatial index of clients, at chunk granularity. It tracks both the chunk each player is in, and
+ * the chunks each client observes for block changes; broadcasts use it to only reach clients that
+ * actually care, so their cost scales with local player density rather than total player count.
+ *
+ * Callbacks are invoked with the grid lock held; clients remove themselves from the grid before
+ * they're deallocated, so the client pointers passed to callbacks are always valid. Callbacks
+ * shouldn't do any I/O; collect the clients instead, and act on them with the listener's client
+ * lock held once the grid lock has been released.
+ */
+class InterestGrid {
+    public:
+        InterestGrid();
+
+        /// Updates the chunk a player is located in
+        void updatePosition(ListenerClient *client, const glm::vec3 &pos);
+
+        /// Registers a client as observing the given chunk
+        void addObserver(ListenerClient *client, const glm::ivec2 &chunkPos);
+        /// Removes a chunk observation
+        void removeObserver(ListenerClient *client, const glm::ivec2 &chunkPos);
+
+        /// Removes all state for the given client
+        void removeClient(ListenerClient *client);
+
+        /// Invokes the callback once for every client observing any of the given chunks
+        void forEachObserver(const std::vector<glm::ivec2> &chunks,
+                const std::function<void(ListenerClient *, const std::vector<glm::ivec2> &)> &cb);
+        /// Invokes the callback for every player within the interest radius of the given client
+        void forEachNearby(ListenerClient *client,
+                const std::function<void(ListenerClient *, const size_t)> &cb);
+
+        /// Radius (in chunks) in which players are considered nearby
+        const size_t getRadius() const {
+            return this->radius;
+        }
+
+    private:
+        /// maximum chunk distance at which players receive each other's movement
+        size_t radius;
+
+        /// lock protecting all of the maps below
+        std::mutex lock;
+
+        /// chunk each player is currently located in
+        std::unordered_map<ListenerClient *, glm::ivec2> playerCells;
+        /// players located in each chunk
+        std::unordered_map<glm::ivec2, std::unordered_set<ListenerClient *>> cells;
+
+        /// chunks observed by each client
+        std::unordered_map<ListenerClient *, std::unordered_set<glm::ivec2>> observing;
+        /// clients observing each chunk
+        std::unordered_map<glm::ivec2, std::unordered_set<ListenerClient *>> observers;
+};
+}
+
+#endif
@@ -1,15 +1,23 @@
 #include "Listener.h"
 #include "ListenerClient.h"
+#include "ChunkPrefetcher.h"
+#include "InterestGrid.h"
+#include "TickScheduler.h"
 
 #include "net/handlers/BlockChange.h"
 #include "net/handlers/Chat.h"
+#include "net/handlers/PlayerMovement.h"
+#include "net/handlers/Time.h"
 
+#include "world/ChunkVersions.h"
 #include "world/time/Clock.h"
 
 #include <world/WorldSource.h>
 #include <util/Thread.h>
 #include <io/Format.h>
 #include <io/ConfigManager.h>
+#include <util/Metrics.h>
+#include <net/PacketTypes.h>
 #include <Logging.h>
 
 #include <unistd.h>
@@ -22,6 +30,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <stdexcept>
 
 using namespace net;
 
@@ -72,27 +81,114 @@ Listener::Listener(world::WorldSource *_reader) : world(_reader) {
 
     // set up some other parts of the game logic
     this->clock = new world::Clock(this->world);
+    this->versions = new world::ChunkVersions(this->world);
+    this->interest = new InterestGrid;
 
     // set up the chunk serializer thread pool
     const auto serializerThreads = io::ConfigManager::getUnsigned("world.chunkSerializerThreads", 4);
     Logging::debug("Chunk serializer threads: {}", serializerThreads);
     this->serializerPool = new util::ThreadPool<WorkItem>("Chunk Serializer", serializerThreads);
 
+    // limit how many TLS handshakes may perform crypto at once
+    this->handshakeSlots = std::max(io::ConfigManager::getUnsigned("tls.handshakeThreads", 2), 1UL);
+    Logging::debug("Concurrent TLS handshakes: {}", this->handshakeSlots);
+
     // create the work threads
     this->workerRun = true;
     this->worker = std::make_unique<std::thread>(&Listener::workerMain, this);
 
     this->murderThread = std::make_unique<std::thread>(&Listener::murdererMain, this);
-    this->saverThread = std::make_unique<std::thread>(&Listener::saverMain, this);
 
-    handler::BlockChange::startBroadcaster(this);
-    handler::Chat::startBroadcaster(this);
+    // set up periodic work, including prefetching chunks for moving players
+    this->tick = new TickScheduler(this);
+    this->registerTickTasks();
+
+    if(io::ConfigManager::getBool("world.prefetch", true)) {
+        this->prefetcher = new ChunkPrefetcher(this);
+    }
+
+    this->tick->start();
 
-    // add a repeating timer for actually saving chunks
-    const auto interval = std::chrono::milliseconds(100);
-    this->timer.add(interval, [&](auto){
+    this->registerMetrics();
+}
+
+/**
+ * Registers the periodic work of the listener, and that of all handlers, with the tick scheduler.
+ */
+void Listener::registerTickTasks() {
+    // advance the world time
+    this->tick->addTask(TickPhase::Simulate, this->tick->getInterval(), [&] {
+        this->clock->step();
+    });
+
+    // save dirty client state, and queue modified chunks for writing
+    this->tick->addClientTask(TickPhase::Persist, kClientSaveInterval, [](ListenerClient *client) {
+        client->save();
+    });
+    this->tick->addTask(TickPhase::Persist, kDirtyListInterval, [&] {
         this->world->updateDirtyList();
-    }, interval);
+    });
+
+    handler::BlockChange::registerTickTasks(this);
+    handler::Chat::registerTickTasks(this);
+    handler::PlayerMovement::registerTickTasks(this);
+    handler::Time::registerTickTasks(this);
+}
+
+/**
+ * Registers gauges for the depths of the various queues and the number of connected clients.
+ */
+void Listener::registerMetrics() {
+    using util::Metrics;
+
+    Metrics::gauge("cubeland_clients_connected", "Number of connected clients", {}, [&] {
+        std::lock_guard<std::mutex> lg(this->clientLock);
+        return this->clients.size();
+    });
+    Metrics::gauge("cubeland_serializer_queue_depth", "Work items waiting for a chunk serializer",
+            {}, [&] {
+        return this->serializerPool->numPending();
+    });
+
+    Metrics::gauge("cubeland_tls_handshake_queue_depth", "Handshakes waiting for a slot", {},
+            [&] {
+        return this->handshakesWaiting.load();
+    });
+
+    Metrics::gauge("cubeland_world_queue_depth", "Requests waiting in the world source",
+            {{"queue", "requests"}}, [&] {
+        return this->world->numPendingRequests();
+    });
+    Metrics::gauge("cubeland_world_queue_depth", "Requests waiting in the world source",
+            {{"queue", "writes"}}, [&] {
+        return this->world->numQueuedWrites();
+    });
+    Metrics::gauge("cubeland_world_dirty_chunks", "Chunks modified but not yet written", {}, [&] {
+        return this->world->numPendingWrites();
+    });
+    Metrics::gauge("cubeland_world_cache_bytes", "Estimated memory used by cached chunks", {},
+            [&] {
+        return this->world->getCacheBytes();
+    });
+    Metrics::gauge("cubeland_world_cache_chunks", "Number of cached chunks", {}, [&] {
+        return this->world->numCachedChunks();
+    });
+}
+
+/**
+ * Removes all gauges registered by the listener, since they reference it.
+ */
+void Listener::removeMetrics() {
+    using util::Metrics;
+
+    Metrics::remove("cubeland_clients_connected");
+    Metrics::remove("cubeland_serializer_queue_depth");
+    Metrics::remove("cubeland_tls_handshake_queue_depth");
+    Metrics::remove("cubeland_world_queue_depth", {{"queue", "requests"}});
+    Metrics::remove("cubeland_world_queue_depth", {{"queue", "writes"}});
+    Metrics::remove("cubeland_world_dirty_chunks");
+    Metrics::remove("cubeland_world_cache_bytes");
+    Metrics::remove("cubeland_world_cache_chunks");
 }
 
 /**
@@ -111,8 +207,13 @@ void Listener::buildTlsConfig(struct tls_config *cfg) {
     err = tls_config_set_protocols(cfg, protocols);
     XASSERT(err == 0, "tls_config_set_protocols() failed: {}", tls_config_error(cfg));
 
-    // cubeland protocol
-    err = tls_config_set_alpn(cfg, "cubeland/1.0");
+    // cubeland protocol; we prefer the compressed variant if enabled and the client supports it
+    std::string alpn = kProtocolName;
+    if(io::ConfigManager::getBool("listen.compression", true)) {
+        alpn = f("{},{}", kProtocolNameCompressed, kProtocolName);
+    }
+
+    err = tls_config_set_alpn(cfg, alpn.c_str());
     XASSERT(err == 0, "tls_config_set_alpn() failed: {}", tls_config_error(cfg));
 
     // load ciphers (using secure defaults otherwise)
@@ -133,17 +234,38 @@ void Listener::buildTlsConfig(struct tls_config *cfg) {
     const auto keyPath = io::ConfigManager::get("tls.key", "");
     err = tls_config_set_key_file(cfg, keyPath.c_str());
     XASSERT(err == 0, "Couldn't load key: {}", tls_config_error(cfg));
+
+    /*
+     * Allow clients to resume sessions via session tickets, so reconnecting clients can skip the
+     * expensive part of the handshake. libtls generates the ticket keys itself and rotates them
+     * based on the session lifetime.
+     *
+     * Note that LibreSSL can only resume TLS 1.2 sessions.
+     */
+    const auto sessionLifetime = io::ConfigManager::getUnsigned("tls.sessionLifetime", 7200);
+    if(sessionLifetime) {
+        err = tls_config_set_session_lifetime(cfg, sessionLifetime);
+        XASSERT(err == 0, "tls_config_set_session_lifetime() failed: {}", tls_config_error(cfg));
+    }
 }
 
 /**
  * Ensures we accept no new requests, and notifies all connected clients that we're quitting.
  */
 Listener::~Listener() {
+    this->removeMetrics();
+
+    // stop periodic work; pending block changes must still be written out
+    this->tick->stop();
+
+    delete this->prefetcher;
+    delete this->tick;
+
+    handler::BlockChange::flushPending(this);
+
     // stop accepting new requests
     this->workerRun = false;
 
-    this->saverThread->join();
-
     this->removeClient(nullptr);
 
     // exit thread pools
@@ -157,9 +279,6 @@ Listener::~Listener() {
         this->clients.clear();
     }
 
-    handler::BlockChange::stopBroadcaster();
-    handler::Chat::stopBroadcaster();
-
     // release SSL resources and listening socket
     tls_close(this->tls);
     tls_free(this->tls);
@@ -170,8 +289,13 @@ Listener::~Listener() {
     this->worker->join();
     this->murderThread->join();
 
+    // clients accepted while shutting down may still be waiting on a handshake
+    this->clients.clear();
+
     // delete any other resources
     delete this->clock;
+    delete this->versions;
+    delete this->interest;
 }
 
 
@@ -245,27 +369,34 @@ void Listener::murdererMain() {
 }
 
 /**
- * Main loop for the saving thread
+ * Blocks until a handshake slot is available, and takes it.
  *
- * We sleep for a fixed amount on each loop iteration, and invoke the save method of all clients.
+ * Clients perform their TLS handshakes on their own threads, with a non-blocking socket; only the
+ * steps of the handshake (which is where all the crypto happens) take a slot. Waiting for the
+ * client's data doesn't, so a slow client can't hold up other clients' handshakes.
  */
-void Listener::saverMain() {
-    util::Thread::setName("Client Saver");
+void Listener::beginHandshakeStep() {
+    std::unique_lock<std::mutex> lk(this->handshakeLock);
 
-    while(this->workerRun) {
-        // invoke clients save methods
-        try {
-            std::lock_guard<std::mutex> lg(this->clientLock);
-            for(auto &client : this->clients) {
-                client->save();
-            }
-        } catch(std::exception &e) {
-            Logging::error("Failed to save client data: {}", e.what());
-        }
+    this->handshakesWaiting++;
+    this->handshakeCond.wait(lk, [&] {
+        return this->handshakeSlots > 0;
+    });
+    this->handshakesWaiting--;
+
+    this->handshakeSlots--;
+}
 
-        // yeet
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+/**
+ * Returns a handshake slot taken earlier.
+ */
+void Listener::endHandshakeStep() {
+    {
+        std::lock_guard<std::mutex> lg(this->handshakeLock);
+        this->handshakeSlots++;
     }
+
+    this->handshakeCond.notify_one();
 }
 
 /**
@@ -278,3 +409,57 @@ void Listener::forEach(const std::function<void(std::unique_ptr<ListenerClient>
         cb(client);
     }
 }
+
+/**
+ * Invokes the callback while holding the client lock. Clients are only deallocated with this lock
+ * held, so client pointers obtained elsewhere (such as from the interest grid) remain valid for
+ * the duration of the callback.
+ */
+void Listener::withClientsLocked(const std::function<void(void)> &cb) {
+    std::lock_guard<std::mutex> lg(this->clientLock);
+    cb();
+}
+
+
+
+/**
+ * Assigns a player index. Released indices are reused in the order they were released, so that an
+ * index isn't handed out again right after its previous player left.
+ */
+uint16_t Listener::allocPlayerIndex() {
+    std::lock_guard<std::mutex> lg(this->playerIndicesLock);
+    uint16_t index;
+
+    if(this->nextPlayerIndex <= UINT16_MAX) {
+        index = this->nextPlayerIndex++;
+    } else if(!this->freePlayerIndices.empty()) {
+        index = this->freePlayerIndices.front();
+        this->freePlayerIndices.pop_front();
+    } else {
+        throw std::runtime_error("Out of player indices");
+    }
+
+    this->usedPlayerIndices.set(index);
+    return index;
+}
+
+/**
+ * Releases a player index, so it may be assigned to another player.
+ */
+void Listener::releasePlayerIndex(const uint16_t index) {
+    if(!index) return;
+
+    std::lock_guard<std::mutex> lg(this->playerIndicesLock);
+    XASSERT(this->usedPlayerIndices.test(index), "Releasing unused player index {}", index);
+
+    this->usedPlayerIndices.reset(index);
+    this->freePlayerIndices.push_back(index);
+}
+
+/**
+ * Checks whether a player index is currently assigned.
+ */
+bool Listener::isPlayerIndexInUse(const uint16_t index) {
+    std::lock_guard<std::mutex> lg(this->playerIndicesLock);
+    return this->usedPlayerIndices.test(index);
+}
@@ -4,7 +4,12 @@
 #include "ListenerClient.h"
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -13,26 +18,32 @@
 
 #include <sys/socket.h>
 
+#include <util/BufferPool.h>
 #include <util/ThreadPool.h>
 #include <blockingconcurrentqueue.h>
 
-#include <cpptime.h>
-
 struct tls;
 struct tls_config;
 
 namespace world {
 class WorldSource;
 class Clock;
+class ChunkVersions;
 }
 
 namespace net {
+class ChunkPrefetcher;
+class InterestGrid;
+class TickScheduler;
+
 /**
  * Handles opening the server's listening socket, accepting new clients, and starting the TLS
  * handshake with them.
  */
 class Listener {
     friend class ListenerClient;
+    friend class ChunkPrefetcher;
+    friend class TickScheduler;
 
     public:
         using WorkItem = std::function<void(void)>;
@@ -45,26 +56,40 @@ class Listener {
             return this->serializerPool;
         }
 
+        /// Waits until a TLS handshake step may run; limits how many run concurrently
+        void beginHandshakeStep();
+        /// Marks a TLS handshake step as finished
+        void endHandshakeStep();
+
         world::Clock *getClock() {
             return this->clock;
         }
 
-        /// Registers a broadcast timer (these are repeating)
-        template <class Rep, class Period>
-        CppTime::timer_id addRepeatingTimer(const std::chrono::duration<Rep, Period> &when,
-                const std::function<void(void)> &handler) {
-            return this->timer.add(when, [=](auto) {
-                handler();
-            }, when);
+        world::ChunkVersions *getChunkVersions() {
+            return this->versions;
         }
-        /// unregisters a timer
-        void removeTimer(const CppTime::timer_id id) {
-            std::lock_guard<std::mutex> lg(this->timerLock);
-            this->timer.remove(id);
+
+        /// Spatial index used to filter broadcasts to interested clients
+        InterestGrid *getInterestGrid() {
+            return this->interest;
+        }
+
+        /// Scheduler that runs all periodic server work
+        TickScheduler *getTickScheduler() {
+            return this->tick;
         }
 
         /// runs a function for each client
         void forEach(const std::function<void(std::unique_ptr<ListenerClient> &)> &cb);
+        /// runs a function with the client list locked, so that no clients are deallocated
+        void withClientsLocked(const std::function<void(void)> &cb);
+
+        /// Assigns a player index, as used to identify players in position broadcasts
+        uint16_t allocPlayerIndex();
+        /// Returns a player index once its player has disconnected
+        void releasePlayerIndex(const uint16_t index);
+        /// Whether the given player index is currently assigned to a player
+        bool isPlayerIndexInUse(const uint16_t index);
 
     protected:
         /// Marks a client for later destruction
@@ -77,6 +102,16 @@ class Listener {
             return this->world;
         }
 
+    private:
+        /// Maximum number of idle receive buffers kept around
+        constexpr static const size_t kReceiveBuffers = 64;
+        /// Receive buffers larger than this are freed rather than kept for reuse
+        constexpr static const size_t kReceiveBufferRetainSize = 1024 * 1024;
+        /// Interval at which dirty client state (such as player positions) is saved
+        constexpr static const std::chrono::milliseconds kClientSaveInterval = std::chrono::seconds(2);
+        /// Interval at which modified chunks are queued for writing
+        constexpr static const std::chrono::milliseconds kDirtyListInterval = std::chrono::milliseconds(100);
+
     private:
         void buildTlsConfig(struct tls_config *);
 
@@ -84,7 +119,10 @@ class Listener {
 
         void murdererMain();
 
-        void saverMain();
+        void registerTickTasks();
+
+        void registerMetrics();
+        void removeMetrics();
 
     private:
         world::WorldSource *world = nullptr;
@@ -110,16 +148,37 @@ class Listener {
         /// thread pool for chunk serialization
         util::ThreadPool<WorkItem> *serializerPool;
 
-        /// this thread periodically invokes the save method on connected clients
-        std::unique_ptr<std::thread> saverThread;
+        /// buffers clients read received packets into
+        util::BufferPool receiveBuffers{kReceiveBuffers, kReceiveBufferRetainSize};
+
+        /// number of TLS handshake steps that may still begin executing
+        size_t handshakeSlots = 0;
+        /// clients waiting to perform a TLS handshake step
+        std::atomic_size_t handshakesWaiting = 0;
+        /// protects the handshake slot count
+        std::mutex handshakeLock;
+        /// signalled whenever a handshake slot becomes available
+        std::condition_variable handshakeCond;
+
+        /// protects the player index allocation state
+        std::mutex playerIndicesLock;
+        /// player indices that have been released; they're reused oldest first
+        std::deque<uint16_t> freePlayerIndices;
+        /// next never used player index; 0 is never handed out
+        uint32_t nextPlayerIndex = 1;
+        /// player indices that are currently assigned
+        std::bitset<65536> usedPlayerIndices;
 
         /// time updating
         world::Clock *clock = nullptr;
-
-        /// shared broadcasting thymer
-        CppTime::Timer timer;
-        /// lock protecting the thymer (for add/remove)
-        std::mutex timerLock;
+        /// allocates slice versions for modified chunks
+        world::ChunkVersions *versions = nullptr;
+        /// player positions and chunk observers
+        InterestGrid *interest = nullptr;
+        /// loads chunks ahead of moving players; may be null if disabled
+        ChunkPrefetcher *prefetcher = nullptr;
+        /// runs periodic work: broadcasts, time updates, saving
+        TickScheduler *tick = nullptr;
 };
 };
 
@@ -1,5 +1,6 @@
 #include "ListenerClient.h"
 #include "Listener.h"
+#include "InterestGrid.h"
 
 #include "handlers/Auth.h"
 #include "handlers/BlockChange.h"
@@ -12,14 +13,17 @@
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/ConfigManager.h>
 #include <util/Math.h>
 #include <util/Thread.h>
+#include <net/Framing.h>
 #include <net/PacketTypes.h>
 
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
 
+#include <chrono>
 #include <cstring>
 #include <stdexcept>
 
@@ -30,6 +34,36 @@ using namespace net;
 // uncomment to log all received packet contents
 // #define LOG_PACKETS
 
+/**
+ * Returns a name for the given packet endpoint, for labelling metrics.
+ */
+static std::string EndpointName(const uint8_t ep) {
+    switch(ep) {
+        case kEndpointUtility:
+            return "utility";
+        case kEndpointAuthentication:
+            return "auth";
+        case kEndpointBlockChange:
+            return "blockChange";
+        case kEndpointChunk:
+            return "chunk";
+        case kEndpointChat:
+            return "chat";
+        case kEndpointWorldInfo:
+            return "worldInfo";
+        case kEndpointPlayerData:
+            return "playerData";
+        case kEndpointPlayerMovement:
+            return "playerMovement";
+        case kEndpointPlayerInfo:
+            return "playerInfo";
+        case kEndpointTime:
+            return "time";
+        default:
+            return f("{:02x}", ep);
+    }
+}
+
 
 /**
  * Creates a new listener client. Its worker thread is created.
@@ -58,15 +92,20 @@ ListenerClient::ListenerClient(Listener *_list, struct tls *_tls, const int _fd,
     // initialize packet handlers
     this->auth = new handler::Auth(this);
     this->block = new handler::BlockChange(this);
+    this->movement = new handler::PlayerMovement(this);
+    this->chunks = new handler::ChunkLoader(this);
+    this->time = new handler::Time(this);
 
     this->handlers.emplace_back(this->block);
-    this->handlers.emplace_back(new handler::PlayerMovement(this));
+    this->handlers.emplace_back(this->movement);
     this->handlers.emplace_back(new handler::Chat(this));
-    this->handlers.emplace_back(new handler::ChunkLoader(this));
+    this->handlers.emplace_back(this->chunks);
     this->handlers.emplace_back(new handler::PlayerInfo(this));
     this->handlers.emplace_back(new handler::WorldInfo(this));
     this->handlers.emplace_back(this->auth);
-    this->handlers.emplace_back(new handler::Time(this));
+    this->handlers.emplace_back(this->time);
+
+    this->registerMetrics();
 
     // set up the worker
     this->workerRun = true;
@@ -93,6 +132,12 @@ ListenerClient::~ListenerClient() {
 
     this->worker->join();
 
+    /*
+     * Stop receiving broadcasts. This has to happen once the worker is gone, since handlers on it
+     * may otherwise add us back to the grid after we've been removed.
+     */
+    this->owner->getInterestGrid()->removeClient(this);
+
     // yeet the handlers
     this->handlers.clear();
 
@@ -102,7 +147,42 @@ ListenerClient::~ListenerClient() {
         Logging::error("Failed to close client fd: {}", strerror(errno));
     }
 
+    this->drainPipe();
+
+    ::close(this->notePipe[0]);
     ::close(this->notePipe[1]);
+
+    this->removeMetrics();
+}
+
+/**
+ * Creates the traffic counters for this client.
+ */
+void ListenerClient::registerMetrics() {
+    using util::Metrics;
+
+    this->metricsLabel = f("{}", this->clientAddr);
+
+    this->bytesIn = Metrics::counter("cubeland_client_bytes_total", "Bytes transferred per client",
+            {{"client", this->metricsLabel}, {"direction", "in"}});
+    this->bytesOut = Metrics::counter("cubeland_client_bytes_total", "Bytes transferred per client",
+            {{"client", this->metricsLabel}, {"direction", "out"}});
+    this->packetsIn = Metrics::counter("cubeland_client_packets_total",
+            "Packets transferred per client", {{"client", this->metricsLabel}, {"direction", "in"}});
+    this->packetsOut = Metrics::counter("cubeland_client_packets_total",
+            "Packets transferred per client", {{"client", this->metricsLabel}, {"direction", "out"}});
+}
+
+/**
+ * Removes the traffic counters of a client that's going away.
+ */
+void ListenerClient::removeMetrics() {
+    using util::Metrics;
+
+    for(const auto &name : {"cubeland_client_bytes_total", "cubeland_client_packets_total"}) {
+        Metrics::remove(name, {{"client", this->metricsLabel}, {"direction", "in"}});
+        Metrics::remove(name, {{"client", this->metricsLabel}, {"direction", "out"}});
+    }
 }
 
 
@@ -111,15 +191,49 @@ ListenerClient::~ListenerClient() {
  * Sends a event through the yenpipe.
  */
 void ListenerClient::sendPipeData(const PipeData &d) {
+    // nobody is going to read it once the worker's gone
+    if(!this->connected) {
+        this->discardPipeData(d);
+        return;
+    }
+
     int err = ::write(this->notePipe[1], &d, sizeof(d));
     if(err == -1) {
         Logging::error("Failed to write request to pipe: {}", strerror(errno));
+        this->discardPipeData(d);
     }
 }
 
+/**
+ * Releases the resources owned by a pipe event, without acting on it.
+ */
+void ListenerClient::discardPipeData(const PipeData &d) {
+    if(d.packetBuffer) {
+        ReleasePacketBuffer(d.packetBuffer);
+    } else if(d.type == PipeEvent::SendPacket) {
+        delete[] d.payload;
+    }
+
+    delete d.func;
+}
 
 /**
- * Builds a valid packet header for the packet, then sends it. The payload is copied.
+ * Discards all events left in the yenpipe. This is done once the worker has exited, and everyone
+ * who might still write to the pipe (handlers, broadcasts) is gone; events that raced with the
+ * worker's exit would otherwise leak.
+ */
+void ListenerClient::drainPipe() {
+    PipeData d;
+
+    while(::read(this->notePipe[0], &d, sizeof(d)) == sizeof(d)) {
+        this->discardPipeData(d);
+    }
+}
+
+
+/**
+ * Builds a valid packet header for the packet, then sends it. The payload is copied; if it is
+ * too large for a single frame, it is split over several continuation frames.
  *
  * @return Tag of the packet. You may specify the tag manually, or generate one automagically
  */
@@ -133,38 +247,145 @@ again:;
         if(!tag) goto again;
     }
 
-    // allocate memory
-    size_t reqPacketSize = sizeof(PacketHeader) + dataLen;
-    if(reqPacketSize & 0x3) {
-        reqPacketSize += 4 - (reqPacketSize & 0x3);
-    }
+    // build the frames and send them
+    size_t packetSize;
+    auto buf = BuildFrames(ep, type, tag, data, dataLen, packetSize);
+
+    PipeData pd(PipeEvent::SendPacket);
+    pd.payload = buf;
+    pd.payloadLen = packetSize;
+    this->sendPipeData(pd);
 
-    auto buf = new std::byte[reqPacketSize];
-    memset(buf, 0, reqPacketSize);
+    // clean up
+    return tag;
+}
 
-    // construct header
-    auto hdr = reinterpret_cast<PacketHeader *>(buf);
-    hdr->endpoint = ep;
-    hdr->type = type;
-    hdr->length = IntCeil(dataLen, 4);
+/**
+ * Sends a packet that was serialized into a packet buffer (obtained from `GetPacketBuffer()`.) Its
+ * header is filled in place, and the buffer is handed to the worker thread as-is; it goes back to
+ * the pool once written.
+ *
+ * Packets too large for a single frame are split into continuation frames, which copies them.
+ */
+uint16_t ListenerClient::writePacket(const uint8_t ep, const uint8_t type, PacketBuffer &&packet,
+        const uint16_t _tag) {
+    const auto payloadLen = packet->size() - sizeof(PacketHeader);
+    if(payloadLen > kMaxFramePayload) {
+        return this->writePacket(ep, type, packet->data() + sizeof(PacketHeader), payloadLen, _tag);
+    }
 
-    memcpy(hdr->payload, data, dataLen);
+    // get the real tag to apply to the packet
+    auto tag = _tag;
+    if(!tag) {
+again:;
+        tag = this->nextTag++;
+        if(!tag) goto again;
+    }
 
-    // send it
-    hdr->tag = htons(tag);
-    hdr->length = htons(hdr->length);
+    FinishPacketBuffer(*packet, ep, type, tag);
 
     PipeData pd(PipeEvent::SendPacket);
-    pd.payload = buf;
-    pd.payloadLen = reqPacketSize;
+    pd.payload = packet->data();
+    pd.payloadLen = packet->size();
+    pd.packetBuffer = packet.release();
     this->sendPipeData(pd);
 
-    // clean up
     return tag;
 }
 
 
 
+/**
+ * Performs the TLS handshake with the client.
+ *
+ * The socket is made non-blocking for the duration of the handshake, and we wait for the client
+ * in poll() between handshake steps. Each step takes one of the listener's handshake slots,
+ * which bounds how many run at once, so a burst of (re)connecting clients can't starve the rest
+ * of the server of CPU time. Clients that don't complete the handshake by the deadline are
+ * dropped.
+ *
+ * The note pipe is polled throughout so that a shutdown request is noticed right away. Any other
+ * events read from it in the meantime are appended to `deferred`, for the caller to handle in
+ * order once the connection is set up.
+ */
+void ListenerClient::performHandshake(std::vector<PipeData> &deferred) {
+    using namespace std::chrono;
+    int err, ret;
+
+    const auto timeoutSecs = io::ConfigManager::getUnsigned("tls.handshakeTimeout", 10);
+    const auto start = steady_clock::now();
+    const auto deadline = start + seconds(timeoutSecs);
+
+    const int flags = fcntl(this->fd, F_GETFL);
+    XASSERT(flags != -1, "Failed to get socket flags: {}", strerror(errno));
+    err = fcntl(this->fd, F_SETFL, flags | O_NONBLOCK);
+    XASSERT(err != -1, "Failed to set socket flags: {}", strerror(errno));
+
+    try {
+        while(true) {
+            this->owner->beginHandshakeStep();
+            ret = tls_handshake(this->tls);
+            this->owner->endHandshakeStep();
+
+            if(!ret) {
+                break;
+            } else if(ret != TLS_WANT_POLLIN && ret != TLS_WANT_POLLOUT) {
+                throw std::runtime_error(f("Failed to complete handshake: {}",
+                            tls_error(this->tls)));
+            }
+
+            // wait for the client, the deadline, or for us to be shut down
+            const auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+            if(remaining.count() <= 0) {
+                throw std::runtime_error("Timed out completing handshake");
+            }
+
+            struct pollfd pfd[2];
+            pfd[0].fd = this->fd;
+            pfd[0].events = (ret == TLS_WANT_POLLIN) ? POLLIN : POLLOUT;
+            pfd[1].fd = this->notePipe[0];
+            pfd[1].events = POLLIN;
+
+            err = poll(pfd, 2, remaining.count());
+            if(err == -1) {
+                if(errno == EINTR) continue;
+                throw std::runtime_error(f("poll() failed: {}", strerror(errno)));
+            }
+
+            if(!this->workerRun) {
+                throw std::runtime_error("Client closed during handshake");
+            } else if(pfd[1].revents & POLLIN) {
+                // take the events out of the pipe so it doesn't stay readable
+                PipeData d;
+                while(::read(this->notePipe[0], &d, sizeof(d)) == sizeof(d)) {
+                    deferred.push_back(d);
+                }
+            }
+        }
+    } catch(std::exception &) {
+        for(const auto &d : deferred) {
+            this->discardPipeData(d);
+        }
+        deferred.clear();
+
+        fcntl(this->fd, F_SETFL, flags);
+        throw;
+    }
+
+    err = fcntl(this->fd, F_SETFL, flags);
+    XASSERT(err != -1, "Failed to restore socket flags: {}", strerror(errno));
+
+    // record how long it took
+    const bool resumed = (tls_conn_session_resumed(this->tls) == 1);
+    const auto elapsed = steady_clock::now() - start;
+
+    util::Metrics::histogram("cubeland_tls_handshake_seconds", "Time taken by TLS handshakes",
+            {{"resumed", resumed ? "true" : "false"}})->observe(elapsed);
+
+    Logging::trace("Handshake with {} took {} ms (resumed: {})", this->clientAddr,
+            duration<double, std::milli>(elapsed).count(), resumed);
+}
+
 /**
  * Worker main loop; we try to complete the TLS handshake and then continue to try to read
  * messages from the socket, or for pending writes we want to perform.
@@ -179,11 +400,21 @@ void ListenerClient::workerMain() {
 
     try {
         // complete handshake
-shakeAgain:;
-        err = tls_handshake(this->tls);
-        if(err) {
-            if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) goto shakeAgain;
-            throw std::runtime_error(f("Failed to complete handshake: {}", tls_error(this->tls)));
+        std::vector<PipeData> deferred;
+        this->performHandshake(deferred);
+
+        const auto alpn = tls_conn_alpn_selected(this->tls);
+        if(alpn && !strcmp(alpn, kProtocolNameCompressed)) {
+            this->compression = std::make_unique<util::LZ4Stream>();
+            this->compressedIn.resize(kCompressedReadSize);
+        }
+
+        // handle anything that was sent our way while the handshake was in progress
+        if(!deferred.empty()) {
+            for(const auto &d : deferred) {
+                this->handlePipeEvent(d);
+            }
+            this->flushStream();
         }
 
         // configure socket in non-blocking mode
@@ -198,10 +429,11 @@ shakeAgain:;
             pfd[1].fd = this->fd;
             pfd[1].events = POLLIN;
 
-            // block on the client socket and notification pipe
-            err = poll(pfd, 2, -1);
+            // block on the client socket and notification pipe, unless we've got data buffered
+            const bool buffered = this->compression && this->compression->available();
+            err = poll(pfd, 2, buffered ? 0 : -1);
 
-            if(err == 0) continue; // timeout expired
+            if(err == 0 && !buffered) continue; // timeout expired
             else if(err == -1) {
                 throw std::runtime_error(f("poll() failed: {}", strerror(errno)));
             }
@@ -230,12 +462,15 @@ shakeAgain:;
                     this->handlePipeEvent(d);
                     yenpipePending = false;
                 } while(err > 0);
+
+                // write all packets compressed while handling the events at once
+                this->flushStream();
             }
 
             // try to read packet header
-            if(pfd[1].revents & POLLIN) {
+            if(pfd[1].revents & POLLIN || buffered) {
 readAgain:;
-                err = tls_read(this->tls, &hdr, sizeof(hdr));
+                err = this->readStream(&hdr, sizeof(hdr));
                 if(err == TLS_WANT_POLLIN) {
                     goto readAgain;
                 } else if(err == TLS_WANT_POLLOUT) {
@@ -253,8 +488,7 @@ readAgain:;
                 }
 
                 // handle the message
-                hdr.length = ntohs(hdr.length);
-                hdr.tag = ntohs(hdr.tag);
+                FrameHeaderToHost(hdr);
                 this->handleMessage(hdr);
             }
         }
@@ -280,39 +514,51 @@ closeAgain:;
         Logging::error("Failed to close client {}: {}", this->clientAddr, tls_error(this->tls));
     }
 
-    // release resources and close the read end of the yenpipe
+    // release resources; the yenpipe is drained and closed when we're deallocated
     tls_free(this->tls);
-    ::close(this->notePipe[0]);
 
     // remove it from client
     this->owner->removeClient(this);
 }
 
+/**
+ * Queues a function to be invoked on the worker thread, the next time it checks the yenpipe.
+ */
+void ListenerClient::runOnWorker(const std::function<void(void)> &f) {
+    PipeData pd(PipeEvent::Invoke);
+    pd.func = new std::function<void(void)>(f);
+    this->sendPipeData(pd);
+}
+
 /**
  * Handles an event received on the yenpipe.
  */
 void ListenerClient::handlePipeEvent(const PipeData &data) {
     switch(data.type) {
         case PipeEvent::SendPacket: {
-            size_t len = data.payloadLen;
-            auto buf = data.payload;
-
-            while(len > 0) {
-                int err;
-                err = tls_write(this->tls, buf, len);
-
-                if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
-                    continue;
-                } else if(err == -1) {
-                    throw std::runtime_error(f("tls_write() failed: {}", tls_error(this->tls)));
-                }
-
-                buf += err;
-                len -= err;
+            if(this->compression) {
+                const auto hdr = reinterpret_cast<const PacketHeader *>(data.payload);
+                const auto written = this->compression->compress(data.payload, data.payloadLen,
+                        this->compressedOut);
+                this->countCompression(hdr->endpoint, data.payloadLen, written);
+            } else {
+                this->writeStream(data.payload, data.payloadLen);
             }
 
+            this->bytesOut->inc(data.payloadLen);
+            this->packetsOut->inc();
+
             // clean up the payload
-            delete[] data.payload;
+            if(data.packetBuffer) {
+                ReleasePacketBuffer(data.packetBuffer);
+            } else {
+                delete[] data.payload;
+            }
+            break;
+        }
+        case PipeEvent::Invoke: {
+            std::unique_ptr<std::function<void(void)>> func(data.func);
+            (*func)();
             break;
         }
         case PipeEvent::NoOp:
@@ -323,51 +569,191 @@ void ListenerClient::handlePipeEvent(const PipeData &data) {
 }
 
 /**
- * Handle a received message.
+ * Reads from the connection, decompressing the data if compression is enabled.
+ *
+ * Without compression, this is just tls_read(). With compression, we keep reading from the
+ * connection until the requested number of bytes has been decompressed.
+ *
+ * @return Number of bytes read, 0 if the connection was closed, or a TLS error code
  */
-void ListenerClient::handleMessage(const PacketHeader &header) {
-    int err;
+int ListenerClient::readStream(void *out, const size_t outLen) {
+    if(!this->compression) {
+        return tls_read(this->tls, out, outLen);
+    }
 
-    // read the remainder of the packet
-    std::vector<std::byte> buffer;
+    auto outPtr = reinterpret_cast<std::byte *>(out);
+    size_t copied = 0;
 
-    if(header.length) {
-        buffer.resize(header.length * 4);
+    while(true) {
+        copied += this->compression->read(outPtr + copied, outLen - copied);
+        if(copied == outLen) break;
 
-        auto writePtr = buffer.data();
-        size_t toRead = buffer.size();
+        // get more data from the connection
+        const auto err = tls_read(this->tls, this->compressedIn.data(), this->compressedIn.size());
+        if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
+            continue;
+        } else if(err <= 0) {
+            return err;
+        }
 
-        while(toRead > 0) {
-            err = tls_read(this->tls, writePtr, toRead);
-            if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
-                continue;
-            }
-            else if(err == -1) {
-                throw std::runtime_error(f("tls_read() failed: {}", tls_error(this->tls)));
-            } else if(err == 0) {
-                throw std::runtime_error("Connection closed");
-            }
+        this->compression->decompress(this->compressedIn.data(), err);
+    }
 
-            writePtr += err;
-            toRead -= err;
+    return outLen;
+}
+
+/**
+ * Writes the given data to the connection as-is.
+ */
+void ListenerClient::writeStream(const void *data, const size_t dataLen) {
+    auto buf = reinterpret_cast<const std::byte *>(data);
+    size_t len = dataLen;
+
+    while(len > 0) {
+        int err;
+        err = tls_write(this->tls, buf, len);
+
+        if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
+            continue;
+        } else if(err == -1) {
+            throw std::runtime_error(f("tls_write() failed: {}", tls_error(this->tls)));
+        }
+
+        buf += err;
+        len -= err;
+    }
+}
+
+/**
+ * Writes all compressed packets that have accumulated since the last flush.
+ */
+void ListenerClient::flushStream() {
+    if(this->compressedOut.empty()) return;
+
+    this->writeStream(this->compressedOut.data(), this->compressedOut.size());
+    this->compressedOut.clear();
+}
+
+/**
+ * Records the size of a packet before and after compression. Alongside the byte counters, each
+ * endpoint gets a gauge with its overall compression ratio.
+ */
+void ListenerClient::countCompression(const uint8_t ep, const size_t rawLen,
+        const size_t compressedLen) {
+    using util::Metrics;
+
+    auto &counters = this->compressionBytes[ep];
+    if(!counters.first) {
+        const auto name = EndpointName(ep);
+
+        counters.first = Metrics::counter("cubeland_compression_bytes_total",
+                "Bytes sent on compressed connections, before and after compression",
+                {{"endpoint", name}, {"stage", "raw"}});
+        counters.second = Metrics::counter("cubeland_compression_bytes_total",
+                "Bytes sent on compressed connections, before and after compression",
+                {{"endpoint", name}, {"stage", "compressed"}});
+
+        // the counters are never removed, so the gauge may keep pointers to them
+        Metrics::gauge("cubeland_compression_ratio",
+                "Ratio of uncompressed to compressed bytes sent per endpoint", {{"endpoint", name}},
+                [raw = counters.first, compressed = counters.second] {
+            const auto out = compressed->get();
+            return out ? static_cast<double>(raw->get()) / out : 0.;
+        });
+    }
+
+    counters.first->inc(rawLen);
+    counters.second->inc(compressedLen);
+}
+
+/**
+ * Reads exactly the given number of bytes from the connection.
+ */
+void ListenerClient::readExactly(void *out, const size_t len) {
+    int err;
+
+    auto writePtr = reinterpret_cast<std::byte *>(out);
+    size_t toRead = len;
+
+    while(toRead > 0) {
+        err = this->readStream(writePtr, toRead);
+        if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
+            continue;
+        }
+        else if(err == -1) {
+            throw std::runtime_error(f("tls_read() failed: {}", tls_error(this->tls)));
+        } else if(err == 0) {
+            throw std::runtime_error("Connection closed");
+        }
+
+        writePtr += err;
+        toRead -= err;
+    }
+}
+
+/**
+ * Handles a received message.
+ *
+ * Its payload is read into a buffer from the pool; if it's split over several frames, the
+ * payloads of the continuation frames are appended to it. Handlers receive the header of the
+ * first frame, but the payload of the entire packet.
+ */
+void ListenerClient::handleMessage(const PacketHeader &header) {
+    auto buffer = this->owner->receiveBuffers.get(header.length * 4);
+    PacketHeader frame = header;
+    size_t numFrames = 1;
+
+    while(true) {
+        const auto offset = buffer->size();
+        buffer->resize(offset + (frame.length * 4));
+        this->readExactly(buffer->data() + offset, frame.length * 4);
+
+        if(!(frame.flags & kPacketFlagContinued)) break;
+
+        // read the next frame's header; it must continue the same packet
+        this->readExactly(&frame, sizeof(frame));
+        FrameHeaderToHost(frame);
+        numFrames++;
+
+        if(frame.endpoint != header.endpoint || frame.type != header.type ||
+                frame.tag != header.tag) {
+            throw std::runtime_error(f("Frame {:02x}:{:02x} (tag {}) interrupts packet {:02x}:{:02x} (tag {})",
+                    frame.endpoint, frame.type, frame.tag, header.endpoint, header.type,
+                    header.tag));
+        } else if(buffer->size() + (frame.length * 4) > kMaxPacketSize) {
+            throw std::runtime_error(f("Packet {:02x}:{:02x} exceeds maximum size",
+                    header.endpoint, header.type));
         }
     }
 
 #if LOG_PACKETS
-    Logging::trace("Received packet {:02x}:{:02x} length {}: payload {}", header.endpoint,
-            header.type, header.length, hexdump(buffer.begin(), buffer.end()));
+    Logging::trace("Received packet {:02x}:{:02x} length {} ({} frames): payload {}",
+            header.endpoint, header.type, buffer->size(), numFrames,
+            hexdump(buffer->begin(), buffer->end()));
 #endif
 
+    this->bytesIn->inc((numFrames * sizeof(PacketHeader)) + buffer->size());
+    this->packetsIn->inc();
+
     // invoke the appropriate handler
     for(auto &handler : this->handlers) {
         if(handler->canHandlePacket(header)) {
-            handler->handlePacket(header, buffer.data(), buffer.size());
+            auto &histogram = this->handlerTimes[header.endpoint];
+            if(!histogram) {
+                histogram = util::Metrics::histogram("cubeland_packet_handler_seconds",
+                        "Time taken to handle a received packet",
+                        {{"endpoint", EndpointName(header.endpoint)}});
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            handler->handlePacket(header, buffer->data(), buffer->size());
+            histogram->observe(std::chrono::steady_clock::now() - start);
             return;
         }
     }
 
     Logging::warn("Unhandled packet ({}) {:02x}:{:02x} length {}: payload {}", this->clientAddr,
-            header.endpoint, header.type, header.length, hexdump(buffer.begin(), buffer.end()));
+            header.endpoint, header.type, buffer->size(), hexdump(buffer->begin(), buffer->end()));
 }
 
 /**
@@ -3,19 +3,26 @@
 
 #include "PacketHandler.h"
 
+#include <array>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <optional>
 #include <memory>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <sys/socket.h>
 
 #include <uuid.h>
 
+#include <net/Framing.h>
+#include <util/LZ4Stream.h>
+#include <util/Metrics.h>
+
 struct tls;
 
 namespace world {
@@ -30,6 +37,9 @@ class Listener;
 namespace handler {
 class Auth;
 class BlockChange;
+class ChunkLoader;
+class PlayerMovement;
+class Time;
 }
 
 class ListenerClient {
@@ -50,6 +60,8 @@ class ListenerClient {
 
         /// builds a packet by prepending a header to the specified body
         uint16_t writePacket(const uint8_t ep, const uint8_t type, const void *data, const size_t dataLen, const uint16_t tag = 0);
+        /// sends a packet serialized into a packet buffer, without copying it
+        uint16_t writePacket(const uint8_t ep, const uint8_t type, net::PacketBuffer &&packet, const uint16_t tag = 0);
 
         /// whether the client is still connected
         const bool isConnected() const {
@@ -71,21 +83,41 @@ class ListenerClient {
         }
         /// world source
         world::WorldSource *getWorld() const;
+        /// player movement handler
+        handler::PlayerMovement *getMovement() const {
+            return this->movement;
+        }
+        /// chunk loading handler
+        handler::ChunkLoader *getChunkLoader() const {
+            return this->chunks;
+        }
+        /// time update handler
+        handler::Time *getTimeHandler() const {
+            return this->time;
+        }
 
         /// adds an observer on the given chonk
         void addChunkObserver(const std::shared_ptr<world::Chunk> &);
 
+        /// runs the given function on the client's worker thread
+        void runOnWorker(const std::function<void(void)> &f);
+
         /// invokes the auth state callbacks of all clients
         void authStateChanged();
         /// invokes save method of all dirty handlers
         void save();
 
     private:
+        /// Maximum amount of compressed data read from the connection at once
+        constexpr static const size_t kCompressedReadSize = 16 * 1024;
+
         enum class PipeEvent: uint8_t {
             // do nothing
             NoOp,
             // transmit the given packet
             SendPacket,
+            // invoke the given function
+            Invoke,
         };
 
         /// Data sent to worker thread via pipe
@@ -97,6 +129,10 @@ class ListenerClient {
             std::byte *payload = nullptr;
             /// length of payload
             size_t payloadLen = 0;
+            /// if set, the payload lives in this packet buffer, which is returned to the pool
+            std::vector<std::byte> *packetBuffer = nullptr;
+            /// function to invoke; deleted once it's been called
+            std::function<void(void)> *func = nullptr;
 
             PipeData() = default;
             PipeData(const PipeEvent _type) : type(_type) {}
@@ -104,15 +140,30 @@ class ListenerClient {
 
     private:
         void sendPipeData(const PipeData &);
+        void discardPipeData(const PipeData &);
+        void drainPipe();
 
         void workerMain();
+        void performHandshake(std::vector<PipeData> &);
         void handlePipeEvent(const PipeData &);
+
+        int readStream(void *, const size_t);
+        void readExactly(void *, const size_t);
+        void writeStream(const void *, const size_t);
+        void flushStream();
+        void countCompression(const uint8_t ep, const size_t rawLen, const size_t compressedLen);
         void handleMessage(const PacketHeader &);
 
+        void registerMetrics();
+        void removeMetrics();
+
     private:
         Listener *owner = nullptr;
         handler::Auth *auth = nullptr;
         handler::BlockChange *block = nullptr;
+        handler::PlayerMovement *movement = nullptr;
+        handler::ChunkLoader *chunks = nullptr;
+        handler::Time *time = nullptr;
 
         /// Client TLS connection
         struct tls *tls = nullptr;
@@ -125,6 +176,13 @@ class ListenerClient {
         /// client notification pipes
         int notePipe[2] = {-1, -1};
 
+        /// compresses the connection, if negotiated during the handshake
+        std::unique_ptr<util::LZ4Stream> compression;
+        /// compressed packets waiting to be written
+        std::vector<std::byte> compressedOut;
+        /// buffer for compressed data read from the connection
+        std::vector<std::byte> compressedIn;
+
         struct sockaddr_storage clientAddr;
 
         /// all packet message handlers
@@ -132,8 +190,17 @@ class ListenerClient {
 
         /// Tag value to write in the next packet
         uint16_t nextTag = 1;
-        /// whether the client connection is still alive
-        bool connected = true;
+        /// whether the client connection is still alive; once cleared, pipe events are discarded
+        std::atomic_bool connected = true;
+
+        /// value of the client label on this client's metrics
+        std::string metricsLabel;
+        /// bytes/packets received from and sent to the client
+        util::Metrics::Counter *bytesIn, *bytesOut, *packetsIn, *packetsOut;
+        /// packet handling time histograms, indexed by endpoint; populated as packets come in
+        std::array<util::Metrics::Histogram *, 256> handlerTimes{};
+        /// uncompressed and compressed bytes sent, indexed by endpoint; shared between clients
+        std::array<std::pair<util::Metrics::Counter *, util::Metrics::Counter *>, 256> compressionBytes{};
 };
 };
 
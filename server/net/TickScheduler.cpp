@@ -0,0 +1,299 @@
+#include "TickScheduler.h"
+#include "Listener.h"
+#include "ListenerClient.h"
+
+#include <io/ConfigManager.h>
+#include <io/Format.h>
+#include <util/Thread.h>
+#include <Logging.h>
+
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+
+using namespace net;
+
+/// names of the phases, for metrics and logging
+static const char *kPhaseNames[] = {
+    "ingest", "simulate", "broadcast", "persist",
+};
+
+/**
+ * Reads the tick configuration and creates the client task workers. The tick thread isn't started
+ * until `start()` is called, so tasks can be registered first.
+ */
+TickScheduler::TickScheduler(Listener *_listener) : listener(_listener) {
+    const auto rate = std::max(1UL, io::ConfigManager::getUnsigned("tick.rate", 20));
+    this->interval = std::chrono::milliseconds(1000 / rate);
+
+    const auto threads = std::max(1UL, io::ConfigManager::getUnsigned("tick.threads", 4));
+    Logging::debug("Server tick: {} ms, {} client workers", this->interval.count(), threads);
+
+    this->pool = std::make_unique<util::ThreadPool<std::function<void(void)>>>("Tick Worker",
+            threads);
+
+    this->registerMetrics();
+}
+
+/**
+ * Stops the tick thread if it's still running.
+ */
+TickScheduler::~TickScheduler() {
+    this->stop();
+    this->pool = nullptr;
+
+    this->removeMetrics();
+}
+
+/**
+ * Sets up the tick timing metrics.
+ */
+void TickScheduler::registerMetrics() {
+    using util::Metrics;
+
+    for(size_t i = 0; i < (size_t) TickPhase::Max; i++) {
+        this->phaseTimes[i] = Metrics::histogram("cubeland_tick_phase_seconds",
+                "Time taken by each phase of a server tick", {{"phase", kPhaseNames[i]}});
+    }
+
+    this->tickTime = Metrics::histogram("cubeland_tick_seconds", "Time taken by server ticks");
+    this->overruns = Metrics::counter("cubeland_tick_overruns_total",
+            "Server ticks that took longer than the tick interval");
+
+    Metrics::gauge("cubeland_tick_worker_queue_depth", "Client tick work items waiting for a worker",
+            {}, [&] {
+        return this->pool->numPending();
+    });
+}
+
+/**
+ * Removes all of our metrics.
+ */
+void TickScheduler::removeMetrics() {
+    using util::Metrics;
+
+    for(size_t i = 0; i < (size_t) TickPhase::Max; i++) {
+        Metrics::remove("cubeland_tick_phase_seconds", {{"phase", kPhaseNames[i]}});
+    }
+
+    Metrics::remove("cubeland_tick_seconds");
+    Metrics::remove("cubeland_tick_overruns_total");
+    Metrics::remove("cubeland_tick_worker_queue_depth");
+}
+
+
+
+/**
+ * Starts the tick thread.
+ */
+void TickScheduler::start() {
+    XASSERT(!this->thread, "Tick scheduler already running");
+
+    this->run = true;
+    this->thread = std::make_unique<std::thread>(&TickScheduler::main, this);
+}
+
+/**
+ * Stops the tick thread, after it finishes the current tick.
+ */
+void TickScheduler::stop() {
+    if(!this->thread) return;
+
+    this->run = false;
+    this->thread->join();
+    this->thread = nullptr;
+}
+
+/**
+ * Registers a global task.
+ */
+TickScheduler::TaskId TickScheduler::addTask(const TickPhase phase,
+        const std::chrono::milliseconds interval, const Task &task) {
+    Entry entry;
+    entry.phase = phase;
+    entry.task = task;
+
+    return this->insert(entry, interval);
+}
+
+/**
+ * Registers a per-client task.
+ */
+TickScheduler::TaskId TickScheduler::addClientTask(const TickPhase phase,
+        const std::chrono::milliseconds interval, const ClientTask &task) {
+    Entry entry;
+    entry.phase = phase;
+    entry.clientTask = task;
+
+    return this->insert(entry, interval);
+}
+
+/**
+ * Converts the interval to a number of ticks, and adds the task to the list.
+ */
+TickScheduler::TaskId TickScheduler::insert(Entry entry, const std::chrono::milliseconds interval) {
+    const auto ticks = (interval.count() + this->interval.count() - 1) / this->interval.count();
+    entry.every = std::max<uint64_t>(1, ticks);
+
+    if(interval.count() % this->interval.count()) {
+        Logging::debug("Task interval {} ms isn't a multiple of the tick; it runs every {} ms",
+                interval.count(), entry.every * this->interval.count());
+    }
+
+    std::lock_guard<std::mutex> lg(this->tasksLock);
+    entry.id = this->nextId++;
+    this->tasks.push_back(std::move(entry));
+
+    return this->tasks.back().id;
+}
+
+/**
+ * Removes a task. If a tick is in progress, this waits for it to complete, so the task is
+ * guaranteed not to be running once this returns.
+ */
+void TickScheduler::removeTask(const TaskId id) {
+    std::lock_guard<std::mutex> lg(this->tasksLock);
+
+    this->tasks.erase(std::remove_if(this->tasks.begin(), this->tasks.end(), [id](auto &entry) {
+        return entry.id == id;
+    }), this->tasks.end());
+}
+
+
+
+/**
+ * Main loop of the tick thread
+ *
+ * Ticks are started at fixed intervals. If a tick runs over, the next one starts immediately and
+ * the schedule is reset from there, so a slow tick doesn't cause a burst of ticks to follow.
+ */
+void TickScheduler::main() {
+    using namespace std::chrono;
+    util::Thread::setName("Server Tick");
+
+    std::array<nanoseconds, (size_t) TickPhase::Max> phaseTimes;
+    auto nextTick = steady_clock::now();
+    auto lastOverrunLog = steady_clock::time_point();
+    uint64_t overrunsSinceLog = 0;
+
+    while(this->run) {
+        // wait for the tick to come around
+        std::this_thread::sleep_until(nextTick);
+        if(!this->run) break;
+
+        const auto start = steady_clock::now();
+        const auto tick = this->tick++;
+
+        this->runTick(tick, phaseTimes);
+
+        const auto end = steady_clock::now();
+        const auto elapsed = end - start;
+        this->tickTime->observe(elapsed);
+
+        // schedule the next tick, checking for overruns
+        nextTick += this->interval;
+
+        if(end > nextTick) {
+            this->overruns->inc();
+            overrunsSinceLog++;
+            nextTick = end;
+
+            if(end - lastOverrunLog >= kOverrunLogInterval) {
+                Logging::warn("Server tick {} overran: {} ms (ingest {} ms, simulate {} ms, "
+                        "broadcast {} ms, persist {} ms; {} overruns since last report)", tick,
+                        duration_cast<milliseconds>(elapsed).count(),
+                        duration_cast<milliseconds>(phaseTimes[0]).count(),
+                        duration_cast<milliseconds>(phaseTimes[1]).count(),
+                        duration_cast<milliseconds>(phaseTimes[2]).count(),
+                        duration_cast<milliseconds>(phaseTimes[3]).count(), overrunsSinceLog);
+
+                lastOverrunLog = end;
+                overrunsSinceLog = 0;
+            }
+        }
+    }
+}
+
+/**
+ * Runs all phases of a tick, and records how long each of them took.
+ *
+ * Exceptions thrown by tasks are logged; they don't prevent the remaining tasks from running.
+ */
+void TickScheduler::runTick(const uint64_t tick,
+        std::array<std::chrono::nanoseconds, (size_t) TickPhase::Max> &outTimes) {
+    using namespace std::chrono;
+
+    std::vector<const Entry *> clientTasks;
+    std::lock_guard<std::mutex> lg(this->tasksLock);
+
+    for(size_t i = 0; i < (size_t) TickPhase::Max; i++) {
+        const auto phase = static_cast<TickPhase>(i);
+        const auto start = steady_clock::now();
+
+        clientTasks.clear();
+
+        // run the global tasks that are due
+        for(const auto &entry : this->tasks) {
+            if(entry.phase != phase || (tick % entry.every)) continue;
+
+            if(entry.clientTask) {
+                clientTasks.push_back(&entry);
+                continue;
+            }
+
+            try {
+                entry.task();
+            } catch(std::exception &e) {
+                Logging::error("Tick task {} ({}) failed: {}", entry.id, kPhaseNames[i], e.what());
+            }
+        }
+
+        // then, distribute the per-client tasks
+        if(!clientTasks.empty()) {
+            this->runClientTasks(clientTasks);
+        }
+
+        outTimes[i] = steady_clock::now() - start;
+        this->phaseTimes[i]->observe(outTimes[i]);
+    }
+}
+
+/**
+ * Runs the given per-client tasks for all clients. Clients are split into one contiguous batch
+ * per worker; we wait for all batches to complete.
+ */
+void TickScheduler::runClientTasks(const std::vector<const Entry *> &entries) {
+    std::lock_guard<std::mutex> lg(this->listener->clientLock);
+
+    auto &clients = this->listener->clients;
+    if(clients.empty()) return;
+
+    const auto numBatches = std::min(clients.size(), this->pool->getNumWorkers());
+    const auto batchSize = (clients.size() + numBatches - 1) / numBatches;
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(numBatches);
+
+    for(size_t start = 0; start < clients.size(); start += batchSize) {
+        const auto end = std::min(start + batchSize, clients.size());
+
+        futures.push_back(this->pool->queueWorkItem([&, start, end] {
+            for(size_t i = start; i < end; i++) {
+                auto client = clients[i].get();
+
+                for(auto entry : entries) {
+                    try {
+                        entry->clientTask(client);
+                    } catch(std::exception &e) {
+                        Logging::error("Tick task {} failed for client {}: {}", entry->id,
+                                client->getClientAddr(), e.what());
+                    }
+                }
+            }
+        }));
+    }
+
+    for(auto &future : futures) {
+        future.get();
+    }
+}
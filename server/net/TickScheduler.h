@@ -0,0 +1,141 @@
+#ifndef SERVER_NET_TICKSCHEDULER_H
+#define SERVER_NET_TICKSCHEDULER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <util/Metrics.h>
+#include <util/ThreadPool.h>
+
+namespace net {
+class Listener;
+class ListenerClient;
+
+/**
+ * Phases of a server tick, in the order they run.
+ */
+enum class TickPhase: uint8_t {
+    /// pick up work queued by clients since the last tick
+    Ingest,
+    /// advance the state of the world
+    Simulate,
+    /// send state changes to clients
+    Broadcast,
+    /// write out modified state
+    Persist,
+
+    Max,
+};
+
+/**
+ * Drives all periodic server work from a single fixed-rate loop.
+ *
+ * Each tick runs through the phases in order. In each phase, the global tasks that are due run
+ * first, in the order they were registered, on the tick thread. Then, due per-client tasks are run
+ * for every connected client; clients are spread over a pool of workers, and the phase only ends
+ * once all of them are done. A task registered with an interval runs every N ticks, where N is
+ * the interval rounded up to whole ticks.
+ *
+ * The time taken by each phase is recorded. If a tick overruns its time slot, the next tick starts
+ * right away, and the missed slots are dropped rather than caught up on.
+ *
+ * Tasks run with the scheduler's task lock held, so they can't add or remove tasks themselves;
+ * removing a task waits for the current tick to finish. Per-client tasks also run with the
+ * listener's client lock held, and so must not call `Listener::forEach()`.
+ */
+class TickScheduler {
+    public:
+        using TaskId = uint64_t;
+        using Task = std::function<void(void)>;
+        using ClientTask = std::function<void(ListenerClient *)>;
+
+    public:
+        TickScheduler(Listener *listener);
+        ~TickScheduler();
+
+        void start();
+        void stop();
+
+        /// Registers a task that runs on the tick thread at (roughly) the given interval
+        TaskId addTask(const TickPhase phase, const std::chrono::milliseconds interval,
+                const Task &task);
+        /// Registers a task that runs for each connected client at (roughly) the given interval
+        TaskId addClientTask(const TickPhase phase, const std::chrono::milliseconds interval,
+                const ClientTask &task);
+        /// Removes a previously registered task
+        void removeTask(const TaskId id);
+
+        /// Duration of a single tick
+        const std::chrono::milliseconds getInterval() const {
+            return this->interval;
+        }
+        /// Number of the tick currently (or most recently) executed
+        const uint64_t getTick() const {
+            return this->tick;
+        }
+
+    private:
+        /// A task registered with the scheduler
+        struct Entry {
+            TaskId id;
+            TickPhase phase;
+            /// the task runs on ticks that are a multiple of this
+            uint64_t every;
+
+            Task task;
+            ClientTask clientTask;
+        };
+
+        /// Overruns are logged at most this often
+        constexpr static const std::chrono::seconds kOverrunLogInterval = std::chrono::seconds(10);
+
+    private:
+        void main();
+
+        void runTick(const uint64_t tick, std::array<std::chrono::nanoseconds, (size_t) TickPhase::Max> &);
+        void runClientTasks(const std::vector<const Entry *> &);
+
+        TaskId insert(Entry entry, const std::chrono::milliseconds interval);
+
+        void registerMetrics();
+        void removeMetrics();
+
+    private:
+        Listener *listener = nullptr;
+
+        /// length of a tick
+        std::chrono::milliseconds interval;
+        /// number of the current tick
+        std::atomic_uint64_t tick = 0;
+
+        std::atomic_bool run;
+        std::unique_ptr<std::thread> thread;
+
+        /// workers that per-client tasks are distributed over
+        std::unique_ptr<util::ThreadPool<std::function<void(void)>>> pool;
+
+        /// protects the task list; held while tasks execute
+        std::mutex tasksLock;
+        /// all registered tasks
+        std::vector<Entry> tasks;
+        /// identifier for the next task
+        TaskId nextId = 1;
+
+        /// time taken by each phase
+        std::array<util::Metrics::Histogram *, (size_t) TickPhase::Max> phaseTimes{};
+        /// time taken by entire ticks
+        util::Metrics::Histogram *tickTime = nullptr;
+        /// number of ticks that took longer than the tick interval
+        util::Metrics::Counter *overruns = nullptr;
+};
+}
+
+#endif
@@ -6,17 +6,16 @@
 #include "auth/KeyCache.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPAuth.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <util/Signature.h>
 
 #include <openssl/rand.h>
-#include <cereal/archives/portable_binary.hpp>
-
 #include <cstdlib>
-#include <sstream>
 
 using namespace net::handler;
 using namespace net::message;
@@ -28,6 +27,18 @@ Auth::Auth(ListenerClient *_client) : PacketHandler(_client) {
 
 }
 
+/**
+ * Detaches from an outstanding key lookup, so that its callback no longer references us. Rather
+ * than waiting for the lookup to complete (which may take as long as the web API does) we only
+ * wait for a callback that's currently executing.
+ */
+Auth::~Auth() {
+    if(this->keyLookup) {
+        std::lock_guard<std::mutex> lg(this->keyLookup->lock);
+        this->keyLookup->owner = nullptr;
+    }
+}
+
 /**
  * We handle all auth endpoint packets.
  */
@@ -88,8 +99,7 @@ void Auth::handlePacket(const PacketHeader &header, const void *payload, const s
  */
 void Auth::getConnectedUsers(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     AuthGetUsersRequest request;
     iArc(request);
@@ -119,12 +129,12 @@ void Auth::getConnectedUsers(const PacketHeader &header, const void *payload, co
     });
 
     // send response
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(reply);
 
-    this->client->writePacket(kEndpointAuthentication, kAuthGetConnectedReply, oStream.str(),
+    this->client->writePacket(kEndpointAuthentication, kAuthGetConnectedReply, std::move(packet),
             header.tag);
 }
 
@@ -136,8 +146,7 @@ void Auth::getConnectedUsers(const PacketHeader &header, const void *payload, co
  */
 void Auth::handleAuthReq(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     // attempt to deserialize the auth request packet
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     AuthRequest request;
     iArc(request);
@@ -155,8 +164,8 @@ void Auth::handleAuthReq(const PacketHeader &header, const void *payload, const
 #endif
 
     // build challenge response and serialize
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     AuthChallenge challenge(random);
     oArc(challenge);
@@ -166,34 +175,69 @@ void Auth::handleAuthReq(const PacketHeader &header, const void *payload, const
     this->challengeData = random;
 
     // send it
-    this->client->writePacket(kEndpointAuthentication, kAuthChallenge, oStream.str(), header.tag);
+    this->client->writePacket(kEndpointAuthentication, kAuthChallenge, std::move(packet), header.tag);
 }
 
 /**
  * Handles a client's response to a previous authentication challenge. This is really just a simple
  * signature verification using the client's public key... which we may need to fetch from the
  * web service.
+ *
+ * Looking up the key can take a while, so we don't wait for it here: once it's available, the
+ * verification finishes on the client's worker thread.
  */
 void Auth::handleAuthChallengeReply(const PacketHeader &header, const void *payload,
         const size_t payloadLen) {
-    bool valid = false;
-
     // Deserialize response
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     AuthChallengeReply reply;
     iArc(reply);
 
+    // look up the key
+    this->state = State::WaitingForKey;
+
+    auto lookup = std::make_shared<KeyLookup>();
+    lookup->owner = this;
+    this->keyLookup = lookup;
+
+    const auto tag = header.tag;
+    auto signature = reply.signature;
+
+    /*
+     * The verification runs on the worker thread, which exits before handlers are deallocated;
+     * events it hasn't processed by then are discarded, so that part may reference us directly.
+     */
+    auth::KeyCache::get(this->clientId, [lookup, tag, signature](auto key) {
+        std::lock_guard<std::mutex> lg(lookup->lock);
+        auto auth = lookup->owner;
+        if(!auth) return;
+
+        auth->client->runOnWorker([auth, key, tag, signature] {
+            auth->verifyChallengeReply(key, signature, tag);
+        });
+    });
+}
+
+/**
+ * Verifies the signature the client sent over the challenge data, and sends the result to the
+ * client.
+ */
+void Auth::verifyChallengeReply(const std::shared_ptr<evp_pkey_st> &clientKey,
+        const std::vector<std::byte> &signature, const uint16_t tag) {
+    bool valid = false;
+
     // verify the challenge
-    auto clientKey = auth::KeyCache::get(this->clientId);
-
-    try {
-        valid = util::Signature::verify(clientKey, this->challengeData.data(),
-                this->challengeData.size(), reply.signature);
-    } catch(std::exception &e) {
-        Logging::error("Failed to verify challenge response: {}", e.what());
-        valid = false;
+    if(!clientKey) {
+        Logging::warn("No key available for client {}", this->clientId);
+    } else {
+        try {
+            valid = util::Signature::verify(clientKey.get(), this->challengeData.data(),
+                    this->challengeData.size(), signature);
+        } catch(std::exception &e) {
+            Logging::error("Failed to verify challenge response: {}", e.what());
+            valid = false;
+        }
     }
 
     // send appropriate response
@@ -211,11 +255,11 @@ void Auth::handleAuthChallengeReply(const PacketHeader &header, const void *payl
             this->displayName, valid ?  "success" : "failure");
 
     // send the response
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(status);
 
-    this->client->writePacket(kEndpointAuthentication, kAuthStatus, oStream.str(), header.tag);
+    this->client->writePacket(kEndpointAuthentication, kAuthStatus, std::move(packet), tag);
 
     // invoke handlers
     this->client->authStateChanged();
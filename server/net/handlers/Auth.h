@@ -5,15 +5,21 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <vector>
 
 #include <uuid.h>
 
+struct evp_pkey_st;
+
 namespace net::handler {
 class Auth: public PacketHandler {
     public:
         Auth(ListenerClient *_client);
-        virtual ~Auth() = default;
+        virtual ~Auth();
 
         bool canHandlePacket(const PacketHeader &header) override;
         void handlePacket(const PacketHeader &header, const void *payload,
@@ -44,15 +50,26 @@ class Auth: public PacketHandler {
             Idle,
             /// a challenge has been sent; verify it
             VerifyChallenge,
+            /// the challenge reply was received; waiting for the client's key to verify it
+            WaitingForKey,
             /// Authentication was successful
             Successful,
             /// Client could NOT be authenticated
             Failed,
         };
 
+        /// State shared with an outstanding key lookup callback
+        struct KeyLookup {
+            std::mutex lock;
+            /// handler to notify; cleared when the handler goes away
+            Auth *owner = nullptr;
+        };
+
     private:
         void handleAuthReq(const PacketHeader &, const void *, const size_t);
         void handleAuthChallengeReply(const PacketHeader &, const void *, const size_t);
+        void verifyChallengeReply(const std::shared_ptr<evp_pkey_st> &,
+                const std::vector<std::byte> &, const uint16_t);
 
         void getConnectedUsers(const PacketHeader &, const void *, const size_t);
 
@@ -66,6 +83,9 @@ class Auth: public PacketHandler {
         std::string displayName;
         /// random data generated for client auth challenge
         std::array<std::byte, 32> challengeData;
+
+        /// most recent key lookup; detached from us when we're deallocated
+        std::shared_ptr<KeyLookup> keyLookup;
 };
 }
 
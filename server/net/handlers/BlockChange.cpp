@@ -1,26 +1,31 @@
 #include "BlockChange.h"
 #include "net/Listener.h"
 #include "net/ListenerClient.h"
+#include "net/InterestGrid.h"
+#include "net/TickScheduler.h"
+#include "world/ChunkVersions.h"
 
 #include <world/WorldSource.h>
 #include <world/chunk/Chunk.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPBlockChange.h>
 
+#include <io/ConfigManager.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <Logging.h>
 
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
+#include <chrono>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 using namespace net::handler;
 using namespace net::message;
 
-std::atomic_bool BlockChange::broadcastRun;
-std::unique_ptr<std::thread> BlockChange::broadcastThread;
-moodycamel::BlockingConcurrentQueue<BlockChange::BroadcastItem> BlockChange::broadcastQueue;
+moodycamel::ConcurrentQueue<BlockChange::BroadcastItem> BlockChange::broadcastQueue;
+BlockChange::PendingMap BlockChange::pending;
 
 
 
@@ -73,13 +78,14 @@ void BlockChange::handlePacket(const PacketHeader &header, const void *payload,
  */
 void BlockChange::removeObserver(const PacketHeader &, const void *payload, const size_t payloadLen) {
     // deserialize the message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     BlockChangeUnregister request;
     iArc(request);
 
     // remove the chunk observer
+    this->client->getListener()->getInterestGrid()->removeObserver(this->client, request.chunkPos);
+
     std::lock_guard<std::mutex> lg(this->chunksLock);
     if(!this->chunks.contains(request.chunkPos)) {
         Logging::error("Client {} wants unsubscribe for chunk {}, but no such registration exists",
@@ -95,8 +101,7 @@ void BlockChange::removeObserver(const PacketHeader &, const void *payload, cons
  */
 void BlockChange::handleChange(const PacketHeader &, const void *payload, const size_t payloadLen) {
     // deserialize the message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     BlockChangeReport request;
     iArc(request);
@@ -105,44 +110,30 @@ void BlockChange::handleChange(const PacketHeader &, const void *payload, const
         throw std::runtime_error("Received empty block change report");
     }
 
-    // apply each change to the chunk
+    // apply each change to the chunk, and bump the version of the slice it's in
+    auto versions = this->client->getListener()->getChunkVersions();
+
+    BroadcastItem item;
+    item.sender = this->client;
+    item.world = this->client->getWorld();
+
     {
         std::lock_guard<std::mutex> lg(this->chunksLock);
 
         for(const auto &change : request.changes) {
             auto chunk = this->chunks.at(change.chunkPos);
             chunk->setBlock(change.blockPos, change.newId, true);
+            chunk->sliceVersions[change.blockPos.y] = versions->next();
 
-            this->client->getWorld()->markChunkDirty(chunk);
+            item.chunks.push_back(chunk);
 
             Logging::trace("Chunk {} changed block {} to {}", change.chunkPos, change.blockPos, change.newId);
         }
     }
 
-    // build change message
-    BlockChangeBroadcast broad;
-    broad.changes = request.changes; // TODO: veto changes
-
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
-    oArc(broad);
-
-    const auto str = oStream.str();
-
-    // send to all other clients
-    const auto ourId = this->client->getClientId();
-    const auto thisClient = this->client;
-
-    this->client->getListener()->forEach([&, ourId, thisClient, str](auto &client) {
-        // ignore unauthenticated clients, or this client
-        auto clientId = client->getClientId();
-        if(!clientId) return;
-        else if(client.get() == thisClient) return;
-        // else if(*clientId == *ourId) return;
-
-        // send packet
-        client->writePacket(kEndpointBlockChange, kBlockChangeBroadcast, str);
-    });
+    // the next tick marks chunks dirty and sends the changes out
+    item.changes = request.changes; // TODO: veto changes
+    broadcastQueue.enqueue(std::move(item));
 }
 
 
@@ -151,6 +142,8 @@ void BlockChange::handleChange(const PacketHeader &, const void *payload, const
  * Adds a change observer to the given chunk.
  */
 void BlockChange::addObserver(const std::shared_ptr<world::Chunk> &chunk) {
+    this->client->getListener()->getInterestGrid()->addObserver(this->client, chunk->worldPos);
+
     std::lock_guard<std::mutex> lg(this->chunksLock);
     this->chunks[chunk->worldPos] = chunk;
 }
@@ -158,83 +151,108 @@ void BlockChange::addObserver(const std::shared_ptr<world::Chunk> &chunk) {
 
 
 /**
- * Starts the broadcasting thread.
+ * Registers the tick tasks that pick up reported changes, and periodically broadcast them.
  */
-void BlockChange::startBroadcaster(net::Listener *list) {
-    broadcastRun = true;
-    broadcastThread = std::make_unique<std::thread>(std::bind(&BlockChange::broadcasterMain, list));
+void BlockChange::registerTickTasks(net::Listener *listener) {
+    auto tick = listener->getTickScheduler();
+    const auto interval = std::chrono::milliseconds(io::ConfigManager::getUnsigned("proto.blockChangeTickInterval", 50));
+
+    tick->addTask(TickPhase::Ingest, tick->getInterval(), [] {
+        broadcasterIngest();
+    });
+    tick->addTask(TickPhase::Broadcast, interval, [listener] {
+        broadcasterFlush(listener, pending);
+    });
 }
 
 /**
- * Terminates the broadcasting thread.
+ * Sends out all changes that haven't been broadcast yet; this is used when shutting down, once
+ * the tick scheduler has stopped, so that changed chunks are still written out.
  */
-void BlockChange::stopBroadcaster() {
-    // push some dummy work so the thread wakes
-    broadcastRun = false;
-    broadcastQueue.enqueue(BroadcastItem());
-
-    // wait for it to terminate
-    broadcastThread->join();
-    broadcastThread = nullptr;
+void BlockChange::flushPending(net::Listener *listener) {
+    broadcasterIngest();
+    broadcasterFlush(listener, pending);
 }
 
 /**
- * Main loop for the broadcast thread
+ * Merges all queued changes into the pending set.
  */
-void BlockChange::broadcasterMain(net::Listener *listener) {
-    util::Thread::setName("Block Change Broadcaster");
-
+void BlockChange::broadcasterIngest() {
     BroadcastItem item;
 
-    // try to receive work updates
-    while(broadcastRun) {
-        broadcastQueue.wait_dequeue(item);
-
-        switch(item.op) {
-            // no-op
-            case WorkerOp::NoOp:
-                break;
-
-            // build packet for changes and broadcast it
-            case WorkerOp::BlockChange:
-                // TODO: should we try to coalesce reports?
-                broadcasterHandleChanges(listener, item);
-                break;
-
-            // unknown opcode
-            default:
-                Logging::error("Unknown broadcast op: {}", item.op);
-                break;
-        }
+    while(broadcastQueue.try_dequeue(item)) {
+        broadcasterHandleChanges(pending, item);
     }
+}
 
-    // clean up
+/**
+ * Merges the changes in the work request into the pending changes. Repeated writes to the same
+ * block collapse into the most recent one.
+ */
+void BlockChange::broadcasterHandleChanges(PendingMap &pending, const BroadcastItem &item) {
+    for(size_t i = 0; i < item.changes.size(); i++) {
+        const auto &change = item.changes[i];
+        auto &chunk = pending[change.chunkPos];
+
+        chunk.chunk = item.chunks[i];
+        chunk.world = item.world;
+        chunk.blocks[change.blockPos] = PendingBlock{change.newId, item.sender};
+    }
 }
 
 /**
- * Builds a block change broadcast packet for the blocks that changed in the work request, then
- * sends it to ALL clients.
+ * Marks all chunks with pending changes as dirty, then sends each interested client a single
+ * packet with the changes in all chunks it observes. Clients don't get their own changes echoed
+ * back to them, unless another client wrote to the same block after them.
  */
-void BlockChange::broadcasterHandleChanges(net::Listener *listener, const BroadcastItem &item) {
-    // build the broadcast
-    BlockChangeBroadcast broad;
-    broad.changes = item.changes;
+void BlockChange::broadcasterFlush(net::Listener *listener, PendingMap &pending) {
+    if(pending.empty()) return;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
-    oArc(broad);
+    std::vector<glm::ivec2> chunkPositions;
+    chunkPositions.reserve(pending.size());
+
+    for(auto &[pos, info] : pending) {
+        info.world->markChunkDirty(info.chunk);
+        chunkPositions.push_back(pos);
+    }
 
-    const auto str = oStream.str();
+    /*
+     * Build a packet per client. They're only sent once the grid lock is released; the client
+     * lock is held throughout, so the clients can't go away in between.
+     */
+    listener->withClientsLocked([&] {
+        std::vector<std::pair<ListenerClient *, net::PacketBuffer>> packets;
 
-    // send to all clients
-    listener->forEach([&, str](auto &client) {
-        // ignore unauthenticated clients
-        auto clientId = client->getClientId();
-        if(!clientId) return;
+        listener->getInterestGrid()->forEachObserver(chunkPositions,
+                [&](ListenerClient *client, const std::vector<glm::ivec2> &observed) {
+            BlockChangeBroadcast broad;
 
-        // TODO: we could check whether the given client even cares about these updates
+            for(const auto &pos : observed) {
+                for(const auto &[blockPos, block] : pending[pos].blocks) {
+                    if(block.sender == client) continue;
 
-        // send packet
-        client->writePacket(kEndpointBlockChange, kBlockChangeBroadcast, str);
+                    BlockChangeInfo info;
+                    info.chunkPos = pos;
+                    info.blockPos = blockPos;
+                    info.newId = block.newId;
+
+                    broad.changes.push_back(info);
+                }
+            }
+
+            if(broad.changes.empty()) return;
+
+            auto packet = net::GetPacketBuffer();
+            io::BufferOutputArchive oArc(*packet);
+            oArc(broad);
+
+            packets.emplace_back(client, std::move(packet));
+        });
+
+        for(auto &[client, packet] : packets) {
+            client->writePacket(kEndpointBlockChange, kBlockChangeBroadcast, std::move(packet));
+        }
     });
+
+    pending.clear();
 }
@@ -8,7 +8,6 @@
 #include <cstdint>
 #include <memory>
 #include <string>
-#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -18,11 +17,11 @@
 #include <glm/vec3.hpp>
 #include <glm/gtx/hash.hpp>
 #include <cereal/access.hpp>
-#include <cpptime.h>
-#include <blockingconcurrentqueue.h>
+#include <concurrentqueue.h>
 
 namespace world {
 struct Chunk;
+class WorldSource;
 }
 
 namespace net {
@@ -35,6 +34,9 @@ class Chunk;
 /**
  * Receives block change notifications from the client, then applies them to the chunk and re-
  * broadcasts the change to all other clients.
+ *
+ * Changes are queued as they come in; each server tick picks them up during the ingest phase, and
+ * at the block change interval, sends them out in the broadcast phase.
  */
 class BlockChange: public PacketHandler {
     friend class net::Listener;
@@ -55,30 +57,47 @@ class BlockChange: public PacketHandler {
         void removeObserver(const PacketHeader &, const void *, const size_t);
 
     private:
-        /// types of operations performed by broadcast thread
-        enum class WorkerOp: uint8_t {
-            NoOp,
-            BlockChange,
-        };
-
+        /// changes reported by a client in a single message
         struct BroadcastItem {
-            WorkerOp op = WorkerOp::NoOp;
-
             // block changes
             std::vector<message::BlockChangeInfo> changes;
+            // chunk each of the changes was applied to (same order as changes)
+            std::vector<std::shared_ptr<world::Chunk>> chunks;
+            // client that reported the changes; it won't get them echoed back
+            const ListenerClient *sender = nullptr;
+            // world the chunks belong to
+            world::WorldSource *world = nullptr;
+        };
+
+        /// most recent change to a block, waiting to be broadcast
+        struct PendingBlock {
+            uuids::uuid newId;
+            const ListenerClient *sender = nullptr;
         };
 
+        /// all pending changes in a chunk
+        struct PendingChunk {
+            std::shared_ptr<world::Chunk> chunk;
+            world::WorldSource *world = nullptr;
+
+            std::unordered_map<glm::ivec3, PendingBlock> blocks;
+        };
+
+        using PendingMap = std::unordered_map<glm::ivec2, PendingChunk>;
+
     private:
-        static void startBroadcaster(net::Listener *);
-        static void stopBroadcaster();
+        static void registerTickTasks(net::Listener *);
+        static void flushPending(net::Listener *);
 
-        static void broadcasterMain(net::Listener *);
-        static void broadcasterHandleChanges(net::Listener *, const BroadcastItem &);
+        static void broadcasterIngest();
+        static void broadcasterHandleChanges(PendingMap &, const BroadcastItem &);
+        static void broadcasterFlush(net::Listener *, PendingMap &);
 
     private:
-        static std::unique_ptr<std::thread> broadcastThread;
-        static std::atomic_bool broadcastRun;
-        static moodycamel::BlockingConcurrentQueue<BroadcastItem> broadcastQueue;
+        /// changes reported by clients, waiting to be picked up by the next tick
+        static moodycamel::ConcurrentQueue<BroadcastItem> broadcastQueue;
+        /// changes waiting to be broadcast; only accessed from the tick thread
+        static PendingMap pending;
 
         std::mutex chunksLock;
         std::unordered_map<glm::ivec2, std::shared_ptr<world::Chunk>> chunks;
@@ -1,24 +1,22 @@
 #include "Chat.h"
 #include "net/Listener.h"
 #include "net/ListenerClient.h"
+#include "net/TickScheduler.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPChat.h>
 
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <Logging.h>
 
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
 using namespace net::message;
 
-std::atomic_bool Chat::broadcastRun;
-std::unique_ptr<std::thread> Chat::broadcastThread;
-moodycamel::BlockingConcurrentQueue<Chat::BroadcastItem> Chat::broadcastQueue;
+moodycamel::ConcurrentQueue<Chat::BroadcastItem> Chat::broadcastQueue;
 
 /**
  * We handle all world info endpoint packets.
@@ -57,8 +55,7 @@ void Chat::handlePacket(const PacketHeader &header, const void *payload, const s
  */
 void Chat::playerMessage(const PacketHeader &, const void *payload, const size_t payloadLen) {
     // deserialize message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     ChatPlayerMessage msg;
     iArc(msg);
@@ -73,38 +70,23 @@ void Chat::playerMessage(const PacketHeader &, const void *payload, const size_t
 
 
 /**
- * Starts the broadcasting thread.
+ * Registers the tick task that sends out queued messages.
  */
-void Chat::startBroadcaster(net::Listener *list) {
-    broadcastRun = true;
-    broadcastThread = std::make_unique<std::thread>(std::bind(&Chat::broadcasterMain, list));
-}
+void Chat::registerTickTasks(net::Listener *listener) {
+    auto tick = listener->getTickScheduler();
 
-/**
- * Terminates the broadcasting thread.
- */
-void Chat::stopBroadcaster() {
-    // push some dummy work so the thread wakes
-    broadcastRun = false;
-    broadcastQueue.enqueue(BroadcastItem());
-
-    // wait for it to terminate
-    broadcastThread->join();
-    broadcastThread = nullptr;
+    tick->addTask(TickPhase::Broadcast, tick->getInterval(), [listener] {
+        broadcastPending(listener);
+    });
 }
 
 /**
- * Main loop for the broadcast thread
+ * Sends all messages that were queued since the last tick.
  */
-void Chat::broadcasterMain(net::Listener *listener) {
-    util::Thread::setName("Chat Broadcaster");
-
+void Chat::broadcastPending(net::Listener *listener) {
     BroadcastItem item;
 
-    // try to receive work updates
-    while(broadcastRun) {
-        broadcastQueue.wait_dequeue(item);
-
+    while(broadcastQueue.try_dequeue(item)) {
         std::visit([&](auto&& arg) {
             using T = std::decay_t<decltype(arg)>;
             // send messages to all clients
@@ -123,8 +105,6 @@ void Chat::broadcasterMain(net::Listener *listener) {
             else {}
         }, item);
     }
-
-    // clean up
 }
 
 /**
@@ -137,12 +117,11 @@ void Chat::broadcastMessage(net::Listener *listener, const Message &_msg) {
     msg.sender = _msg.from;
     msg.message = _msg.content;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(msg);
 
-    const auto str = oStream.str();
-    broadcast(listener, str, kChatMessage);
+    broadcast(listener, *packet, kChatMessage);
 }
 
 /**
@@ -154,12 +133,11 @@ void Chat::broadcastPlayerJoined(net::Listener *listener, const PlayerJoined &_m
     joined.playerId = _msg.id;
     joined.displayName = _msg.name;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(joined);
 
-    const auto str = oStream.str();
-    broadcast(listener, str, kChatPlayerJoined);
+    broadcast(listener, *packet, kChatPlayerJoined);
 }
 
 /**
@@ -170,23 +148,27 @@ void Chat::broadcastPlayerLeft(net::Listener *listener, const PlayerLeft &_msg)
     ChatPlayerJoined left;
     left.playerId = _msg.id;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(left);
 
-    const auto str = oStream.str();
-    broadcast(listener, str, kChatPlayerLeft);
+    broadcast(listener, *packet, kChatPlayerLeft);
 }
 
 /**
- * Broadcasts a message to all clients.
+ * Broadcasts a message to all clients. The message is serialized once into a packet buffer, whose
+ * payload is then copied for each client.
  */
-void Chat::broadcast(net::Listener *listener, const std::string &str, const uint8_t type) {
-    listener->forEach([&, type, str](auto &client) {
+void Chat::broadcast(net::Listener *listener, const std::vector<std::byte> &packet,
+        const uint8_t type) {
+    const auto payload = packet.data() + sizeof(PacketHeader);
+    const auto payloadLen = packet.size() - sizeof(PacketHeader);
+
+    listener->forEach([&, type](auto &client) {
         // ignore unauthenticated clients
         auto clientId = client->getClientId();
         if(!clientId) return;
 
-        client->writePacket(kEndpointChat, type, str);
+        client->writePacket(kEndpointChat, type, payload, payloadLen);
     });
 }
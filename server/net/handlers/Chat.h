@@ -3,15 +3,15 @@
 
 #include "net/PacketHandler.h"
 
-#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <string>
 #include <variant>
+#include <vector>
 
 #include <uuid.h>
 
-#include <blockingconcurrentqueue.h>
+#include <concurrentqueue.h>
 #include <cereal/access.hpp>
 
 namespace net {
@@ -20,8 +20,9 @@ class Listener;
 
 namespace net::handler {
 /**
- * Receives chat messages from clients, and with a static worker thread, reflect them back to all
- * other connected clients, as well as notify clients when they are joining/leaving the server.
+ * Receives chat messages from clients, and during the broadcast phase of each server tick,
+ * reflects them back to all other connected clients, as well as notifies clients when they are
+ * joining/leaving the server.
  */
 class Chat: public PacketHandler {
     public:
@@ -63,24 +64,22 @@ class Chat: public PacketHandler {
             broadcastQueue.enqueue(PlayerLeft(id));
         }
 
-        static void startBroadcaster(net::Listener *);
-        static void stopBroadcaster();
+        static void registerTickTasks(net::Listener *);
 
     private:
-        static void broadcasterMain(net::Listener *);
+        static void broadcastPending(net::Listener *);
         static void broadcastMessage(net::Listener *, const Message &);
         static void broadcastPlayerJoined(net::Listener *, const PlayerJoined &);
         static void broadcastPlayerLeft(net::Listener *, const PlayerLeft &);
 
-        static void broadcast(net::Listener *, const std::string &, const uint8_t);
+        static void broadcast(net::Listener *, const std::vector<std::byte> &, const uint8_t);
 
     private:
         void playerMessage(const PacketHeader &, const void *, const size_t);
 
     private:
-        static std::unique_ptr<std::thread> broadcastThread;
-        static std::atomic_bool broadcastRun;
-        static moodycamel::BlockingConcurrentQueue<BroadcastItem> broadcastQueue;
+        /// messages waiting to be broadcast by the next tick
+        static moodycamel::ConcurrentQueue<BroadcastItem> broadcastQueue;
 };
 }
 
@@ -8,19 +8,21 @@
 #include <world/chunk/Chunk.h>
 #include <world/chunk/ChunkSlice.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPChunk.h>
 #include <util/LZ4.h>
 #include <util/ThreadPool.h>
 
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <Logging.h>
 
-#include <cereal/archives/portable_binary.hpp>
-
+#include <bitset>
 #include <cstdint>
 #include <cstring>
-#include <sstream>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 
 // uncomment to enable logging of the received and sent packets
 // #define LOG_PACKETS
@@ -30,15 +32,19 @@
 using namespace net::handler;
 using namespace net::message;
 
-std::mutex ChunkLoader::cacheLock;
-std::unordered_map<glm::ivec2, std::weak_ptr<world::Chunk>> ChunkLoader::cache;
-
 /**
  * Waits for all pending completions.
+ *
+ * The map is moved out first, since the tickets remove themselves from it when they finish.
  */
 ChunkLoader::~ChunkLoader() {
-    std::lock_guard<std::mutex> lg(this->completionsLock);
-    for(auto &[pos, future] : this->completions) {
+    std::unordered_map<uint64_t, std::future<void>> completions;
+    {
+        std::lock_guard<std::mutex> lg(this->completionsLock);
+        completions = std::move(this->completions);
+    }
+
+    for(auto &[ticket, future] : completions) {
         future.get();
     }
 }
@@ -71,6 +77,9 @@ void ChunkLoader::handlePacket(const PacketHeader &header, const void *payload,
         case kChunkGet:
             this->handleGet(header, payload, payloadLen);
             break;
+        case kChunkCancel:
+            this->handleCancel(header, payload, payloadLen);
+            break;
 
         default:
             throw std::runtime_error(f("Invalid chunk packet type: ${:02x}", header.type));
@@ -80,95 +89,201 @@ void ChunkLoader::handlePacket(const PacketHeader &header, const void *payload,
 /**
  * Handles request for getting a chunk.
  *
- * We'll first check to see whether the chunk is cached.
+ * The request is queued by priority, and a ticket added to the serializer pool. If we're already
+ * working on the chunk, its priority is updated instead, as long as we haven't started sending it.
  */
 void ChunkLoader::handleGet(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     auto world = this->client->getWorld();
     auto pool = this->client->getListener()->getSerializerPool();
 
     // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     ChunkGet request;
     iArc(request);
 
+    const auto priority = request.getPriority();
+
+    if(request.distance > this->viewRadius) {
+        this->viewRadius = request.distance;
+    }
+
 #ifdef LOG_PACKETS
-    Logging::trace("Request chunk: {}", request.chunkPos);
+    Logging::trace("Request chunk: {} (priority {})", request.chunkPos, priority);
 #endif
 
-    // ignore if duplicate request
+    // reprioritize if duplicate request
     {
         std::lock_guard<std::mutex> lg(this->dupesLock);
         if(this->dupes.contains(request.chunkPos)) {
-            Logging::warn("Client {} sent duplicate chunk request for {}!",
-                    this->client->getClientAddr(), request.chunkPos);
+            std::lock_guard<std::mutex> lg2(this->inFlightLock);
+
+            // still waiting for a serializer thread?
+            if(this->pending.update(request.chunkPos, priority)) return;
+
+            // is the world source still loading it?
+            if(this->loading.contains(request.chunkPos)) {
+                world->reprioritizeRequest(this->loading[request.chunkPos], priority);
+            }
+
             return;
         }
 
+        // priority updates for chunks we've already sent are dropped
+        if(request.priorityUpdate) return;
+
         this->dupes.insert(request.chunkPos);
+        this->pending.push(request.chunkPos, priority, request);
     }
 
-    // check cache for the chunk
-    std::shared_ptr<world::Chunk> chunk = nullptr;
+    /*
+     * Queue a ticket to process it. The lock is held until the ticket's future is stored, so the
+     * ticket can't try to remove it before then.
+     */
+    std::lock_guard<std::mutex> lg(this->completionsLock);
+    const auto ticket = this->nextTicket++;
+
+    auto fut = pool->queueWorkItem([&, ticket] {
+        this->runNextRequest();
+
+        std::lock_guard<std::mutex> lg(this->completionsLock);
+        this->completions.erase(ticket);
+    });
+
+    this->completions[ticket] = std::move(fut);
+}
+
+/**
+ * Handles a request to cancel a chunk request.
+ *
+ * If the request is still queued, it's removed and we acknowledge the cancellation right away. If
+ * the world source is loading the chunk, we try to cancel that, and the serializer thread that is
+ * waiting on it sends the acknowledgement. Chunks we've started sending can't be cancelled.
+ */
+void ChunkLoader::handleCancel(const PacketHeader &header, const void *payload, const size_t payloadLen) {
+    // deserialize the request
+    io::SpanInputArchive iArc(payload, payloadLen);
+
+    ChunkCancel request;
+    iArc(request);
+
+#ifdef LOG_PACKETS
+    Logging::trace("Cancel chunk: {}", request.chunkPos);
+#endif
+
+    /*
+     * Serializer threads take requests out of the queue and mark them as loading with the
+     * in-flight lock held, so the request is always in one of the two places as far as we can see.
+     */
+    bool wasQueued;
 
     {
-        std::lock_guard<std::mutex> lg(cacheLock);
-        if(cache.contains(request.chunkPos)) {
-            chunk = cache[request.chunkPos].lock();
+        std::lock_guard<std::mutex> lg(this->inFlightLock);
 
-            // remove ptr from cache if the chunk has been deallocated
-            if(!chunk) {
-                cache.erase(request.chunkPos);
-            }
+        // still queued?
+        wasQueued = this->pending.remove(request.chunkPos).has_value();
+
+        // being loaded by the world source?
+        if(!wasQueued && this->loading.contains(request.chunkPos)) {
+            this->client->getWorld()->cancelRequest(this->loading[request.chunkPos]);
+            this->cancelled.insert(request.chunkPos);
         }
     }
 
-    // we've found the chunk in cache; send the slices in the background
-    if(chunk) {
-        auto fut = pool->queueWorkItem([&, chunk] {
-            if(!this->client->isConnected()) return;
-            this->sendSlices(chunk);
-        });
+    if(wasQueued) {
+        this->sendCancelled(request.chunkPos);
+    }
+}
 
-        std::lock_guard<std::mutex> lg(this->completionsLock);
-        this->completions[chunk->worldPos] = std::move(fut);
+/**
+ * Serializer pool ticket: processes the highest priority request that's waiting.
+ *
+ * The chunk is requested from the world source at the request's priority; it takes care of
+ * keeping chunks in memory. The request may also contain the versions of the client's cached
+ * copy of the chunk, in which case we only send what changed since.
+ */
+void ChunkLoader::runNextRequest() {
+    if(!this->client->isConnected()) return;
+
+    /*
+     * Get the request, and the chunk from the world source; it's returned right away if it's in
+     * memory. Both happen with the in-flight lock held, so cancellations can't miss the request
+     * while it's in between the queue and the loading map.
+     */
+    std::shared_ptr<world::Chunk> chunk = nullptr;
+    std::future<std::shared_ptr<world::Chunk>> future;
+    std::optional<std::pair<glm::ivec2, ChunkGet>> next;
+
+    {
+        std::lock_guard<std::mutex> lg(this->inFlightLock);
+
+        // if there's no request, the one this ticket was queued for was cancelled
+        next = this->pending.try_pop();
+        if(!next) return;
+
+        const auto &[pos, request] = *next;
+
+        world::WorldSource::RequestId id;
+        future = this->client->getWorld()->getChunk(pos.x, pos.y, request.getPriority(), id);
+        this->loading[pos] = id;
     }
-    // otherwise, read it from the world source
-    else {
-        auto pos = request.chunkPos;
 
-        auto fut = pool->queueWorkItem([&, pos, world] {
-            // bail if client is disconnected
-            if(!this->client->isConnected()) return;
+    const auto &[pos, request] = *next;
 
-            // get chunk and store in cache
-            auto future = world->getChunk(pos.x, pos.y);
-            auto chunk = future.get();
+    try {
+        chunk = future.get();
+    } catch(const std::future_error &) {
+        // the world source request was cancelled
+    }
 
 #ifdef LOG_LOAD
-            Logging::trace("Loaded chunk: {}", (void *) chunk.get());
+    Logging::trace("Loaded chunk: {}", (void *) chunk.get());
 #endif
 
-            {
-                std::lock_guard<std::mutex> lg(cacheLock);
-                cache[pos] = chunk;
-            }
+    // past this point, the request can no longer be cancelled
+    bool wasCancelled;
+    {
+        std::lock_guard<std::mutex> lg(this->inFlightLock);
+        this->loading.erase(pos);
+        wasCancelled = this->cancelled.erase(pos) || !chunk;
+    }
 
-            // then process as normal
-            if(!this->client->isConnected()) return;
-            this->sendSlices(chunk);
-        });
+    if(!this->client->isConnected()) return;
 
-        std::lock_guard<std::mutex> lg(this->completionsLock);
-        this->completions[pos] = std::move(fut);
+    if(wasCancelled) {
+        this->sendCancelled(pos);
+    } else {
+        this->sendSlices(chunk, request);
     }
 }
 
 /**
- * Worker callback invoked to send data slices for a particular chunk.
+ * Acknowledges the cancellation of a chunk request, by sending a completion with the cancelled
+ * flag set.
+ */
+void ChunkLoader::sendCancelled(const glm::ivec2 &pos) {
+    ChunkCompletion comp;
+    comp.chunkPos = pos;
+    comp.numSlices = 0;
+    comp.cancelled = true;
+
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
+
+    oArc(comp);
+
+    this->client->writePacket(kEndpointChunk, kChunkCompletion, std::move(packet));
+
+    // remove from the pending queue
+    std::lock_guard<std::mutex> lg(this->dupesLock);
+    this->dupes.erase(pos);
+}
+
+/**
+ * Worker callback invoked to send data slices for a particular chunk. Slices that the client
+ * already has cached at their current version are skipped.
  */
-void ChunkLoader::sendSlices(const std::shared_ptr<world::Chunk> &chunk) {
+void ChunkLoader::sendSlices(const std::shared_ptr<world::Chunk> &chunk, const ChunkGet &request) {
     if(!this->client || !this->client->getListener() || 
             !this->client->getListener()->getSerializerPool()) {
         return;
@@ -179,6 +294,28 @@ void ChunkLoader::sendSlices(const std::shared_ptr<world::Chunk> &chunk) {
 
     size_t numSlices = 0;
 
+    // snapshot versions before reading any slice data, so we never label newer data as older
+    const auto versions = chunk->getSliceVersions();
+
+    // figure out which slices the client does not have the current version of
+    std::bitset<world::Chunk::kMaxY> stale;
+    stale.set();
+
+    if(request.cachedVersion) {
+        if(*request.cachedVersion == chunk->getVersion()) {
+            stale.reset();
+        } else {
+            for(size_t y = 0; y < world::Chunk::kMaxY; y++) {
+                auto cached = world::Chunk::kVersionGenerated;
+                if(request.cachedSliceVersions.contains(y)) {
+                    cached = request.cachedSliceVersions.at(y);
+                }
+
+                stale[y] = (cached != versions[y]);
+            }
+        }
+    }
+
     // build the ID maps
     uint16_t nextType = 1;
     Maps maps;
@@ -210,14 +347,16 @@ void ChunkLoader::sendSlices(const std::shared_ptr<world::Chunk> &chunk) {
         maps.rowToGrid.push_back(temp);
     }
 
-    // process each slice with data
+    // process each slice with data the client doesn't have yet
     for(size_t y = 0; y < world::Chunk::kMaxY; y++) {
         auto slice = chunk->slices[y];
-        if(!slice) continue;
+        if(!slice || !stale[y]) continue;
 
-        sendSliceFutures.emplace_back(pool->queueWorkItem([&, maps, y, chunk, slice] {
+        const auto version = versions[y];
+
+        sendSliceFutures.emplace_back(pool->queueWorkItem([&, maps, y, chunk, slice, version] {
             if(!this->client->isConnected()) return;
-            this->sendSlice(chunk, maps, slice, y);
+            this->sendSlice(chunk, maps, slice, y, version);
         }));
 
         numSlices++;
@@ -230,17 +369,14 @@ void ChunkLoader::sendSlices(const std::shared_ptr<world::Chunk> &chunk) {
 
     // send the chunk completion message
     if(!this->client || !this->client->isConnected()) return;
-    this->sendCompletion(chunk, numSlices);
-
-    // remove future
-    std::lock_guard<std::mutex> lg(this->completionsLock);
-    this->completions.erase(chunk->worldPos);
+    const bool unchanged = request.cachedVersion && stale.none();
+    this->sendCompletion(chunk, numSlices, unchanged, versions);
 }
 
 /**
  * Serializes all blocks in the given slice and sends it to the client.
  */
-void ChunkLoader::sendSlice(const std::shared_ptr<world::Chunk> &chunk, const Maps &maps, const world::ChunkSlice *slice, const size_t y) {
+void ChunkLoader::sendSlice(const std::shared_ptr<world::Chunk> &chunk, const Maps &maps, const world::ChunkSlice *slice, const size_t y, const uint64_t version) {
     // set up the output bufer and map
     std::vector<uint16_t> outBuf;
     outBuf.resize(256 * 256, 0);
@@ -282,42 +418,51 @@ void ChunkLoader::sendSlice(const std::shared_ptr<world::Chunk> &chunk, const Ma
     ChunkSliceData out;
     out.chunkPos = chunk->worldPos;
     out.y = y;
+    out.version = version;
     out.typeMap = maps.gridUuidMap;
 
     out.data.resize(compressed.size());
     memcpy(out.data.data(), compressed.data(), compressed.size());
 
     // serialize and send it
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(out);
 
-    this->client->writePacket(kEndpointChunk, kChunkSliceData, oStream.str());
+    this->client->writePacket(kEndpointChunk, kChunkSliceData, std::move(packet));
 }
 
 
 
 /**
- * After all slices have been sent, submit a completion message.
+ * After all slices have been sent, submit a completion message. It carries the versions of all
+ * slices, so the client can update its cached copy.
  */
-void ChunkLoader::sendCompletion(const std::shared_ptr<world::Chunk> &chunk, const size_t numSlices) {
+void ChunkLoader::sendCompletion(const std::shared_ptr<world::Chunk> &chunk, const size_t numSlices,
+        const bool unchanged, const std::array<uint64_t, 256> &versions) {
     // build the message
     ChunkCompletion comp;
     comp.numSlices = numSlices;
+    comp.unchanged = unchanged;
     comp.meta = chunk->meta;
     comp.chunkPos = chunk->worldPos;
 
+    for(size_t y = 0; y < versions.size(); y++) {
+        if(versions[y] == world::Chunk::kVersionGenerated) continue;
+        comp.sliceVersions[y] = versions[y];
+    }
+
     // send it
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(comp);
 
 #if LOG_PACKETS
     Logging::trace("Sent completion for {}: {} slices", chunk->worldPos, numSlices);
 #endif
-    this->client->writePacket(kEndpointChunk, kChunkCompletion, oStream.str());
+    this->client->writePacket(kEndpointChunk, kChunkCompletion, std::move(packet));
 
     // register for chunk change notifications (via block change request handler)
     this->client->addChunkObserver(chunk);
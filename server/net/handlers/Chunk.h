@@ -3,10 +3,15 @@
 
 #include "net/PacketHandler.h"
 
+#include <net/EPChunk.h>
+#include <util/PriorityQueue.h>
+
 #include <uuid.h>
 #include <glm/vec2.hpp>
 #include <glm/gtx/hash.hpp>
 
+#include <array>
+#include <atomic>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -27,6 +32,10 @@ struct ChunkSlice;
 namespace net::handler {
 /**
  * Handles sending chunks as a whole
+ *
+ * Requests are queued by priority; each one adds a ticket to the serializer pool, which services
+ * whichever of our requests has the highest priority once it gets to run. A request can be
+ * cancelled until we start sending its slices.
  */
 class ChunkLoader: public PacketHandler {
     public:
@@ -37,6 +46,11 @@ class ChunkLoader: public PacketHandler {
         void handlePacket(const PacketHeader &header, const void *payload,
                 const size_t payloadLen) override;
 
+        /// largest distance (in chunks) from the player at which the client has requested chunks
+        const uint16_t getViewRadius() const {
+            return this->viewRadius;
+        }
+
     private:
         struct Maps {
             /**
@@ -54,24 +68,38 @@ class ChunkLoader: public PacketHandler {
 
     private:
         void handleGet(const PacketHeader &, const void *, const size_t);
-        void sendSlices(const std::shared_ptr<world::Chunk> &);
-        void sendSlice(const std::shared_ptr<world::Chunk> &, const Maps &, const world::ChunkSlice *, const size_t);
-        void sendCompletion(const std::shared_ptr<world::Chunk> &, const size_t);
+        void handleCancel(const PacketHeader &, const void *, const size_t);
 
-    private:
-        /// lock protecting chunk cache
-        static std::mutex cacheLock;
-        /// cache map
-        static std::unordered_map<glm::ivec2, std::weak_ptr<world::Chunk>> cache;
+        void runNextRequest();
+        void sendCancelled(const glm::ivec2 &);
+        void sendSlices(const std::shared_ptr<world::Chunk> &, const message::ChunkGet &);
+        void sendSlice(const std::shared_ptr<world::Chunk> &, const Maps &, const world::ChunkSlice *, const size_t, const uint64_t);
+        void sendCompletion(const std::shared_ptr<world::Chunk> &, const size_t, const bool, const std::array<uint64_t, 256> &);
 
+    private:
         /// lock protecting duplicates set
         std::mutex dupesLock;
         /// set containing chunk positions we're currently working on
         std::unordered_set<glm::ivec2> dupes;
 
+        /// largest request distance seen so far; approximates the client's view distance
+        std::atomic_uint16_t viewRadius = 0;
+
+        /// requests waiting for a serializer thread, by priority
+        util::PriorityQueue<glm::ivec2, message::ChunkGet> pending;
+
+        /// lock protecting the loading and cancelled maps
+        std::mutex inFlightLock;
+        /// chunks being loaded by the world source, and their world source request ids
+        std::unordered_map<glm::ivec2, uint64_t> loading;
+        /// chunks that were cancelled while the world source was loading them
+        std::unordered_set<glm::ivec2> cancelled;
+
         std::mutex completionsLock;
-        /// mapping of chunk pos -> completion future
-        std::unordered_map<glm::ivec2, std::future<void>> completions;
+        /// mapping of serializer pool ticket -> completion future
+        std::unordered_map<uint64_t, std::future<void>> completions;
+        /// id of the next serializer pool ticket
+        std::atomic_uint64_t nextTicket = 1;
 };
 }
 
@@ -3,14 +3,13 @@
 
 #include <world/WorldSource.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPPlayerInfo.h>
 
 #include <io/Format.h>
-
-#include <cereal/archives/portable_binary.hpp>
+#include <io/SpanArchive.h>
 
 #include <cstring>
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -65,8 +64,7 @@ void PlayerInfo::handleGet(const PacketHeader &hdr, const void *payload, const s
     auto playerId = *this->client->getClientId();
 
     // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     PlayerInfoGet request;
     iArc(request);
@@ -90,12 +88,12 @@ void PlayerInfo::handleGet(const PacketHeader &hdr, const void *payload, const s
     }
 
     // send it
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(reply);
 
-    this->client->writePacket(kEndpointPlayerInfo, kPlayerInfoGetResponse, oStream.str(), hdr.tag);
+    this->client->writePacket(kEndpointPlayerInfo, kPlayerInfoGetResponse, std::move(packet), hdr.tag);
 }
 
 
@@ -108,8 +106,7 @@ void PlayerInfo::handleSet(const PacketHeader &hdr, const void *payload, const s
     auto playerId = *this->client->getClientId();
 
     // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     PlayerInfoSet request;
     iArc(request);
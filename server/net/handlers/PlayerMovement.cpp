@@ -1,18 +1,19 @@
 #include "PlayerMovement.h"
 #include "net/Listener.h"
 #include "net/ListenerClient.h"
+#include "net/InterestGrid.h"
+#include "net/TickScheduler.h"
 
 #include <world/WorldSource.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPPlayerMovement.h>
 #include <io/ConfigManager.h>
 
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <Logging.h>
 
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -21,23 +22,37 @@ using namespace net::message;
 const std::string PlayerMovement::kPositionInfoKey = "server.player.position";
 
 /**
- * Register the broadcast timer.
+ * Assigns the player index.
  */
 PlayerMovement::PlayerMovement(ListenerClient *_client) : PacketHandler(_client) {
-    const auto updateFreq = io::ConfigManager::getUnsigned("proto.positionBroadcastInterval", 74);
-    const auto interval = std::chrono::milliseconds(updateFreq);
+    this->playerIndex = this->client->getListener()->allocPlayerIndex();
 
-    this->broadcastTimerId = this->client->getListener()->addRepeatingTimer(interval, [&]() {
-        this->broadcastPosition();
-    });
+    this->fullRateRadius = io::ConfigManager::getUnsigned("proto.positionFullRateRadius", 1);
 }
 
-
 /**
- * Removes the registered broadcast timer.
+ * Releases the player index, so it can be reused by another player.
  */
 PlayerMovement::~PlayerMovement() {
-    this->client->getListener()->removeTimer(this->broadcastTimerId);
+    this->client->getListener()->releasePlayerIndex(this->playerIndex);
+}
+
+/**
+ * Registers the per-client tick task that sends out position broadcasts. By default, they go out
+ * every tick; the interval should be a multiple of the tick interval, since it's rounded up to
+ * whole ticks.
+ */
+void PlayerMovement::registerTickTasks(net::Listener *listener) {
+    const auto updateFreq = io::ConfigManager::getUnsigned("proto.positionBroadcastInterval", 50);
+    const auto interval = std::chrono::milliseconds(updateFreq);
+
+    listener->getTickScheduler()->addClientTask(TickPhase::Broadcast, interval,
+            [](ListenerClient *client) {
+        auto movement = client->getMovement();
+        if(movement) {
+            movement->broadcastPosition();
+        }
+    });
 }
 
 /**
@@ -81,28 +96,67 @@ void PlayerMovement::handlePacket(const PacketHeader &header, const void *payloa
 void PlayerMovement::clientPosChanged(const PacketHeader &, const void *payload,
         const size_t payloadLen) {
     // deserialize the message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     PlayerPositionChanged request;
     iArc(request);
 
-    // discard if this packet is too old
-    if(request.epoch < this->lastEpoch && (this->lastEpoch - request.epoch) < kEpochDiff) {
-        Logging::debug("Discarding player position update from {} (epoch ${:x}, last ${:x})",
-                this->client->getClientId(), request.epoch, this->lastEpoch);
-        return;
+    // apply the delta to get the new state
+    const auto now = std::chrono::steady_clock::now();
+    glm::vec3 pos;
+    {
+        std::lock_guard<std::mutex> lg(this->stateLock);
+
+        if(!this->state && !request.movement.isKeyframe()) {
+            throw std::runtime_error("Received movement delta without keyframe");
+        }
+
+        const bool hadState = this->state.has_value();
+        this->state = request.movement.apply(this->state.value_or(MovementState()));
+        pos = this->state->getPosition();
+
+        // update the velocity estimate; after a pause, start over from the new sample
+        const auto dt = std::chrono::duration<float>(now - this->lastMoveTime).count();
+        if(hadState && dt > 0) {
+            const auto sample = (pos - this->position) / dt;
+
+            if(now - this->lastMoveTime > kVelocityTimeout) {
+                this->velocity = sample;
+            } else {
+                this->velocity += (sample - this->velocity) * kVelocitySmoothing;
+            }
+        }
+        this->lastMoveTime = now;
+
+        this->position = pos;
+        this->angles = this->state->getAngles();
+        this->dirty = true;
     }
 
-    this->lastEpoch = request.epoch;
+    this->client->getListener()->getInterestGrid()->updatePosition(this->client, pos);
+}
+
 
-    // store position
-    this->position = request.position;
-    this->angles = request.angles;
-    this->dirty = true;
 
-    // set broadcast flag
-    this->needsBroadcast = true;
+/**
+ * Gets the player's current position and estimated velocity. The velocity is zero if the player
+ * hasn't moved in a while.
+ *
+ * @return Whether the player's position is known
+ */
+bool PlayerMovement::getMotion(glm::vec3 &outPosition, glm::vec3 &outVelocity) {
+    std::lock_guard<std::mutex> lg(this->stateLock);
+    if(!this->state) return false;
+
+    outPosition = this->position;
+
+    if(std::chrono::steady_clock::now() - this->lastMoveTime > kVelocityTimeout) {
+        outVelocity = glm::vec3(0);
+    } else {
+        outVelocity = this->velocity;
+    }
+
+    return true;
 }
 
 
@@ -116,17 +170,20 @@ void PlayerMovement::savePosition() {
 
     // build the info struct
     SavePos p;
-    p.position = this->position;
-    p.angles = this->angles;
+    {
+        std::lock_guard<std::mutex> lg(this->stateLock);
+        p.position = this->position;
+        p.angles = this->angles;
+    }
 
     // serialize and write out
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    std::vector<std::byte> data;
+    io::BufferOutputArchive oArc(data);
 
     oArc(p);
 
-    const auto &str = oStream.str();
-    std::vector<char> bytes(str.begin(), str.end());
+    const auto dataPtr = reinterpret_cast<const char *>(data.data());
+    std::vector<char> bytes(dataPtr, dataPtr + data.size());
 
     auto fut = world->setPlayerInfo(id, kPositionInfoKey, bytes);
     fut.get();
@@ -154,61 +211,102 @@ void PlayerMovement::authStateChanged() {
     }
 
     // deserialize
-    std::stringstream stream(std::string(value.begin(), value.end()));
-    cereal::PortableBinaryInputArchive arc(stream);
+    io::SpanInputArchive arc(value.data(), value.size());
 
     SavePos data;
     arc(data);
 
-    this->position = data.position;
-    this->angles = data.angles;
+    {
+        std::lock_guard<std::mutex> lg(this->stateLock);
+        this->position = data.position;
+        this->angles = data.angles;
+        this->state = MovementState::quantize(data.position, data.angles);
+    }
+
+    this->client->getListener()->getInterestGrid()->updatePosition(this->client, this->position);
 
     // send message to client
     PlayerPositionInitial initial;
     initial.position = data.position;
     initial.angles = data.angles;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(initial);
 
-    this->client->writePacket(kEndpointPlayerMovement, kPlayerPositionInitial, oStream.str());
+    this->client->writePacket(kEndpointPlayerMovement, kPlayerPositionInitial, std::move(packet));
 }
 
 /**
- * Sends our position to all players, except ourselves.
+ * Sends the movement of all nearby players (except ourselves) to our client, in a single packet.
+ *
+ * Each player is delta encoded against the state we last sent for them; players that haven't
+ * moved since then are left out entirely. Players beyond the full rate radius are only considered
+ * every Nth tick, where N grows with distance; since the delta is against what the client last
+ * received, skipped ticks simply get folded into the next update.
+ *
+ * Players we've sent to the client before, but who have since disconnected, are forgotten, and the
+ * client is told to forget them too.
+ *
+ * This is invoked from a tick worker, and never concurrently for the same client, so the known
+ * state map needs no locking.
  */
 void PlayerMovement::broadcastPosition() {
-    if(!this->needsBroadcast) return;
-
-    // get our ID
-    const auto ourId = this->client->getClientId();
-    if(!ourId) return;
+    if(!this->client->getClientId()) return;
 
-    // build the position update message
     PlayerPositionBroadcast b;
+    const auto tick = this->broadcastTicks++;
 
-    b.position = this->position;
-    b.angles = this->angles;
-    b.playerId = *ourId;
+    auto listener = this->client->getListener();
+    for(auto it = this->known.begin(); it != this->known.end();) {
+        if(listener->isPlayerIndexInUse(it->first)) {
+            it++;
+            continue;
+        }
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
-    oArc(b);
+        b.departed.push_back(it->first);
+        it = this->known.erase(it);
+    }
 
-    const auto str = oStream.str();
+    this->client->getListener()->getInterestGrid()->forEachNearby(this->client,
+            [&](ListenerClient *other, const size_t distance) {
+        // reduce update rate for far away players
+        if(distance > this->fullRateRadius) {
+            const auto divisor = 1 + (distance - this->fullRateRadius);
+            if(tick % divisor) return;
+        }
+
+        // get the other player's state
+        auto movement = other->getMovement();
+        const auto otherId = other->getClientId();
+        if(!movement || !otherId) return;
+
+        const auto state = movement->getState();
+        if(!state) return;
+
+        // encode against what we've last sent for it
+        PlayerPositionEntry entry;
+        entry.playerIndex = movement->getPlayerIndex();
+
+        auto it = this->known.find(entry.playerIndex);
+        if(it == this->known.end() || it->second.id != *otherId) {
+            entry.playerId = *otherId;
+            entry.movement = MovementDelta::encode(std::nullopt, *state);
+        } else {
+            if(it->second.state == *state) return;
+            entry.movement = MovementDelta::encode(it->second.state, *state);
+        }
+
+        this->known[entry.playerIndex] = {*otherId, *state};
+        b.players.push_back(entry);
+    });
 
-    // iterate over all clients
-    this->client->getListener()->forEach([&, ourId, str](auto &client) {
-        // ignore unauthenticated clients, or this client
-        auto clientId = client->getClientId();
-        if(!clientId) return;
-        else if(*clientId == *ourId) return;
+    if(b.players.empty() && b.departed.empty()) return;
 
-        // send packet
-        client->writePacket(kEndpointPlayerMovement, kPlayerPositionBroadcast, str);
-    });
+    // send it
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
+    oArc(b);
 
-    // clean flags
-    this->needsBroadcast = false;
+    this->client->writePacket(kEndpointPlayerMovement, kPlayerPositionBroadcast, std::move(packet));
 }
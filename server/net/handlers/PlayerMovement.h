@@ -3,25 +3,39 @@
 
 #include "net/PacketHandler.h"
 
-#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <unordered_map>
 
 #include <glm/vec3.hpp>
+#include <uuid.h>
 #include <cereal/access.hpp>
-#include <cpptime.h>
+#include <net/EPPlayerMovement.h>
+
+namespace net {
+class Listener;
+}
 
 namespace net::handler {
 /**
  * Serves as a sort of "bent pipe" for player position updates, so they're propagated to all other
  * players. It also makes sure the player's position is saved/restored correctly.
+ *
+ * Rather than each player pushing its movement out, the broadcast phase of the server tick collects
+ * the movement of all nearby players into a single packet for every client, delta encoded against
+ * what that client was last sent.
  */
 class PlayerMovement: public PacketHandler {
     public:
         PlayerMovement(ListenerClient *_client);
         virtual ~PlayerMovement();
 
+        static void registerTickTasks(net::Listener *);
+
         bool canHandlePacket(const PacketHeader &header) override;
         void handlePacket(const PacketHeader &header, const void *payload,
                 const size_t payloadLen) override;
@@ -35,6 +49,17 @@ class PlayerMovement: public PacketHandler {
             this->savePosition();
         }
 
+        /// short identifier for this player in position broadcasts
+        const uint16_t getPlayerIndex() const {
+            return this->playerIndex;
+        }
+        /// gets the most recent quantized movement state, if we've got one
+        std::optional<net::message::MovementState> getState() {
+            std::lock_guard<std::mutex> lg(this->stateLock);
+            return this->state;
+        }
+        bool getMotion(glm::vec3 &outPosition, glm::vec3 &outVelocity);
+
     private:
         void clientPosChanged(const PacketHeader &, const void *, const size_t);
 
@@ -44,6 +69,10 @@ class PlayerMovement: public PacketHandler {
     private:
         /// name of the player position saved in the world file
         static const std::string kPositionInfoKey;
+        /// weight of each new movement sample in the smoothed velocity
+        constexpr static const float kVelocitySmoothing = .5;
+        /// if no movement is received for this long, the player is considered stationary
+        constexpr static const std::chrono::milliseconds kVelocityTimeout = std::chrono::milliseconds(750);
 
         /// world position, saved
         struct SavePos {
@@ -58,22 +87,39 @@ class PlayerMovement: public PacketHandler {
         };
 
     private:
-        /// max allowable difference between epochs and still consider the value valid
-        static constexpr const uint32_t kEpochDiff = 10;
-        /// epoch value of the most recently received player position update
-        uint32_t lastEpoch = 0;
+        /// last state sent to our client for another player
+        struct KnownPlayer {
+            /// ID of the player; used to detect player indices being reused
+            uuids::uuid id;
+            /// most recently sent state
+            net::message::MovementState state;
+        };
+
+    private:
+        /// our player index, as assigned by the listener
+        uint16_t playerIndex = 0;
 
+        /// protects the position state below; it's read from other clients' broadcasts
+        std::mutex stateLock;
         /// current player position and view angles
         glm::vec3 position, angles;
+        /// most recent quantized state as received from the client
+        std::optional<net::message::MovementState> state;
+        /// smoothed velocity, in blocks per second
+        glm::vec3 velocity = glm::vec3(0);
+        /// when the most recent movement was received
+        std::chrono::steady_clock::time_point lastMoveTime;
         /// whether the position/angles have changed and need to be saved
         bool dirty = false;
         /// whether the initial position has been loaded
         bool loadedInitialPos = false;
 
-        /// when set, we need to broadcast data to clientes
-        std::atomic_bool needsBroadcast = false;
-        /// broadcasting thymer
-        CppTime::timer_id broadcastTimerId;
+        /// state of other players as last sent to our client, keyed by player index
+        std::unordered_map<uint16_t, KnownPlayer> known;
+        /// number of broadcasts made; used to reduce the rate for far away players
+        size_t broadcastTicks = 0;
+        /// players within this many chunks get every update; beyond it, the rate falls off
+        size_t fullRateRadius = 1;
 };
 }
 
@@ -1,20 +1,20 @@
 #include "Time.h"
 #include "net/ListenerClient.h"
 #include "net/Listener.h"
+#include "net/TickScheduler.h"
 
 #include "world/time/Clock.h"
 
 #include <world/WorldSource.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPTime.h>
 #include <io/ConfigManager.h>
 
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <Logging.h>
 
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -23,12 +23,9 @@ using namespace net::message;
 /// number of instances of the time handler we've got
 std::atomic_uint Time::numConnectedClients = 0;
 
-/// this timer is used for both advancing the time step, but also for updating clients
-CppTime::Timer Time::timer;
-
 /**
- * Sets up a new time handler. This also increments the connected client count and starts the
- * thymer.
+ * Sets up a new time handler. This also increments the connected client count and resumes the
+ * clock.
  */
 Time::Time(ListenerClient *_client) : PacketHandler(_client) {
     // start time updates if needed
@@ -36,14 +33,6 @@ Time::Time(ListenerClient *_client) : PacketHandler(_client) {
         auto clock = this->client->getListener()->getClock();
         clock->resume();
     }
-
-    // install the client update timer
-    const auto updateFreq = io::ConfigManager::getUnsigned("proto.timeUpdateInterval", 10);
-    const auto interval = std::chrono::seconds(updateFreq);
-
-    this->updateTimer = timer.add(interval, [&](auto) {
-        this->sendTime();
-    }, interval);
 }
 
 /**
@@ -56,9 +45,22 @@ Time::~Time() {
         auto clock = this->client->getListener()->getClock();
         clock->stop();
     }
+}
+
+/**
+ * Registers the per-client tick task that periodically sends each client the current time.
+ */
+void Time::registerTickTasks(net::Listener *listener) {
+    const auto updateFreq = io::ConfigManager::getUnsigned("proto.timeUpdateInterval", 10);
+    const auto interval = std::chrono::seconds(updateFreq);
 
-    // remove client update timer
-    timer.remove(this->updateTimer);
+    listener->getTickScheduler()->addClientTask(TickPhase::Broadcast, interval,
+            [](ListenerClient *client) {
+        auto time = client->getTimeHandler();
+        if(time) {
+            time->sendTime();
+        }
+    });
 }
 
 /**
@@ -104,12 +106,12 @@ void Time::authStateChanged() {
     init.currentTime = this->client->getListener()->getClock()->getTime();
 
     // serialize and send
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(init);
 
-    this->client->writePacket(kEndpointTime, kTimeInitialState, oStream.str());
+    this->client->writePacket(kEndpointTime, kTimeInitialState, std::move(packet));
 }
 
 /**
@@ -120,11 +122,11 @@ void Time::sendTime() {
     update.currentTime = this->client->getListener()->getClock()->getTime();
 
     // serialize and send
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(update);
 
-    this->client->writePacket(kEndpointTime, kTimeUpdate, oStream.str());
+    this->client->writePacket(kEndpointTime, kTimeUpdate, std::move(packet));
 }
 
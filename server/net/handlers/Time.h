@@ -4,13 +4,14 @@
 #include "net/PacketHandler.h"
 
 #include <atomic>
-#include <condition_variable>
-#include <mutex>
 #include <string>
 
-#include <cpptime.h>
 #include <cereal/access.hpp>
 
+namespace net {
+class Listener;
+}
+
 namespace net::handler {
 /**
  * Updates clients as to what tf the time is
@@ -28,14 +29,11 @@ class Time: public PacketHandler {
 
         void sendTime();
 
+        static void registerTickTasks(net::Listener *);
+
     private:
-        /// thymer for all clients
-        static CppTime::Timer timer;
         /// number of connected clients; if none are connected, time doesn't advance
         static std::atomic_uint numConnectedClients;
-
-        /// timer for notifying the client of the current thyme
-        CppTime::timer_id updateTimer;
 };
 }
 
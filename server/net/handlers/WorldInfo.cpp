@@ -3,14 +3,13 @@
 
 #include <world/WorldSource.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPWorldInfo.h>
 
 #include <io/Format.h>
-
-#include <cereal/archives/portable_binary.hpp>
+#include <io/SpanArchive.h>
 
 #include <cstring>
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -59,8 +58,7 @@ void WorldInfo::handlePacket(const PacketHeader &header, const void *payload,
  */
 void WorldInfo::handleGet(const PacketHeader &hdr, const void *payload, const size_t payloadLen) {
     // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     WorldInfoGet request;
     iArc(request);
@@ -95,12 +93,12 @@ void WorldInfo::sendKey(const std::string &key, const uint16_t tag) {
     }
 
     // send it
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(reply);
 
-    this->client->writePacket(kEndpointWorldInfo, kWorldInfoGetResponse, oStream.str(), tag);
+    this->client->writePacket(kEndpointWorldInfo, kWorldInfoGetResponse, std::move(packet), tag);
 }
 
 /**
@@ -0,0 +1,58 @@
+#include "ChunkVersions.h"
+
+#include <world/WorldSource.h>
+
+#include <Logging.h>
+
+#include <cereal/archives/portable_binary.hpp>
+
+#include <sstream>
+#include <vector>
+
+using namespace world;
+
+const std::string ChunkVersions::kEpochInfoKey = "server.world.versionEpoch";
+
+/**
+ * Loads the previous version epoch, and writes back the one to use for this run.
+ */
+ChunkVersions::ChunkVersions(WorldSource *_source) : source(_source) {
+    this->bumpEpoch();
+}
+
+/**
+ * Reads the last epoch out of the world info, increments it, and saves it again. The first epoch
+ * is 1, so no version handed out by us ever collides with the generated version.
+ */
+void ChunkVersions::bumpEpoch() {
+    EpochData data;
+    data.epoch = 0;
+
+    // read the previous epoch, if any
+    auto infoProm = this->source->getWorldInfo(kEpochInfoKey);
+    auto value = infoProm.get_future().get();
+
+    if(!value.empty()) {
+        std::stringstream stream(std::string(value.begin(), value.end()));
+        cereal::PortableBinaryInputArchive arc(stream);
+
+        arc(data);
+    }
+
+    data.epoch++;
+    this->epoch = data.epoch;
+
+    // write it back
+    std::stringstream oStream;
+    cereal::PortableBinaryOutputArchive oArc(oStream);
+
+    oArc(data);
+
+    const auto &str = oStream.str();
+    std::vector<char> bytes(str.begin(), str.end());
+
+    auto promise = this->source->setWorldInfo(kEpochInfoKey, bytes);
+    promise.get_future().get();
+
+    Logging::debug("Chunk version epoch: {}", this->epoch);
+}
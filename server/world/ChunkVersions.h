@@ -0,0 +1,57 @@
+#ifndef WORLD_CHUNKVERSIONS_H
+#define WORLD_CHUNKVERSIONS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include <cereal/access.hpp>
+
+namespace world {
+class WorldSource;
+
+/**
+ * Hands out content versions for chunk slices.
+ *
+ * Versions consist of an epoch in the high 32 bits, which is incremented (and persisted in the
+ * world info) every time the server starts, and a counter in the low 32 bits. This guarantees
+ * versions are never reused, even if the server went down before modified chunks were written.
+ */
+class ChunkVersions {
+    public:
+        ChunkVersions(WorldSource *source);
+
+        /// Allocates a new, never before used slice version.
+        uint64_t next() {
+            return (this->epoch << 32) | ++this->counter;
+        }
+
+    private:
+        // saved in world data containing the last used epoch
+        struct EpochData {
+            uint32_t epoch;
+
+            private:
+                friend class cereal::access;
+                template <class Archive> void serialize(Archive &ar) {
+                    ar(this->epoch);
+                }
+        };
+
+        /// world info key for the epoch
+        static const std::string kEpochInfoKey;
+
+    private:
+        void bumpEpoch();
+
+    private:
+        /// epoch for this run of the server (upper 32 bits of every version)
+        uint64_t epoch = 0;
+        /// counter for the lower 32 bits of versions
+        std::atomic_uint32_t counter = 0;
+
+        WorldSource *source = nullptr;
+};
+}
+
+#endif
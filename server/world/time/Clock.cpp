@@ -26,7 +26,7 @@ Clock::Clock(WorldSource *_source) : source(_source) {
 }
 
 /**
- * Save time out and remove timer when deleting.
+ * Save time out when deleting.
  */
 Clock::~Clock() {
     if(!this->isPaused) {
@@ -40,35 +40,36 @@ Clock::~Clock() {
  * Starts updating the clock.
  */
 void Clock::resume() {
+    std::lock_guard<std::mutex> lg(this->lock);
     XASSERT(this->isPaused, "Cannot resume an already running clock");
 
-    const auto interval = std::chrono::milliseconds(kUpdateInterval);
-
     this->isPaused = false;
     this->lastStep = std::chrono::steady_clock::now();
-    this->updateTimer = this->timer.add(interval, [&](auto) {
-        this->step();
-    }, interval);
 }
 
 /**
  * Stops the clock.
  */
 void Clock::stop() {
-    XASSERT(!this->isPaused, "Cannot stop an already stopped clock");
+    {
+        std::lock_guard<std::mutex> lg(this->lock);
+        XASSERT(!this->isPaused, "Cannot stop an already stopped clock");
 
-    this->timer.remove(this->updateTimer);
-    this->isPaused = true;
+        this->isPaused = true;
+    }
 
     this->saveTime();
 }
 
 /**
- * Updates the current time.
+ * Updates the current time; this is invoked every server tick.
  */
 void Clock::step() {
     using namespace std::chrono;
 
+    std::lock_guard<std::mutex> lg(this->lock);
+    if(this->isPaused) return;
+
     const auto now = steady_clock::now();
     const auto diffUs = duration_cast<microseconds>(now - this->lastStep);
     const auto diffSec = ((double) diffUs.count()) / 1000. / 1000.;
@@ -2,9 +2,9 @@
 #define WORLD_TIME_CLOCK_H
 
 #include <chrono>
+#include <mutex>
 #include <string>
 
-#include <cpptime.h>
 #include <cereal/access.hpp>
 
 namespace world {
@@ -12,6 +12,9 @@ class WorldSource;
 
 /**
  * Serves as the source of the current time for the world.
+ *
+ * The clock is advanced by the server tick; while paused (because no players are connected) it
+ * ignores ticks.
  */
 class Clock {
     public:
@@ -21,6 +24,8 @@ class Clock {
         void resume();
         void stop();
 
+        void step();
+
         double getTime() const {
             return this->currentTime;
         }
@@ -37,14 +42,10 @@ class Clock {
                 }
         };
 
-        /// interval at which to update time, in ms
-        constexpr static const size_t kUpdateInterval = 100;
         /// world info key for time storage
         static const std::string kTimeInfoKey;
 
     private:
-        void step();
-
         void loadTime();
         void saveTime();
 
@@ -52,9 +53,9 @@ class Clock {
         double currentTime = 0.;
         double tickStep = 0.;
 
-        CppTime::Timer timer;
+        /// protects the pause state and the time of the last step
+        std::mutex lock;
         bool isPaused = true;
-        CppTime::timer_id updateTimer;
 
         WorldSource *source = nullptr;
 
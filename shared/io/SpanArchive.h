@@ -0,0 +1,203 @@
+/**
+ * Cereal archives that read from and write to memory buffers directly, without going through a
+ * stream. They produce exactly the same format as Cereal's portable binary archives, so the two
+ * can be mixed freely on either end of a connection.
+ */
+#ifndef IO_SPANARCHIVE_H
+#define IO_SPANARCHIVE_H
+
+#include <cereal/cereal.hpp>
+#include <cereal/archives/portable_binary.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace io {
+/**
+ * Deserializes data from a region of memory. The memory must stay valid for as long as the
+ * archive is in use.
+ *
+ * Reads past the end of the region throw a `cereal::Exception`, as do container sizes that could
+ * not possibly fit in the remaining data.
+ */
+class SpanInputArchive: public cereal::InputArchive<SpanInputArchive, cereal::AllowEmptyClassElision> {
+    public:
+        /**
+         * Reads the endianness flag at the start of the data.
+         */
+        SpanInputArchive(const void *data, const size_t length) :
+            cereal::InputArchive<SpanInputArchive, cereal::AllowEmptyClassElision>(this),
+            readPtr(reinterpret_cast<const std::uint8_t *>(data)),
+            end(reinterpret_cast<const std::uint8_t *>(data) + length) {
+            std::uint8_t streamLittleEndian;
+            this->operator()(streamLittleEndian);
+
+            this->convertEndianness = cereal::portable_binary_detail::is_little_endian() ^
+                streamLittleEndian;
+        }
+
+        /// Copies out the given number of bytes, swapping each `DataSize` sized element if needed.
+        template<std::size_t DataSize>
+        void loadBinary(void * const data, const size_t size) {
+            if(size > this->remaining()) {
+                throw cereal::Exception("Failed to read " + std::to_string(size) +
+                        " bytes from span; only " + std::to_string(this->remaining()) + " left");
+            }
+
+            memcpy(data, this->readPtr, size);
+            this->readPtr += size;
+
+            if(this->convertEndianness) {
+                auto ptr = reinterpret_cast<std::uint8_t *>(data);
+                for(size_t i = 0; i < size; i += DataSize) {
+                    cereal::portable_binary_detail::swap_bytes<DataSize>(ptr + i);
+                }
+            }
+        }
+
+        /// Number of bytes that have yet to be read
+        size_t remaining() const {
+            return this->end - this->readPtr;
+        }
+
+    private:
+        /// current read position
+        const std::uint8_t *readPtr = nullptr;
+        /// end of the data
+        const std::uint8_t *end = nullptr;
+
+        /// whether data needs to be byte swapped on read
+        bool convertEndianness = false;
+};
+
+/**
+ * Serializes data by appending it to a byte vector; this lets callers reuse buffers, or reserve
+ * space at their start for a header.
+ */
+class BufferOutputArchive: public cereal::OutputArchive<BufferOutputArchive, cereal::AllowEmptyClassElision> {
+    public:
+        /**
+         * Writes the endianness flag. Data is always written little endian, which is what the
+         * portable binary archive does by default.
+         */
+        BufferOutputArchive(std::vector<std::byte> &out) :
+            cereal::OutputArchive<BufferOutputArchive, cereal::AllowEmptyClassElision>(this),
+            out(out),
+            convertEndianness(!cereal::portable_binary_detail::is_little_endian()) {
+            this->operator()(std::uint8_t(1));
+        }
+
+        /// Appends the given bytes, swapping each `DataSize` sized element if needed.
+        template<std::size_t DataSize>
+        void saveBinary(const void *data, const size_t size) {
+            const auto offset = this->out.size();
+            this->out.resize(offset + size);
+
+            auto ptr = reinterpret_cast<std::uint8_t *>(this->out.data() + offset);
+            memcpy(ptr, data, size);
+
+            if(this->convertEndianness) {
+                for(size_t i = 0; i < size; i += DataSize) {
+                    cereal::portable_binary_detail::swap_bytes<DataSize>(ptr + i);
+                }
+            }
+        }
+
+    private:
+        /// buffer to append to
+        std::vector<std::byte> &out;
+
+        /// whether data needs to be byte swapped on write
+        bool convertEndianness = false;
+};
+}
+
+namespace cereal {
+/// Saves arithmetic types
+template<class T> inline typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+CEREAL_SAVE_FUNCTION_NAME(io::BufferOutputArchive &ar, T const &t) {
+    static_assert(!std::is_floating_point<T>::value || std::numeric_limits<T>::is_iec559,
+            "Portable binary only supports IEEE 754 standardized floating point");
+    ar.template saveBinary<sizeof(T)>(std::addressof(t), sizeof(t));
+}
+/// Loads arithmetic types
+template<class T> inline typename std::enable_if<std::is_arithmetic<T>::value, void>::type
+CEREAL_LOAD_FUNCTION_NAME(io::SpanInputArchive &ar, T &t) {
+    static_assert(!std::is_floating_point<T>::value || std::numeric_limits<T>::is_iec559,
+            "Portable binary only supports IEEE 754 standardized floating point");
+    ar.template loadBinary<sizeof(T)>(std::addressof(t), sizeof(t));
+}
+
+/// Names aren't stored; only the value
+template<class Archive, class T> inline
+CEREAL_ARCHIVE_RESTRICT(io::SpanInputArchive, io::BufferOutputArchive)
+CEREAL_SERIALIZE_FUNCTION_NAME(Archive &ar, NameValuePair<T> &t) {
+    ar(t.value);
+}
+
+/// Container sizes are written as-is
+template<class T> inline void
+CEREAL_SAVE_FUNCTION_NAME(io::BufferOutputArchive &ar, SizeTag<T> const &t) {
+    ar(t.size);
+}
+/**
+ * Container sizes are read as-is, but are rejected if there are not enough bytes left to hold
+ * that many elements; this way, a corrupt size can't trigger a huge allocation.
+ */
+template<class T> inline void
+CEREAL_LOAD_FUNCTION_NAME(io::SpanInputArchive &ar, SizeTag<T> &t) {
+    ar(t.size);
+
+    if(static_cast<std::uint64_t>(t.size) > ar.remaining()) {
+        throw cereal::Exception("Container size " + std::to_string(t.size) +
+                " exceeds remaining span data (" + std::to_string(ar.remaining()) + ")");
+    }
+}
+
+/// Saves binary blobs
+template<class T> inline void
+CEREAL_SAVE_FUNCTION_NAME(io::BufferOutputArchive &ar, BinaryData<T> const &bd) {
+    using TT = typename std::remove_pointer<T>::type;
+    static_assert(!std::is_floating_point<TT>::value || std::numeric_limits<TT>::is_iec559,
+            "Portable binary only supports IEEE 754 standardized floating point");
+    ar.template saveBinary<sizeof(TT)>(bd.data, static_cast<size_t>(bd.size));
+}
+/// Loads binary blobs
+template<class T> inline void
+CEREAL_LOAD_FUNCTION_NAME(io::SpanInputArchive &ar, BinaryData<T> &bd) {
+    using TT = typename std::remove_pointer<T>::type;
+    static_assert(!std::is_floating_point<TT>::value || std::numeric_limits<TT>::is_iec559,
+            "Portable binary only supports IEEE 754 standardized floating point");
+    ar.template loadBinary<sizeof(TT)>(bd.data, static_cast<size_t>(bd.size));
+}
+
+/**
+ * Byte vectors (such as compressed chunk data) are copied in one go, rather than byte by byte as
+ * Cereal does for enum element types. This produces the same output.
+ */
+template<class A> inline void
+CEREAL_SAVE_FUNCTION_NAME(io::BufferOutputArchive &ar, std::vector<std::byte, A> const &vec) {
+    ar(make_size_tag(static_cast<size_type>(vec.size())));
+    ar(binary_data(vec.data(), vec.size()));
+}
+template<class A> inline void
+CEREAL_LOAD_FUNCTION_NAME(io::SpanInputArchive &ar, std::vector<std::byte, A> &vec) {
+    size_type size;
+    ar(make_size_tag(size));
+
+    vec.resize(static_cast<size_t>(size));
+    ar(binary_data(vec.data(), static_cast<size_t>(size)));
+}
+}
+
+CEREAL_REGISTER_ARCHIVE(io::SpanInputArchive)
+CEREAL_REGISTER_ARCHIVE(io::BufferOutputArchive)
+CEREAL_SETUP_ARCHIVE_TRAITS(io::SpanInputArchive, io::BufferOutputArchive)
+
+#endif
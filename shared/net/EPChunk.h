@@ -15,6 +15,7 @@
 #include <cereal/types/map.hpp>
 #include <cereal/types/optional.hpp>
 #include <cereal/types/string.hpp>
+#include <cereal/types/unordered_map.hpp>
 #include <cereal/types/variant.hpp>
 #include <cereal/types/vector.hpp>
 
@@ -29,6 +30,8 @@ enum ChunkMsgType: uint8_t {
     kChunkSliceData                     = 0x02,
     /// server -> client; chunk transfer completed
     kChunkCompletion                    = 0x03,
+    /// client -> server; chunk is no longer needed
+    kChunkCancel                        = 0x04,
 
     kChunkTypeMax,
 };
@@ -39,11 +42,63 @@ enum ChunkMsgType: uint8_t {
  * Chunks are sent slice by slice -- not necessarily in order -- until all slices with data have
  * been transmitted. Then, a final completion message is sent. Because TCP ensures order, this
  * means we'll have all the slices processed at that time.
+ *
+ * If the client has a cached copy of the chunk, it sends along the versions of the chunk and all
+ * of its slices. The server then only transmits the slices whose versions differ.
+ *
+ * Requests are serviced in order of priority, which is derived from how far away the chunk is and
+ * whether it's in front of the player. Sending another request for a chunk that's still pending
+ * updates its priority; set the priority update flag to make sure this never starts a new request
+ * in case the chunk was sent in the meantime.
  */
 struct ChunkGet {
     /// position of the chunk
     glm::ivec2 chunkPos;
 
+    /// distance between the chunk and the player's chunk, in chunks
+    uint16_t distance = 0;
+    /**
+     * Cosine of the angle between the player's horizontal view direction and the direction to
+     * the chunk, scaled to [-127, 127]. Chunks straight ahead are 127.
+     */
+    int8_t viewAlignment = 127;
+    /// when set, this only updates the priority of an earlier request
+    bool priorityUpdate = false;
+
+    /// version of the chunk as a whole, if the client has it cached
+    std::optional<uint64_t> cachedVersion;
+    /// versions of all cached slices that aren't at the generated version (0)
+    std::unordered_map<uint16_t, uint64_t> cachedSliceVersions;
+
+    /**
+     * Gets the priority of the request; lower values are serviced first. Chunks behind the player
+     * are treated as if they were up to three times as far away.
+     */
+    float getPriority() const {
+        const float alignment = this->viewAlignment / 127.f;
+        return (this->distance + 1) * (2.f - alignment);
+    }
+
+    private:
+        friend class cereal::access;
+        template <class Archive> void serialize(Archive &ar) {
+            ar(this->chunkPos);
+            ar(this->distance, this->viewAlignment, this->priorityUpdate);
+            ar(this->cachedVersion);
+            ar(this->cachedSliceVersions);
+        }
+};
+
+/**
+ * Client to server message cancelling a chunk request.
+ *
+ * If the server hasn't started sending the chunk yet, it drops the request and replies with a
+ * completion that has the cancelled flag set. Otherwise the chunk is sent as usual.
+ */
+struct ChunkCancel {
+    /// position of the chunk
+    glm::ivec2 chunkPos;
+
     private:
         friend class cereal::access;
         template <class Archive> void serialize(Archive &ar) {
@@ -59,6 +114,8 @@ struct ChunkSliceData {
     glm::ivec2 chunkPos;
     /// Y level of the slice
     uint16_t y;
+    /// content version of the slice
+    uint64_t version;
 
     /// mapping of UUID to integer value stored in here
     std::unordered_map<uuids::uuid, uint16_t> typeMap;
@@ -71,6 +128,7 @@ struct ChunkSliceData {
         template <class Archive> void serialize(Archive &ar) {
             ar(this->chunkPos);
             ar(this->y);
+            ar(this->version);
             ar(this->typeMap);
             ar(this->data);
         }
@@ -78,13 +136,23 @@ struct ChunkSliceData {
 
 /**
  * Message sent by the server to indicate an entire chunk worth of slice data has been sent.
+ *
+ * When the client sent cached versions, only changed slices were sent; any cached slice whose
+ * version doesn't match `sliceVersions` and wasn't sent is empty on the server.
  */
 struct ChunkCompletion {
     /// position of the completed chunk
     glm::ivec2 chunkPos;
-    /// total number of Y slices in the chunk
+    /// total number of Y slices sent for the chunk
     uint16_t numSlices;
 
+    /// set if the client's cached copy was entirely up to date
+    bool unchanged = false;
+    /// set if the request was cancelled before any data was sent
+    bool cancelled = false;
+    /// versions of all slices that aren't at the generated version (0)
+    std::unordered_map<uint16_t, uint64_t> sliceVersions;
+
     /// chunk metadata
     std::unordered_map<std::string, world::MetaValue> meta;
 
@@ -93,6 +161,8 @@ struct ChunkCompletion {
         template <class Archive> void serialize(Archive &ar) {
             ar(this->chunkPos);
             ar(this->numSlices);
+            ar(this->unchanged, this->cancelled);
+            ar(this->sliceVersions);
             ar(this->meta);
         }
 };
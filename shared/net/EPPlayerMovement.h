@@ -1,14 +1,24 @@
 #ifndef SHARED_NET_EPPLAYERMOVEMENT_H
 #define SHARED_NET_EPPLAYERMOVEMENT_H
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
 
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
 #include <uuid.h>
 #include <io/Serialization.h>
 
 #include <cereal/access.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/optional.hpp>
 #include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
 
 namespace net::message {
 /**
@@ -26,44 +36,253 @@ enum PlayerMovementMsgType: uint8_t {
 };
 
 
+/**
+ * Quantized player position and view angles, as they're sent over the wire.
+ *
+ * Positions are fixed point, relative to the chunk the player is in: the X and Z offsets have a
+ * resolution of 1/256th of a block (which exactly covers the 256 block wide chunk) and Y is a
+ * signed value with 1/64th block resolution. Angles are stored as fractions of a full turn.
+ */
+struct MovementState {
+    /// X/Z resolution: units per block
+    constexpr static const float kXZScale = 256.;
+    /// Y resolution: units per block
+    constexpr static const float kYScale = 64.;
+    /// angle resolution: units per full turn
+    constexpr static const float kAngleScale = 65536.;
+    /// width of a chunk, in blocks
+    constexpr static const float kChunkSize = 256.;
+
+    /// chunk the player is in
+    glm::ivec2 chunk = glm::ivec2(0);
+    /// offset into the chunk
+    uint16_t x = 0, z = 0;
+    /// height of the player
+    int16_t y = 0;
+    /// pitch, yaw, roll
+    std::array<uint16_t, 3> angles{};
+
+    bool operator==(const MovementState &s) const {
+        return (this->chunk == s.chunk) && (this->x == s.x) && (this->y == s.y) &&
+            (this->z == s.z) && (this->angles == s.angles);
+    }
+    bool operator!=(const MovementState &s) const {
+        return !(*this == s);
+    }
+
+    /**
+     * Quantizes the given world space position and angles (in degrees.)
+     */
+    static MovementState quantize(const glm::vec3 &pos, const glm::vec3 &angles) {
+        MovementState s;
+
+        s.chunk = glm::ivec2(std::floor(pos.x / kChunkSize), std::floor(pos.z / kChunkSize));
+
+        const auto xOff = pos.x - (s.chunk.x * kChunkSize), zOff = pos.z - (s.chunk.y * kChunkSize);
+        s.x = std::clamp<long>(std::lround(xOff * kXZScale), 0, UINT16_MAX);
+        s.z = std::clamp<long>(std::lround(zOff * kXZScale), 0, UINT16_MAX);
+        s.y = std::clamp<long>(std::lround(pos.y * kYScale), INT16_MIN, INT16_MAX);
+
+        for(size_t i = 0; i < 3; i++) {
+            // wrap into [0, 360) first; the cast then takes care of the full turn case
+            const auto turns = std::fmod(std::fmod(angles[i], 360.f) + 360.f, 360.f) / 360.f;
+            s.angles[i] = static_cast<uint16_t>(std::lround(turns * kAngleScale) & 0xFFFF);
+        }
+
+        return s;
+    }
+
+    /**
+     * Converts the state back to a world space position.
+     */
+    glm::vec3 getPosition() const {
+        return glm::vec3((this->chunk.x * kChunkSize) + (this->x / kXZScale),
+                this->y / kYScale, (this->chunk.y * kChunkSize) + (this->z / kXZScale));
+    }
+    /**
+     * Converts the angles back to degrees, in the range (-180, 180].
+     */
+    glm::vec3 getAngles() const {
+        glm::vec3 out;
+        for(size_t i = 0; i < 3; i++) {
+            out[i] = (this->angles[i] / kAngleScale) * 360.f;
+            if(out[i] > 180.f) out[i] -= 360.f;
+        }
+        return out;
+    }
+
+    private:
+        friend class cereal::access;
+        template <class Archive> void serialize(Archive &ar) {
+            ar(this->chunk);
+            ar(this->x, this->y, this->z);
+            ar(this->angles);
+        }
+};
+
+/**
+ * A movement state, delta encoded against a base state that both sides already know.
+ *
+ * Only fields flagged as present are serialized. Position components are small signed deltas;
+ * angles are sent as absolute values when they change. If there's no base, the player changed
+ * chunks, or moved too far for a delta to fit, a keyframe holding the full state is sent instead.
+ */
+struct MovementDelta {
+    enum Flags: uint8_t {
+        /// full state follows; no base is needed
+        kKeyframe                       = (1 << 0),
+        kPosX                           = (1 << 1),
+        kPosY                           = (1 << 2),
+        kPosZ                           = (1 << 3),
+        kPitch                          = (1 << 4),
+        kYaw                            = (1 << 5),
+        kRoll                           = (1 << 6),
+    };
+
+    /// which fields are present
+    uint8_t flags = 0;
+    /// full state, for keyframes
+    MovementState keyframe;
+    /// position deltas (x, y, z) in quantized units
+    std::array<int8_t, 3> pos{};
+    /// absolute angles; only those flagged are serialized
+    std::array<uint16_t, 3> angles{};
+
+    /**
+     * Encodes the given state against the base (if any.)
+     */
+    static MovementDelta encode(const std::optional<MovementState> &base, const MovementState &state) {
+        MovementDelta d;
+
+        // figure out whether we can delta encode at all
+        std::array<int32_t, 3> diff{};
+        bool keyframe = !base || (base->chunk != state.chunk);
+
+        if(!keyframe) {
+            diff = {state.x - base->x, state.y - base->y, state.z - base->z};
+            for(const auto v : diff) {
+                if(v < INT8_MIN || v > INT8_MAX) keyframe = true;
+            }
+        }
+
+        if(keyframe) {
+            d.flags = kKeyframe;
+            d.keyframe = state;
+            return d;
+        }
+
+        // encode the components that changed
+        for(size_t i = 0; i < 3; i++) {
+            if(diff[i]) {
+                d.flags |= (kPosX << i);
+                d.pos[i] = diff[i];
+            }
+            if(state.angles[i] != base->angles[i]) {
+                d.flags |= (kPitch << i);
+                d.angles[i] = state.angles[i];
+            }
+        }
+
+        return d;
+    }
+
+    /**
+     * Applies the delta to the given base state, producing the new state.
+     */
+    MovementState apply(const MovementState &base) const {
+        if(this->flags & kKeyframe) return this->keyframe;
+
+        MovementState s = base;
+        if(this->flags & kPosX) s.x += this->pos[0];
+        if(this->flags & kPosY) s.y += this->pos[1];
+        if(this->flags & kPosZ) s.z += this->pos[2];
+
+        for(size_t i = 0; i < 3; i++) {
+            if(this->flags & (kPitch << i)) s.angles[i] = this->angles[i];
+        }
+
+        return s;
+    }
+
+    /// whether this is a keyframe
+    const bool isKeyframe() const {
+        return (this->flags & kKeyframe);
+    }
+
+    private:
+        friend class cereal::access;
+        template <class Archive> void serialize(Archive &ar) {
+            ar(this->flags);
+
+            if(this->flags & kKeyframe) {
+                ar(this->keyframe);
+                return;
+            }
+
+            for(size_t i = 0; i < 3; i++) {
+                if(this->flags & (kPosX << i)) ar(this->pos[i]);
+            }
+            for(size_t i = 0; i < 3; i++) {
+                if(this->flags & (kPitch << i)) ar(this->angles[i]);
+            }
+        }
+};
+
+
+
 /**
  * Client to server message indicating that our player has moved.
+ *
+ * The delta is relative to the previous state the client sent; since the connection is ordered
+ * and reliable, that's always the last state the server has applied. The first message after
+ * connecting is always a keyframe.
  */
 struct PlayerPositionChanged {
-    /// timestamp/identifier; used to reject out-of-order/older updates
-    uint32_t epoch;
+    /// new position and angles
+    MovementDelta movement;
 
-    /// origin of the player bounding volume
-    glm::vec3 position;
-    /// camera angles currently used
-    glm::vec3 angles;
+    private:
+        friend class cereal::access;
+        template <class Archive> void serialize(Archive &ar) {
+            ar(this->movement);
+        }
+};
+
+/**
+ * A single player's movement in a position broadcast
+ */
+struct PlayerPositionEntry {
+    /// server assigned short identifier of the player
+    uint16_t playerIndex;
+    /// player ID; only sent the first time a player index is sent to a client
+    std::optional<uuids::uuid> playerId;
+    /// movement relative to the last state the client was sent for this player
+    MovementDelta movement;
 
     private:
         friend class cereal::access;
         template <class Archive> void serialize(Archive &ar) {
-            ar(this->epoch);
-            ar(this->position);
-            ar(this->angles);
+            ar(this->playerIndex);
+            ar(this->playerId);
+            ar(this->movement);
         }
 };
 
 /**
- * Player position broadcast
+ * Player position broadcast; contains the movement of all nearby players that moved since the
+ * last broadcast tick, and the indices of players that left since then.
  */
 struct PlayerPositionBroadcast {
-    /// player ID that moved
-    uuids::uuid playerId;
-    /// origin of the player bounding volume
-    glm::vec3 position;
-    /// camera angles currently used
-    glm::vec3 angles;
+    /// all players that moved
+    std::vector<PlayerPositionEntry> players;
+    /// indices of previously sent players that disconnected; they may be reused later
+    std::vector<uint16_t> departed;
 
     private:
         friend class cereal::access;
         template <class Archive> void serialize(Archive &ar) {
-            ar(this->playerId);
-            ar(this->position);
-            ar(this->angles);
+            ar(this->players);
+            ar(this->departed);
         }
 };
 
@@ -0,0 +1,114 @@
+#include "Framing.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace net;
+
+/// Maximum number of idle packet buffers to keep around
+constexpr static const size_t kMaxPacketBuffers = 128;
+/// Packet buffers larger than this are freed rather than reused
+constexpr static const size_t kPacketBufferRetainSize = 256 * 1024;
+
+/**
+ * Gets the packet buffer pool. It's intentionally leaked, so that buffers still in flight when the
+ * process exits can't outlive it.
+ */
+static util::BufferPool &GetPacketBufferPool() {
+    static auto pool = new util::BufferPool(kMaxPacketBuffers, kPacketBufferRetainSize);
+    return *pool;
+}
+
+/**
+ * Builds the frames for the packet in a single buffer, so they're always written back to back.
+ */
+std::byte *net::BuildFrames(const uint8_t ep, const uint8_t type, const uint16_t tag,
+        const void *data, const size_t dataLen, size_t &outLen) {
+    // figure out how much space we need
+    const size_t numFrames = std::max<size_t>(1, (dataLen + kMaxFramePayload - 1) / kMaxFramePayload);
+
+    size_t totalSize = (numFrames * sizeof(PacketHeader)) + dataLen;
+    if(totalSize & 0x3) {
+        totalSize += 4 - (totalSize & 0x3);
+    }
+
+    auto buf = new std::byte[totalSize];
+    memset(buf, 0, totalSize);
+
+    // build each frame
+    auto writePtr = buf;
+    auto readPtr = reinterpret_cast<const std::byte *>(data);
+    size_t remaining = dataLen;
+
+    for(size_t i = 0; i < numFrames; i++) {
+        const auto frameLen = std::min(remaining, kMaxFramePayload);
+        const bool isLast = (i == numFrames - 1);
+
+        auto hdr = reinterpret_cast<PacketHeader *>(writePtr);
+        hdr->endpoint = ep;
+        hdr->type = type;
+        hdr->tag = htons(tag);
+        hdr->length = htons((frameLen + 3) / 4);
+        hdr->flags = htons(isLast ? 0 : kPacketFlagContinued);
+
+        memcpy(hdr->payload, readPtr, frameLen);
+
+        writePtr += sizeof(PacketHeader) + frameLen;
+        readPtr += frameLen;
+        remaining -= frameLen;
+    }
+
+    outLen = totalSize;
+    return buf;
+}
+
+/**
+ * Swaps the tag, length and flags fields.
+ */
+void net::FrameHeaderToHost(PacketHeader &hdr) {
+    hdr.tag = ntohs(hdr.tag);
+    hdr.length = ntohs(hdr.length);
+    hdr.flags = ntohs(hdr.flags);
+}
+
+/**
+ * Takes a buffer from the pool and reserves the header space.
+ */
+PacketBuffer net::GetPacketBuffer() {
+    auto buf = GetPacketBufferPool().get(1024);
+    buf->resize(sizeof(PacketHeader));
+    return buf;
+}
+
+/**
+ * Pads the packet and writes its header in place.
+ */
+bool net::FinishPacketBuffer(std::vector<std::byte> &packet, const uint8_t ep, const uint8_t type,
+        const uint16_t tag) {
+    const auto payloadLen = packet.size() - sizeof(PacketHeader);
+    if(payloadLen > kMaxFramePayload) {
+        return false;
+    }
+
+    if(packet.size() & 0x3) {
+        packet.resize(packet.size() + (4 - (packet.size() & 0x3)), std::byte(0));
+    }
+
+    auto hdr = reinterpret_cast<PacketHeader *>(packet.data());
+    hdr->endpoint = ep;
+    hdr->type = type;
+    hdr->tag = htons(tag);
+    hdr->length = htons((payloadLen + 3) / 4);
+    hdr->flags = 0;
+
+    return true;
+}
+
+/**
+ * Re-wraps the buffer in a smart pointer, which returns it to the pool as it goes out of scope.
+ */
+void net::ReleasePacketBuffer(util::BufferPool::Bytes *packet) {
+    PacketBuffer buf(packet, util::BufferPool::Releaser{&GetPacketBufferPool()});
+}
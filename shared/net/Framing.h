@@ -0,0 +1,52 @@
+#ifndef SHARED_NET_FRAMING_H
+#define SHARED_NET_FRAMING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PacketTypes.h"
+#include <util/BufferPool.h>
+
+namespace net {
+/**
+ * Builds the frames for a packet: its payload is split into as many frames as needed, each
+ * preceded by a header, and the last one padded to a multiple of 4 bytes.
+ *
+ * @param outLen Receives the total size of all frames
+ *
+ * @return Buffer containing the frames; release it with `delete[]`
+ */
+std::byte *BuildFrames(const uint8_t ep, const uint8_t type, const uint16_t tag,
+        const void *data, const size_t dataLen, size_t &outLen);
+
+/**
+ * Converts the multi-byte fields of a received header to host byte order.
+ */
+void FrameHeaderToHost(PacketHeader &hdr);
+
+/// Buffer that an outgoing packet is serialized into
+using PacketBuffer = util::BufferPool::Buffer;
+
+/**
+ * Gets a buffer to serialize an outgoing packet into. It's taken from a process-wide pool, and
+ * already has room for the frame header reserved at its start; append the payload after it.
+ */
+PacketBuffer GetPacketBuffer();
+
+/**
+ * Fills in the header of a packet built in a packet buffer, and pads it to a multiple of 4 bytes.
+ * This can only be done if the payload fits in a single frame.
+ *
+ * @return Whether the header was written
+ */
+bool FinishPacketBuffer(std::vector<std::byte> &packet, const uint8_t ep, const uint8_t type,
+        const uint16_t tag);
+
+/**
+ * Returns a packet buffer that had been released from its smart pointer back to the pool.
+ */
+void ReleasePacketBuffer(util::BufferPool::Bytes *packet);
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SHARED_NET_PACKETTYPES_H
 #define SHARED_NET_PACKETTYPES_H
 
+#include <cstddef>
 #include <cstdint>
 
 #include "EPAuth.h"
@@ -10,6 +11,11 @@
 
 namespace net {
 
+/// ALPN protocol name for plain connections
+constexpr static const char *kProtocolName = "cubeland/1.0";
+/// ALPN protocol name for connections where everything after the handshake is LZ4 compressed
+constexpr static const char *kProtocolNameCompressed = "cubeland/1.0+lz4";
+
 /**
  * Packet endpoints
  */
@@ -37,8 +43,26 @@ enum PacketEndpoint: uint8_t {
 
 };
 
+/**
+ * Flags in the packet header
+ */
+enum PacketFlags: uint16_t {
+    /// Another frame follows that continues this packet's payload
+    kPacketFlagContinued                = (1 << 0),
+};
+
+/// Largest payload a single frame can carry, in bytes
+constexpr static const size_t kMaxFramePayload = 0xFFFF * 4;
+/// Largest payload a packet may have after joining all of its frames
+constexpr static const size_t kMaxPacketSize = 32 * 1024 * 1024;
+
 /**
  * Header for all network packets
+ *
+ * Payloads larger than `kMaxFramePayload` are split over several frames, each with its own
+ * header. All but the last have the `kPacketFlagContinued` flag set and carry exactly
+ * `kMaxFramePayload` bytes. The frames of a packet are always sent back to back, with the same
+ * endpoint, type and tag.
  */
 struct PacketHeader {
     /// Endpoint
@@ -51,8 +75,8 @@ struct PacketHeader {
     /// length of packet (in units of 4 bytes) in network byte order
     uint16_t length;
 
-    // reserved; send as 0
-    uint16_t reserved;
+    /// flags (from PacketFlags) in network byte order
+    uint16_t flags;
 
     /// payload data
     char payload[];
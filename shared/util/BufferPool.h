@@ -0,0 +1,94 @@
+#ifndef UTIL_BUFFERPOOL_H
+#define UTIL_BUFFERPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace util {
+/**
+ * Keeps a few byte buffers around for reuse, so that code that constantly needs temporary
+ * buffers (such as for receiving packets) doesn't have to allocate new ones every time.
+ *
+ * Buffers are handed out as smart pointers that return them to the pool when they go out of
+ * scope; the pool must outlive all of them. Buffers that grew beyond the retention limit are
+ * freed instead, so that the occasional huge message doesn't pin its memory forever.
+ *
+ * This class is thread safe.
+ */
+class BufferPool {
+    public:
+        using Bytes = std::vector<std::byte>;
+
+        /// Returns buffers to the pool they came from
+        struct Releaser {
+            BufferPool *pool = nullptr;
+
+            void operator()(Bytes *buf) const {
+                this->pool->release(buf);
+            }
+        };
+        using Buffer = std::unique_ptr<Bytes, Releaser>;
+
+    public:
+        /**
+         * @param maxBuffers Maximum number of idle buffers kept
+         * @param maxRetainedSize Buffers with a larger capacity than this are not kept
+         */
+        BufferPool(const size_t maxBuffers, const size_t maxRetainedSize) :
+            maxBuffers(maxBuffers), maxRetainedSize(maxRetainedSize) {}
+        ~BufferPool() {
+            for(auto buf : this->idle) {
+                delete buf;
+            }
+        }
+
+        /**
+         * Gets an empty buffer, with at least the given capacity.
+         */
+        Buffer get(const size_t capacity = 0) {
+            Bytes *buf = nullptr;
+            {
+                std::lock_guard<std::mutex> lg(this->lock);
+                if(!this->idle.empty()) {
+                    buf = this->idle.back();
+                    this->idle.pop_back();
+                }
+            }
+
+            if(!buf) {
+                buf = new Bytes;
+            }
+            buf->reserve(capacity);
+
+            return Buffer(buf, Releaser{this});
+        }
+
+    private:
+        /// Takes back a buffer, if we've got room to store it
+        void release(Bytes *buf) {
+            if(buf->capacity() <= this->maxRetainedSize) {
+                buf->clear();
+
+                std::lock_guard<std::mutex> lg(this->lock);
+                if(this->idle.size() < this->maxBuffers) {
+                    this->idle.push_back(buf);
+                    return;
+                }
+            }
+
+            delete buf;
+        }
+
+    private:
+        const size_t maxBuffers;
+        const size_t maxRetainedSize;
+
+        std::mutex lock;
+        /// buffers waiting to be reused
+        std::vector<Bytes *> idle;
+};
+}
+
+#endif
@@ -0,0 +1,160 @@
+#include "LZ4Stream.h"
+#include "io/Format.h"
+#include <Logging.h>
+
+#include <lz4frame.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace util;
+
+/**
+ * Settings for the outgoing frame: linked 64K blocks, with each compression call flushed to its
+ * own block. There's no checksum, since the transport already guarantees integrity.
+ */
+static LZ4F_preferences_t MakePrefs() {
+    LZ4F_preferences_t prefs;
+    memset(&prefs, 0, sizeof(prefs));
+
+    prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+    prefs.frameInfo.blockMode = LZ4F_blockLinked;
+    prefs.frameInfo.contentChecksumFlag = LZ4F_noContentChecksum;
+    prefs.autoFlush = 1;
+
+    return prefs;
+}
+
+/**
+ * Allocates the compression and decompression contexts.
+ */
+LZ4Stream::LZ4Stream() {
+    size_t err;
+
+    err = LZ4F_createCompressionContext(&this->cctx, LZ4F_VERSION);
+    if(LZ4F_isError(err)) {
+        throw std::runtime_error(f("failed to create LZ4F compression context: {} ({:x})",
+                    LZ4F_getErrorName(err), err));
+    }
+
+    err = LZ4F_createDecompressionContext(&this->dctx, LZ4F_VERSION);
+    if(LZ4F_isError(err)) {
+        throw std::runtime_error(f("failed to create LZ4F decompression context: {} ({:x})",
+                    LZ4F_getErrorName(err), err));
+    }
+}
+
+/**
+ * Releases the LZ4 contexts.
+ */
+LZ4Stream::~LZ4Stream() {
+    if(this->cctx) {
+        LZ4F_freeCompressionContext(this->cctx);
+    }
+    if(this->dctx) {
+        LZ4F_freeDecompressionContext(this->dctx);
+    }
+}
+
+/**
+ * Compresses the given data into a block, and appends it to the output buffer. The first call
+ * also writes the frame header.
+ *
+ * @return Number of bytes appended to the output buffer
+ */
+size_t LZ4Stream::compress(const void *in, const size_t inLen, std::vector<std::byte> &out) {
+    size_t err;
+    const auto prefs = MakePrefs();
+
+    const auto start = out.size();
+    size_t written = start;
+
+    // write the frame header if needed
+    if(!this->frameStarted) {
+        out.resize(written + LZ4F_HEADER_SIZE_MAX);
+
+        err = LZ4F_compressBegin(this->cctx, out.data() + written, LZ4F_HEADER_SIZE_MAX, &prefs);
+        if(LZ4F_isError(err)) {
+            throw std::runtime_error(f("LZ4F_compressBegin() failed: {} ({:x})",
+                        LZ4F_getErrorName(err), err));
+        }
+
+        written += err;
+        this->frameStarted = true;
+    }
+
+    // then the data
+    const auto bound = LZ4F_compressBound(inLen, &prefs);
+    out.resize(written + bound);
+
+    err = LZ4F_compressUpdate(this->cctx, out.data() + written, bound, in, inLen, nullptr);
+    if(LZ4F_isError(err)) {
+        throw std::runtime_error(f("LZ4F_compressUpdate() failed: {} ({:x})",
+                    LZ4F_getErrorName(err), err));
+    }
+
+    written += err;
+    out.resize(written);
+
+    return written - start;
+}
+
+/**
+ * Decompresses data received from the peer. It may contain any portion of the stream; partial
+ * blocks are buffered by the decompressor until the rest of them arrives.
+ */
+void LZ4Stream::decompress(const void *in, const size_t inLen) {
+    size_t err, consumed = 0;
+    bool outputFull = false;
+
+    auto inPtr = reinterpret_cast<const std::byte *>(in);
+
+    // discard bytes that have already been read
+    if(this->decodedOffset) {
+        this->decoded.erase(this->decoded.begin(), this->decoded.begin() + this->decodedOffset);
+        this->decodedOffset = 0;
+    }
+
+    // decompress until all input is consumed and the decompressor has nothing left to output
+    do {
+        const auto used = this->decoded.size();
+        this->decoded.resize(used + kDecodeChunk);
+
+        size_t srcSize = inLen - consumed;
+        size_t dstSize = kDecodeChunk;
+
+        err = LZ4F_decompress(this->dctx, this->decoded.data() + used, &dstSize,
+                inPtr + consumed, &srcSize, nullptr);
+        if(LZ4F_isError(err)) {
+            this->decoded.resize(used);
+            throw std::runtime_error(f("LZ4F_decompress() failed: {} ({:x})",
+                        LZ4F_getErrorName(err), err));
+        }
+
+        consumed += srcSize;
+        this->decoded.resize(used + dstSize);
+
+        outputFull = (dstSize == kDecodeChunk);
+    } while(consumed < inLen || outputFull);
+}
+
+/**
+ * Reads decompressed data.
+ *
+ * @return Number of bytes copied, which may be less than requested if not enough data has been
+ * decompressed yet.
+ */
+size_t LZ4Stream::read(void *out, const size_t outLen) {
+    const auto toCopy = std::min(outLen, this->available());
+
+    memcpy(out, this->decoded.data() + this->decodedOffset, toCopy);
+    this->decodedOffset += toCopy;
+
+    if(this->decodedOffset == this->decoded.size()) {
+        this->decoded.clear();
+        this->decodedOffset = 0;
+    }
+
+    return toCopy;
+}
@@ -0,0 +1,60 @@
+/**
+ * Streaming LZ4 compression for network connections. Unlike the one-shot interface in LZ4.h, the
+ * compressor and decompressor keep their state between calls, so that data sent earlier on the
+ * stream serves as the dictionary for later data.
+ */
+#ifndef UTIL_LZ4STREAM_H
+#define UTIL_LZ4STREAM_H
+
+#include <cstddef>
+#include <vector>
+
+struct LZ4F_cctx_s;
+struct LZ4F_dctx_s;
+
+namespace util {
+/**
+ * One direction each of a compressed byte stream.
+ *
+ * Outgoing data is compressed into a single LZ4 frame that is never ended; every call to
+ * `compress()` produces a complete block, which the peer can decode as soon as it arrives. The
+ * blocks are linked, so matches may reference up to 64K of previously sent data.
+ *
+ * Incoming data is fed to `decompress()` as it's received, in chunks of any size; decompressed
+ * bytes are buffered until they're read.
+ *
+ * This class is not thread safe.
+ */
+class LZ4Stream {
+    public:
+        LZ4Stream();
+        ~LZ4Stream();
+
+        size_t compress(const void *in, const size_t inLen, std::vector<std::byte> &out);
+
+        void decompress(const void *in, const size_t inLen);
+
+        /// Number of decompressed bytes waiting to be read
+        size_t available() const {
+            return this->decoded.size() - this->decodedOffset;
+        }
+        size_t read(void *out, const size_t outLen);
+
+    private:
+        /// Space reserved in the decompression buffer before each decompression call
+        constexpr static const size_t kDecodeChunk = 64 * 1024;
+
+    private:
+        struct LZ4F_cctx_s *cctx = nullptr;
+        struct LZ4F_dctx_s *dctx = nullptr;
+
+        /// set once the frame header has been written
+        bool frameStarted = false;
+
+        /// decompressed bytes that haven't been read yet start at this offset in the buffer
+        size_t decodedOffset = 0;
+        std::vector<std::byte> decoded;
+};
+}
+
+#endif
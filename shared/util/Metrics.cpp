@@ -0,0 +1,260 @@
+#include "Metrics.h"
+
+#include <io/Format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+using namespace util;
+
+const std::vector<double> Metrics::kLatencyBuckets = {
+    .00005, .0001, .00025, .0005, .001, .0025, .005, .01, .025, .05, .1, .25, .5, 1, 2.5, 5, 10
+};
+
+/**
+ * Returns the shared registry, creating it the first time it's used.
+ */
+Metrics &Metrics::shared() {
+    static Metrics gShared;
+    return gShared;
+}
+
+
+
+/**
+ * Sets up a histogram with the given bucket bounds, which must be sorted in ascending order.
+ */
+Metrics::Histogram::Histogram(const std::vector<double> &_bounds) : bounds(_bounds) {
+    this->buckets = std::make_unique<std::atomic_uint64_t[]>(this->bounds.size() + 1);
+    for(size_t i = 0; i <= this->bounds.size(); i++) {
+        this->buckets[i] = 0;
+    }
+}
+
+/**
+ * Records an observation.
+ */
+void Metrics::Histogram::observe(const double value) {
+    const auto it = std::lower_bound(this->bounds.begin(), this->bounds.end(), value);
+    const auto bucket = std::distance(this->bounds.begin(), it);
+
+    this->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    auto sum = this->sum.load(std::memory_order_relaxed);
+    while(!this->sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {}
+}
+
+
+
+/**
+ * Gets a counter, creating it if needed.
+ */
+Metrics::Counter *Metrics::getCounter(const std::string &name, const std::string &help,
+        const Labels &labels) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    auto &series = this->getSeries(name, help, Type::Counter, labels);
+    if(!series.counter) {
+        series.counter = std::make_unique<Counter>();
+    }
+    return series.counter.get();
+}
+
+/**
+ * Gets a histogram, creating it with the given bucket bounds if needed.
+ */
+Metrics::Histogram *Metrics::getHistogram(const std::string &name, const std::string &help,
+        const Labels &labels, const std::vector<double> &bounds) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    auto &series = this->getSeries(name, help, Type::Histogram, labels);
+    if(!series.histogram) {
+        series.histogram = std::make_unique<Histogram>(bounds);
+    }
+    return series.histogram.get();
+}
+
+/**
+ * Installs (or replaces) the callback for a gauge.
+ */
+void Metrics::setGauge(const std::string &name, const std::string &help, const Labels &labels,
+        const GaugeFunc &func) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    auto &series = this->getSeries(name, help, Type::Gauge, labels);
+    series.gauge = func;
+}
+
+/**
+ * Removes a single series. The family is removed along with its last series.
+ */
+void Metrics::removeSeries(const std::string &name, const Labels &labels) {
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    auto it = this->families.find(name);
+    if(it == this->families.end()) return;
+
+    it->second.series.erase(formatLabels(labels));
+    if(it->second.series.empty()) {
+        this->families.erase(it);
+    }
+}
+
+/**
+ * Finds the series with the given labels in a family, creating both if needed. The lock must be
+ * held.
+ */
+Metrics::Series &Metrics::getSeries(const std::string &name, const std::string &help,
+        const Type type, const Labels &labels) {
+    auto it = this->families.find(name);
+    if(it == this->families.end()) {
+        Family family;
+        family.type = type;
+        family.help = help;
+
+        it = this->families.emplace(name, std::move(family)).first;
+    } else if(it->second.type != type) {
+        throw std::runtime_error(f("Metric '{}' already registered with a different type", name));
+    }
+
+    auto &series = it->second.series[formatLabels(labels)];
+    series.labels = labels;
+    return series;
+}
+
+
+
+/**
+ * Renders every metric in the Prometheus text exposition format.
+ */
+std::string Metrics::formatAll() {
+    std::stringstream out;
+
+    // sample gauges without holding the lock, since their callbacks may take locks of their own
+    std::vector<std::tuple<std::string, std::string, GaugeFunc>> gauges;
+    std::map<std::pair<std::string, std::string>, double> gaugeValues;
+    {
+        std::lock_guard<std::mutex> lg(this->lock);
+        for(const auto &[name, family] : this->families) {
+            if(family.type != Type::Gauge) continue;
+
+            for(const auto &[key, series] : family.series) {
+                gauges.emplace_back(name, key, series.gauge);
+            }
+        }
+    }
+
+    for(const auto &[name, key, func] : gauges) {
+        gaugeValues[{name, key}] = func();
+    }
+
+    // then format all metrics
+    std::lock_guard<std::mutex> lg(this->lock);
+
+    for(const auto &[name, family] : this->families) {
+        out << "# HELP " << name << ' ' << family.help << '\n';
+
+        switch(family.type) {
+            case Type::Counter:
+                out << "# TYPE " << name << " counter\n";
+                for(const auto &[key, series] : family.series) {
+                    out << name << key << ' ' << series.counter->get() << '\n';
+                }
+                break;
+
+            case Type::Gauge:
+                out << "# TYPE " << name << " gauge\n";
+                for(const auto &[key, series] : family.series) {
+                    // skip gauges registered since we sampled them
+                    auto it = gaugeValues.find({name, key});
+                    if(it == gaugeValues.end()) continue;
+
+                    out << name << key << ' ' << formatValue(it->second) << '\n';
+                }
+                break;
+
+            case Type::Histogram:
+                out << "# TYPE " << name << " histogram\n";
+                for(const auto &[key, series] : family.series) {
+                    const auto &h = *series.histogram;
+
+                    // buckets are cumulative
+                    uint64_t total = 0;
+                    for(size_t i = 0; i < h.bounds.size(); i++) {
+                        total += h.buckets[i].load(std::memory_order_relaxed);
+                        out << name << "_bucket"
+                            << formatLabels(series.labels, "le", formatValue(h.bounds[i]))
+                            << ' ' << total << '\n';
+                    }
+                    total += h.buckets[h.bounds.size()].load(std::memory_order_relaxed);
+
+                    out << name << "_bucket" << formatLabels(series.labels, "le", "+Inf") << ' '
+                        << total << '\n';
+                    out << name << "_sum" << key << ' ' << formatValue(h.sum) << '\n';
+                    out << name << "_count" << key << ' ' << total << '\n';
+                }
+                break;
+        }
+    }
+
+    return out.str();
+}
+
+/**
+ * Formats a label set, optionally with one extra label appended. Values are escaped as required
+ * by the text format.
+ */
+std::string Metrics::formatLabels(const Labels &labels, const std::string &extraName,
+        const std::string &extraValue) {
+    if(labels.empty() && extraName.empty()) return "";
+
+    std::string out = "{";
+
+    auto append = [&](const std::string &name, const std::string &value) {
+        if(out.size() > 1) out.push_back(',');
+
+        out.append(name);
+        out.append("=\"");
+
+        for(const auto c : value) {
+            switch(c) {
+                case '\\':
+                    out.append("\\\\");
+                    break;
+                case '"':
+                    out.append("\\\"");
+                    break;
+                case '\n':
+                    out.append("\\n");
+                    break;
+                default:
+                    out.push_back(c);
+            }
+        }
+
+        out.push_back('"');
+    };
+
+    for(const auto &[name, value] : labels) {
+        append(name, value);
+    }
+    if(!extraName.empty()) {
+        append(extraName, extraValue);
+    }
+
+    out.push_back('}');
+    return out;
+}
+
+/**
+ * Formats a sample value.
+ */
+std::string Metrics::formatValue(const double value) {
+    if(std::isnan(value)) return "NaN";
+    if(std::isinf(value)) return (value > 0) ? "+Inf" : "-Inf";
+
+    return f("{}", value);
+}
@@ -0,0 +1,146 @@
+#ifndef UTIL_METRICS_H
+#define UTIL_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace util {
+/**
+ * Process wide registry of performance metrics.
+ *
+ * Metrics are grouped into families by name; each family has one series per distinct set of
+ * labels. Counters and histograms are owned by the registry and handed out as pointers, which
+ * stay valid until the series is removed; gauges are callbacks sampled whenever the metrics are
+ * formatted.
+ *
+ * The registry can be rendered in the Prometheus text exposition format.
+ */
+class Metrics {
+    public:
+        /// label name/value pairs identifying a series
+        using Labels = std::vector<std::pair<std::string, std::string>>;
+        /// returns the current value of a gauge
+        using GaugeFunc = std::function<double(void)>;
+
+        /// Monotonically increasing count
+        class Counter {
+            public:
+                void inc(const uint64_t n = 1) {
+                    this->value.fetch_add(n, std::memory_order_relaxed);
+                }
+                uint64_t get() const {
+                    return this->value.load(std::memory_order_relaxed);
+                }
+
+            private:
+                std::atomic_uint64_t value = 0;
+        };
+
+        /// Distribution of observed values, counted into fixed buckets
+        class Histogram {
+            friend class Metrics;
+
+            public:
+                Histogram(const std::vector<double> &bounds);
+
+                void observe(const double value);
+                /// observes a duration, in seconds
+                template<class Rep, class Period>
+                void observe(const std::chrono::duration<Rep, Period> &d) {
+                    this->observe(std::chrono::duration<double>(d).count());
+                }
+
+            private:
+                /// upper bound (inclusive) of each bucket
+                std::vector<double> bounds;
+                /// number of observations in each bucket, plus one for values beyond the last
+                std::unique_ptr<std::atomic_uint64_t[]> buckets;
+
+                /// sum of all observed values; updated with compare-and-swap, as not all of our
+                /// standard libraries support floating point atomic arithmetic
+                std::atomic<double> sum = 0;
+        };
+
+    public:
+        /// Bucket bounds for latencies, in seconds: 50µS to 10 seconds
+        static const std::vector<double> kLatencyBuckets;
+
+    public:
+        static Counter *counter(const std::string &name, const std::string &help,
+                const Labels &labels = {}) {
+            return shared().getCounter(name, help, labels);
+        }
+        static Histogram *histogram(const std::string &name, const std::string &help,
+                const Labels &labels = {}, const std::vector<double> &bounds = kLatencyBuckets) {
+            return shared().getHistogram(name, help, labels, bounds);
+        }
+        static void gauge(const std::string &name, const std::string &help, const Labels &labels,
+                const GaugeFunc &func) {
+            shared().setGauge(name, help, labels, func);
+        }
+
+        /// Removes a series; pointers to it are no longer valid afterwards
+        static void remove(const std::string &name, const Labels &labels = {}) {
+            shared().removeSeries(name, labels);
+        }
+
+        /// Formats all metrics in the Prometheus text format
+        static std::string format() {
+            return shared().formatAll();
+        }
+
+    private:
+        enum class Type {
+            Counter, Gauge, Histogram,
+        };
+
+        struct Series {
+            Labels labels;
+
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Histogram> histogram;
+            GaugeFunc gauge;
+        };
+
+        struct Family {
+            Type type;
+            std::string help;
+
+            /// series, keyed by their formatted labels
+            std::map<std::string, Series> series;
+        };
+
+    private:
+        static Metrics &shared();
+
+        Counter *getCounter(const std::string &, const std::string &, const Labels &);
+        Histogram *getHistogram(const std::string &, const std::string &, const Labels &,
+                const std::vector<double> &);
+        void setGauge(const std::string &, const std::string &, const Labels &, const GaugeFunc &);
+        void removeSeries(const std::string &, const Labels &);
+
+        Series &getSeries(const std::string &, const std::string &, const Type, const Labels &);
+
+        std::string formatAll();
+
+        static std::string formatLabels(const Labels &, const std::string &extraName = "",
+                const std::string &extraValue = "");
+        static std::string formatValue(const double);
+
+    private:
+        std::mutex lock;
+        /// all metric families, by name
+        std::map<std::string, Family> families;
+};
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef UTIL_PRIORITYQUEUE_H
+#define UTIL_PRIORITYQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace util {
+/**
+ * Thread safe queue that hands out items in order of ascending priority value; items with equal
+ * priority come out in the order they were inserted.
+ *
+ * Every item has a key, which can be used to change its priority or remove it for as long as it
+ * is still in the queue.
+ */
+template<class Key, class T, class Hash = std::hash<Key>> class PriorityQueue {
+    public:
+        /**
+         * Inserts an item. If an item with the same key is already queued, only its priority is
+         * updated.
+         *
+         * @return Whether the item was inserted
+         */
+        bool push(const Key &key, const float priority, T item) {
+            {
+                std::lock_guard<std::mutex> lg(this->lock);
+                if(this->items.contains(key)) {
+                    this->reorder(key, priority);
+                    return false;
+                }
+
+                const Order order(priority, this->nextSeq++);
+                this->order.emplace(order, key);
+                this->items.emplace(key, Entry{std::move(item), order});
+            }
+
+            this->cond.notify_one();
+            return true;
+        }
+
+        /**
+         * Changes the priority of a queued item.
+         *
+         * @return Whether the item was still queued
+         */
+        bool update(const Key &key, const float priority) {
+            std::lock_guard<std::mutex> lg(this->lock);
+            if(!this->items.contains(key)) return false;
+
+            this->reorder(key, priority);
+            return true;
+        }
+
+        /**
+         * Removes a queued item, returning it if it hadn't been dequeued yet.
+         */
+        std::optional<T> remove(const Key &key) {
+            std::lock_guard<std::mutex> lg(this->lock);
+
+            auto it = this->items.find(key);
+            if(it == this->items.end()) return std::nullopt;
+
+            T item = std::move(it->second.item);
+            this->order.erase(it->second.order);
+            this->items.erase(it);
+
+            return item;
+        }
+
+        /**
+         * Dequeues the item with the lowest priority value, if there is one.
+         */
+        std::optional<std::pair<Key, T>> try_pop() {
+            std::lock_guard<std::mutex> lg(this->lock);
+            if(this->order.empty()) return std::nullopt;
+
+            return this->popFront();
+        }
+
+        /**
+         * Dequeues the item with the lowest priority value, waiting for one to become available.
+         */
+        std::pair<Key, T> wait_pop() {
+            std::unique_lock<std::mutex> lk(this->lock);
+            this->cond.wait(lk, [&]{
+                return !this->order.empty();
+            });
+
+            return this->popFront();
+        }
+
+        /// whether an item with the given key is queued
+        bool contains(const Key &key) {
+            std::lock_guard<std::mutex> lg(this->lock);
+            return this->items.contains(key);
+        }
+        /// number of queued items
+        size_t size() {
+            std::lock_guard<std::mutex> lg(this->lock);
+            return this->items.size();
+        }
+
+    private:
+        /// sort key: priority, then insertion order
+        using Order = std::pair<float, uint64_t>;
+
+        struct Entry {
+            T item;
+            Order order;
+        };
+
+    private:
+        /// moves an item to a new priority; the lock must be held
+        void reorder(const Key &key, const float priority) {
+            auto &entry = this->items.at(key);
+            if(entry.order.first == priority) return;
+
+            this->order.erase(entry.order);
+            entry.order.first = priority;
+            this->order.emplace(entry.order, key);
+        }
+
+        /// removes the first item; the lock must be held and the queue non-empty
+        std::pair<Key, T> popFront() {
+            auto first = this->order.begin();
+            const auto key = first->second;
+            this->order.erase(first);
+
+            auto it = this->items.find(key);
+            std::pair<Key, T> out(key, std::move(it->second.item));
+            this->items.erase(it);
+
+            return out;
+        }
+
+    private:
+        std::mutex lock;
+        /// signalled whenever an item is inserted
+        std::condition_variable cond;
+
+        /// keys of all queued items, in dequeue order
+        std::map<Order, Key> order;
+        /// all queued items
+        std::unordered_map<Key, Entry, Hash> items;
+        /// insertion counter, used to keep FIFO order among equal priorities
+        uint64_t nextSeq = 0;
+};
+}
+
+#endif
@@ -10,6 +10,7 @@
 #include <Logging.h>
 #include <sqlite3.h>
 
+#include <cereal/types/array.hpp>
 #include <cereal/types/variant.hpp>
 #include <cereal/types/string.hpp>
 #include <cereal/types/unordered_map.hpp>
@@ -147,6 +148,17 @@ void FileWorldReader::deserializeChunkMeta(std::shared_ptr<Chunk> chunk, const s
 
         cereal::PortableBinaryInputArchive arc(stream);
         arc(chunk->meta);
+
+        // older worlds don't store slice versions; those slices keep the generated version
+        std::array<Chunk::Version, Chunk::kMaxY> versions;
+
+        try {
+            arc(versions);
+        } catch(cereal::Exception &) {
+            versions.fill(Chunk::kVersionGenerated);
+        }
+
+        chunk->setSliceVersions(versions);
     }
 }
 
@@ -13,6 +13,7 @@
 #include <Logging.h>
 #include <sqlite3.h>
 
+#include <cereal/types/array.hpp>
 #include <cereal/types/variant.hpp>
 #include <cereal/types/string.hpp>
 #include <cereal/types/unordered_map.hpp>
@@ -171,6 +172,7 @@ void FileWorldReader::serializeChunkMeta(const std::shared_ptr<Chunk> &chunk, st
         PROFILE_SCOPE(Archive);
         cereal::PortableBinaryOutputArchive arc(stream);
         arc(chunk->meta);
+        arc(chunk->getSliceVersions());
     }
 
     // then compress
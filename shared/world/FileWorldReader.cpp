@@ -11,6 +11,8 @@
 
 #include <stdexcept>
 #include <filesystem>
+#include <sstream>
+#include <cctype>
 #include <time.h>
 
 #if PROFILE
@@ -60,6 +62,9 @@ FileWorldReader::FileWorldReader(const std::string &path, const bool create, con
                                    sqlite3_errstr(err), err));
     }
 
+    // time every statement that's executed
+    sqlite3_trace_v2(this->db, SQLITE_TRACE_PROFILE, &FileWorldReader::traceCallback, this);
+
     // allocate some additional stuff
     this->compressor = std::make_unique<util::LZ4>();
 
@@ -94,6 +99,69 @@ FileWorldReader::~FileWorldReader() {
 
 
 
+/**
+ * SQLite trace callback; records the execution time of each completed statement into a histogram
+ * for its kind of statement.
+ */
+int FileWorldReader::traceCallback(unsigned int type, void *ctx, void *p, void *x) {
+    if(type != SQLITE_TRACE_PROFILE) return 0;
+
+    auto reader = reinterpret_cast<FileWorldReader *>(ctx);
+    auto stmt = reinterpret_cast<sqlite3_stmt *>(p);
+    const auto nanos = *reinterpret_cast<const sqlite3_int64 *>(x);
+
+    const char *sqlStr = sqlite3_sql(stmt);
+    if(!sqlStr) return 0;
+    const std::string sql(sqlStr);
+
+    util::Metrics::Histogram *histogram = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(reader->statementTimesLock);
+
+        auto it = reader->statementTimes.find(sql);
+        if(it == reader->statementTimes.end()) {
+            auto h = util::Metrics::histogram("cubeland_db_statement_seconds",
+                    "Time taken to execute world file database statements",
+                    {{"statement", statementLabel(sql)}});
+            it = reader->statementTimes.emplace(sql, h).first;
+        }
+        histogram = it->second;
+    }
+
+    histogram->observe(static_cast<double>(nanos) / 1e9);
+    return 0;
+}
+
+/**
+ * Derives a short label for a statement from its SQL: the verb, plus the table it operates on if
+ * we can find one. So "SELECT id, data FROM chunk_slice_v1 WHERE ..." becomes "SELECT
+ * chunk_slice_v1".
+ */
+std::string FileWorldReader::statementLabel(const std::string &sql) {
+    std::stringstream str(sql);
+    std::string verb, word;
+
+    str >> verb;
+    for(auto &c : verb) c = toupper(c);
+
+    // updates name their table right after the verb; everything else after FROM or INTO
+    if(verb != "UPDATE") {
+        while(str >> word) {
+            for(auto &c : word) c = toupper(c);
+            if(word == "FROM" || word == "INTO") break;
+        }
+    }
+
+    if(str >> word) {
+        // strip any punctuation, such as the opening parenthesis of a column list
+        return verb + " " + word.substr(0, word.find_first_of("(;,"));
+    }
+
+    return verb;
+}
+
+
+
 /**
  * Checks the database for the presense of the expected schema. If missing, we initialize it.
  */
@@ -3,6 +3,7 @@
 
 #include "WorldReader.h"
 #include "util/SQLite.h"
+#include "util/Metrics.h"
 
 #include <string>
 #include <thread>
@@ -12,6 +13,7 @@
 #include <stdexcept>
 #include <array>
 #include <future>
+#include <mutex>
 #include <unordered_map>
 #include <cstdint>
 
@@ -185,6 +187,9 @@ class FileWorldReader: public WorldReader {
         void workerMain();
         void sendWorkerNop();
 
+        static int traceCallback(unsigned int, void *, void *, void *);
+        static std::string statementLabel(const std::string &sql);
+
     private:
         /// worker thread processes requests as long as this is set
         std::atomic_bool workerRun;
@@ -221,6 +226,11 @@ class FileWorldReader: public WorldReader {
 
         /// used for decompressing/compressing block data
         std::unique_ptr<util::LZ4> compressor;
+
+        /// lock protecting the statement timing histograms
+        std::mutex statementTimesLock;
+        /// statement timing histograms, keyed by the statement's SQL
+        std::unordered_map<std::string, util::Metrics::Histogram *> statementTimes;
 };
 }
 
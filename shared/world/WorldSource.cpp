@@ -5,6 +5,7 @@
 #include "chunk/Chunk.h"
 #include "chunk/ChunkSlice.h"
 #include <io/Format.h>
+#include <util/Metrics.h>
 #include <util/Thread.h>
 
 #include <Logging.h>
@@ -12,6 +13,8 @@
 #include <utility>
 #include <chrono>
 #include <algorithm>
+#include <exception>
+#include <limits>
 #include <random>
 
 #if PROFILE
@@ -95,6 +98,297 @@ void WorldSource::flushDirtyChunksSync() {
     this->inhibitDirtyChunkHandling = false;
 }
 
+/**
+ * Gets a chunk, scheduled according to the given priority.
+ *
+ * Chunks that are already in memory (either because someone else is still using them, or because
+ * they're in the cache) are returned immediately. If the chunk is already being loaded, the
+ * request shares that load; this way, all callers always get the same chunk object. Otherwise, a
+ * load is queued.
+ *
+ * The request can be cancelled or reprioritized through the returned request id until the chunk
+ * has been loaded; the future of a cancelled request throws `std::future_error`.
+ */
+std::future<std::shared_ptr<Chunk>> WorldSource::getChunk(int x, int z, const float priority,
+        RequestId &outId) {
+    static auto hits = util::Metrics::counter("cubeland_world_chunk_requests_total",
+            "Chunk requests, by whether the chunk was in memory, already loading, or loaded",
+            {{"result", "hit"}});
+    static auto joined = util::Metrics::counter("cubeland_world_chunk_requests_total",
+            "Chunk requests, by whether the chunk was in memory, already loading, or loaded",
+            {{"result", "joined"}});
+    static auto misses = util::Metrics::counter("cubeland_world_chunk_requests_total",
+            "Chunk requests, by whether the chunk was in memory, already loading, or loaded",
+            {{"result", "miss"}});
+
+    const glm::ivec2 pos(x, z);
+    const auto id = this->nextRequestId++;
+    outId = id;
+
+    std::promise<std::shared_ptr<Chunk>> prom;
+    auto future = prom.get_future();
+
+    LOCK_GUARD(this->residencyLock, GetChunk);
+
+    // is the chunk in memory already?
+    auto chunk = this->findResident(pos);
+    if(chunk) {
+        hits->inc();
+        prom.set_value(chunk);
+        return future;
+    }
+
+    // is it being loaded?
+    auto it = this->loads.find(pos);
+    if(it != this->loads.end()) {
+        joined->inc();
+
+        auto &load = it->second;
+        load.waiters.emplace(id, std::make_pair(std::move(prom), priority));
+        this->waiterPositions[id] = pos;
+
+        if(!load.started) {
+            this->updateLoadPriority(load);
+        }
+        return future;
+    }
+
+    // otherwise, load it. the worker can't look at the load until we've released the lock
+    misses->inc();
+
+    PendingLoad load;
+    load.waiters.emplace(id, std::make_pair(std::move(prom), priority));
+
+    this->workWithPriority(priority, &load.workId, [&, pos] {
+        this->workerLoadChunk(pos);
+    });
+
+    this->loads.emplace(pos, std::move(load));
+    this->waiterPositions[id] = pos;
+
+    return future;
+}
+
+/**
+ * Cancels a chunk request. If nobody else is waiting for the chunk, and no worker has started
+ * loading it yet, the load is removed from the work queue as well.
+ *
+ * @return Whether the request was cancelled; this fails if the chunk was already loaded.
+ */
+bool WorldSource::cancelRequest(const RequestId id) {
+    LOCK_GUARD(this->residencyLock, CancelRequest);
+
+    auto posIt = this->waiterPositions.find(id);
+    if(posIt == this->waiterPositions.end()) return false;
+
+    const auto pos = posIt->second;
+    this->waiterPositions.erase(posIt);
+
+    // dropping the promise breaks the request's future
+    auto &load = this->loads.at(pos);
+    load.waiters.erase(id);
+
+    if(!load.started) {
+        // if the worker already dequeued the load, it'll notice it has no waiters left
+        if(load.waiters.empty()) {
+            if(this->workQueue.remove(load.workId)) {
+                this->loads.erase(pos);
+            }
+        } else {
+            this->updateLoadPriority(load);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Changes the priority of a chunk request. Its load is scheduled at the most urgent priority of
+ * all requests waiting on it.
+ *
+ * @return Whether the request was found; this fails if the chunk was already loaded.
+ */
+bool WorldSource::reprioritizeRequest(const RequestId id, const float priority) {
+    LOCK_GUARD(this->residencyLock, ReprioritizeRequest);
+
+    auto posIt = this->waiterPositions.find(id);
+    if(posIt == this->waiterPositions.end()) return false;
+
+    auto &load = this->loads.at(posIt->second);
+    load.waiters.at(id).second = priority;
+
+    if(!load.started) {
+        this->updateLoadPriority(load);
+    }
+    return true;
+}
+
+/**
+ * Updates the work queue priority of a chunk load to that of its most urgent waiter. The
+ * residency lock must be held.
+ */
+void WorldSource::updateLoadPriority(PendingLoad &load) {
+    if(load.waiters.empty()) return;
+
+    float priority = std::numeric_limits<float>::max();
+    for(const auto &[id, waiter] : load.waiters) {
+        priority = std::min(priority, waiter.second);
+    }
+
+    this->workQueue.update(load.workId, priority);
+}
+
+/**
+ * Worker side of a chunk load: gets the chunk, makes it resident, and hands it to everyone that
+ * is still waiting for it.
+ */
+void WorldSource::workerLoadChunk(const glm::ivec2 &pos) {
+    {
+        LOCK_GUARD(this->residencyLock, StartLoad);
+
+        auto it = this->loads.find(pos);
+        if(it == this->loads.end()) return;
+
+        // everyone cancelled after we dequeued the load, but before it could be removed
+        if(it->second.waiters.empty()) {
+            this->loads.erase(it);
+            return;
+        }
+
+        it->second.started = true;
+    }
+
+    // get the chunk
+    std::shared_ptr<Chunk> chunk = nullptr;
+    std::exception_ptr error = nullptr;
+
+    try {
+        chunk = this->workerGetChunk(pos.x, pos.y);
+    } catch(...) {
+        error = std::current_exception();
+    }
+
+    // publish it; chunks are resident even if everyone cancelled, since they're already loaded
+    decltype(PendingLoad::waiters) waiters;
+    {
+        LOCK_GUARD(this->residencyLock, FinishLoad);
+
+        auto it = this->loads.find(pos);
+        waiters = std::move(it->second.waiters);
+        this->loads.erase(it);
+
+        for(const auto &[id, waiter] : waiters) {
+            this->waiterPositions.erase(id);
+        }
+
+        if(chunk) {
+            this->insertResident(pos, chunk);
+        }
+    }
+
+    for(auto &[id, waiter] : waiters) {
+        if(error) {
+            waiter.first.set_exception(error);
+        } else {
+            waiter.first.set_value(chunk);
+        }
+    }
+}
+
+/**
+ * Sets the memory budget for the chunk cache, in bytes. Chunks in the cache are kept in memory
+ * after everyone has released them, until they are evicted by more recently used chunks. If the
+ * budget is zero, chunks are only kept as long as someone is using them.
+ *
+ * Sizes of chunks are estimated from the size of their row pools.
+ */
+void WorldSource::setCacheBudget(const size_t bytes) {
+    LOCK_GUARD(this->residencyLock, SetCacheBudget);
+
+    this->cacheBudget = bytes;
+    this->evictCached();
+}
+
+/**
+ * Looks up a chunk that's in memory; if found, it's also moved to the front of the LRU cache. The
+ * residency lock must be held.
+ */
+std::shared_ptr<Chunk> WorldSource::findResident(const glm::ivec2 &pos) {
+    auto it = this->resident.find(pos);
+    if(it == this->resident.end()) return nullptr;
+
+    auto chunk = it->second.chunk.lock();
+    if(!chunk) {
+        // it can't be in the cache, since that holds a strong reference
+        this->resident.erase(it);
+        return nullptr;
+    }
+
+    this->touchCached(pos, it->second, chunk);
+    return chunk;
+}
+
+/**
+ * Makes a freshly loaded chunk resident, and inserts it into the cache. Every so often, entries
+ * for chunks that have since been deallocated are removed. The residency lock must be held.
+ */
+void WorldSource::insertResident(const glm::ivec2 &pos, const std::shared_ptr<Chunk> &chunk) {
+    auto &entry = this->resident[pos];
+    entry.chunk = chunk;
+
+    this->touchCached(pos, entry, chunk);
+
+    if(++this->residentSinceSweep >= kResidentSweepInterval) {
+        std::erase_if(this->resident, [](const auto &item) {
+            return !item.second.cached && item.second.chunk.expired();
+        });
+        this->residentSinceSweep = 0;
+    }
+}
+
+/**
+ * Moves a chunk to the front of the LRU cache, inserting it if needed, and updates its size. Then
+ * evicts chunks if we're over budget. The residency lock must be held.
+ */
+void WorldSource::touchCached(const glm::ivec2 &pos, ResidentChunk &entry,
+        const std::shared_ptr<Chunk> &chunk) {
+    if(!this->cacheBudget) return;
+
+    if(entry.cached) {
+        this->lru.splice(this->lru.begin(), this->lru, entry.lruPos);
+        this->cacheBytes -= entry.bytes;
+    } else {
+        entry.cached = chunk;
+        this->lru.push_front(pos);
+        entry.lruPos = this->lru.begin();
+    }
+
+    // chunks grow as they're modified, so re-measure every time
+    entry.bytes = sizeof(Chunk) + chunk->poolAllocSpace();
+    this->cacheBytes += entry.bytes;
+
+    this->evictCached();
+}
+
+/**
+ * Evicts least recently used chunks from the cache until it fits its budget. Evicted chunks stay
+ * resident if someone else still holds a reference to them. The residency lock must be held.
+ */
+void WorldSource::evictCached() {
+    while(this->cacheBytes > this->cacheBudget && !this->lru.empty()) {
+        const auto pos = this->lru.back();
+        this->lru.pop_back();
+
+        auto &entry = this->resident.at(pos);
+        this->cacheBytes -= entry.bytes;
+        entry.cached = nullptr;
+
+        if(entry.chunk.expired()) {
+            this->resident.erase(pos);
+        }
+    }
+}
+
 /**
  * Retrieves a chunk of the world.
  *
@@ -102,13 +396,23 @@ void WorldSource::flushDirtyChunksSync() {
  * it is read from there. Otherwise, we generate it on our background thread and return it.
  */
 std::shared_ptr<Chunk> WorldSource::workerGetChunk(const int x, const int z) {
+    static auto loadTime = util::Metrics::histogram("cubeland_world_chunk_load_seconds",
+            "Time taken to get a chunk", {{"source", "file"}});
+    static auto generateTime = util::Metrics::histogram("cubeland_world_chunk_load_seconds",
+            "Time taken to get a chunk", {{"source", "generator"}});
+
+    const auto start = std::chrono::steady_clock::now();
+
     // check the world reader if we're not in generate only mode
     if(!this->generateOnly && this->reader) {
         auto exists = this->reader->chunkExists(x, z);
         if(exists.get_future().get()) {
             auto chunk = this->reader->getChunk(x, z);
             auto future = chunk.get_future();
-            return future.get();
+            auto loaded = future.get();
+
+            loadTime->observe(std::chrono::steady_clock::now() - start);
+            return loaded;
         }
     }
 
@@ -116,6 +420,7 @@ std::shared_ptr<Chunk> WorldSource::workerGetChunk(const int x, const int z) {
     auto generated = this->generator->generateChunk(x, z);
     // this->markChunkDirty(generated);
 
+    generateTime->observe(std::chrono::steady_clock::now() - start);
     return generated;
 }
 
@@ -133,9 +438,8 @@ void WorldSource::workerMain(size_t i) {
     util::Thread::setName(threadName);
 
     // main loop; dequeue work items
-    WorkItem item;
     while(this->workerRun) {
-        this->workQueue.wait_dequeue(item);
+        auto [id, item] = this->workQueue.wait_pop();
         item();
     }
 
@@ -235,6 +539,9 @@ void WorldSource::writerMain() {
 #endif
     util::Thread::setName("WorldSource Writer");
 
+    auto writeTime = util::Metrics::histogram("cubeland_world_chunk_write_seconds",
+            "Time taken to write a chunk to the world file");
+
     while(this->workerRun) {
         // get a new write request
         WriteRequest req;
@@ -254,6 +561,8 @@ void WorldSource::writerMain() {
         const auto diffUs = duration_cast<microseconds>(diff).count();
         Logging::trace("Writing chunk {} took {} µS", req.chunk->worldPos, diffUs);
 
+        writeTime->observe(diff);
+
         // run completion handler if provided
         if(req.completion) {
             (*req.completion)();
@@ -17,6 +17,7 @@
 #include <thread>
 #include <vector>
 #include <future>
+#include <list>
 #include <optional>
 #include <unordered_map>
 #include <mutex>
@@ -26,6 +27,8 @@
 #include <glm/gtx/hash.hpp>
 #include <blockingconcurrentqueue.h>
 
+#include <util/PriorityQueue.h>
+
 namespace world {
 struct Chunk;
 
@@ -38,11 +41,32 @@ class WorldSource: public AbstractWorldSource {
                 std::shared_ptr<WorldGenerator> generator, const size_t numThreads = 0);
         virtual ~WorldSource();
 
+        /// Identifies a queued work request, for cancellation or reprioritization
+        using RequestId = uint64_t;
+        /// Priority of requests that don't specify one; lower values are serviced first
+        constexpr static const float kDefaultPriority = 0.;
+
         /// Gets a chunk from either the file or the world generator.
         std::future<std::shared_ptr<Chunk>> getChunk(int x, int z) override {
-            return this->work([&, x, z]{
-                return this->workerGetChunk(x, z);
-            });
+            RequestId id;
+            return this->getChunk(x, z, kDefaultPriority, id);
+        }
+        std::future<std::shared_ptr<Chunk>> getChunk(int x, int z, const float priority,
+                RequestId &outId);
+
+        bool cancelRequest(const RequestId id);
+        bool reprioritizeRequest(const RequestId id, const float priority);
+
+        void setCacheBudget(const size_t bytes);
+        /// Gets the estimated memory used by chunks in the cache
+        size_t getCacheBytes() {
+            std::lock_guard<std::mutex> lg(this->residencyLock);
+            return this->cacheBytes;
+        }
+        /// Gets the number of chunks held by the cache
+        size_t numCachedChunks() {
+            std::lock_guard<std::mutex> lg(this->residencyLock);
+            return this->lru.size();
         }
 
         std::future<void> setPlayerInfo(const uuids::uuid &id, const std::string &key, const std::vector<char> &value) override;
@@ -76,16 +100,32 @@ class WorldSource: public AbstractWorldSource {
             return this->dirtyChunks.size();
             // return this->writeQueue.size_approx();
         }
+        /// Gets the number of work requests waiting for a worker
+        size_t numPendingRequests() {
+            return this->workQueue.size();
+        }
+        /// Gets the number of chunks queued for the writer thread
+        size_t numQueuedWrites() const {
+            return this->writeQueue.size_approx();
+        }
 
     private:
         using WorkItem = std::function<void(void)>;
 
+        void workerLoadChunk(const glm::ivec2 &pos);
         std::shared_ptr<Chunk> workerGetChunk(const int x, const int z);
 
     private:
         // executes a function on the work queue, resulting a future holding its return value
         template<class F, class... Args>
         auto work(F&& f, Args&&... args) 
+        -> std::future<typename std::invoke_result<F, Args...>::type> {
+            return this->workWithPriority(kDefaultPriority, nullptr, std::forward<F>(f),
+                    std::forward<Args>(args)...);
+        }
+        // as above, but at the given priority; the request's id is written to outId if given
+        template<class F, class... Args>
+        auto workWithPriority(const float priority, RequestId *outId, F&& f, Args&&... args) 
         -> std::future<typename std::invoke_result<F, Args...>::type> {
             // build a task from the function invocation
             using return_type = typename std::invoke_result<F, Args...>::type;
@@ -100,19 +140,55 @@ class WorldSource: public AbstractWorldSource {
             if(!this->acceptRequests) {
                 throw std::runtime_error("work queue not accepting requests");
             }
-            this->workQueue.enqueue([task](){ (*task)(); });
+            const auto id = this->nextRequestId++;
+            if(outId) *outId = id;
+
+            this->workQueue.push(id, priority, [task](){ (*task)(); });
 
             return fut;
         }
 
         /// enqueue an empty work item
         void pushNop() {
-            this->workQueue.enqueue([&] {});
+            this->workQueue.push(this->nextRequestId++, kDefaultPriority, [&] {});
         }
         void workerMain(size_t i);
 
         void writerMain();
 
+    private:
+        /// A chunk load that's queued or in progress, and the requests waiting on it
+        struct PendingLoad {
+            /// work queue request that loads the chunk
+            RequestId workId;
+            /// set once a worker has started loading; it can no longer be removed from the queue
+            bool started = false;
+
+            /// promise to fulfill for each request, and the priority it was made at
+            std::unordered_map<RequestId, std::pair<std::promise<std::shared_ptr<Chunk>>, float>> waiters;
+        };
+
+        /// A chunk that is (or recently was) in memory
+        struct ResidentChunk {
+            /// the chunk; valid as long as anyone is still holding on to it
+            std::weak_ptr<Chunk> chunk;
+
+            /// reference held while the chunk is in the LRU cache
+            std::shared_ptr<Chunk> cached = nullptr;
+            /// position in the LRU list, if cached
+            std::list<glm::ivec2>::iterator lruPos;
+            /// estimated memory used by the chunk when it was last accessed
+            size_t bytes = 0;
+        };
+
+        std::shared_ptr<Chunk> findResident(const glm::ivec2 &pos);
+        void insertResident(const glm::ivec2 &pos, const std::shared_ptr<Chunk> &chunk);
+        void touchCached(const glm::ivec2 &pos, ResidentChunk &entry,
+                const std::shared_ptr<Chunk> &chunk);
+        void evictCached();
+
+        void updateLoadPriority(PendingLoad &load);
+
     private:
         /// Number of frames a chunk must be dirty before it's written out
         constexpr static const size_t kDirtyThreshold = 60*2.5;
@@ -122,6 +198,9 @@ class WorldSource: public AbstractWorldSource {
         /// Maximum number of chunks to queue for writing per frame
         constexpr static const size_t kMaxWriteChunksPerFrame = 2;
 
+        /// Number of chunks made resident between sweeps of expired entries from the resident map
+        constexpr static const size_t kResidentSweepInterval = 256;
+
     private:
         struct DirtyChunkInfo {
             /// Chunk to write out
@@ -155,8 +234,10 @@ class WorldSource: public AbstractWorldSource {
         std::atomic_bool workerRun;
         /// worker threads
         std::vector<std::unique_ptr<std::thread>> workers;
-        /// work requests sent to the thread
-        moodycamel::BlockingConcurrentQueue<WorkItem> workQueue;
+        /// work requests sent to the thread, ordered by priority
+        util::PriorityQueue<RequestId, WorkItem> workQueue;
+        /// id to assign to the next work request
+        std::atomic<RequestId> nextRequestId = 1;
 
         /// chunk writer thread
         std::unique_ptr<std::thread> writerThread;
@@ -167,6 +248,23 @@ class WorldSource: public AbstractWorldSource {
         /// lock protecting the dirty chunks map
         std::mutex dirtyChunksLock;
 
+        /// lock protecting the loads, resident chunks and the LRU cache
+        std::mutex residencyLock;
+        /// chunks being loaded, by position
+        std::unordered_map<glm::ivec2, PendingLoad> loads;
+        /// position of the chunk each outstanding request is waiting on
+        std::unordered_map<RequestId, glm::ivec2> waiterPositions;
+        /// chunks in memory, by position
+        std::unordered_map<glm::ivec2, ResidentChunk> resident;
+        /// positions of cached chunks; the most recently used one is at the front
+        std::list<glm::ivec2> lru;
+        /// maximum memory chunks in the LRU cache may use; if zero, nothing is cached
+        size_t cacheBudget = 0;
+        /// estimated memory currently used by cached chunks
+        size_t cacheBytes = 0;
+        /// chunks made resident since the resident map was last swept
+        size_t residentSinceSweep = 0;
+
         /// when set, we accept work items
         std::atomic_bool acceptRequests;
 
@@ -178,6 +178,9 @@ dispensary:;
     // insert value. this should never fail
     row->set(pos.x, mapValue);
 
+    // the slice no longer matches whatever version it was loaded as
+    this->sliceVersions[pos.y] = kVersionUnknown;
+
     if(prepare) {
         row->prepare();
     }
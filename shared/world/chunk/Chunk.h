@@ -10,6 +10,7 @@
 
 #include "ChunkSlice.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -91,6 +92,9 @@ struct Chunk {
 
         using ChangeToken = uint32_t;
 
+        /// Content version of a chunk slice
+        using Version = uint64_t;
+
         /**
          * Change callback type 
          *
@@ -108,6 +112,11 @@ struct Chunk {
         /// Maximum Y height of a chunk [0..kMaxY) layers are available
         constexpr static const size_t kMaxY = 256;
 
+        /// Version of a slice that hasn't been modified since the chunk was generated
+        constexpr static const Version kVersionGenerated = 0;
+        /// Version of a slice modified locally; it doesn't correspond to any server version
+        constexpr static const Version kVersionUnknown = UINT64_MAX;
+
     public:
         /**
          * X/Z coordinates of this chunk, in world chunk coordinate space.
@@ -153,6 +162,17 @@ struct Chunk {
          */
         std::unordered_map<std::string, MetaValue> meta;
 
+        /**
+         * Content version of each slice. The server assigns a new version whenever a slice is
+         * modified; clients use these to request only the slices that changed since they cached
+         * the chunk. Any call to `setBlock()` resets the slice's version to `kVersionUnknown`.
+         *
+         * Versions may be read by other threads while the chunk is being edited (for example, by
+         * the server's chunk serializers) so they're atomic; use `getSliceVersions()` to get a
+         * snapshot of all of them.
+         */
+        std::array<std::atomic<Version>, kMaxY> sliceVersions{};
+
     public:
         /**
          * Releases all the memory used by slices.
@@ -183,6 +203,27 @@ struct Chunk {
         /// Sets the UUID of a block at the given chunk-relative coordinate.
         void setBlock(const glm::ivec3 &pos, const uuids::uuid &blockId, const bool prepare = false, const bool runCallbacks = true);
 
+        /// Gets the version of the chunk as a whole; this is the most recent slice version.
+        Version getVersion() const {
+            const auto versions = this->getSliceVersions();
+            return *std::max_element(versions.begin(), versions.end());
+        }
+
+        /// Gets a copy of the versions of all slices
+        std::array<Version, kMaxY> getSliceVersions() const {
+            std::array<Version, kMaxY> versions;
+            for(size_t y = 0; y < kMaxY; y++) {
+                versions[y] = this->sliceVersions[y];
+            }
+            return versions;
+        }
+        /// Replaces the versions of all slices
+        void setSliceVersions(const std::array<Version, kMaxY> &versions) {
+            for(size_t y = 0; y < kMaxY; y++) {
+                this->sliceVersions[y] = versions[y];
+            }
+        }
+
     private:
         /**
          * All registered chunk modification callbacks. Each of these is invoked when a block in
@@ -56,6 +56,10 @@ class Buffer {
         void *mapBuffer(BufferMapPolicy policy);
         void unmapBuffer();
 
+        gl::GLuint getGlObjectId() const {
+            return this->buffer;
+        }
+
     private:
         static gl::GLenum bufferTypeGL(BufferType type);
         gl::GLenum bufferTypeGL(void) {
@@ -0,0 +1,63 @@
+/*
+ * BufferTexture.cpp
+ */
+
+#include "BufferTexture.h"
+
+#include "gfx/gl/buffer/Buffer.h"
+
+#include <Logging.h>
+
+#include <glbinding/gl/gl.h>
+
+using namespace gl;
+using namespace gfx;
+
+/**
+ * Allocates a texture object. It has no storage until a buffer is attached.
+ */
+BufferTexture::BufferTexture(int unit) : Texture(unit) {
+
+}
+
+/**
+ * Releases the texture; the buffer is released as well, unless it's used elsewhere.
+ */
+BufferTexture::~BufferTexture() {
+
+}
+
+/**
+ * Binds the texture on the specified texture unit.
+ */
+void BufferTexture::bind(void) {
+    glActiveTexture(GL_TEXTURE0 + ((unsigned int) this->unit));
+    glBindTexture(GL_TEXTURE_BUFFER, this->texture);
+}
+
+/**
+ * Unbinds the texture.
+ */
+void BufferTexture::unbind(void) {
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+/**
+ * Buffer textures can't be dumped.
+ */
+void BufferTexture::dump(const std::string &base) {
+    // not implemented
+    Logging::debug("BufferTexture::dump() is unimplemented (this = {}, base = {})", (void *) this, base);
+}
+
+/**
+ * Uses the given buffer as the texture's storage. Each texel is one element of the given format;
+ * only unnormalized formats (such as `RG32UI`) are sensible here.
+ */
+void BufferTexture::attachBuffer(const std::shared_ptr<Buffer> &_buffer, const TextureFormat format) {
+    this->buffer = _buffer;
+    this->format = format;
+
+    this->bind();
+    glTexBuffer(GL_TEXTURE_BUFFER, this->glFormat(), this->buffer->getGlObjectId());
+}
@@ -0,0 +1,39 @@
+/*
+ * BufferTexture.h
+ *
+ * A texture whose texels are read directly out of a buffer object; shaders access it with
+ * `texelFetch()` on a buffer sampler.
+ */
+
+#ifndef GFX_BUFFER_TEXTURE_BUFFERTEXTURE_H_
+#define GFX_BUFFER_TEXTURE_BUFFERTEXTURE_H_
+
+#include "Texture.h"
+
+#include <memory>
+#include <string>
+
+namespace gfx {
+class Buffer;
+
+class BufferTexture: public Texture {
+    public:
+        BufferTexture(int unit);
+        BufferTexture() : BufferTexture(0) {}
+
+        ~BufferTexture();
+
+        void bind(void);
+        static void unbind(void);
+
+        void dump(const std::string &base);
+
+        void attachBuffer(const std::shared_ptr<Buffer> &buffer, const TextureFormat format);
+
+    private:
+        /// buffer holding the texel data; it's kept alive as long as it's attached
+        std::shared_ptr<Buffer> buffer;
+};
+} /* namespace gfx */
+
+#endif /* GFX_BUFFER_TEXTURE_BUFFERTEXTURE_H_ */
@@ -221,6 +221,8 @@ GLenum Texture::glFormat(void) {
 			return GL_RG16F;
 		case RG32F:
 			return GL_RG32F;
+		case RG32UI:
+			return GL_RG32UI;
 
 		case RGB:
 			return GL_RGB;
@@ -27,6 +27,7 @@ class Texture {
             RG8,
             RG16F,
             RG32F,
+            RG32UI,
 
             RGB,
             RGB8,
@@ -3,6 +3,7 @@
 #include "MainWindow.h"
 #include "io/PrefsManager.h"
 #include "io/Format.h"
+#include "render/chunk/ChunkWorker.h"
 
 #include <glbinding/gl/gl.h>
 #include <glbinding/Binding.h>
@@ -124,6 +125,8 @@ void PreferencesWindow::loadGfxPaneState() {
     this->gfx.fancySky = io::PrefsManager::getBool("gfx.fancySky", true);
     this->gfx.dirShadows = io::PrefsManager::getBool("gfx.sunShadow");
     this->gfx.ssao = io::PrefsManager::getBool("gfx.ssao", true);
+    this->gfx.bakedOcclusion = io::PrefsManager::getBool("gfx.bakedOcclusion", true);
+    this->gfx.bakedOcclusionReplacesSsao = io::PrefsManager::getBool("gfx.bakedOcclusionReplacesSsao", true);
     this->gfx.gamma = io::PrefsManager::getFloat("gfx.fxaa.gamma", 2.2);
     this->gfx.fov = io::PrefsManager::getFloat("gfx.fov", 74.);
     this->gfx.horizontalInventory = io::PrefsManager::getBool("ui.inventory.isHorizontal", true);
@@ -135,6 +138,8 @@ void PreferencesWindow::saveGfxPaneState() {
     io::PrefsManager::setBool("gfx.fancySky", this->gfx.fancySky);
     io::PrefsManager::setBool("gfx.sunShadow", this->gfx.dirShadows);
     io::PrefsManager::setBool("gfx.ssao", this->gfx.ssao);
+    io::PrefsManager::setBool("gfx.bakedOcclusion", this->gfx.bakedOcclusion);
+    io::PrefsManager::setBool("gfx.bakedOcclusionReplacesSsao", this->gfx.bakedOcclusionReplacesSsao);
     io::PrefsManager::setFloat("gfx.fxaa.gamma", this->gfx.gamma);
     io::PrefsManager::setFloat("gfx.fov", this->gfx.fov);
     io::PrefsManager::setBool("ui.inventory.isHorizontal", this->gfx.horizontalInventory);
@@ -197,6 +202,17 @@ void PreferencesWindow::drawGfxPane(GameUI *ui) {
         if(ImGui::IsItemHovered()) {
             ImGui::SetTooltip("Selectively darkens areas of intersecting planes, such as corners of rooms.");
         }
+
+        // baked ambient occlusion
+        if(ImGui::Checkbox("Smooth Block Lighting", &this->gfx.bakedOcclusion)) dirty = true;
+        if(ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Darkens the corners of blocks next to other blocks. This is computed once when chunks are loaded, and is much cheaper than ambient occlusion.\nHint: Changes take effect after restarting the game.");
+        }
+
+        if(ImGui::Checkbox("Skip Ambient Occlusion", &this->gfx.bakedOcclusionReplacesSsao)) dirty = true;
+        if(ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Disables ambient occlusion when smooth block lighting is enabled.\nHint: Changes take effect after restarting the game.");
+        }
     }
     ImGui::EndChild();
 
@@ -237,10 +253,13 @@ void PreferencesWindow::drawGfxPane(GameUI *ui) {
  * Loads preferences for the performance pane.
  */
 void PreferencesWindow::loadPerfPaneState() {
-    this->perf.drawThreads = io::PrefsManager::getUnsigned("chunk.drawWorkThreads", 4);
+    this->perf.drawThreads = io::PrefsManager::getUnsigned("chunk.drawWorkThreads",
+            render::chunk::ChunkWorker::defaultNumWorkers());
     this->perf.sourceThreads = io::PrefsManager::getUnsigned("world.sourceWorkThreads", 2);
+    this->perf.greedyMeshing = io::PrefsManager::getBool("chunk.greedyMeshing", false);
     this->perf.renderDist = io::PrefsManager::getUnsigned("world.render.distance", 2);
     this->perf.renderCacheBuffer = io::PrefsManager::getUnsigned("world.render.cacheRange", 1);
+    this->perf.compressNetwork = io::PrefsManager::getBool("net.compression", true);
 }
 
 /**
@@ -249,8 +268,10 @@ void PreferencesWindow::loadPerfPaneState() {
 void PreferencesWindow::savePerfPaneState() {
     io::PrefsManager::setUnsigned("chunk.drawWorkThreads", std::max(2, this->perf.drawThreads));
     io::PrefsManager::setUnsigned("world.sourceWorkThreads", std::max(2, this->perf.sourceThreads));
+    io::PrefsManager::setBool("chunk.greedyMeshing", this->perf.greedyMeshing);
     io::PrefsManager::setUnsigned("world.render.distance", std::max(1, this->perf.renderDist));
     io::PrefsManager::setUnsigned("world.render.cacheRange", std::max(1, this->perf.renderCacheBuffer));
+    io::PrefsManager::setBool("net.compression", this->perf.compressNetwork);
 }
 
 /**
@@ -274,6 +295,11 @@ void PreferencesWindow::drawPerfPane(GameUI *gui) {
     if(ImGui::IsItemHovered()) {
         ImGui::SetTooltip("World source threads read world data and generates new chunks.\nHint: Multiplayer worlds may see performance gains from increasing this value.");
     }
+    // greedy meshing
+    if(ImGui::Checkbox("Merge Block Faces", &this->perf.greedyMeshing)) dirty = true;
+    if(ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Draws adjacent faces of identical blocks as a single surface, which greatly reduces the amount of geometry to draw.\nHint: Changes take effect after restarting the game.");
+    }
 
     ImGui::Dummy(ImVec2(8, 0));
     // render distance
@@ -286,6 +312,13 @@ void PreferencesWindow::drawPerfPane(GameUI *gui) {
     if(ImGui::IsItemHovered()) {
         ImGui::SetTooltip("Added to the render distance to calculate the maximum distance a chunk can be from the player before it is evicted from caches.\nHint: Increase this value if your machine has plenty available RAM.");
     }
+
+    ImGui::Dummy(ImVec2(8, 0));
+    // network compression
+    if(ImGui::Checkbox("Compress Network Traffic", &this->perf.compressNetwork)) dirty = true;
+    if(ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Compresses traffic to and from multiplayer servers that support it.\nHint: Leave this enabled on metered or slow connections. Changes take effect the next time you connect.");
+    }
     // save if needed
     if(dirty) {
         this->savePerfPaneState();
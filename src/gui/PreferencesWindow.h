@@ -37,16 +37,22 @@ class PreferencesWindow: public GameWindow {
             this->gfx.fancySky = false;
             this->gfx.dirShadows = false;
             this->gfx.ssao = false;
+            this->gfx.bakedOcclusion = true;
+            this->gfx.bakedOcclusionReplacesSsao = true;
         }
         void loadGfxPresetMedium() {
             this->gfx.fancySky = true;
             // this->gfx.dirShadows = true;
             this->gfx.ssao = false;
+            this->gfx.bakedOcclusion = true;
+            this->gfx.bakedOcclusionReplacesSsao = true;
         }
         void loadGfxPresetHigh() {
             this->gfx.fancySky = true;
             // this->gfx.dirShadows = true;
             this->gfx.ssao = true;
+            this->gfx.bakedOcclusion = true;
+            this->gfx.bakedOcclusionReplacesSsao = false;
         }
         void loadGfxPresetUltra() {
             // TODO: make this its own thing
@@ -86,6 +92,10 @@ class PreferencesWindow: public GameWindow {
             bool fancySky;
             bool dirShadows;
             bool ssao;
+            // whether ambient occlusion is computed for block corners when meshing chunks
+            bool bakedOcclusion;
+            // whether SSAO is skipped if ambient occlusion is baked
+            bool bakedOcclusionReplacesSsao;
 
             float gamma;
             // field of view (degrees)
@@ -100,11 +110,16 @@ class PreferencesWindow: public GameWindow {
             int drawThreads = 0;
             // world source threads
             int sourceThreads = 0;
+            // whether faces of adjacent blocks are merged when drawing chunks
+            bool greedyMeshing = false;
 
             // render distance (in chunks)
             int renderDist = 0;
             // how many chunks outside render distance to keep in cache
             int renderCacheBuffer = 0;
+
+            // whether to compress traffic to servers that support it
+            bool compressNetwork = true;
         } perf;
 };
 }
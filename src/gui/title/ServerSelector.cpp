@@ -780,7 +780,9 @@ void ServerSelector::workerMain() {
             const auto req = std::get<ConnectionReq>(i);
 
             try {
-                auto server = std::make_shared<net::ServerConnection>(req.host);
+                const bool compress = io::PrefsManager::getBool("net.compression", true);
+                auto server = std::make_shared<net::ServerConnection>(req.host, "default",
+                        compress);
 
                 // authenticate
                 this->connStage = ConnectionStage::Authenticating;
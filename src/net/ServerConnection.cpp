@@ -16,6 +16,7 @@
 #include <io/PathHelper.h>
 #include <util/Thread.h>
 #include <util/Math.h>
+#include <net/Framing.h>
 #include <net/PacketTypes.h>
 
 #include <sys/types.h>
@@ -27,6 +28,8 @@
 
 #include <tls.h>
 
+#include <cctype>
+#include <chrono>
 #include <cstring>
 #include <regex>
 #include <sstream>
@@ -48,8 +51,13 @@ const static std::regex kPortRegex("^([^:]+)(?::)(\\d+)");
  *
  * @param host Address or DNS name of the server. The port may be specified as in "host:port" if
  * not using the default.
+ * @param sessionTag Distinguishes saved TLS sessions for the same server, so several connections
+ * from one process don't resume each other's sessions. An empty tag disables session resumption.
+ * @param compress Whether to offer compressing the connection; the server decides whether it's
+ * actually used.
  */
-ServerConnection::ServerConnection(const std::string &_host) : host(_host) {
+ServerConnection::ServerConnection(const std::string &_host, const std::string &sessionTag,
+        const bool compress) : host(_host) {
     int err;
 
     // resolve hostname and connect a socket
@@ -63,7 +71,18 @@ ServerConnection::ServerConnection(const std::string &_host) : host(_host) {
     auto config = tls_config_new();
     XASSERT(config, "Failed to allocate TLS config");
 
-    this->buildTlsConfig(config);
+    this->buildTlsConfig(config, compress);
+
+    if(!sessionTag.empty()) {
+        this->openSessionFile(sessionTag);
+
+        if(this->sessionFd != -1) {
+            err = tls_config_set_session_fd(config, this->sessionFd);
+            if(err) {
+                Logging::warn("Failed to set TLS session file: {}", tls_config_error(config));
+            }
+        }
+    }
 
 #ifndef NDEBUG
     if(host.rfind("localhost", 0) == 0 || host.rfind("127.0.0.1", 0) == 0 ||
@@ -86,6 +105,8 @@ ServerConnection::ServerConnection(const std::string &_host) : host(_host) {
     }
 
     // complete TLS handshake
+    const auto handshakeStart = std::chrono::steady_clock::now();
+
     shakeAgain:;
     err = tls_handshake(this->client);
     if(err) {
@@ -93,6 +114,20 @@ ServerConnection::ServerConnection(const std::string &_host) : host(_host) {
         throw std::runtime_error(f("TLS handshake failed: {}", tls_error(this->client)));
     }
 
+    this->handshakeTime = std::chrono::steady_clock::now() - handshakeStart;
+    this->sessionResumed = (tls_conn_session_resumed(this->client) == 1);
+
+    Logging::debug("TLS handshake with {} took {} ms (resumed: {})", _host,
+            std::chrono::duration<double, std::milli>(this->handshakeTime).count(),
+            this->sessionResumed);
+
+    // set up compression if the server agreed to it
+    const auto alpn = tls_conn_alpn_selected(this->client);
+    if(alpn && !strcmp(alpn, kProtocolNameCompressed)) {
+        this->compression = std::make_unique<util::LZ4Stream>();
+        this->compressedIn.resize(kCompressedReadSize);
+    }
+
     // set up notification pipe. the read end is non-blocking
     err = pipe(this->notePipe);
     XASSERT(!err, "Failed to create notification pipe: {}", strerror(errno));
@@ -209,22 +244,54 @@ void ServerConnection::connect(const std::string &host, std::string &servname) {
     this->socket = sock;
 }
 
+/**
+ * Opens the file the TLS session for this server is stored in. libtls reads the session from it
+ * before the handshake, and writes the new session (or ticket) into it afterwards, so the next
+ * connection can skip the full handshake.
+ */
+void ServerConnection::openSessionFile(const std::string &tag) {
+    // build a file name safe string from the host and tag
+    std::string name = f("tls-session-{}-{}", this->host, tag);
+    for(auto &c : name) {
+        if(!isalnum(c) && c != '-' && c != '_' && c != '.') {
+            c = '_';
+        }
+    }
+
+    const auto path = io::PathHelper::cacheDir() + "/" + name;
+
+    // the file holds key material, so only we may read it
+    this->sessionFd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(this->sessionFd == -1) {
+        Logging::warn("Failed to open TLS session file '{}': {}", path, strerror(errno));
+    }
+}
+
 /**
  * Fills in a server TLS configuration.
  */
-void ServerConnection::buildTlsConfig(struct tls_config *cfg) {
+void ServerConnection::buildTlsConfig(struct tls_config *cfg, const bool compress) {
     int err;
 
-    // Use TLSv1.3 only for release; debug use 1.2 to allow decrypting
+    /*
+     * Release builds allow TLSv1.2 and 1.3; debug use 1.2 only to allow decrypting. libtls can
+     * only resume TLS 1.2 sessions, so the session file only saves a handshake when the server
+     * negotiates 1.2.
+     */
 #ifdef NDEBUG
-    err = tls_config_set_protocols(cfg, TLS_PROTOCOL_TLSv1_3);
+    err = tls_config_set_protocols(cfg, TLS_PROTOCOL_TLSv1_2 | TLS_PROTOCOL_TLSv1_3);
 #else
     err = tls_config_set_protocols(cfg, TLS_PROTOCOL_TLSv1_2);
 #endif
     XASSERT(err == 0, "tls_config_set_protocols() failed: {}", tls_config_error(cfg));
 
-    // cubeland protocol
-    err = tls_config_set_alpn(cfg, "cubeland/1.0");
+    // cubeland protocol; the server picks the compressed variant if we offer it
+    std::string alpn = kProtocolName;
+    if(compress) {
+        alpn = f("{},{}", kProtocolNameCompressed, kProtocolName);
+    }
+
+    err = tls_config_set_alpn(cfg, alpn.c_str());
     XASSERT(err == 0, "tls_config_set_alpn() failed: {}", tls_config_error(cfg));
 
     // use secure ciphers only
@@ -275,6 +342,10 @@ ServerConnection::~ServerConnection() {
     ::close(this->notePipe[1]);
 
     ::close(this->socket);
+
+    if(this->sessionFd != -1) {
+        ::close(this->sessionFd);
+    }
 }
 
 
@@ -302,10 +373,11 @@ void ServerConnection::workerMain() {
             pfd[1].fd = this->socket;
             pfd[1].events = POLLIN;
 
-            // block on the client socket and notification pipe
-            err = poll(pfd, 2, -1);
+            // block on the client socket and notification pipe, unless we've got data buffered
+            const bool buffered = this->compression && this->compression->available();
+            err = poll(pfd, 2, buffered ? 0 : -1);
 
-            if(err == 0) continue; // timeout expired
+            if(err == 0 && !buffered) continue; // timeout expired
             else if(err == -1) {
                 throw std::runtime_error(f("poll() failed: {}", strerror(errno)));
             }
@@ -334,12 +406,15 @@ void ServerConnection::workerMain() {
                     this->workerHandleEvent(d);
                     yenpipePending = false;
                 } while(err > 0);
+
+                // write all packets compressed while handling the events at once
+                this->flushStream();
             }
 
             // try to read packet header
-            if(pfd[1].revents & POLLIN) {
+            if(pfd[1].revents & POLLIN || buffered) {
 readAgain:;
-                err = tls_read(this->client, &hdr, sizeof(hdr));
+                err = this->readStream(&hdr, sizeof(hdr));
                 if(err == TLS_WANT_POLLIN) {
                     goto readAgain;
                 } else if(err == TLS_WANT_POLLOUT) {
@@ -357,8 +432,7 @@ readAgain:;
                 }
 
                 // handle the message
-                hdr.length = ntohs(hdr.length);
-                hdr.tag = ntohs(hdr.tag);
+                FrameHeaderToHost(hdr);
                 this->workerHandleMessage(hdr);
             }
 
@@ -392,25 +466,18 @@ void ServerConnection::workerHandleEvent(const PipeData &evt) {
             XASSERT(evt.payload && evt.payloadLen, "Invalid payload {} len {}",
                     (void *) evt.payload, evt.payloadLen);
 
-            size_t len = evt.payloadLen;
-            auto buf = evt.payload;
-
-            while(len > 0) {
-                int err;
-                err = tls_write(this->client, buf, len);
-
-                if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
-                    continue;
-                } else if(err == -1) {
-                    throw std::runtime_error(f("tls_write() failed: {}", tls_error(this->client)));
-                }
-
-                buf += err;
-                len -= err;
+            if(this->compression) {
+                this->compression->compress(evt.payload, evt.payloadLen, this->compressedOut);
+            } else {
+                this->writeStream(evt.payload, evt.payloadLen);
             }
 
             // clean up the payload
-            delete[] evt.payload;
+            if(evt.packetBuffer) {
+                ReleasePacketBuffer(evt.packetBuffer);
+            } else {
+                delete[] evt.payload;
+            }
             break;
         }
 
@@ -419,6 +486,73 @@ void ServerConnection::workerHandleEvent(const PipeData &evt) {
     }
 }
 
+/**
+ * Reads from the connection, decompressing the data if compression is enabled.
+ *
+ * Without compression, this is just tls_read(). With compression, we keep reading from the
+ * connection until the requested number of bytes has been decompressed.
+ *
+ * @return Number of bytes read, 0 if the connection was closed, or a TLS error code
+ */
+int ServerConnection::readStream(void *out, const size_t outLen) {
+    if(!this->compression) {
+        return tls_read(this->client, out, outLen);
+    }
+
+    auto outPtr = reinterpret_cast<std::byte *>(out);
+    size_t copied = 0;
+
+    while(true) {
+        copied += this->compression->read(outPtr + copied, outLen - copied);
+        if(copied == outLen) break;
+
+        // get more data from the connection
+        const auto err = tls_read(this->client, this->compressedIn.data(),
+                this->compressedIn.size());
+        if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
+            continue;
+        } else if(err <= 0) {
+            return err;
+        }
+
+        this->compression->decompress(this->compressedIn.data(), err);
+    }
+
+    return outLen;
+}
+
+/**
+ * Writes the given data to the connection as-is.
+ */
+void ServerConnection::writeStream(const void *data, const size_t dataLen) {
+    auto buf = reinterpret_cast<const std::byte *>(data);
+    size_t len = dataLen;
+
+    while(len > 0) {
+        int err;
+        err = tls_write(this->client, buf, len);
+
+        if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
+            continue;
+        } else if(err == -1) {
+            throw std::runtime_error(f("tls_write() failed: {}", tls_error(this->client)));
+        }
+
+        buf += err;
+        len -= err;
+    }
+}
+
+/**
+ * Writes all compressed packets that have accumulated since the last flush.
+ */
+void ServerConnection::flushStream() {
+    if(this->compressedOut.empty()) return;
+
+    this->writeStream(this->compressedOut.data(), this->compressedOut.size());
+    this->compressedOut.clear();
+}
+
 /**
  * Sends a event through the yenpipe.
  */
@@ -432,51 +566,81 @@ void ServerConnection::sendPipeData(const PipeData &d) {
 
 
 /**
- * Handles a message received from the server
+ * Reads exactly the given number of bytes from the connection.
  */
-void ServerConnection::workerHandleMessage(const PacketHeader &header) {
-   int err;
-
-    // read the remainder of the packet
-    std::vector<std::byte> buffer;
+void ServerConnection::readExactly(void *out, const size_t len) {
+    int err;
 
-    if(header.length) {
-        buffer.resize(header.length * 4);
+    auto writePtr = reinterpret_cast<std::byte *>(out);
+    size_t toRead = len;
 
-        auto writePtr = buffer.data();
-        size_t toRead = buffer.size();
+    while(toRead > 0) {
+        err = this->readStream(writePtr, toRead);
+        if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
+            continue;
+        }
+        else if(err == -1) {
+            throw std::runtime_error(f("tls_read() failed: {}", tls_error(this->client)));
+        } else if(err == 0) {
+            throw std::runtime_error("Connection closed");
+        }
 
-        while(toRead > 0) {
-            err = tls_read(this->client, writePtr, toRead);
-            if(err == TLS_WANT_POLLIN || err == TLS_WANT_POLLOUT) {
-                continue;
-            }
-            else if(err == -1) {
-                throw std::runtime_error(f("tls_read() failed: {}", tls_error(this->client)));
-            } else if(err == 0) {
-                throw std::runtime_error("Connection closed");
-            }
+        writePtr += err;
+        toRead -= err;
+    }
+}
 
-            writePtr += err;
-            toRead -= err;
+/**
+ * Handles a received message.
+ *
+ * Its payload is read into a buffer from the pool; if it's split over several frames, the
+ * payloads of the continuation frames are appended to it. Handlers receive the header of the
+ * first frame, but the payload of the entire packet.
+ */
+void ServerConnection::workerHandleMessage(const PacketHeader &header) {
+    auto buffer = this->receiveBuffers.get(header.length * 4);
+    PacketHeader frame = header;
+    size_t numFrames = 1;
+
+    while(true) {
+        const auto offset = buffer->size();
+        buffer->resize(offset + (frame.length * 4));
+        this->readExactly(buffer->data() + offset, frame.length * 4);
+
+        if(!(frame.flags & kPacketFlagContinued)) break;
+
+        // read the next frame's header; it must continue the same packet
+        this->readExactly(&frame, sizeof(frame));
+        FrameHeaderToHost(frame);
+        numFrames++;
+
+        if(frame.endpoint != header.endpoint || frame.type != header.type ||
+                frame.tag != header.tag) {
+            throw std::runtime_error(f("Frame {:02x}:{:02x} (tag {}) interrupts packet {:02x}:{:02x} (tag {})",
+                    frame.endpoint, frame.type, frame.tag, header.endpoint, header.type,
+                    header.tag));
+        } else if(buffer->size() + (frame.length * 4) > kMaxPacketSize) {
+            throw std::runtime_error(f("Packet {:02x}:{:02x} exceeds maximum size after {} frames",
+                    header.endpoint, header.type, numFrames));
         }
     }
 
 #if LOG_PACKETS
-    Logging::trace("Received packet {:02x}:{:02x} length {}: payload {}", header.endpoint,
-            header.type, header.length, hexdump(buffer.begin(), buffer.end()));
+    Logging::trace("Received packet {:02x}:{:02x} length {} ({} frames): payload {}",
+            header.endpoint, header.type, buffer->size(), numFrames,
+            hexdump(buffer->begin(), buffer->end()));
 #endif
 
     // invoke the appropriate handler
     for(auto &handler : this->handlers) {
         if(handler->canHandlePacket(header)) {
-            handler->handlePacket(header, buffer.data(), buffer.size());
+            handler->handlePacket(header, buffer->data(), buffer->size());
             return;
         }
     }
 
     Logging::warn("Unhandled packet ({}) {:02x}:{:02x} length {}: payload {}", this->host,
-            header.endpoint, header.type, header.length, hexdump(buffer.begin(), buffer.end()));
+            header.endpoint, header.type, buffer->size(), hexdump(buffer->begin(), buffer->end()));
 }
 
 /**
@@ -511,7 +675,8 @@ bool ServerConnection::authenticate() {
 
 
 /**
- * Builds a valid packet header for the packet, then sends it. The payload is copied.
+ * Builds a valid packet header for the packet, then sends it. The payload is copied; if it is
+ * too large for a single frame, it is split over several continuation frames.
  *
  * @return Tag of the packet. You may specify the tag manually, or generate one automagically
  */
@@ -525,33 +690,49 @@ again:;
         if(!tag) goto again;
     }
 
-    // allocate memory
-    size_t reqPacketSize = sizeof(PacketHeader) + dataLen;
-    if(reqPacketSize & 0x3) {
-        reqPacketSize += 4 - (reqPacketSize & 0x3);
-    }
+    // build the frames and send them
+    size_t packetSize;
+    auto buf = BuildFrames(ep, type, tag, data, dataLen, packetSize);
 
-    auto buf = new std::byte[reqPacketSize];
-    memset(buf, 0, reqPacketSize);
+    PipeData pd(PipeEvent::SendPacket);
+    pd.payload = buf;
+    pd.payloadLen = packetSize;
+    this->sendPipeData(pd);
 
-    // construct header
-    auto hdr = reinterpret_cast<PacketHeader *>(buf);
-    hdr->endpoint = ep;
-    hdr->type = type;
-    hdr->length = IntCeil(dataLen, 4);
+    // clean up
+    return tag;
+}
 
-    memcpy(hdr->payload, data, dataLen);
+/**
+ * Sends a packet that was serialized into a packet buffer (obtained from `GetPacketBuffer()`.) Its
+ * header is filled in place, and the buffer is handed to the worker thread as-is; it goes back to
+ * the pool once written.
+ *
+ * Packets too large for a single frame are split into continuation frames, which copies them.
+ */
+uint16_t ServerConnection::writePacket(const uint8_t ep, const uint8_t type, PacketBuffer &&packet,
+        const uint16_t _tag) {
+    const auto payloadLen = packet->size() - sizeof(PacketHeader);
+    if(payloadLen > kMaxFramePayload) {
+        return this->writePacket(ep, type, packet->data() + sizeof(PacketHeader), payloadLen, _tag);
+    }
 
-    // send it
-    hdr->tag = htons(tag);
-    hdr->length = htons(hdr->length);
+    // get the real tag to apply to the packet
+    auto tag = _tag;
+    if(!tag) {
+again:;
+        tag = this->nextTag++;
+        if(!tag) goto again;
+    }
+
+    FinishPacketBuffer(*packet, ep, type, tag);
 
     PipeData pd(PipeEvent::SendPacket);
-    pd.payload = buf;
-    pd.payloadLen = reqPacketSize;
+    pd.payload = packet->data();
+    pd.payloadLen = packet->size();
+    pd.packetBuffer = packet.release();
     this->sendPipeData(pd);
 
-    // clean up
     return tag;
 }
 
@@ -590,18 +771,29 @@ std::future<std::optional<std::vector<std::byte>>> ServerConnection::getWorldInf
 }
 
 /**
- * Requests full chunk data for the given chunk.
+ * Requests chunk data for the given chunk. If a cached copy is provided, only the slices that
+ * changed since it was cached are transferred.
  */
-std::future<std::shared_ptr<world::Chunk>> ServerConnection::getChunk(const glm::ivec2 &pos) {
+std::future<std::shared_ptr<world::Chunk>> ServerConnection::getChunk(const glm::ivec2 &pos,
+        const std::shared_ptr<world::Chunk> &cached) {
     // make request
-    return this->chonker->get(pos);
+    return this->chonker->get(pos, cached);
+}
+
+/**
+ * Cancels a chunk request.
+ */
+void ServerConnection::cancelChunk(const glm::ivec2 &pos) {
+    this->chonker->cancel(pos);
 }
 
 /**
- * Sends a player position update.
+ * Sends a player position update. Since chunk requests are prioritized by their position relative
+ * to the player, this also updates the priority of any outstanding requests.
  */
 void ServerConnection::sendPlayerPosUpdate(const glm::vec3 &pos, const glm::vec3 &angle) {
     this->movement->positionChanged(pos, angle);
+    this->chonker->updatePriorities();
 }
 
 /**
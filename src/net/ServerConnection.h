@@ -5,6 +5,7 @@
 #include "handlers/Auth.h"
 
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <future>
 #include <memory>
@@ -16,6 +17,9 @@
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
+#include <net/Framing.h>
+#include <util/BufferPool.h>
+#include <util/LZ4Stream.h>
 #include <util/ThreadPool.h>
 
 struct tls;
@@ -53,10 +57,29 @@ class ServerConnection {
         constexpr static uint16_t kDefaultPort = 47420;
 
     public:
-        ServerConnection(const std::string &host);
+        ServerConnection(const std::string &host, const std::string &sessionTag = "default",
+                const bool compress = true);
         ~ServerConnection();
 
         void close();
+
+        /// Whether the TLS handshake resumed an earlier session
+        const bool wasSessionResumed() const {
+            return this->sessionResumed;
+        }
+        /// Whether the connection is compressed
+        const bool isCompressed() const {
+            return !!this->compression;
+        }
+        /// How long the TLS handshake took
+        const std::chrono::steady_clock::duration getHandshakeTime() const {
+            return this->handshakeTime;
+        }
+
+        /// Authenticates as a different player than the one the auth manager holds keys for
+        void setIdentity(const handler::Auth::Identity &identity) {
+            this->auth->setIdentity(identity);
+        }
         bool authenticate();
 
         uint16_t writePacket(const uint8_t ep, const uint8_t type, const std::string &payload,
@@ -70,6 +93,8 @@ class ServerConnection {
 
         /// builds a packet by prepending a header to the specified body
         uint16_t writePacket(const uint8_t ep, const uint8_t type, const void *data, const size_t dataLen, const uint16_t tag = 0);
+        /// sends a packet serialized into a packet buffer, without copying it
+        uint16_t writePacket(const uint8_t ep, const uint8_t type, net::PacketBuffer &&packet, const uint16_t tag = 0);
 
         /// Reads a player info key.
         std::future<std::optional<std::vector<std::byte>>> getPlayerInfo(const std::string &key);
@@ -79,8 +104,11 @@ class ServerConnection {
         /// Reads a world info key
         std::future<std::optional<std::vector<std::byte>>> getWorldInfo(const std::string &key);
 
-        /// Reads a chunk
-        std::future<std::shared_ptr<world::Chunk>> getChunk(const glm::ivec2 &pos);
+        /// Reads a chunk, optionally updating a cached copy of it
+        std::future<std::shared_ptr<world::Chunk>> getChunk(const glm::ivec2 &pos,
+                const std::shared_ptr<world::Chunk> &cached = nullptr);
+        /// Cancels an outstanding chunk request
+        void cancelChunk(const glm::ivec2 &pos);
 
         /// Sends a player position update packet
         void sendPlayerPosUpdate(const glm::vec3 &pos, const glm::vec3 &angle);
@@ -99,6 +127,11 @@ class ServerConnection {
         util::ThreadPool<std::function<void(void)>> *getWorkPool() {
             return this->pool;
         }
+        /// player movement handler
+        handler::PlayerMovement *getMovement() {
+            return this->movement;
+        }
+
         /// sets the reference to the work pool
         void setWorkPool(util::ThreadPool<std::function<void(void)>> *newPool) {
             this->pool = newPool;
@@ -122,6 +155,11 @@ class ServerConnection {
         }
 
     private:
+        /// Maximum amount of compressed data read from the connection at once
+        constexpr static const size_t kCompressedReadSize = 16 * 1024;
+        /// Receive buffers larger than this are freed after use rather than kept around
+        constexpr static const size_t kReceiveBufferRetainSize = 4 * 1024 * 1024;
+
         enum class PipeEvent: uint8_t {
             // do nothing
             NoOp,
@@ -138,6 +176,8 @@ class ServerConnection {
             std::byte *payload = nullptr;
             /// length of payload
             size_t payloadLen = 0;
+            /// if set, the payload lives in this packet buffer, which is returned to the pool
+            std::vector<std::byte> *packetBuffer = nullptr;
 
             PipeData() = default;
             PipeData(const PipeEvent _type) : type(_type) {}
@@ -147,11 +187,17 @@ class ServerConnection {
         int notePipe[2] = {-1, -1};
 
     private:
-        void buildTlsConfig(struct tls_config *);
+        void buildTlsConfig(struct tls_config *, const bool compress);
         void connect(const std::string &connectTo, std::string &servname);
+        void openSessionFile(const std::string &tag);
 
         void workerMain();
         void workerHandleEvent(const PipeData &);
+
+        int readStream(void *, const size_t);
+        void readExactly(void *, const size_t);
+        void writeStream(const void *, const size_t);
+        void flushStream();
         void workerHandleMessage(const PacketHeader &);
 
         void sendPipeData(const PipeData &);
@@ -164,6 +210,22 @@ class ServerConnection {
         int socket = -1;
         /// client connection
         struct tls *client = nullptr;
+        /// file holding the TLS session, for resuming it on the next connection; -1 if disabled
+        int sessionFd = -1;
+        /// whether the handshake resumed a session
+        bool sessionResumed = false;
+        /// duration of the TLS handshake
+        std::chrono::steady_clock::duration handshakeTime;
+
+        /// compresses the connection, if negotiated during the handshake
+        std::unique_ptr<util::LZ4Stream> compression;
+        /// compressed packets waiting to be written
+        std::vector<std::byte> compressedOut;
+        /// buffer for compressed data read from the connection
+        std::vector<std::byte> compressedIn;
+
+        /// buffers for received packets; we only ever need one at a time
+        util::BufferPool receiveBuffers{1, kReceiveBufferRetainSize};
 
         std::atomic_bool workerRun;
         std::unique_ptr<std::thread> worker;
@@ -5,17 +5,16 @@
 #include "io/PrefsManager.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPAuth.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 #include <util/Signature.h>
 
 #include <openssl/rand.h>
-#include <cereal/archives/portable_binary.hpp>
-
 #include <cstdlib>
-#include <sstream>
 
 using namespace net::handler;
 using namespace net::message;
@@ -105,11 +104,10 @@ void Auth::handlePacket(const PacketHeader &header, const void *payload, const s
  */
 void Auth::handleAuthChallenge(const PacketHeader &header, const void *payload,
         const size_t payloadLen) {
-    std::stringstream oStream;
+    auto packet = net::GetPacketBuffer();
 
     // deserialize challenge
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     AuthChallenge challenge;
     iArc(challenge);
@@ -118,17 +116,21 @@ void Auth::handleAuthChallenge(const PacketHeader &header, const void *payload,
     const auto &random = challenge.challenge;
     std::vector<std::byte> signature;
 
-    web::AuthManager::sign(random.data(), random.size(), signature);
+    if(this->identity) {
+        util::Signature::sign(this->identity->key, random.data(), random.size(), signature);
+    } else {
+        web::AuthManager::sign(random.data(), random.size(), signature);
+    }
 
     // build response packet and send it
     AuthChallengeReply reply(signature);
 
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    io::BufferOutputArchive oArc(*packet);
     oArc(reply);
 
     this->setState(State::WaitAuth);
     this->expectedTag = this->server->writePacket(kEndpointAuthentication, kAuthChallengeReply,
-            oStream.str());
+            std::move(packet));
 }
 
 /**
@@ -138,8 +140,7 @@ void Auth::handleAuthChallenge(const PacketHeader &header, const void *payload,
 void Auth::handleAuthStatus(const PacketHeader &header, const void *payload,
         const size_t payloadLen) {
     // deserialize status
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     AuthStatus status;
     iArc(status);
@@ -192,20 +193,25 @@ void Auth::setState(const State newState) {
 void Auth::beginAuth() {
     XASSERT(this->state == State::Idle, "Invalid state: {}", this->state);
 
-    std::stringstream stream;
+    auto packet = net::GetPacketBuffer();
 
     // build the auth request packet
-    net::message::AuthRequest req(web::AuthManager::getPlayerId());
+    const auto id = this->identity ? this->identity->id : web::AuthManager::getPlayerId();
+    net::message::AuthRequest req(id);
 
-    req.displayName = io::PrefsManager::getString("auth.displayName", "Mystery Player");
+    if(this->identity) {
+        req.displayName = this->identity->displayName;
+    } else {
+        req.displayName = io::PrefsManager::getString("auth.displayName", "Mystery Player");
+    }
 
-    cereal::PortableBinaryOutputArchive arc(stream);
+    io::BufferOutputArchive arc(*packet);
     arc(req);
 
     // send it
     this->setState(State::SolveChallenge);
     this->expectedTag = this->server->writePacket(kEndpointAuthentication, kAuthRequest,
-            stream.str());
+            std::move(packet));
 }
 
 /**
@@ -235,14 +241,14 @@ std::future<std::vector<Auth::Player>> Auth::getConnectedPlayers(const bool want
 
     req.includeAddress = wantClientAddr;
 
-    std::stringstream stream;
-    cereal::PortableBinaryOutputArchive arc(stream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive arc(*packet);
     arc(req);
 
     // send it and save the promise
     std::lock_guard<std::mutex> lg(this->requestsLock);
     const auto tag = this->server->writePacket(kEndpointAuthentication, kAuthGetConnected,
-            stream.str());
+            std::move(packet));
     this->requests[tag] = std::move(prom);
 
     return future;
@@ -254,8 +260,7 @@ std::future<std::vector<Auth::Player>> Auth::getConnectedPlayers(const bool want
 void Auth::connectedReply(const PacketHeader &hdr, const void *payload, const size_t payloadLen) {
     try {
         // deserialize message
-        std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-        cereal::PortableBinaryInputArchive iArc(stream);
+        io::SpanInputArchive iArc(payload, payloadLen);
 
         AuthGetUsersReply reply;
         iArc(reply);
@@ -10,11 +10,14 @@
 #include <future>
 #include <mutex>
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include <uuid.h>
 
+struct evp_pkey_st;
+
 namespace net::handler {
 /**
  * Handles authenticating the client.
@@ -37,6 +40,18 @@ class Auth: public PacketHandler {
             std::optional<std::string> remoteAddr;
         };
 
+        /**
+         * Identity to authenticate as, instead of the one owned by the auth manager. This lets
+         * several connections in the same process log in as different players.
+         */
+        struct Identity {
+            uuids::uuid id;
+            std::string displayName;
+
+            /// private key used to sign the auth challenge; this is owned by the caller
+            evp_pkey_st *key = nullptr;
+        };
+
     public:
         Auth(ServerConnection *_server);
         virtual ~Auth();
@@ -45,6 +60,11 @@ class Auth: public PacketHandler {
         void handlePacket(const PacketHeader &header, const void *payload,
                 const size_t payloadLen) override;
 
+        /// overrides the identity used to authenticate; must be set before beginning auth
+        void setIdentity(const Identity &identity) {
+            this->identity = identity;
+        }
+
         void beginAuth();
 
         /// wait for auth to complete. return success state
@@ -91,6 +111,9 @@ class Auth: public PacketHandler {
         /// tag of the message we expect to receive next
         uint16_t expectedTag;
 
+        /// if set, the identity to use instead of the auth manager's
+        std::optional<Identity> identity;
+
         /// lock over the promises list
         std::mutex requestsLock;
         /// outstanding requests
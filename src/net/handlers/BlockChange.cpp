@@ -4,15 +4,14 @@
 #include <world/block/BlockIds.h>
 #include <world/chunk/Chunk.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPBlockChange.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -61,8 +60,7 @@ void BlockChange::handlePacket(const PacketHeader &header, const void *payload,
  */
 void BlockChange::updateChunks(const PacketHeader &, const void *payload, const size_t payloadLen) {
     // deserialize the message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     BlockChangeBroadcast broad;
     iArc(broad);
@@ -105,11 +103,11 @@ void BlockChange::chunkChanged(world::Chunk *chunk, const glm::ivec3 &relBlock,
     BlockChangeReport report;
     report.changes.push_back(info);
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(report);
 
-    this->server->writePacket(kEndpointBlockChange, kBlockChangeReport, oStream.str());
+    this->server->writePacket(kEndpointBlockChange, kBlockChangeReport, std::move(packet));
 }
 
 
@@ -153,11 +151,11 @@ void BlockChange::stopChunkNotifications(const std::shared_ptr<world::Chunk> &ch
     BlockChangeUnregister unsub;
     unsub.chunkPos = chunk->worldPos;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(unsub);
 
-    this->server->writePacket(kEndpointBlockChange, kBlockChangeUnregister, oStream.str());
+    this->server->writePacket(kEndpointBlockChange, kBlockChangeUnregister, std::move(packet));
 }
 
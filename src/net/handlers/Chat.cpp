@@ -2,15 +2,14 @@
 #include "net/ServerConnection.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPChat.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -62,8 +61,7 @@ void Chat::handlePacket(const PacketHeader &header, const void *payload, const s
  */
 void Chat::playerJoined(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     // deserialize message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     ChatPlayerJoined joined;
     iArc(joined);
@@ -84,8 +82,7 @@ void Chat::playerJoined(const PacketHeader &header, const void *payload, const s
  */
 void Chat::playerLeft(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     // deserialize message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     ChatPlayerLeft left;
     iArc(left);
@@ -107,8 +104,7 @@ void Chat::playerLeft(const PacketHeader &header, const void *payload, const siz
  */
 void Chat::message(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     // deserialize message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     ChatMessage msg;
     iArc(msg);
@@ -130,9 +126,9 @@ void Chat::message(const PacketHeader &header, const void *payload, const size_t
 void Chat::sendMessage(const std::string &msg) {
     ChatPlayerMessage message(msg);
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
     oArc(message);
 
-    this->server->writePacket(kEndpointChat, kChatPlayerMessage, oStream.str());
+    this->server->writePacket(kEndpointChat, kChatPlayerMessage, std::move(packet));
 }
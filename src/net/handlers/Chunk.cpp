@@ -1,23 +1,26 @@
 #include "Chunk.h"
+#include "ChunkSliceDecoder.h"
+#include "PlayerMovement.h"
 #include "net/ServerConnection.h"
+#include "world/RemoteSource.h"
 
-#include <world/block/BlockIds.h>
 #include <world/chunk/Chunk.h>
 #include <world/chunk/ChunkSlice.h>
 #include <world/WorldSource.h>
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPChunk.h>
-#include <util/LZ4.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
+#include <glm/glm.hpp>
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -33,20 +36,9 @@ ChunkLoader::ChunkLoader(ServerConnection *_server) : PacketHandler(_server) {
 }
 
 /**
- * Notify any pending waits that we're exiting.
+ * Fails all outstanding requests.
  */
 ChunkLoader::~ChunkLoader() {
-    // max out all pending counts
-    {
-        std::lock_guard<std::mutex> lg(this->countsLock);
-
-        for(auto &[pos, count] : this->counts) {
-            count = world::Chunk::kMaxY;
-        }
-
-        this->countsCond.notify_all();
-    }
-
     this->abortAll();
 }
 
@@ -61,6 +53,7 @@ void ChunkLoader::abortAll() {
         promise.set_exception(std::make_exception_ptr(std::runtime_error("Request aborted")));
     }
     this->requests.clear();
+    this->priorities.clear();
 }
 
 
@@ -100,8 +93,12 @@ void ChunkLoader::handlePacket(const PacketHeader &header, const void *payload,
 
 /**
  * Sends a request to the server to get a particular world info key.
+ *
+ * If we have a cached copy of the chunk, its versions are sent along; the server then only sends
+ * the slices that changed, and we update the cached chunk in place.
  */
-std::future<std::shared_ptr<world::Chunk>> ChunkLoader::get(const glm::ivec2 &pos) {
+std::future<std::shared_ptr<world::Chunk>> ChunkLoader::get(const glm::ivec2 &pos,
+        const std::shared_ptr<world::Chunk> &cached) {
     // set up the promise
     std::promise<std::shared_ptr<world::Chunk>> prom;
     auto future = prom.get_future();
@@ -111,236 +108,322 @@ std::future<std::shared_ptr<world::Chunk>> ChunkLoader::get(const glm::ivec2 &po
         return future;
     }
 
+    const auto priority = this->calculatePriority(pos);
+
     {
         std::lock_guard<std::mutex> lg(this->requestsLock);
         XASSERT(!this->requests.contains(pos), "Already waiting for chunk load for {}!", pos);
         this->requests[pos] = std::move(prom);
+        this->priorities[pos] = priority;
     }
 
     // set up initial state
     {
-        std::lock_guard<std::mutex> lg(this->inProgressLock), lg2(this->countsLock);
+        auto transfer = std::make_shared<Transfer>();
 
-        auto chunk = std::make_shared<world::Chunk>();
-        chunk->worldPos = pos;
-        this->inProgress[pos] = chunk;
+        transfer->chunk = cached;
+        if(!transfer->chunk) {
+            transfer->chunk = std::make_shared<world::Chunk>();
+            transfer->chunk->worldPos = pos;
+        }
 
-        this->counts[pos] = 0;
+        std::lock_guard<std::mutex> lg(this->inProgressLock);
+        this->inProgress[pos] = transfer;
     }
 
     // build the request
     ChunkGet request;
     request.chunkPos = pos;
+    request.distance = priority.first;
+    request.viewAlignment = priority.second;
+
+    if(cached) {
+        request.cachedVersion = cached->getVersion();
+
+        for(size_t y = 0; y < world::Chunk::kMaxY; y++) {
+            const auto version = cached->sliceVersions[y].load();
+            if(version == world::Chunk::kVersionGenerated) continue;
+
+            request.cachedSliceVersions[y] = version;
+        }
+    }
 
 #if LOG_CHUNK_REQUESTS
     Logging::trace("Sending request for chunk {}", pos);
 #endif
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(request);
 
     // send it
-    this->server->writePacket(kEndpointChunk, kChunkGet, oStream.str());
+    this->server->writePacket(kEndpointChunk, kChunkGet, std::move(packet));
     return future;
 }
 
 
 /**
- * Handles received slice data
+ * Asks the server to cancel the request for the given chunk. If the server hasn't started sending
+ * it yet, the request's future will throw; otherwise the chunk is delivered as usual.
  */
-void ChunkLoader::handleSlice(const PacketHeader &header, const void *payload, const size_t payloadLen) {
-    // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+void ChunkLoader::cancel(const glm::ivec2 &pos) {
+    {
+        std::lock_guard<std::mutex> lg(this->requestsLock);
+        if(!this->requests.contains(pos)) return;
+    }
 
-    ChunkSliceData data;
-    iArc(data);
+    ChunkCancel request;
+    request.chunkPos = pos;
 
-    // process in background
-    this->server->getWorkPool()->queueWorkItem([&, data] {
-        try {
-            this->process(data);
-        } catch(std::exception &e) {
-            Logging::error("Failed to process slice {} for {}: {}", data.y, data.chunkPos, e.what());
-        }
-    });
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
+
+    oArc(request);
+
+    this->server->writePacket(kEndpointChunk, kChunkCancel, std::move(packet));
 }
 
 /**
- * Worker thread callback for processing a single slice worth of data
+ * Recalculates the priority of all outstanding requests based on the player's current position
+ * and view direction. The server is only told about those that changed significantly.
  */
-void ChunkLoader::process(const ChunkSliceData &data) {
-    PROFILE_SCOPE(ProcessSlice);
+void ChunkLoader::updatePriorities() {
+    std::vector<ChunkGet> updates;
 
-    // get the chunk
-    this->inProgressLock.lock();
-    auto chunk = this->inProgress[data.chunkPos];
-    this->inProgressLock.unlock();
+    {
+        std::lock_guard<std::mutex> lg(this->requestsLock);
 
-    if(!chunk) {
-        Logging::error("Received data for chunk {} (y = {}) but no such chunk found!", data.chunkPos, data.y);
-        return;
-    }
+        for(auto &[pos, current] : this->priorities) {
+            const auto priority = this->calculatePriority(pos);
+            if(priority.first == current.first &&
+                    std::abs(priority.second - current.second) < kAlignmentThreshold) {
+                continue;
+            }
 
-    // reverse the uuid -> uint16_t map
-    std::unordered_map<uint16_t, uuids::uuid> idMap;
-    for(const auto &[uuid, id] : data.typeMap) {
-        idMap[id] = uuid;
-    }
+            current = priority;
 
-    // create or find a suitable ID map
-    int mapId = -1;
+            ChunkGet update;
+            update.chunkPos = pos;
+            update.distance = priority.first;
+            update.viewAlignment = priority.second;
+            update.priorityUpdate = true;
 
-    chunk->sliceIdMapsLock.lock();
+            updates.push_back(update);
+        }
+    }
 
-    /*
-     * Now that we have a set of all of the 16-bit block IDs used by this row, we can use this
-     * to see if we've generated a map containing these 16-bit IDs in our slice struct. This
-     * avoids the need to muck about with UUIDs which is relatively slow.
-     */
-    for(size_t i = 0; i < chunk->sliceIdMaps.size(); i++) {
-        const auto &map = chunk->sliceIdMaps[i];
+    // send them
+    for(const auto &update : updates) {
+        auto packet = net::GetPacketBuffer();
+        io::BufferOutputArchive oArc(*packet);
 
-        for(const auto &[id, uuid] : idMap) {
-            auto found = std::find(map.idMap.begin(), map.idMap.end(), uuid);
-            if(found == map.idMap.end()) goto beach;
-        }
+        oArc(update);
 
-        // this map contains all block IDs, yay
-        mapId = i;
-        // we jump down here if the map does _not_ contain one of the IDs in this row
-beach:;
+        this->server->writePacket(kEndpointChunk, kChunkGet, std::move(packet));
     }
+}
 
-    // failed to find a map; create a new one
-    if(mapId == -1) {
-        // in the first slot, we have the id for air
-        std::array<uuids::uuid, 256> ids;
-        ids[0] = world::kAirBlockId;
-
-        // fill the remaining entries
-        size_t i = 1;
-        for(const auto &[id, uuid] : idMap) {
-            ids[i] = uuid;
-            ++i;
-        }
+/**
+ * Figures out the distance (in chunks) between the player and the given chunk, and how closely
+ * the direction to it lines up with the player's horizontal view direction.
+ */
+ChunkLoader::Priority ChunkLoader::calculatePriority(const glm::ivec2 &pos) {
+    const auto state = this->server->getMovement()->getLastSent();
+    if(!state) return {0, 127};
 
-        // yeet it into the chunk
-        mapId = chunk->sliceIdMaps.size();
+    const auto offset = glm::abs(pos - state->chunk);
+    const uint16_t distance = std::min(std::max(offset.x, offset.y), UINT16_MAX);
+    if(!distance) return {0, 127};
 
-        world::ChunkRowBlockTypeMap yeet;
-        yeet.idMap = ids;
+    // direction towards the center of the chunk
+    const auto playerPos = state->getPosition();
+    const glm::vec2 chunkCenter((pos.x * 256.f) + 128.f, (pos.y * 256.f) + 128.f);
+    const auto toChunk = glm::normalize(chunkCenter - glm::vec2(playerPos.x, playerPos.z));
 
-        chunk->sliceIdMaps.push_back(yeet);
-    }
+    // yaw is about the Y axis, measured from +X towards +Z
+    const auto yaw = glm::radians(state->getAngles().y);
+    const glm::vec2 view(std::cos(yaw), std::sin(yaw));
 
-    chunk->sliceIdMapsLock.unlock();
+    const int8_t alignment = std::lround(glm::dot(toChunk, view) * 127.f);
+    return {distance, alignment};
+}
 
-    // build the reverse map
-    XASSERT(mapId >= 0, "Failed to select map id");
-    std::unordered_map<uint16_t, uint8_t> reverseIdMap;
 
-    const auto &map = chunk->sliceIdMaps[mapId];
-    for(size_t i = 0; i < 256; i++) {
-        const auto uuid = map.idMap[i];
 
-        // air doesn't really have an entry in the typemap the server sent, so special case it
-        if(uuid == world::kAirBlockId) {
-            reverseIdMap[0] = i;
-        } else if(!uuid.is_nil()) {
-            reverseIdMap[data.typeMap.at(uuid)] = i;
-        }
-    }
+/**
+ * Gets the transfer state of the chunk at the given position.
+ *
+ * @return Transfer state, or `nullptr` if the chunk isn't being received
+ */
+std::shared_ptr<ChunkLoader::Transfer> ChunkLoader::getTransfer(const glm::ivec2 &pos) {
+    std::lock_guard<std::mutex> lg(this->inProgressLock);
 
-    // decompress data
-    static thread_local std::unique_ptr<util::LZ4> compressor = nullptr;
-    if(!compressor) {
-        compressor = std::make_unique<util::LZ4>();
+    auto it = this->inProgress.find(pos);
+    if(it == this->inProgress.end()) {
+        return nullptr;
     }
+    return it->second;
+}
 
-    std::vector<uint16_t> grid;
-    grid.resize(256*256, 0);
+/**
+ * Handles received slice data
+ *
+ * The slice takes a reference on the chunk's transfer before it's queued, which is dropped once
+ * it's been decoded (whether successfully or not.) Since the completion message is always received
+ * after all slices, it can never drop the transfer's last reference while slices are pending.
+ */
+void ChunkLoader::handleSlice(const PacketHeader &header, const void *payload, const size_t payloadLen) {
+    // deserialize the request
+    io::SpanInputArchive iArc(payload, payloadLen);
 
-    auto bytes = reinterpret_cast<char *>(grid.data());
-    const size_t numBytes = grid.size() * sizeof(uint16_t);
+    ChunkSliceData data;
+    iArc(data);
 
-    compressor->decompress(data.data.data(), data.data.size(), bytes, numBytes);
+    auto transfer = this->getTransfer(data.chunkPos);
+    if(!transfer) {
+        Logging::error("Received data for chunk {} (y = {}) but no such chunk found!", data.chunkPos, data.y);
+        return;
+    }
 
-    // allocate a slice and fill it in
-    auto slice = new world::ChunkSlice;
+    transfer->outstanding++;
 
-    for(size_t z = 0; z < 256; z++) {
-        const size_t zOff = (z * 256);
+    // process in background
+    this->server->getWorkPool()->queueWorkItem([&, transfer, data] {
+        try {
+            this->process(transfer, data);
+        } catch(std::exception &e) {
+            Logging::error("Failed to process slice {} for {}: {}", data.y, data.chunkPos, e.what());
+        }
 
-        world::ChunkSliceRow *row = nullptr;
+        this->release(transfer);
+    });
+}
 
-        // TODO: decide if we want a sparse row
-        row = chunk->allocRowDense(); 
-        row->typeMap = mapId;
+/**
+ * Worker thread callback for processing a single slice worth of data
+ */
+void ChunkLoader::process(const std::shared_ptr<Transfer> &transfer, const ChunkSliceData &data) {
+    PROFILE_SCOPE(ProcessSlice);
 
-        // fill in each column
-        for(size_t x = 0; x < 256; x++) {
-            row->set(x, reverseIdMap.at(grid[zOff + x]));
-        }
+    auto &chunk = transfer->chunk;
 
-        // store the row
-        slice->rows[z] = row;
+    // decode the block data
+    static thread_local std::unique_ptr<ChunkSliceDecoder> decoder = nullptr;
+    if(!decoder) {
+        decoder = std::make_unique<ChunkSliceDecoder>();
     }
 
-    // write it into the chunk
+    auto slice = decoder->decode(chunk.get(), data);
+
+    // write it into the chunk, replacing any stale cached slice
+    auto old = chunk->slices[data.y];
     chunk->slices[data.y] = slice;
+    chunk->sliceVersions[data.y] = data.version;
+
+    if(old) {
+        delete old;
+    }
 
-    // update counts
-    std::lock_guard<std::mutex> lg(this->countsLock);
-    this->counts[chunk->worldPos]++;
-    this->countsCond.notify_all();
+    transfer->decoded++;
 }
 
 /**
- * Handles a received completion callback. We'll copy out the chunk global metadata and satisfy
- * the promise for the chunk.
+ * Handles a received completion callback. The message is stored in the chunk's transfer, and the
+ * reference the transfer was created with is dropped; if all slices have already been decoded,
+ * the chunk is finished right away.
  */
 void ChunkLoader::handleCompletion(const PacketHeader &header, const void *payload, const size_t payloadLen) {
     // deserialize the request
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     ChunkCompletion comp;
     iArc(comp);
 
+    auto transfer = this->getTransfer(comp.chunkPos);
+    if(!transfer) {
+        Logging::error("Received completion for chunk {} but no such chunk found!", comp.chunkPos);
+        return;
+    }
+
     // send to the work thread pool
-    this->server->getWorkPool()->queueWorkItem([&, comp] {
-        this->process(comp);
+    this->server->getWorkPool()->queueWorkItem([&, transfer, comp] {
+        transfer->completion = comp;
+        this->release(transfer);
     });
 }
 
-void ChunkLoader::process(const ChunkCompletion &comp) {
+/**
+ * Drops a reference on the given transfer, finishing the chunk if it was the last one.
+ */
+void ChunkLoader::release(const std::shared_ptr<Transfer> &transfer) {
+    if(--transfer->outstanding) return;
+
+    try {
+        this->finish(transfer);
+    } catch(std::exception &e) {
+        Logging::error("Failed to finish chunk {}: {}", transfer->chunk->worldPos, e.what());
+    }
+}
+
+/**
+ * Finishes a chunk once all of its slices have been decoded: we'll copy out the chunk global
+ * metadata and satisfy the promise for the chunk.
+ */
+void ChunkLoader::finish(const std::shared_ptr<Transfer> &transfer) {
     PROFILE_SCOPE(FinishChunk);
 
-    // wait on outstanding work
-    std::unique_lock<std::mutex> lk(this->countsLock);
-    this->countsCond.wait(lk, [&]{
-        if(!this->counts.contains(comp.chunkPos)) {
-            throw std::runtime_error("Invalid chunk slices count map");
+    const auto &comp = *transfer->completion;
+    const size_t decoded = transfer->decoded;
+    auto chunk = transfer->chunk;
+
+    {
+        std::lock_guard<std::mutex> lg(this->inProgressLock);
+
+        auto it = this->inProgress.find(comp.chunkPos);
+        if(it != this->inProgress.end() && it->second == transfer) {
+            this->inProgress.erase(it);
         }
+    }
 
-        return (this->counts[comp.chunkPos] >= comp.numSlices);
-    });
+    // the request was cancelled; no slices were sent, so the chunk is untouched
+    if(comp.cancelled) {
+        std::lock_guard<std::mutex> lg(this->requestsLock);
+
+        auto it = this->requests.find(comp.chunkPos);
+        if(it != this->requests.end()) {
+            it->second.set_exception(std::make_exception_ptr(std::runtime_error("Request cancelled")));
+            this->requests.erase(it);
+        }
+        this->priorities.erase(comp.chunkPos);
+        return;
+    }
 
 #if LOG_CHUNK_REQUESTS
-    Logging::trace("Completed chunk {}! Total {} slices", comp.chunkPos, this->counts[comp.chunkPos]);
+    Logging::trace("Completed chunk {}! Total {} slices (unchanged {})", comp.chunkPos,
+            decoded, comp.unchanged);
 #endif
-    this->counts.erase(comp.chunkPos);
+    if(decoded != comp.numSlices) {
+        Logging::warn("Chunk {}: decoded {} slices, but server sent {}", comp.chunkPos, decoded,
+                comp.numSlices);
+    }
 
-    // get the chunk out of the in progress map
-    std::shared_ptr<world::Chunk> chunk;
-    {
-        std::lock_guard<std::mutex> lg(this->inProgressLock);
-        chunk = this->inProgress[comp.chunkPos];
+    /*
+     * Any cached slice whose version doesn't match the server's, and which the server didn't send
+     * us a replacement for, no longer exists on the server.
+     */
+    for(size_t y = 0; y < world::Chunk::kMaxY; y++) {
+        auto version = world::Chunk::kVersionGenerated;
+        if(comp.sliceVersions.contains(y)) {
+            version = comp.sliceVersions.at(y);
+        }
+
+        if(chunk->sliceVersions[y] != version && chunk->slices[y]) {
+            delete chunk->slices[y];
+            chunk->slices[y] = nullptr;
+        }
 
-        this->inProgress.erase(comp.chunkPos);
+        chunk->sliceVersions[y] = version;
     }
 
     // add an observeyboi for changes
@@ -349,7 +432,16 @@ void ChunkLoader::process(const ChunkCompletion &comp) {
     // copy metadata and then satisfy the promise
     chunk->meta = comp.meta;
 
+    if(!comp.unchanged && this->server->getSource()) {
+        this->server->getSource()->cacheChunk(chunk);
+    }
+
     std::lock_guard<std::mutex> lg(this->requestsLock);
-    this->requests[comp.chunkPos].set_value(chunk);
-    this->requests.erase(comp.chunkPos);
+
+    auto it = this->requests.find(comp.chunkPos);
+    if(it != this->requests.end()) {
+        it->second.set_value(chunk);
+        this->requests.erase(it);
+    }
+    this->priorities.erase(comp.chunkPos);
 }
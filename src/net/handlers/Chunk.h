@@ -4,27 +4,24 @@
 #include "net/PacketHandler.h"
 
 #include <atomic>
-#include <condition_variable>
 #include <cstddef>
 #include <future>
 #include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <glm/vec2.hpp>
 #include <glm/gtx/hash.hpp>
 
+#include <net/EPChunk.h>
+
 namespace world {
 struct Chunk;
 }
 
-namespace net::message {
-struct ChunkSliceData;
-struct ChunkCompletion;
-}
-
 namespace net::handler {
 
 class ChunkLoader: public PacketHandler {
@@ -36,36 +33,65 @@ class ChunkLoader: public PacketHandler {
         void handlePacket(const PacketHeader &header, const void *payload,
                 const size_t payloadLen) override;
 
-        std::future<std::shared_ptr<world::Chunk>> get(const glm::ivec2 &pos);
+        std::future<std::shared_ptr<world::Chunk>> get(const glm::ivec2 &pos,
+                const std::shared_ptr<world::Chunk> &cached = nullptr);
+
+        void cancel(const glm::ivec2 &pos);
+        void updatePriorities();
 
         void abortAll();
 
     private:
+        /// distance and view alignment of a request, as sent to the server
+        using Priority = std::pair<uint16_t, int8_t>;
+
+        /// minimum change in view alignment before we'll send a priority update
+        constexpr static const int kAlignmentThreshold = 32;
+
+        /**
+         * State of a chunk that's being received.
+         *
+         * The outstanding count holds one reference for each slice that's still being decoded,
+         * plus one that's dropped once the completion message has been processed. Whichever of
+         * these drops the last reference finishes the chunk, so no thread ever waits on another.
+         */
+        struct Transfer {
+            /// chunk that slices are decoded into
+            std::shared_ptr<world::Chunk> chunk;
+            /// number of references on the transfer
+            std::atomic_size_t outstanding = 1;
+            /// number of slices that were decoded
+            std::atomic_size_t decoded = 0;
+
+            /// completion message; set before its reference is dropped
+            std::optional<message::ChunkCompletion> completion;
+        };
+
+    private:
+        Priority calculatePriority(const glm::ivec2 &pos);
+
+        std::shared_ptr<Transfer> getTransfer(const glm::ivec2 &pos);
+
         void handleSlice(const PacketHeader &, const void *, const size_t);
-        void process(const message::ChunkSliceData &);
+        void process(const std::shared_ptr<Transfer> &, const message::ChunkSliceData &);
 
         void handleCompletion(const PacketHeader &, const void *, const size_t);
-        void process(const message::ChunkCompletion &);
+
+        void release(const std::shared_ptr<Transfer> &);
+        void finish(const std::shared_ptr<Transfer> &);
 
     private:
         /// lock over the promises list
         std::mutex requestsLock;
         /// outstanding requests
         std::unordered_map<glm::ivec2, std::promise<std::shared_ptr<world::Chunk>>> requests;
+        /// priority most recently sent to the server for each outstanding request
+        std::unordered_map<glm::ivec2, Priority> priorities;
 
         /// lock to protect in progress chunks
         std::mutex inProgressLock;
         /// in progress chunks
-        std::unordered_map<glm::ivec2, std::shared_ptr<world::Chunk>> inProgress;
-
-        /**
-         * Count of slices processed, by chunk position. We've got a lock and condition variable
-         * that's signalled any time this changes. The completion callbacks will block on this to
-         * ensure all slices in the chunk have finished processing.
-         */
-        std::unordered_map<glm::ivec2, size_t> counts;
-        std::condition_variable countsCond;
-        std::mutex countsLock;
+        std::unordered_map<glm::ivec2, std::shared_ptr<Transfer>> inProgress;
 
         std::atomic_bool acceptGets = true;
 };
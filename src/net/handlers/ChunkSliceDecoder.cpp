@@ -0,0 +1,265 @@
+#include "ChunkSliceDecoder.h"
+
+#include <world/block/BlockIds.h>
+#include <world/chunk/Chunk.h>
+#include <world/chunk/ChunkSlice.h>
+#include <net/EPChunk.h>
+#include <util/LZ4.h>
+
+#include <io/Format.h>
+
+#include <mutils/time/profiler.h>
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+
+using namespace net::handler;
+using namespace net::message;
+
+/**
+ * Allocates the scratch buffers.
+ */
+ChunkSliceDecoder::ChunkSliceDecoder() {
+    this->compressor = std::make_unique<util::LZ4>();
+
+    this->grid.resize(kSliceBlocks, 0);
+    this->idTable.resize(kNumTypeIds, kInvalidId);
+}
+
+/**
+ * Releases the decompressor.
+ */
+ChunkSliceDecoder::~ChunkSliceDecoder() = default;
+
+/**
+ * Decodes the block data of the given slice. An ID map that can represent all blocks in the slice
+ * is selected (or created) in the chunk, and rows are allocated from the chunk's pools.
+ *
+ * @return Slice containing the decoded rows, or `nullptr` if the slice is entirely air.
+ */
+world::ChunkSlice *ChunkSliceDecoder::decode(world::Chunk *chunk, const ChunkSliceData &data) {
+    this->decompress(data);
+    this->findUsedIds();
+
+    // even if the slice is empty, this ensures the chunk has an ID map for later block changes
+    const auto mapId = this->selectIdMap(chunk, data);
+
+    if(this->usedIds.size() == 1 && this->isUsed[0]) {
+        return nullptr;
+    }
+
+    // decode each row
+    PROFILE_SCOPE(DecodeRows);
+
+    auto slice = new world::ChunkSlice;
+    bool empty = true;
+
+    for(size_t z = 0; z < 256; z++) {
+        auto row = this->decodeRow(chunk, this->grid.data() + (z * 256), mapId);
+        slice->rows[z] = row;
+
+        if(row) empty = false;
+    }
+
+    if(empty) {
+        delete slice;
+        return nullptr;
+    }
+
+    return slice;
+}
+
+/**
+ * Decompresses the slice's block data into the grid buffer.
+ */
+void ChunkSliceDecoder::decompress(const ChunkSliceData &data) {
+    PROFILE_SCOPE(LZ4Decompress);
+
+    const auto numBytes = this->grid.size() * sizeof(uint16_t);
+    const auto read = this->compressor->decompress(data.data.data(), data.data.size(),
+            this->grid.data(), numBytes);
+
+    if(read != numBytes) {
+        throw std::runtime_error(f("Slice data is {} bytes, expected {}", read, numBytes));
+    }
+}
+
+/**
+ * Builds the set of type IDs that occur in the grid. State left over from the previous slice is
+ * cleared first.
+ */
+void ChunkSliceDecoder::findUsedIds() {
+    PROFILE_SCOPE(FindUsedIds);
+
+    this->resetIdTable();
+
+    for(const auto id : this->usedIds) {
+        this->isUsed.reset(id);
+    }
+    this->usedIds.clear();
+
+    for(const auto id : this->grid) {
+        if(this->isUsed[id]) continue;
+
+        this->isUsed.set(id);
+        this->usedIds.push_back(id);
+    }
+}
+
+/**
+ * Selects an ID map in the chunk that contains all block types used by the slice, and fills in the
+ * ID table with the 8-bit ID of each of them.
+ *
+ * If no existing map is suitable, a new one is created. It contains all of the types the server
+ * described, not just those used by this slice, since the server sends the same type map for all
+ * slices of a chunk; subsequent slices can then share the map.
+ *
+ * @return Index of the selected map
+ */
+uint8_t ChunkSliceDecoder::selectIdMap(world::Chunk *chunk, const ChunkSliceData &data) {
+    PROFILE_SCOPE(SelectIdMap);
+
+    // every type ID in the slice, except air, must have a UUID
+    size_t known = 0;
+    for(const auto &[uuid, id] : data.typeMap) {
+        if(this->isUsed[id]) known++;
+    }
+
+    const auto numTypes = this->usedIds.size() - (this->isUsed[0] ? 1 : 0);
+    if(known != numTypes) {
+        throw std::runtime_error(f("Slice uses {} block types, but only {} are known", numTypes,
+                    known));
+    }
+
+    std::lock_guard<std::mutex> lg(chunk->sliceIdMapsLock);
+
+    // find an existing map containing all used types
+    for(size_t i = 0; i < chunk->sliceIdMaps.size(); i++) {
+        const auto &map = chunk->sliceIdMaps[i];
+        size_t found = 0;
+
+        for(size_t j = 0; j < map.idMap.size(); j++) {
+            const auto &uuid = map.idMap[j];
+            if(uuid.is_nil()) continue;
+
+            // air doesn't have an entry in the server's type map; it's always type 0
+            uint16_t typeId = 0;
+
+            if(uuid != world::kAirBlockId) {
+                const auto it = data.typeMap.find(uuid);
+                if(it == data.typeMap.end()) continue;
+
+                typeId = it->second;
+            }
+
+            if(!this->isUsed[typeId] || this->idTable[typeId] != kInvalidId) continue;
+
+            this->idTable[typeId] = j;
+            found++;
+        }
+
+        if(found == this->usedIds.size()) {
+            return i;
+        }
+
+        this->resetIdTable();
+    }
+
+    // otherwise, create a new map
+    if(chunk->sliceIdMaps.size() > UINT8_MAX) {
+        throw std::runtime_error("Too many ID maps in chunk");
+    } else if(numTypes >= 256) {
+        throw std::runtime_error(f("Too many block types in slice ({})", numTypes));
+    }
+
+    world::ChunkRowBlockTypeMap map;
+    size_t next = 1;
+
+    map.idMap[0] = world::kAirBlockId;
+    if(this->isUsed[0]) {
+        this->idTable[0] = 0;
+    }
+
+    for(const auto &[uuid, id] : data.typeMap) {
+        if(!this->isUsed[id]) continue;
+
+        map.idMap[next] = uuid;
+        this->idTable[id] = next++;
+    }
+    for(const auto &[uuid, id] : data.typeMap) {
+        if(this->isUsed[id] || next == map.idMap.size()) continue;
+
+        map.idMap[next++] = uuid;
+    }
+
+    chunk->sliceIdMaps.push_back(map);
+    return chunk->sliceIdMaps.size() - 1;
+}
+
+/**
+ * Clears the ID table entries of all type IDs used by the current slice.
+ */
+void ChunkSliceDecoder::resetIdTable() {
+    for(const auto id : this->usedIds) {
+        this->idTable[id] = kInvalidId;
+    }
+}
+
+/**
+ * Decodes a single row of the grid.
+ *
+ * Rows that are entirely air aren't allocated; those that consist of a single block type, or
+ * where all but a few blocks are of the same type, become sparse rows. Anything else is dense.
+ *
+ * @return Decoded row, or `nullptr` if it's all air
+ */
+world::ChunkSliceRow *ChunkSliceDecoder::decodeRow(world::Chunk *chunk, const uint16_t *in,
+        const uint8_t mapId) {
+    using world::ChunkSliceRowSparse;
+
+    // translate to 8-bit IDs, and check whether it's all one type of block
+    std::array<uint8_t, 256> ids;
+    bool uniform = true;
+
+    for(size_t x = 0; x < 256; x++) {
+        ids[x] = this->idTable[in[x]];
+        uniform &= (in[x] == in[0]);
+    }
+
+    if(uniform) {
+        if(!in[0]) return nullptr;
+
+        auto row = chunk->allocRowSparse();
+        row->typeMap = mapId;
+        row->defaultBlockId = ids[0];
+        return row;
+    }
+
+    // find the most common block type to decide whether the row should be sparse
+    std::array<uint16_t, 256> counts{};
+    for(const auto id : ids) {
+        counts[id]++;
+    }
+
+    const uint8_t common = std::max_element(counts.begin(), counts.end()) - counts.begin();
+
+    if(counts[common] >= (256 - ChunkSliceRowSparse::kMaxEntries)) {
+        auto row = chunk->allocRowSparse();
+        row->typeMap = mapId;
+        row->defaultBlockId = common;
+
+        // entries are added in X order, so the storage is already sorted
+        for(size_t x = 0; x < 256; x++) {
+            if(ids[x] == common) continue;
+            row->storage[row->slotsUsed++] = (x << 8) | ids[x];
+        }
+
+        return row;
+    }
+
+    auto row = chunk->allocRowDense();
+    row->typeMap = mapId;
+    row->storage = ids;
+    return row;
+}
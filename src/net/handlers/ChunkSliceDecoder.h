@@ -0,0 +1,77 @@
+#ifndef NET_HANDLER_CHUNKSLICEDECODER_H
+#define NET_HANDLER_CHUNKSLICEDECODER_H
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace util {
+class LZ4;
+}
+
+namespace world {
+struct Chunk;
+struct ChunkSlice;
+struct ChunkSliceRow;
+}
+
+namespace net::message {
+struct ChunkSliceData;
+}
+
+namespace net::handler {
+/**
+ * Converts the block data of a slice received from the server into the chunk's in-memory form.
+ *
+ * Like the file loader, each row is stored in the most compact representation: rows that are all
+ * air aren't allocated at all, rows that are mostly (or entirely) one block type become sparse
+ * rows, and everything else is stored as a dense row. Rows are allocated from the chunk's pools.
+ *
+ * The server's 16-bit type IDs are translated to the row's 8-bit IDs with a flat lookup table,
+ * which is filled in while selecting the chunk's ID map, rather than by hashing UUIDs per block.
+ *
+ * Decoders keep their scratch buffers between slices, so no memory is allocated for decoding
+ * itself; they aren't thread safe, so each worker thread should use its own.
+ */
+class ChunkSliceDecoder {
+    public:
+        ChunkSliceDecoder();
+        ~ChunkSliceDecoder();
+
+        world::ChunkSlice *decode(world::Chunk *chunk, const message::ChunkSliceData &data);
+
+    private:
+        /// number of blocks in a slice
+        constexpr static const size_t kSliceBlocks = 256 * 256;
+        /// number of distinct 16-bit type IDs
+        constexpr static const size_t kNumTypeIds = 65536;
+        /// marks type IDs that the selected ID map doesn't contain
+        constexpr static const uint16_t kInvalidId = 0xFFFF;
+
+    private:
+        void decompress(const message::ChunkSliceData &data);
+        void findUsedIds();
+        uint8_t selectIdMap(world::Chunk *chunk, const message::ChunkSliceData &data);
+        void resetIdTable();
+
+        world::ChunkSliceRow *decodeRow(world::Chunk *chunk, const uint16_t *in, const uint8_t mapId);
+
+    private:
+        std::unique_ptr<util::LZ4> compressor;
+
+        /// decompressed block data of the slice being decoded
+        std::vector<uint16_t> grid;
+
+        /// server type ID -> 8-bit ID in the selected map, or kInvalidId
+        std::vector<uint16_t> idTable;
+        /// type IDs that occur in the slice being decoded
+        std::vector<uint16_t> usedIds;
+        /// set for each type ID in `usedIds`
+        std::bitset<kNumTypeIds> isUsed;
+};
+}
+
+#endif
@@ -2,16 +2,15 @@
 #include "net/ServerConnection.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPPlayerInfo.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
-
 #include <cstdlib>
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -87,13 +86,13 @@ std::future<std::optional<std::vector<std::byte>>> PlayerInfo::get(const std::st
     // build the request
     PlayerInfoGet request(key);
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(request);
 
     // send it
-    this->server->writePacket(kEndpointPlayerInfo, kPlayerInfoGet, oStream.str());
+    this->server->writePacket(kEndpointPlayerInfo, kPlayerInfoGet, std::move(packet));
     return future;
 }
 
@@ -105,8 +104,7 @@ std::future<std::optional<std::vector<std::byte>>> PlayerInfo::get(const std::st
  */
 void PlayerInfo::receivedKey(const PacketHeader &hdr, const void *payload, const size_t payloadLen) {
     // deserialize the respone
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     PlayerInfoGetReply response;
     iArc(response);
@@ -142,12 +140,12 @@ void PlayerInfo::set(const std::string &key, const std::vector<std::byte> &value
     request.key = key;
     request.data = value;
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(request);
 
     // send it
-    this->server->writePacket(kEndpointPlayerInfo, kPlayerInfoSet, oStream.str());
+    this->server->writePacket(kEndpointPlayerInfo, kPlayerInfoSet, std::move(packet));
 }
 
@@ -2,15 +2,14 @@
 #include "net/ServerConnection.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPPlayerMovement.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -51,43 +50,79 @@ void PlayerMovement::handlePacket(const PacketHeader &header, const void *payloa
 }
 
 /**
- * Another player on the server has moved; update internal state.
+ * Other players on the server have moved; update internal state.
+ *
+ * Each entry is delta encoded against the last state we received for that player index. The
+ * server includes the player's ID whenever it starts over with a player index. Players that left
+ * are removed first, since their indices may be reused.
  */
 void PlayerMovement::otherPlayerMoved(const PacketHeader &, const void *payload,
         const size_t payloadLen) {
     // try to deserialize the message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     PlayerPositionBroadcast b;
     iArc(b);
 
-    // deal with it
-    Logging::trace("Player {} moved: pos {} angles {}", b.playerId, b.position, b.angles);
+    for(const auto index : b.departed) {
+        this->others.erase(index);
+    }
 
-    // idk fam
+    // apply each player's movement
+    for(const auto &entry : b.players) {
+        auto it = this->others.find(entry.playerIndex);
+
+        if(entry.playerId) {
+            OtherPlayer p;
+            p.id = *entry.playerId;
+            p.state = entry.movement.apply(MovementState());
+
+            it = this->others.insert_or_assign(entry.playerIndex, p).first;
+        } else {
+            if(it == this->others.end()) {
+                throw std::runtime_error(f("Movement for unknown player index {}", entry.playerIndex));
+            }
+            it->second.state = entry.movement.apply(it->second.state);
+        }
+
+        // deal with it
+        const auto &state = it->second.state;
+        Logging::trace("Player {} moved: pos {} angles {}", it->second.id, state.getPosition(),
+                state.getAngles());
+
+        std::lock_guard<std::mutex> lg(this->callbacksLock);
+        for(auto &[token, cb] : this->callbacks) {
+            cb(it->second.id, state);
+        }
+    }
 }
 
 
 
 /**
- * Transmits a position change packet.
+ * Transmits a position change packet, if the quantized position or angles actually changed.
  */
 void PlayerMovement::positionChanged(const glm::vec3 &pos, const glm::vec3 &angles) {
+    const auto state = MovementState::quantize(pos, angles);
+
     // build packet
     PlayerPositionChanged delta;
-    delta.epoch = this->epoch++;
-    delta.position = pos;
-    delta.angles = angles;
+    {
+        std::lock_guard<std::mutex> lg(this->lastSentLock);
+        if(this->lastSent && *this->lastSent == state) return;
+
+        delta.movement = MovementDelta::encode(this->lastSent, state);
+        this->lastSent = state;
+    }
 
     // send it
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(delta);
 
     // send it
-    this->server->writePacket(kEndpointPlayerMovement, kPlayerPositionChanged, oStream.str());
+    this->server->writePacket(kEndpointPlayerMovement, kPlayerPositionChanged, std::move(packet));
 }
 
 /**
@@ -96,8 +131,7 @@ void PlayerMovement::positionChanged(const glm::vec3 &pos, const glm::vec3 &angl
  */
 void PlayerMovement::handleInitialPos(const PacketHeader &, const void *payload, const size_t payloadLen) {
     // deserialize message
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     PlayerPositionInitial initial;
     iArc(initial);
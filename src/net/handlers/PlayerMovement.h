@@ -4,8 +4,14 @@
 #include "net/PacketHandler.h"
 
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 
 #include <glm/vec3.hpp>
+#include <uuid.h>
+#include <net/EPPlayerMovement.h>
 
 namespace world {
 class RemoteSource;
@@ -16,6 +22,10 @@ namespace net::handler {
 class PlayerMovement: public PacketHandler {
     friend class world::RemoteSource;
 
+    public:
+        /// invoked with the player's ID and new state whenever another player moves
+        using MovedCallback = std::function<void(const uuids::uuid &, const net::message::MovementState &)>;
+
     public:
         PlayerMovement(ServerConnection *_server) : PacketHandler(_server) {};
         virtual ~PlayerMovement() = default;
@@ -26,6 +36,25 @@ class PlayerMovement: public PacketHandler {
 
         void positionChanged(const glm::vec3 &pos, const glm::vec3 &angles);
 
+        /// most recent player state sent to the server, if any
+        std::optional<net::message::MovementState> getLastSent() {
+            std::lock_guard<std::mutex> lg(this->lastSentLock);
+            return this->lastSent;
+        }
+
+        /// Installs a callback for other players' movement
+        uint32_t addCallback(const MovedCallback &func) {
+            std::lock_guard<std::mutex> lg(this->callbacksLock);
+            const auto token = this->nextToken++;
+            this->callbacks[token] = func;
+            return token;
+        }
+        /// Removes a previously installed movement callback
+        void removeCallback(const uint32_t token) {
+            std::lock_guard<std::mutex> lg(this->callbacksLock);
+            this->callbacks.erase(token);
+        }
+
     private:
         void otherPlayerMoved(const PacketHeader &, const void *, const size_t);
         void handleInitialPos(const PacketHeader &, const void *, const size_t);
@@ -36,8 +65,25 @@ class PlayerMovement: public PacketHandler {
         /// most recent position and angles (only set by initial message frame atm)
         glm::vec3 position, angles;
 
-        /// epoch value to insert into outgoing position update packets; increments by one
-        uint32_t epoch = 1;
+        /// last movement state sent to the server; outgoing updates are delta encoded against it
+        std::optional<net::message::MovementState> lastSent;
+        /// protects the last sent state, which chunk requests read to figure out their priority
+        std::mutex lastSentLock;
+
+        /// state of another player on the server
+        struct OtherPlayer {
+            /// player's ID
+            uuids::uuid id;
+            /// most recently received state
+            net::message::MovementState state;
+        };
+
+        /// other players we've received movement for, keyed by their player index
+        std::unordered_map<uint16_t, OtherPlayer> others;
+
+        std::mutex callbacksLock;
+        std::unordered_map<uint32_t, MovedCallback> callbacks;
+        uint32_t nextToken = 1;
 };
 }
 
@@ -7,11 +7,9 @@
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
-
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -60,8 +58,7 @@ void Time::configTime(const PacketHeader &, const void *payload, const size_t pa
     auto world = this->server->getSource();
 
     // deserialize the payload
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     TimeInitialState init;
     iArc(init);
@@ -84,15 +81,16 @@ void Time::resyncTime(const PacketHeader &, const void *payload, const size_t pa
     auto world = this->server->getSource();
 
     // deserialize the payload
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     TimeUpdate update;
     iArc(update);
 
     // update time
 //    auto diff = world->getTime() - update.currentTime;
-    world->setTime(update.currentTime);
+    if(world) {
+        world->setTime(update.currentTime);
+    }
 //    Logging::trace("Resync time: server = {}, delta = {}", update.currentTime, diff);
 }
 
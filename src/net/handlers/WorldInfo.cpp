@@ -2,16 +2,15 @@
 #include "net/ServerConnection.h"
 
 #include <net/PacketTypes.h>
+#include <net/Framing.h>
 #include <net/EPWorldInfo.h>
 
 #include <Logging.h>
 #include <io/Format.h>
+#include <io/SpanArchive.h>
 
 #include <mutils/time/profiler.h>
-#include <cereal/archives/portable_binary.hpp>
-
 #include <cstdlib>
-#include <sstream>
 #include <stdexcept>
 
 using namespace net::handler;
@@ -93,13 +92,13 @@ std::future<std::optional<std::vector<std::byte>>> WorldInfo::get(const std::str
     // build the request
     WorldInfoGet request(key);
 
-    std::stringstream oStream;
-    cereal::PortableBinaryOutputArchive oArc(oStream);
+    auto packet = net::GetPacketBuffer();
+    io::BufferOutputArchive oArc(*packet);
 
     oArc(request);
 
     // send it
-    this->server->writePacket(kEndpointWorldInfo, kWorldInfoGet, oStream.str());
+    this->server->writePacket(kEndpointWorldInfo, kWorldInfoGet, std::move(packet));
     return future;
 }
 
@@ -111,8 +110,7 @@ std::future<std::optional<std::vector<std::byte>>> WorldInfo::get(const std::str
  */
 void WorldInfo::receivedKey(const PacketHeader &hdr, const void *payload, const size_t payloadLen) {
     // deserialize the respone
-    std::stringstream stream(std::string(reinterpret_cast<const char *>(payload), payloadLen));
-    cereal::PortableBinaryInputArchive iArc(stream);
+    io::SpanInputArchive iArc(payload, payloadLen);
 
     WorldInfoGetReply response;
     iArc(response);
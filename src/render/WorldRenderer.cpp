@@ -60,7 +60,13 @@ inventory::Manager *gInventoryManager = nullptr;
 WorldRenderer::WorldRenderer(gui::MainWindow *_win, std::shared_ptr<gui::GameUI> &_gui,
         std::shared_ptr<world::ClientWorldSource> &_source) : window(_win), gui(_gui), source(_source) {
     std::shared_ptr<SSAO> ssao = nullptr;
-    const bool wantSsao = io::PrefsManager::getBool("gfx.ssao", true);
+    bool wantSsao = io::PrefsManager::getBool("gfx.ssao", true);
+
+    // chunks with baked ambient occlusion may not need SSAO
+    if(io::PrefsManager::getBool("gfx.bakedOcclusion", true) &&
+       io::PrefsManager::getBool("gfx.bakedOcclusionReplacesSsao", true)) {
+        wantSsao = false;
+    }
 
     // set up the vertex generator; it needs to create a GL context
     render::chunk::VertexGenerator::init(_win);
@@ -0,0 +1,97 @@
+/**
+ * The parts of a block that the mesher needs to know about, to build the mesh of a globule.
+ *
+ * These interfaces don't depend on any of the rendering or UI code. In the game, every block
+ * implements `BlockAppearance`, and the block registry is the `BlockSource`; tools that mesh
+ * chunks without a window provide their own.
+ */
+#ifndef RENDER_CHUNK_BLOCKAPPEARANCE_H
+#define RENDER_CHUNK_BLOCKAPPEARANCE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <uuid.h>
+#include <glm/vec3.hpp>
+
+namespace render::chunk {
+/**
+ * Blocks can have custom models, which are just vertices whose coordinates are in the range of
+ * [0, 1], and an index buffer. Note that the bottom left corner of the block is at the origin.
+ *
+ * Each vertex position also must correspond to a face/vertex id pair. The faces are ordered as
+ * 0 = bottom, 1 = top, 2 = left, 3 = right, 4 = front, 5 = back.
+ *
+ * A maximum of about 60 vertices is suggested.
+ */
+struct BlockModel {
+    std::vector<glm::vec3> vertices;
+    std::vector<std::pair<uint8_t, uint8_t>> faceVertIds;
+    std::vector<uint8_t> indices;
+};
+
+/**
+ * Describes how a type of block is drawn.
+ */
+class BlockAppearance {
+    public:
+        enum BlockFlags: uint32_t {
+            kFlagsNone = 0,
+
+            /// exposed edges
+            kExposureMask       = 0x3F,
+
+            kExposedYPlus       = (1 << 0),
+            kExposedYMinus      = (1 << 1),
+            kExposedXPlus       = (1 << 2),
+            kExposedXMinus      = (1 << 3),
+            kExposedZPlus       = (1 << 4),
+            kExposedZMinus      = (1 << 5),
+        };
+
+    public:
+        virtual ~BlockAppearance() = default;
+
+        /// Whether the block is fully opaque, hiding the faces of blocks next to it
+        virtual const bool isOpaque() const = 0;
+        /// Whether the block is drawn in the alpha blended pass
+        virtual const bool needsAlphaBlending(const glm::ivec3 &pos) const = 0;
+
+        /// Returns the 16-bit block appearance (block data ID) for the block at the given position
+        virtual uint16_t getBlockId(const glm::ivec3 &pos, const BlockFlags flags) = 0;
+        /// Returns the model ID to draw the block with, or 0 to draw it as a cube
+        virtual uint16_t getModelId(const glm::ivec3 &pos, const BlockFlags flags) = 0;
+
+        /// A block with a model is about to be displayed at the given world position
+        virtual void blockWillDisplay(const glm::ivec3 &pos) = 0;
+};
+
+// proper bitset OR for block flags. (XXX: extend if we ever use more than 32 bits)
+inline BlockAppearance::BlockFlags operator|(BlockAppearance::BlockFlags a, BlockAppearance::BlockFlags b) {
+    return static_cast<BlockAppearance::BlockFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
+}
+inline BlockAppearance::BlockFlags operator|=(BlockAppearance::BlockFlags &a, BlockAppearance::BlockFlags b) {
+    return (BlockAppearance::BlockFlags &) ((uint32_t &) a |= (uint32_t) b);
+}
+
+/**
+ * Provides the blocks and models that chunks are meshed with.
+ *
+ * Methods may be called from multiple threads at once.
+ */
+class BlockSource {
+    public:
+        virtual ~BlockSource() = default;
+
+        /// Gets the block with the given ID; this is `nullptr` for air, and unknown blocks
+        virtual BlockAppearance *getBlock(const uuids::uuid &id) = 0;
+        /// Whether the block with the given ID hides faces of adjacent blocks
+        virtual bool isOpaqueBlock(const uuids::uuid &id) = 0;
+
+        /// Gets the model with the given ID, or `nullptr` if there's no such model
+        virtual const BlockModel *getModel(const uint16_t id) = 0;
+};
+}
+
+#endif
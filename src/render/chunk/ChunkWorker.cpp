@@ -8,6 +8,8 @@
 
 #include <mutils/time/profiler.h>
 
+#include <algorithm>
+
 using namespace render::chunk;
 
 /// shared instance
@@ -20,15 +22,22 @@ std::shared_ptr<ChunkWorker> ChunkWorker::gShared;
  */
 ChunkWorker::ChunkWorker() : ThreadPool("Chunk Worker") {
     // read number of workers from preferences
-    unsigned int hwThreads = std::thread::hardware_concurrency() / 2;
-    unsigned int fallback = std::min(hwThreads, 5U);
-
-    this->numWorkers = io::PrefsManager::getUnsigned("chunk.drawWorkThreads", fallback);
+    this->numWorkers = io::PrefsManager::getUnsigned("chunk.drawWorkThreads", defaultNumWorkers());
 
     // create workers
     this->startWorkers(this->numWorkers);
 }
 
+/**
+ * Returns the number of workers to use if the user hasn't configured it: about two thirds of the
+ * machine's hardware threads, leaving the rest for the main thread and world sources. There are
+ * always at least two workers.
+ */
+unsigned int ChunkWorker::defaultNumWorkers() {
+    const unsigned int hwThreads = std::thread::hardware_concurrency();
+    return std::max(2U, (hwThreads * 2) / 3);
+}
+
 /**
  * When deallocating, make sure the thread pool is shut down cleanly
  */
@@ -45,6 +45,9 @@ class ChunkWorker: public util::ThreadPool<WorkItem> {
             return gShared->getNumWorkers() > 1;
         }
 
+        /// Number of workers to use unless configured otherwise
+        static unsigned int defaultNumWorkers();
+
         /// Forces initialization of the chunk worker threads
         static void init() {
             gShared = std::make_unique<ChunkWorker>();
@@ -2,6 +2,7 @@
 
 #include "gfx/gl/buffer/Buffer.h"
 #include "gfx/gl/texture/Texture2D.h"
+#include "gfx/gl/texture/BufferTexture.h"
 #include "gfx/gl/buffer/VertexArray.h"
 
 #include <Logging.h>
@@ -21,6 +22,9 @@ Globule::Globule(WorldChunk *_c, const glm::ivec3 _pos) : position(_pos) {
     using namespace gfx;
 
     this->facesVao = new VertexArray;
+
+    this->pullVao = new VertexArray;
+    this->faceTex = new BufferTexture(kFaceDataTexUnit);
 }
 
 /**
@@ -28,6 +32,9 @@ Globule::Globule(WorldChunk *_c, const glm::ivec3 _pos) : position(_pos) {
  */
 Globule::~Globule() {
     delete this->facesVao;
+
+    delete this->pullVao;
+    delete this->faceTex;
 }
 
 /**
@@ -37,9 +44,11 @@ void Globule::clearBuffers() {
     // also, inhibit drawing until we get a buffer assigned again
     this->numIndices = 0;
     this->numVertices = 0;
+    this->numFaces = this->specialFaceStart = 0;
 
     this->vertexBuf = nullptr;
     this->indexBuf = nullptr;
+    this->faceBuf = nullptr;
 
     this->inhibitDrawing = true;
 }
@@ -52,6 +61,18 @@ void Globule::setBuffer(const VertexGenerator::Buffer &buf) {
     using namespace gfx;
     using BlockVertex = VertexGenerator::BlockVertex;
 
+    // attach the face records, if the cube faces were generated as such
+    if(buf.numFaces) {
+        this->faceBuf = buf.faceBuffer;
+        this->faceTex->attachBuffer(this->faceBuf, Texture::RG32UI);
+
+        this->numFaces = buf.numFaces;
+        this->specialFaceStart = buf.specialFaceOffset;
+    } else {
+        this->faceBuf = nullptr;
+        this->numFaces = this->specialFaceStart = 0;
+    }
+
     // re-prepare the VAO
     if(buf.numVertices) {
         this->vertexBuf = buf.buffer;
@@ -68,6 +89,10 @@ void Globule::setBuffer(const VertexGenerator::Buffer &buf) {
                 offsetof(BlockVertex, face)); // face
         this->facesVao->registerVertexAttribPointerInt(3, 1, VertexArray::UnsignedByte, kVertexSize,
                 offsetof(BlockVertex, vertexId)); // vertex id
+        this->facesVao->registerVertexAttribPointerInt(4, 2, VertexArray::UnsignedByte, kVertexSize,
+                offsetof(BlockVertex, tile)); // texture repeat coordinate
+        this->facesVao->registerVertexAttribPointerInt(5, 1, VertexArray::UnsignedByte, kVertexSize,
+                offsetof(BlockVertex, occlusion)); // baked ambient occlusion
 
         gfx::VertexArray::unbind();
 
@@ -75,12 +100,13 @@ void Globule::setBuffer(const VertexGenerator::Buffer &buf) {
 
         this->numVertices = buf.numVertices;
     } 
-    // no vertices in this globule, so no need to waste time drawing
+    // no vertices in this globule; if there's no face records either, don't bother drawing
     else {
         this->vertexBuf = nullptr;
         this->indexBuf = nullptr;
+        this->numVertices = this->numIndices = this->numSpecialIndices = 0;
 
-        this->inhibitDrawing = true;
+        this->inhibitDrawing = !this->numFaces;
         return;
     }
 
@@ -117,6 +143,8 @@ void Globule::drawInternal(std::shared_ptr<gfx::RenderProgram> &program,
 
     // draw if we have indices to do so with
     if(!this->inhibitDrawing && numIndices) {
+        program->setUniform1i("pullFaces", 0);
+
         this->facesVao->bind();
         this->indexBuf->bind();
 
@@ -131,6 +159,24 @@ void Globule::drawInternal(std::shared_ptr<gfx::RenderProgram> &program,
     }
 }
 
+/**
+ * Draws a range of the globule's face records. The vertex shader reads the record for each vertex
+ * from the face data texture; each face is drawn as two triangles, so there are no indices.
+ */
+void Globule::drawFaces(std::shared_ptr<gfx::RenderProgram> &program, const size_t firstFace,
+        const size_t numFaces) {
+    using namespace gl;
+
+    if(this->inhibitDrawing || !numFaces) return;
+
+    this->faceTex->bind();
+    program->setUniform1i("pullFaces", 1);
+
+    this->pullVao->bind();
+    glDrawArrays(GL_TRIANGLES, firstFace * 6, numFaces * 6);
+    gfx::VertexArray::unbind();
+}
+
 
 
 /**
@@ -44,6 +44,7 @@ class VertexArray;
 class Buffer;
 class RenderProgram;
 class Texture2D;
+class BufferTexture;
 }
 
 namespace render::chunk {
@@ -61,24 +62,28 @@ class Globule {
 
         /// Draws all normal blocks.
         void draw(std::shared_ptr<gfx::RenderProgram> &program) {
+            this->drawFaces(program, 0, this->specialFaceStart);
             this->drawInternal(program, 0, this->numIndices);
         }
         /// Draws the blocks in the special index range.
         void drawSpecial(std::shared_ptr<gfx::RenderProgram> &program) {
+            this->drawFaces(program, this->specialFaceStart, this->numFaces - this->specialFaceStart);
+
             if(!this->numSpecialIndices) return;
             this->drawInternal(program, this->numIndices, this->numSpecialIndices);
         }
 
-        void eraseBlockAt(const glm::ivec3 &pos);
-        void insertBlockAt(const glm::ivec3 &pos, const uuids::uuid &newId);
-        void updateBlockAt(const glm::ivec3 &pos, const uuids::uuid &newId);
-
     public:
         static void fillNormalTex(gfx::Texture2D *tex);
 
+        /// texture unit on which the face records of the globule being drawn are bound
+        constexpr static const int kFaceDataTexUnit = 5;
+
     private:
         void drawInternal(std::shared_ptr<gfx::RenderProgram> &program, const size_t firstIdx, 
                 const size_t numIndices);
+        void drawFaces(std::shared_ptr<gfx::RenderProgram> &program, const size_t firstFace,
+                const size_t numFaces);
 
     private:
         // position of the globule, in block coordinates, relative to the chunk origin
@@ -98,6 +103,15 @@ class Globule {
         // index format
         gl::GLenum indexFormat;
 
+        // attribute-less vertex array used for drawing from face records
+        gfx::VertexArray *pullVao = nullptr;
+        // buffer containing the packed face records, if any
+        std::shared_ptr<gfx::Buffer> faceBuf = nullptr;
+        // texture through which the vertex shader reads the face records
+        gfx::BufferTexture *faceTex = nullptr;
+        // number of face records, and the index of the first one drawn in the special pass
+        size_t numFaces = 0, specialFaceStart = 0;
+
         /// inhibits the chunk visibility til the next time the index/vertex buffers are uploaded
         bool inhibitDrawing = true;
         /// visibility override flag
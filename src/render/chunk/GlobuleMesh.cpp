@@ -0,0 +1,283 @@
+#include "GlobuleMesh.h"
+
+#include <algorithm>
+
+using namespace render::chunk;
+
+/// axes along the edges of each face, from vertex 0 to 1, and from vertex 1 to 2
+static const size_t kTileAxes[6][2] = {
+    {0, 2}, {0, 2}, {1, 2}, {1, 2}, {0, 1}, {0, 1},
+};
+
+const glm::ivec3 GlobuleMesh::kFaceCorners[6][4] = {
+    {{0,0,0}, {1,0,0}, {1,0,1}, {0,0,1}},
+    {{0,1,1}, {1,1,1}, {1,1,0}, {0,1,0}},
+    {{0,0,1}, {0,1,1}, {0,1,0}, {0,0,0}},
+    {{1,0,0}, {1,1,0}, {1,1,1}, {1,0,1}},
+    {{0,1,0}, {1,1,0}, {1,0,0}, {0,0,0}},
+    {{0,0,1}, {1,0,1}, {1,1,1}, {0,1,1}},
+};
+
+/**
+ * Lays out the given quads, followed by spare slots, and generates their vertices and indices.
+ *
+ * @param vertices Vertex buffer; it must be empty, as slot N is placed at vertex N * 4
+ * @param indices Indices of the normal quads are appended here
+ * @param indicesSpecial Indices of the alpha blended quads are appended here
+ */
+void GlobuleMesh::build(const std::vector<Quad> &quads, std::vector<BlockVertex> &vertices,
+        std::vector<uint32_t> &indices, std::vector<uint32_t> &indicesSpecial) {
+    const size_t numSlots = this->layout(quads);
+
+    // generate vertices and indices
+    vertices.reserve(numSlots * 4);
+
+    for(size_t i = 0; i < numSlots; i++) {
+        const uint32_t iVtx = vertices.size();
+
+        if(this->used[i]) {
+            writeQuad(this->slots[i], vertices);
+        } else {
+            vertices.resize(vertices.size() + 4, BlockVertex{});
+        }
+
+        auto &out = (i >= this->specialStart) ? indicesSpecial : indices;
+        out.insert(out.end(), {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
+    }
+}
+
+/**
+ * Lays out the given quads, followed by spare slots, and generates a face record for each slot.
+ * Unused slots are empty records, which the vertex shader turns into degenerate triangles.
+ *
+ * @param faces Face records; it must be empty, as slot N is placed at record N
+ */
+void GlobuleMesh::build(const std::vector<Quad> &quads, std::vector<FaceRecord> &faces) {
+    const size_t numSlots = this->layout(quads);
+
+    faces.reserve(numSlots);
+
+    for(size_t i = 0; i < numSlots; i++) {
+        faces.push_back(this->used[i] ? packQuad(this->slots[i]) : FaceRecord{});
+    }
+}
+
+/**
+ * Assigns slots to the given quads: first the normal quads, then the alpha blended ones, each
+ * followed by their spare slots.
+ *
+ * @return Total number of slots
+ */
+size_t GlobuleMesh::layout(const std::vector<Quad> &quads) {
+    const size_t numSpecial = std::count_if(quads.begin(), quads.end(), [](const auto &q) {
+        return q.special;
+    });
+    const size_t numNormal = quads.size() - numSpecial;
+
+    // allocate slots
+    this->specialStart = numNormal + kSpareSlots;
+    const size_t numSlots = this->specialStart + numSpecial + (numSpecial ? kSpareSpecialSlots : 0);
+
+    this->slots.clear();
+    this->slots.resize(numSlots);
+    this->used.assign(numSlots, false);
+    this->planes.clear();
+    this->dirty.clear();
+
+    size_t nextNormal = 0, nextSpecial = this->specialStart;
+
+    for(const auto &quad : quads) {
+        this->insert(quad.special ? nextSpecial++ : nextNormal++, quad);
+    }
+
+    this->freeSlots.clear();
+    for(size_t i = this->specialStart; i-- > nextNormal; ) {
+        this->freeSlots.push_back(i);
+    }
+    this->freeSpecialSlots.clear();
+    for(size_t i = numSlots; i-- > nextSpecial; ) {
+        this->freeSpecialSlots.push_back(i);
+    }
+
+    return numSlots;
+}
+
+/**
+ * Finds all quads that cover the given face of a block.
+ *
+ * @param block Chunk relative block position
+ * @param outSlots Slots of the quads are appended to this list
+ */
+void GlobuleMesh::find(const uint8_t face, const glm::ivec3 &block, std::vector<uint32_t> &outSlots) const {
+    const auto planePos = toPlane(face, block);
+
+    auto it = this->planes.find(planeKey(face, planePos.x));
+    if(it == this->planes.end()) return;
+
+    for(const auto slot : it->second) {
+        const auto &quad = this->slots[slot];
+        const auto min = toPlane(face, glm::ivec3(quad.pos));
+        const auto size = toPlane(face, glm::ivec3(quad.size));
+
+        if(planePos.y >= min.y && planePos.y < (min.y + size.y) &&
+           planePos.z >= min.z && planePos.z < (min.z + size.z)) {
+            outSlots.push_back(slot);
+        }
+    }
+}
+
+/**
+ * Removes the quad in the given slot.
+ */
+void GlobuleMesh::remove(const uint32_t slot) {
+    if(!this->used[slot]) return;
+
+    const auto &quad = this->slots[slot];
+    auto &list = this->planes[planeKey(quad.face, toPlane(quad.face, glm::ivec3(quad.pos)).x)];
+    list.erase(std::remove(list.begin(), list.end(), slot), list.end());
+
+    this->used[slot] = false;
+    this->dirty.push_back(slot);
+
+    if(slot >= this->specialStart) {
+        this->freeSpecialSlots.push_back(slot);
+    } else {
+        this->freeSlots.push_back(slot);
+    }
+}
+
+/**
+ * Adds a quad in a free slot.
+ *
+ * @return Whether the quad was added; if there are no free slots left, the mesh has to be
+ * generated again.
+ */
+bool GlobuleMesh::add(const Quad &quad) {
+    auto &free = quad.special ? this->freeSpecialSlots : this->freeSlots;
+    if(free.empty()) return false;
+
+    const auto slot = free.back();
+    free.pop_back();
+
+    this->insert(slot, quad);
+    this->dirty.push_back(slot);
+    return true;
+}
+
+/**
+ * Stores a quad in the given slot and indexes it.
+ */
+void GlobuleMesh::insert(const uint32_t slot, const Quad &quad) {
+    this->slots[slot] = quad;
+    this->used[slot] = true;
+
+    this->planes[planeKey(quad.face, toPlane(quad.face, glm::ivec3(quad.pos)).x)].push_back(slot);
+}
+
+/**
+ * Gets the vertices of all slots modified since the last call. Adjacent slots are combined into
+ * a single range.
+ */
+void GlobuleMesh::getChanges(std::vector<VertexRange> &outRanges) {
+    this->getDirtyRuns([&](const uint32_t first, const uint32_t count) {
+        std::vector<BlockVertex> vertices;
+        vertices.reserve(count * 4);
+
+        for(uint32_t slot = first; slot < (first + count); slot++) {
+            if(this->used[slot]) {
+                writeQuad(this->slots[slot], vertices);
+            } else {
+                vertices.resize(vertices.size() + 4, BlockVertex{});
+            }
+        }
+
+        outRanges.emplace_back(first * 4, std::move(vertices));
+    });
+}
+
+/**
+ * Gets the face records of all slots modified since the last call, combining adjacent slots.
+ */
+void GlobuleMesh::getChanges(std::vector<FaceRange> &outRanges) {
+    this->getDirtyRuns([&](const uint32_t first, const uint32_t count) {
+        std::vector<FaceRecord> faces;
+        faces.reserve(count);
+
+        for(uint32_t slot = first; slot < (first + count); slot++) {
+            faces.push_back(this->used[slot] ? packQuad(this->slots[slot]) : FaceRecord{});
+        }
+
+        outRanges.emplace_back(first, std::move(faces));
+    });
+}
+
+/**
+ * Invokes the callback with the first slot and number of slots of each run of consecutive
+ * modified slots, then clears the modified slots.
+ */
+void GlobuleMesh::getDirtyRuns(const std::function<void(const uint32_t, const uint32_t)> &callback) {
+    std::sort(this->dirty.begin(), this->dirty.end());
+    this->dirty.erase(std::unique(this->dirty.begin(), this->dirty.end()), this->dirty.end());
+
+    for(size_t i = 0; i < this->dirty.size(); ) {
+        const auto first = this->dirty[i];
+        uint32_t count = 0;
+
+        for(; i < this->dirty.size() && this->dirty[i] == (first + count); i++) {
+            count++;
+        }
+
+        callback(first, count);
+    }
+
+    this->dirty.clear();
+}
+
+/**
+ * Appends the four vertices of a quad.
+ *
+ * The texture repeat coordinates count the number of blocks along the edges of the face, so its
+ * texture is tiled once per block.
+ *
+ * Slots are always drawn as the triangles (0, 1, 2) and (2, 3, 0); to split the quad along the
+ * other diagonal instead, its vertices are written starting at vertex 1.
+ */
+void GlobuleMesh::writeQuad(const Quad &quad, std::vector<BlockVertex> &vertices) {
+    const auto face = quad.face;
+    const uint16_t f = BlockVertex::kPointFactor;
+    const glm::i16vec3 origin = glm::i16vec3(quad.pos) * glm::i16vec3(f);
+    const glm::i16vec3 extent = glm::i16vec3(quad.size) * glm::i16vec3(f);
+
+    const uint8_t s = quad.size[kTileAxes[face][0]], t = quad.size[kTileAxes[face][1]];
+    const glm::u8vec2 tiles[4] = {
+        {0, 0}, {s, 0}, {s, t}, {0, t},
+    };
+
+    const uint8_t first = flipsDiagonal(quad.occlusion) ? 1 : 0;
+
+    for(uint8_t j = 0; j < 4; j++) {
+        const uint8_t i = (first + j) & 0x3;
+
+        vertices.push_back({
+            .p = origin + (glm::i16vec3(kFaceCorners[face][i]) * extent), .blockId = quad.blockId,
+            .face = face, .vertexId = i, .tile = tiles[i],
+            .occlusion = static_cast<uint8_t>((quad.occlusion >> (i * 2)) & 0x3)
+        });
+    }
+}
+
+/**
+ * Packs a quad into a face record. Instead of its size along each axis, the number of blocks
+ * along its two edges is stored, in the same order as the texture repeat coordinates. A quad
+ * covers at least one and at most 64 blocks along each edge, so one less than that is stored.
+ */
+GlobuleMesh::FaceRecord GlobuleMesh::packQuad(const Quad &quad) {
+    const auto face = quad.face;
+    const uint32_t s = quad.size[kTileAxes[face][0]] - 1, t = quad.size[kTileAxes[face][1]] - 1;
+
+    FaceRecord record;
+    record.position = quad.pos.x | (quad.pos.y << 8) | (quad.pos.z << 16) |
+        (static_cast<uint32_t>(quad.occlusion) << 24);
+    record.info = quad.blockId | ((s & 0x3F) << 16) | ((t & 0x3F) << 22) | ((face & 0x7) << 28);
+    return record;
+}
@@ -0,0 +1,148 @@
+/**
+ * Keeps track of where each cube face of a globule lives in its vertex buffer, so the mesh can be
+ * patched when blocks change.
+ */
+#ifndef RENDER_CHUNK_GLOBULEMESH_H
+#define RENDER_CHUNK_GLOBULEMESH_H
+
+#include "Mesher.h"
+
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+namespace render::chunk {
+/**
+ * CPU side record of the cube faces in a globule's vertex buffer.
+ *
+ * Faces are stored as quads in fixed slots of four vertices: first the normal quads, then those
+ * that need alpha blending. Each of these regions has some spare slots at the end, which are
+ * drawn as degenerate triangles, so faces can be added without changing the layout. Model
+ * vertices follow the quad slots; they aren't tracked, and are never patched.
+ *
+ * To find the quads covering a block's face, quads are indexed by face direction and the plane
+ * they lie in; the few quads in a plane are then checked directly.
+ */
+class GlobuleMesh {
+    public:
+        using BlockVertex = Mesher::BlockVertex;
+        using Quad = Mesher::Quad;
+        using FaceRecord = Mesher::FaceRecord;
+
+        /// A range of modified vertices: the index of the first one, and their data
+        using VertexRange = std::pair<size_t, std::vector<BlockVertex>>;
+        /// A range of modified face records: the index of the first one, and their data
+        using FaceRange = std::pair<size_t, std::vector<FaceRecord>>;
+
+        /// number of spare slots added for normal quads
+        constexpr static const size_t kSpareSlots = 64;
+        /// number of spare slots added for alpha blended quads, if the globule has any
+        constexpr static const size_t kSpareSpecialSlots = 16;
+
+        /// corners of each face of a unit cube, in vertex ID order
+        static const glm::ivec3 kFaceCorners[6][4];
+
+    public:
+        void build(const std::vector<Quad> &quads, std::vector<BlockVertex> &vertices,
+                std::vector<uint32_t> &indices, std::vector<uint32_t> &indicesSpecial);
+        void build(const std::vector<Quad> &quads, std::vector<FaceRecord> &faces);
+
+        /// Index of the first slot (and vertex quad, or face record) for alpha blended quads
+        size_t getSpecialStart() const {
+            return this->specialStart;
+        }
+
+        void find(const uint8_t face, const glm::ivec3 &block, std::vector<uint32_t> &outSlots) const;
+        const Quad &get(const uint32_t slot) const {
+            return this->slots[slot];
+        }
+        void remove(const uint32_t slot);
+        bool add(const Quad &quad);
+
+        void getChanges(std::vector<VertexRange> &outRanges);
+        void getChanges(std::vector<FaceRange> &outRanges);
+
+        static void writeQuad(const Quad &quad, std::vector<BlockVertex> &vertices);
+        static FaceRecord packQuad(const Quad &quad);
+
+        /**
+         * Whether a quad is split into triangles along the diagonal from vertex 1 to 3, rather
+         * than 0 to 2. The diagonal between the less occluded corners is used, so the occlusion
+         * is interpolated the same way regardless of the face's orientation.
+         */
+        static inline bool flipsDiagonal(const uint8_t occlusion) {
+            const int c0 = occlusion & 0x3, c1 = (occlusion >> 2) & 0x3,
+                  c2 = (occlusion >> 4) & 0x3, c3 = (occlusion >> 6) & 0x3;
+            return (c0 + c2) < (c1 + c3);
+        }
+
+        /// Converts a position in a face's plane (plane, u, v) to a chunk relative position.
+        static inline glm::ivec3 toPos(const uint8_t face, const int p, const int u, const int v) {
+            switch(face / 2) {
+                // top and bottom: u = x, v = z
+                case 0:
+                    return glm::ivec3(u, p, v);
+                // left and right: u = z, v = y
+                case 1:
+                    return glm::ivec3(p, v, u);
+                // front and back: u = x, v = y
+                default:
+                    return glm::ivec3(u, v, p);
+            }
+        }
+        /// Converts a chunk relative position to a position in the face's plane (plane, u, v).
+        static inline glm::ivec3 toPlane(const uint8_t face, const glm::ivec3 &pos) {
+            switch(face / 2) {
+                case 0:
+                    return glm::ivec3(pos.y, pos.x, pos.z);
+                case 1:
+                    return glm::ivec3(pos.x, pos.z, pos.y);
+                default:
+                    return glm::ivec3(pos.z, pos.x, pos.y);
+            }
+        }
+
+        /// Packs a chunk relative block position, for the model block set
+        static inline uint32_t blockKey(const glm::ivec3 &pos) {
+            return (pos.y << 16) | (pos.z << 8) | pos.x;
+        }
+
+    public:
+        /// positions of model blocks in the globule, as returned by `blockKey()`
+        std::unordered_set<uint32_t> models;
+
+    private:
+        static inline uint32_t planeKey(const uint8_t face, const int plane) {
+            return (face << 8) | (plane & 0xFF);
+        }
+
+        size_t layout(const std::vector<Quad> &quads);
+        void insert(const uint32_t slot, const Quad &quad);
+        void getDirtyRuns(const std::function<void(const uint32_t, const uint32_t)> &callback);
+
+    private:
+        /// quad stored in each slot; only valid if the slot is in use
+        std::vector<Quad> slots;
+        /// whether each slot holds a quad
+        std::vector<bool> used;
+        /// index of the first slot for alpha blended quads
+        size_t specialStart = 0;
+
+        /// unused slots, for normal and alpha blended quads
+        std::vector<uint32_t> freeSlots, freeSpecialSlots;
+        /// slots of the quads in each plane, keyed by face and plane coordinate
+        std::unordered_map<uint32_t, std::vector<uint32_t>> planes;
+
+        /// slots modified since the changes were last retrieved
+        std::vector<uint32_t> dirty;
+};
+}
+
+#endif
@@ -0,0 +1,1013 @@
+#include "Mesher.h"
+#include "GlobuleMesh.h"
+
+#include "world/block/BlockIds.h"
+#include "world/chunk/Chunk.h"
+#include "world/chunk/ChunkSlice.h"
+
+#include "io/Format.h"
+#include <Logging.h>
+
+#include <mutils/time/profiler.h>
+#include <uuid.h>
+
+#include <algorithm>
+#include <bit>
+#include <span>
+
+#include <glm/vector_relational.hpp>
+
+using namespace render::chunk;
+
+const std::array<glm::ivec3, 7> Mesher::kBlockOffsets = {
+    glm::ivec3(0, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, -1, 0),
+    glm::ivec3(0, 1, 0), glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1),
+};
+
+const std::array<glm::ivec3, 27> Mesher::kNeighborhoodOffsets = []() {
+    std::array<glm::ivec3, 27> offsets;
+    size_t i = 0;
+
+    for(int y = -1; y <= 1; y++) {
+        for(int z = -1; z <= 1; z++) {
+            for(int x = -1; x <= 1; x++) {
+                offsets[i++] = glm::ivec3(x, y, z);
+            }
+        }
+    }
+
+    return offsets;
+}();
+
+/**
+ * Creates a mesher. Its scratch buffers are allocated as globules are generated.
+ *
+ * @param source Provides the blocks; it must remain valid for as long as the mesher exists
+ * @param compactFaces Whether cube faces are output as face records, rather than vertices
+ * @param bakedOcclusion Whether the ambient occlusion of cube face corners is computed; faces are
+ * then only merged if their occlusion is the same across the entire face
+ */
+Mesher::Mesher(BlockSource *_source, const bool _greedyMeshing, const bool _compactFaces,
+        const bool _bakedOcclusion) : source(_source), greedyMeshing(_greedyMeshing),
+    compactFaces(_compactFaces), bakedOcclusion(_bakedOcclusion) {
+
+}
+
+/**
+ * Releases the scratch buffers.
+ */
+Mesher::~Mesher() = default;
+
+
+
+/**
+ * Builds the block lookup tables for all of the chunk's ID maps.
+ *
+ * @param neighbors Adjacent chunks, in the order X-1, X+1, Z-1, Z+1; any of them may be `nullptr`
+ * if it isn't loaded
+ */
+void Mesher::buildChunkMaps(BlockSource *source, const std::shared_ptr<world::Chunk> &chunk, const std::array<std::shared_ptr<world::Chunk>, 4> &neighbors, ChunkMaps &maps) {
+    // count IDs first, so that IDs added while we build the tables make them outdated
+    maps.usedIds = countUsedIds(chunk);
+
+    // convert the 8 bit block ID -> UUID maps into 8 bit ID -> block transparency
+    generateBlockIdMap(source, chunk, maps.exposure);
+
+    // convert the 8 bit -> UUID maps to 8 bit -> block instance maps
+    PROFILE_SCOPE(BuildBlockPtrMap);
+
+    maps.blocks.clear();
+    maps.blocks.reserve(chunk->sliceIdMaps.size());
+
+    for(const auto &map : chunk->sliceIdMaps) {
+        std::array<BlockAppearance *, 256> list;
+        std::fill(list.begin(), list.end(), nullptr);
+
+        for(size_t i = 0; i < list.size(); i++) {
+            const auto &id = map.idMap[i];
+            if(id.is_nil() || id == world::kAirBlockId) {
+                continue;
+            }
+
+            list[i] = source->getBlock(id);
+        }
+
+        maps.blocks.push_back(list);
+    }
+
+    // get the adjacent chunks' air maps, for culling faces on the chunk's edges
+    for(size_t i = 0; i < neighbors.size(); i++) {
+        auto &neighbor = maps.neighbors[i];
+        neighbor = neighbors[i];
+
+        if(neighbor) {
+            maps.neighborUsedIds[i] = countUsedIds(neighbor);
+            generateBlockIdMap(source, neighbor, maps.neighborExposure[i]);
+        } else {
+            maps.neighborUsedIds[i] = 0;
+            maps.neighborExposure[i].clear();
+        }
+    }
+}
+
+/**
+ * Checks whether block lookup tables still reflect the chunk's ID maps, and those of its
+ * neighbors. IDs are only ever added to ID maps, either in free slots or in new maps, so the
+ * tables are current as long as the number of IDs in use is unchanged.
+ *
+ * @param neighbors Adjacent chunks that are currently loaded, in the same order as for
+ * `buildChunkMaps()`
+ */
+bool Mesher::isCurrent(const std::shared_ptr<world::Chunk> &chunk, const std::array<std::shared_ptr<world::Chunk>, 4> &neighbors, const ChunkMaps &maps) {
+    if(maps.blocks.size() != chunk->sliceIdMaps.size() || maps.usedIds != countUsedIds(chunk)) {
+        return false;
+    }
+
+    for(size_t i = 0; i < neighbors.size(); i++) {
+        if(neighbors[i] != maps.neighbors[i]) return false;
+        if(neighbors[i] && maps.neighborUsedIds[i] != countUsedIds(neighbors[i])) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Counts the IDs in use across all of a chunk's ID maps.
+ */
+size_t Mesher::countUsedIds(const std::shared_ptr<world::Chunk> &chunk) {
+    size_t count = 0;
+
+    for(const auto &map : chunk->sliceIdMaps) {
+        count += std::count_if(map.idMap.begin(), map.idMap.end(), [](const auto &id) {
+            return !id.is_nil();
+        });
+    }
+
+    return count;
+}
+
+/**
+ * Generates the vertices and indices for the globule at the given origin.
+ *
+ * Cube faces are laid out by a `GlobuleMesh`, so the mesh can be patched later; they are followed
+ * by the vertices of any blocks with models.
+ *
+ * @param maps Block lookup tables for the chunk; they must have been built since the chunk's
+ * ID maps last changed
+ *
+ * @return Mesh of the globule, which remains valid until the mesher is used again
+ */
+const Mesher::Result &Mesher::generate(const std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &origin, const ChunkMaps &maps) {
+    PROFILE_SCOPE(GenerateGlobule);
+    // Logging::trace("Generating {} for {}", origin, (void *) chunk.get());
+
+    // counters
+    size_t numCulled = 0, numTotal = 0;
+    // get the chunk pos
+    const auto chunkPos = glm::ivec3(chunk->worldPos.x * 256, 0, chunk->worldPos.y * 256);
+
+    const auto &blockPtrMaps = maps.blocks;
+
+    // index data buffers; special indices are appended to the regular ones at the end
+    auto &out = this->result;
+    auto &indices = out.indices;
+    auto &indicesSpecial = this->indicesSpecial;
+    auto &vertices = out.vertices;
+
+    indices.clear();
+    indicesSpecial.clear();
+    vertices.clear();
+    out.faces.clear();
+
+    out.specialIdxOffset = out.specialFaceOffset = 0;
+    out.numFaces = out.numQuads = out.numModels = 0;
+
+    // cube faces and models are collected separately, then laid out at the end
+    auto &quads = this->quads;
+    auto &modelVertices = this->modelVertices;
+    auto &modelIndices = this->modelIndices;
+    auto &modelIndicesSpecial = this->modelIndicesSpecial;
+
+    quads.clear();
+    modelVertices.clear();
+    modelIndices.clear();
+    modelIndicesSpecial.clear();
+
+    auto mesh = std::make_shared<GlobuleMesh>();
+    out.mesh = mesh;
+
+    // when greedy meshing, cube blocks are collected here and turned into quads at the end
+    auto &greedy = this->greedy;
+
+    if(this->greedyMeshing) {
+        if(!greedy) {
+            greedy = std::make_unique<GreedyGrid>(this->bakedOcclusion);
+        } else {
+            std::fill(greedy->cells.begin(), greedy->cells.end(), 0);
+        }
+    }
+
+    // initial air map filling; the layer below comes from the globule below, if any
+    auto &am = this->airMap;
+    this->buildAirLayer(chunk, maps, origin, origin.y - 1, am.below);
+    this->buildAirLayer(chunk, maps, origin, origin.y, am.current);
+    this->buildAirLayer(chunk, maps, origin, origin.y + 1, am.above);
+
+    // update the actual instance buffer itself
+    {
+        PROFILE_SCOPE(ProcessSlices);
+        const size_t yMax = origin.y + 63;
+        for(size_t y = origin.y; y <= yMax; y++) {
+            // if there's no blocks at this Y level, check the next one
+            auto slice = chunk->slices[y];
+            if(!slice) {
+                goto nextRow;
+            }
+
+            // the bottom and top of the world are always exposed
+            {
+                const auto &cur = am.current;
+                const uint64_t bottom = (y == 0) ? ~0ULL : 0, top = ((y + 1) >= 255) ? ~0ULL : 0;
+
+                // iterate over each of the globule's rows
+                for(size_t i = 0; i < 64; i++) {
+                    // skip rows without any blocks to draw
+                    const uint64_t drawn = cur.drawn[i];
+                    if(!drawn) {
+                        continue;
+                    }
+
+                    const size_t z = origin.z + i;
+                    auto row = slice->rows[z];
+
+                    // find the faces of each block next to air, even across globule and chunk
+                    // boundaries; bit N of each mask is the block at X = origin.x + N
+                    const uint64_t air = cur.rows[i + 1];
+                    const uint64_t faceMasks[6] = {
+                        drawn & am.below.rows[i + 1],
+                        drawn & am.above.rows[i + 1],
+                        drawn & ((air << 1) | ((cur.left >> i) & 1)),
+                        drawn & ((air >> 1) | (((cur.right >> i) & 1) << 63)),
+                        drawn & cur.rows[i],
+                        drawn & cur.rows[i + 2],
+                    };
+
+                    const uint64_t visible = faceMasks[0] | faceMasks[1] | faceMasks[2] |
+                        faceMasks[3] | faceMasks[4] | faceMasks[5];
+                    numCulled += std::popcount(drawn & ~visible);
+
+                    // process each visible block in this row
+                    const auto &blockMap = blockPtrMaps[row->typeMap];
+
+                    for(uint64_t bits = visible; bits; bits &= (bits - 1)) {
+                        const size_t bit = std::countr_zero(bits);
+                        const size_t x = origin.x + bit;
+
+                        auto &block = blockMap[row->at(x)];
+                        if(!block) {
+                            continue;
+                        }
+                        numTotal++;
+
+                        // figure out what edges are exposed
+                        uint8_t faces = 0;
+                        for(uint8_t face = 0; face < 6; face++) {
+                            faces |= ((faceMasks[face] >> bit) & 1) << face;
+                        }
+
+                        faces |= ((bottom >> bit) & 1) << 0;
+                        faces |= ((top >> bit) & 1) << 1;
+
+                        out.numFaces += std::popcount(faces);
+
+                        const auto flags = flagsForFaces(faces);
+
+                        // ambient occlusion of each exposed face; nothing below the world occludes
+                        std::array<uint8_t, 6> occlusion;
+                        occlusion.fill(Quad::kUnoccluded);
+
+                        if(this->bakedOcclusion) {
+                            auto isSolid = [&](const int dx, const int dy, const int dz) {
+                                if(dy < 0 && y == 0) return false;
+
+                                const auto &layer = (dy < 0) ? am.below : ((dy > 0) ? am.above : cur);
+                                return !layer.isAir(int(bit) + dx, int(i) + dz);
+                            };
+
+                            for(uint8_t face = 0; face < 6; face++) {
+                                if(faces & (1 << face)) {
+                                    occlusion[face] = faceOcclusion(face, isSolid);
+                                }
+                            }
+                        }
+
+                        // determine block data ID
+                        const auto worldPos = glm::ivec3(x, y, z) + chunkPos;
+                        const uint16_t type = block->getBlockId(worldPos, flags);
+
+                        // append the vertices for this block
+                        const uint16_t model = block->getModelId(worldPos, flags);
+
+                        const bool special = block->needsAlphaBlending(worldPos);
+
+                        if(model == 0 && this->greedyMeshing) {
+                            auto &cell = greedy->at(bit, y - origin.y, i);
+
+                            cell = type | (special ? GreedyGrid::kSpecial : 0) |
+                                (static_cast<uint32_t>(faces) << GreedyGrid::kFaceShift);
+
+                            if(this->bakedOcclusion) {
+                                greedy->occlusionAt(bit, y - origin.y, i) = occlusion;
+                            }
+                        } else if(model == 0) {
+                            this->insertCubeQuads(quads, x, y, z, faces, type, special, occlusion);
+                        } else if(auto modelData = this->source->getModel(model)) {
+                            this->insertModelVertices(modelVertices,
+                                    special ? modelIndicesSpecial : modelIndices, x, y, z, type,
+                                    *modelData);
+                            mesh->models.insert(GlobuleMesh::blockKey(glm::ivec3(x, y, z)));
+                            out.numModels++;
+
+                            block->blockWillDisplay(worldPos);
+                        } else {
+                            XASSERT(false, "Unknown model id ${:04x} for block {}", model, worldPos);
+                        }
+                    }
+                }
+            }
+
+            // set up for processing the next row
+    nextRow:;
+            if(y != yMax) {
+                std::swap(am.below, am.current);
+                std::swap(am.current, am.above);
+                this->buildAirLayer(chunk, maps, origin, y + 2, am.above);
+            }
+        }
+
+        // merge the faces of all cube blocks
+        if(this->greedyMeshing) {
+            PROFILE_SCOPE(GreedyMerge);
+            this->insertGreedyQuads(*greedy, origin, (yMax - origin.y) + 1, quads);
+        }
+    }
+
+    // lay out the cube faces (leaving room for patching) followed by the models; in the compact
+    // format, cube faces are stored as records instead, so the vertices only contain models
+    out.numQuads = quads.size();
+
+    if(!quads.empty() || !modelVertices.empty()) {
+        PROFILE_SCOPE(BuildMesh);
+
+        if(this->compactFaces) {
+            mesh->build(quads, out.faces);
+            out.specialFaceOffset = mesh->getSpecialStart();
+        } else {
+            mesh->build(quads, vertices, indices, indicesSpecial);
+        }
+
+        const uint32_t base = vertices.size();
+        vertices.insert(vertices.end(), modelVertices.begin(), modelVertices.end());
+
+        for(const auto index : modelIndices) {
+            indices.push_back(index + base);
+        }
+        for(const auto index : modelIndicesSpecial) {
+            indicesSpecial.push_back(index + base);
+        }
+    }
+
+    // insert the special indices if needed
+    if(indicesSpecial.size()) {
+        out.specialIdxOffset = indices.size();
+        indices.insert(indices.end(), indicesSpecial.begin(), indicesSpecial.end());
+    }
+
+    return out;
+}
+
+/**
+ * Patches the mesh of a globule after blocks have changed.
+ *
+ * All quads covering a face of an affected block (the changed blocks and their neighbors) are
+ * removed; the parts of them that cover other blocks are added back. Then, the current exposed
+ * faces of all affected blocks are added as new quads. The modified slots can then be retrieved
+ * from the mesh.
+ *
+ * @param blocks Chunk relative positions of the changed blocks; they may be outside the globule
+ *
+ * @return Whether the mesh was patched. If not, the globule needs to be generated entirely; this
+ * is the case if model blocks are involved, or if the mesh ran out of free slots.
+ */
+bool Mesher::patch(const std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &origin, const ChunkMaps &maps, GlobuleMesh &mesh, const std::vector<glm::ivec3> &blocks) {
+    PROFILE_SCOPE(PatchGlobule);
+
+    // find the affected blocks inside the globule, and evaluate their current state
+    std::vector<PatchBlock> affected;
+
+    // with baked occlusion, the faces of all blocks around the changed one may be darkened by it
+    const std::span<const glm::ivec3> offsets = this->bakedOcclusion ?
+        std::span<const glm::ivec3>(kNeighborhoodOffsets) : std::span<const glm::ivec3>(kBlockOffsets);
+
+    for(const auto &changed : blocks) {
+        for(const auto &offset : offsets) {
+            const auto p = changed + offset;
+            if(glm::any(glm::lessThan(p, origin)) ||
+               glm::any(glm::greaterThanEqual(p, origin + glm::ivec3(64)))) {
+                continue;
+            }
+
+            if(std::find_if(affected.begin(), affected.end(), [&](const auto &b) {
+                return b.pos == p;
+            }) != affected.end()) {
+                continue;
+            }
+
+            PatchBlock block;
+            block.pos = p;
+            this->evaluateBlock(chunk, maps, block);
+
+            // model blocks aren't tracked by the mesh
+            if(block.model || mesh.models.contains(GlobuleMesh::blockKey(p))) {
+                return false;
+            }
+
+            affected.push_back(block);
+        }
+    }
+
+    // remove all quads covering the affected blocks; keep the parts that cover other blocks
+    std::vector<uint32_t> slots;
+    std::vector<Quad> quads;
+
+    for(const auto &block : affected) {
+        for(uint8_t face = 0; face < 6; face++) {
+            mesh.find(face, block.pos, slots);
+        }
+    }
+
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+    for(const auto slot : slots) {
+        const auto quad = mesh.get(slot);
+        mesh.remove(slot);
+
+        this->splitQuad(quad, affected, quads);
+    }
+
+    // then, add the current faces of the affected blocks
+    for(const auto &block : affected) {
+        for(uint8_t face = 0; face < 6; face++) {
+            if(!(block.faces & (1 << face))) continue;
+
+            quads.push_back({
+                .pos = glm::u8vec3(block.pos), .size = glm::u8vec3(1), .face = face,
+                .special = block.special, .blockId = block.type,
+                .occlusion = block.occlusion[face]
+            });
+        }
+    }
+
+    for(const auto &quad : quads) {
+        if(!mesh.add(quad)) return false;
+    }
+
+    return true;
+}
+
+
+
+/**
+ * Generates the mapping of 8-bit block ids to whether they're air or not
+ */
+void Mesher::generateBlockIdMap(BlockSource *source, const std::shared_ptr<world::Chunk> &c, ExposureMaps &maps) {
+    maps.clear();
+    maps.reserve(c->sliceIdMaps.size());
+
+    // iterate over each input ID map...
+    for(const auto &map : c->sliceIdMaps) {
+        PROFILE_SCOPE(ProcessMap);
+
+        // all blocks should be air by default
+        std::array<bool, 256> isAir;
+        std::fill(isAir.begin(), isAir.end(), true);
+
+        // then, check each of the UUIDs
+        for(size_t i = 0; i < map.idMap.size(); i++) {
+            const auto &uuid = map.idMap[i];
+
+            // skip if nil UUID
+            if(uuid.is_nil()) {
+                continue;
+            }
+
+            // query the block registry if this is an opaque block
+            isAir[i] = !source->isOpaqueBlock(uuid);
+        }
+
+        maps.push_back(isAir);
+    }
+}
+
+/**
+ * Builds the air map of the given Y layer, for the globule at the given origin and the blocks
+ * bordering it; those may be in the neighboring chunks. Layers outside the chunk, and blocks of
+ * chunks that aren't loaded, are considered to be air. Once such a chunk is loaded, the border
+ * globules facing it are generated again.
+ */
+void Mesher::buildAirLayer(const std::shared_ptr<world::Chunk> &chunk, const ChunkMaps &maps, const glm::ivec3 &origin, const int y, AirMap::Layer &layer) {
+    PROFILE_SCOPE(BuildAirLayer);
+
+    // below the world, nothing is air; bottom faces are exposed separately
+    if(y < 0) {
+        layer.fill(false);
+        return;
+    }
+    // if the slice is empty (e.g. nonexistent,) bail; the entire thing is air
+    else if(y >= (int) chunk->slices.size() || !chunk->slices[y]) {
+        layer.fill(true);
+        return;
+    }
+
+    auto slice = chunk->slices[y];
+
+    auto neighborSlice = [&](const size_t i) -> world::ChunkSlice * {
+        const auto &neighbor = maps.neighbors[i];
+        return neighbor ? neighbor->slices[y] : nullptr;
+    };
+
+    // the globule's rows; only these have blocks that are drawn
+    for(size_t i = 0; i < 64; i++) {
+        layer.rows[i + 1] = this->rowAirMask(slice->rows[origin.z + i], maps.exposure, origin.x,
+                &maps.blocks, &layer.drawn[i]);
+    }
+
+    // rows bordering it on Z
+    if(origin.z == 0) {
+        auto other = neighborSlice(2);
+        layer.rows[0] = other ? this->rowAirMask(other->rows[255], maps.neighborExposure[2], origin.x) : ~0ULL;
+    } else {
+        layer.rows[0] = this->rowAirMask(slice->rows[origin.z - 1], maps.exposure, origin.x);
+    }
+
+    if(origin.z == 192) {
+        auto other = neighborSlice(3);
+        layer.rows[65] = other ? this->rowAirMask(other->rows[0], maps.neighborExposure[3], origin.x) : ~0ULL;
+    } else {
+        layer.rows[65] = this->rowAirMask(slice->rows[origin.z + 64], maps.exposure, origin.x);
+    }
+
+    // and the columns bordering it on X
+    if(origin.x == 0) {
+        auto other = neighborSlice(0);
+        layer.left = other ? this->columnAirMask(other, maps.neighborExposure[0], 255, origin.z) : ~0ULL;
+    } else {
+        layer.left = this->columnAirMask(slice, maps.exposure, origin.x - 1, origin.z);
+    }
+
+    if(origin.x == 192) {
+        auto other = neighborSlice(1);
+        layer.right = other ? this->columnAirMask(other, maps.neighborExposure[1], 0, origin.z) : ~0ULL;
+    } else {
+        layer.right = this->columnAirMask(slice, maps.exposure, origin.x + 64, origin.z);
+    }
+
+    // the diagonal corners are only needed for ambient occlusion
+    layer.corners = 0xF;
+
+    if(this->bakedOcclusion) {
+        for(uint8_t i = 0; i < 4; i++) {
+            const glm::ivec3 pos(origin.x + ((i & 1) ? 64 : -1), y, origin.z + ((i & 2) ? 64 : -1));
+
+            if(!this->isAirAt(chunk, maps, pos)) {
+                layer.corners &= ~(1 << i);
+            }
+        }
+    }
+}
+
+/**
+ * Gets the air mask of the 64 blocks of a row, starting at the given X coordinate. Bit N is set
+ * if the block at X + N is air.
+ *
+ * @param blocks If specified, a mask of the blocks that are drawn is written to `outDrawn`.
+ */
+uint64_t Mesher::rowAirMask(world::ChunkSliceRow *row, const ExposureMaps &exposure, const size_t x, const BlockMaps *blocks, uint64_t *outDrawn) {
+    if(outDrawn) *outDrawn = 0;
+
+    // the chunk may have gained ID maps since we built its air maps
+    if(!row || row->typeMap >= exposure.size()) {
+        return ~0ULL;
+    }
+
+    const auto &isAir = exposure[row->typeMap];
+    uint64_t air = 0;
+
+    if(blocks) {
+        const auto &blockMap = (*blocks)[row->typeMap];
+        uint64_t drawn = 0;
+
+        for(size_t i = 0; i < 64; i++) {
+            const auto id = row->at(x + i);
+            air |= static_cast<uint64_t>(isAir[id]) << i;
+            drawn |= static_cast<uint64_t>(blockMap[id] != nullptr) << i;
+        }
+
+        *outDrawn = drawn;
+    } else {
+        for(size_t i = 0; i < 64; i++) {
+            air |= static_cast<uint64_t>(isAir[row->at(x + i)]) << i;
+        }
+    }
+
+    return air;
+}
+
+/**
+ * Gets the air mask of the 64 blocks of a column, starting at the given Z coordinate. Bit N is
+ * set if the block at Z + N is air.
+ */
+uint64_t Mesher::columnAirMask(world::ChunkSlice *slice, const ExposureMaps &exposure, const size_t x, const size_t z) {
+    uint64_t air = 0;
+
+    for(size_t i = 0; i < 64; i++) {
+        auto row = slice->rows[z + i];
+
+        if(!row || row->typeMap >= exposure.size() || exposure[row->typeMap][row->at(x)]) {
+            air |= (1ULL << i);
+        }
+    }
+
+    return air;
+}
+
+/**
+ * Checks whether the block at the given position in a neighboring chunk is air.
+ *
+ * @param i Index of the neighbor in the chunk maps
+ */
+bool Mesher::isNeighborAir(const ChunkMaps &maps, const size_t i, const size_t x, const size_t y, const size_t z) {
+    const auto &chunk = maps.neighbors[i];
+    if(!chunk) return true;
+
+    auto slice = chunk->slices[y];
+    if(!slice) return true;
+    auto row = slice->rows[z];
+    if(!row) return true;
+
+    // the chunk may have gained ID maps since we built its air maps
+    const auto &exposure = maps.neighborExposure[i];
+    if(row->typeMap >= exposure.size()) return true;
+
+    return exposure[row->typeMap][row->at(x)];
+}
+
+/**
+ * Converts a mask of exposed faces to the block flags for them. Bit N of the mask is set if face
+ * N is exposed.
+ */
+BlockAppearance::BlockFlags Mesher::flagsForFaces(const uint8_t faces) {
+    BlockAppearance::BlockFlags flags = BlockAppearance::kFlagsNone;
+
+    if(faces & (1 << 0)) flags |= BlockAppearance::kExposedYMinus;
+    if(faces & (1 << 1)) flags |= BlockAppearance::kExposedYPlus;
+    if(faces & (1 << 2)) flags |= BlockAppearance::kExposedXMinus;
+    if(faces & (1 << 3)) flags |= BlockAppearance::kExposedXPlus;
+    if(faces & (1 << 4)) flags |= BlockAppearance::kExposedZMinus;
+    if(faces & (1 << 5)) flags |= BlockAppearance::kExposedZPlus;
+
+    return flags;
+}
+
+/**
+ * Computes the ambient occlusion of the four corners of a block's face. Each corner is darkened by
+ * the blocks in front of the face that touch it: the two along its edges, and the one diagonally
+ * across from it. If both edge blocks are solid, the corner is fully occluded.
+ *
+ * @param isSolid Invoked with the offset of a block, relative to the face's block, to determine
+ * whether it's solid
+ *
+ * @return Occlusion of the corners, 2 bits each in vertex ID order; 3 is unoccluded
+ */
+template<typename F> uint8_t Mesher::faceOcclusion(const uint8_t face, F &&isSolid) {
+    // offset to the block in front of each face
+    static const glm::ivec3 kNormals[6] = {
+        {0, -1, 0}, {0, 1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 0, -1}, {0, 0, 1},
+    };
+
+    const auto &n = kNormals[face];
+    const size_t axis = (face < 2) ? 1 : ((face < 4) ? 0 : 2);
+    const size_t a1 = (axis == 0) ? 1 : 0, a2 = (axis == 2) ? 1 : 2;
+
+    uint8_t occlusion = 0;
+
+    for(uint8_t i = 0; i < 4; i++) {
+        const auto &corner = GlobuleMesh::kFaceCorners[face][i];
+
+        glm::ivec3 e1(0), e2(0);
+        e1[a1] = corner[a1] ? 1 : -1;
+        e2[a2] = corner[a2] ? 1 : -1;
+
+        const bool side1 = isSolid(n.x + e1.x, n.y + e1.y, n.z + e1.z);
+        const bool side2 = isSolid(n.x + e2.x, n.y + e2.y, n.z + e2.z);
+        const auto d = n + e1 + e2;
+
+        uint8_t value = 0;
+        if(!(side1 && side2)) {
+            value = 3 - (side1 + side2 + isSolid(d.x, d.y, d.z));
+        }
+
+        occlusion |= (value << (i * 2));
+    }
+
+    return occlusion;
+}
+
+/**
+ * For a visible (e.g. at least one exposed face) block at the given coordinates, insert a quad
+ * for each of its exposed faces.
+ *
+ * Note that this works only for FULLY SOLID blocks, e.g. ones where they want to look like a
+ * textured cube.
+ *
+ * @param faces Exposed faces of the block; bit N is set if face N is exposed
+ * @param occlusion Ambient occlusion of each face
+ */
+void Mesher::insertCubeQuads(std::vector<Quad> &quads, const size_t x, const size_t y, const size_t z, const uint8_t faces, const uint16_t blockId, const bool special, const std::array<uint8_t, 6> &occlusion) {
+    const glm::u8vec3 pos(x, y, z);
+
+    for(uint8_t face = 0; face < 6; face++) {
+        if(faces & (1 << face)) {
+            quads.push_back({
+                .pos = pos, .size = glm::u8vec3(1), .face = face, .special = special,
+                .blockId = blockId, .occlusion = occlusion[face]
+            });
+        }
+    }
+}
+
+/**
+ * Merges the exposed faces of all cube blocks in the globule into as few quads as possible.
+ *
+ * For each face direction, every plane of the globule perpendicular to it is processed. Starting
+ * at the first exposed face that hasn't been merged yet, we extend a quad as far as possible along
+ * the first axis of the plane, then along the second, as long as all faces it covers have the same
+ * block data ID and alpha blending mode. Those faces are then marked as merged.
+ *
+ * With baked occlusion, faces also need the same occlusion to be merged; and since it's
+ * interpolated across the quad, faces whose corners aren't occluded equally aren't merged at all.
+ *
+ * @param numLayers Number of Y layers in the grid that contain blocks
+ */
+void Mesher::insertGreedyQuads(GreedyGrid &grid, const glm::ivec3 &origin, const size_t numLayers, std::vector<Quad> &quads) {
+    for(uint8_t face = 0; face < 6; face++) {
+        const uint32_t faceBit = (1 << (GreedyGrid::kFaceShift + face));
+        const size_t axis = face / 2;
+
+        // get the size of the planes, and a mapping of (plane, u, v) to globule coordinates
+        const size_t numPlanes = (axis == 0) ? numLayers : 64;
+        const size_t uSize = 64, vSize = (axis == 0) ? 64 : numLayers;
+
+        auto toPos = [axis](const size_t p, const size_t u, const size_t v) -> glm::ivec3 {
+            switch(axis) {
+                // top and bottom: u = x, v = z
+                case 0:
+                    return glm::ivec3(u, p, v);
+                // left and right: u = z, v = y
+                case 1:
+                    return glm::ivec3(p, v, u);
+                // front and back: u = x, v = y
+                default:
+                    return glm::ivec3(u, v, p);
+            }
+        };
+        auto keyAt = [&](const size_t p, const size_t u, const size_t v) -> uint64_t {
+            const auto pos = toPos(p, u, v);
+            const auto cell = grid.at(pos.x, pos.y, pos.z);
+            if(!(cell & faceBit)) return 0;
+
+            const uint8_t occlusion = this->bakedOcclusion ?
+                grid.occlusionAt(pos.x, pos.y, pos.z)[face] : Quad::kUnoccluded;
+
+            return (cell & GreedyGrid::kKeyMask) | faceBit | (static_cast<uint64_t>(occlusion) << 32);
+        };
+
+        for(size_t p = 0; p < numPlanes; p++) {
+            for(size_t v = 0; v < vSize; v++) {
+                for(size_t u = 0; u < uSize; u++) {
+                    const auto key = keyAt(p, u, v);
+                    if(!key) continue;
+
+                    const uint8_t occlusion = (key >> 32) & 0xFF;
+                    const bool uniform = (occlusion == ((occlusion & 0x3) * 0x55));
+
+                    // extend along u, then along v while the entire span matches
+                    size_t w = 1, h = 1;
+
+                    if(uniform) {
+                        while((u + w) < uSize && keyAt(p, u + w, v) == key) {
+                            w++;
+                        }
+
+                        for(; (v + h) < vSize; h++) {
+                            for(size_t i = 0; i < w; i++) {
+                                if(keyAt(p, u + i, v + h) != key) goto extended;
+                            }
+                        }
+                    }
+extended:;
+
+                    // mark the covered faces as merged
+                    for(size_t j = 0; j < h; j++) {
+                        for(size_t i = 0; i < w; i++) {
+                            const auto pos = toPos(p, u + i, v + j);
+                            grid.at(pos.x, pos.y, pos.z) &= ~faceBit;
+                        }
+                    }
+
+                    // emit the quad
+                    quads.push_back({
+                        .pos = glm::u8vec3(origin + toPos(p, u, v)),
+                        .size = glm::u8vec3(toPos(1, w, h)), .face = face,
+                        .special = (key & GreedyGrid::kSpecial) != 0,
+                        .blockId = static_cast<uint16_t>(key & 0xFFFF), .occlusion = occlusion
+                    });
+
+                    u += (w - 1);
+                }
+            }
+        }
+    }
+}
+
+void Mesher::insertModelVertices(std::vector<BlockVertex> &vertices, std::vector<uint32_t> &indices, const size_t x, const size_t y, const size_t z, const uint16_t blockId, const BlockModel &model) {
+    // model faces show their texture exactly once; the repeat coordinate is the vertex' corner
+    static const glm::u8vec2 kModelTiles[4] = {
+        {0, 0}, {1, 0}, {1, 1}, {0, 1},
+    };
+
+    const uint16_t f = BlockVertex::kPointFactor;
+    const glm::i16vec3 origin(x * f, y * f, z * f);
+
+    uint32_t iVtx = vertices.size();
+
+    // create vertices
+    for(size_t i = 0; i < model.vertices.size(); i++) {
+        const auto &vtx = model.vertices[i];
+        const auto &faceInfo = model.faceVertIds[i];
+
+        const auto pos = origin + glm::i16vec3(vtx * glm::vec3(f));
+
+        const BlockVertex vtxData = {
+            .p = pos, .blockId = blockId, .face = faceInfo.first, .vertexId = faceInfo.second,
+            .tile = kModelTiles[faceInfo.second & 3]
+        };
+        vertices.push_back(vtxData);
+    }
+
+    // copy the indices
+    for(size_t i = 0; i < model.indices.size(); i++) {
+        indices.emplace_back(model.indices[i] + iVtx);
+    }
+}
+
+
+
+/**
+ * Determines the exposed faces and block data ID of the block at the given position, the same way
+ * as when generating the entire globule.
+ */
+void Mesher::evaluateBlock(const std::shared_ptr<world::Chunk> &chunk, const ChunkMaps &maps, PatchBlock &out) {
+    const auto &pos = out.pos;
+
+    // get the block; skip air
+    auto slice = chunk->slices[pos.y];
+    if(!slice) return;
+    auto row = slice->rows[pos.z];
+    if(!row || row->typeMap >= maps.blocks.size()) return;
+
+    const auto temp = row->at(pos.x);
+    auto block = maps.blocks[row->typeMap][temp];
+    if(!block) return;
+
+    // skip it if it's not visible
+    const bool above = this->isAirAt(chunk, maps, pos + glm::ivec3(0, 1, 0));
+    const bool below = pos.y > 0 && this->isAirAt(chunk, maps, pos - glm::ivec3(0, 1, 0));
+    const bool xMinus = this->isAirAt(chunk, maps, pos - glm::ivec3(1, 0, 0));
+    const bool xPlus = this->isAirAt(chunk, maps, pos + glm::ivec3(1, 0, 0));
+    const bool zMinus = this->isAirAt(chunk, maps, pos - glm::ivec3(0, 0, 1));
+    const bool zPlus = this->isAirAt(chunk, maps, pos + glm::ivec3(0, 0, 1));
+
+    if(!(above || below || xMinus || xPlus || zMinus || zPlus)) return;
+
+    // get exposed faces and flags
+    if(pos.y == 0 || below) out.faces |= (1 << 0);
+    if((pos.y + 1) >= 255 || above) out.faces |= (1 << 1);
+    if(xMinus) out.faces |= (1 << 2);
+    if(xPlus) out.faces |= (1 << 3);
+    if(zMinus) out.faces |= (1 << 4);
+    if(zPlus) out.faces |= (1 << 5);
+
+    const auto flags = flagsForFaces(out.faces);
+
+    // and the occlusion of those faces
+    out.occlusion.fill(Quad::kUnoccluded);
+
+    if(this->bakedOcclusion) {
+        auto isSolid = [&](const int dx, const int dy, const int dz) {
+            if(dy < 0 && pos.y == 0) return false;
+            return !this->isAirAt(chunk, maps, pos + glm::ivec3(dx, dy, dz));
+        };
+
+        for(uint8_t face = 0; face < 6; face++) {
+            if(out.faces & (1 << face)) {
+                out.occlusion[face] = faceOcclusion(face, isSolid);
+            }
+        }
+    }
+
+    // get the block's data ID
+    const auto worldPos = pos + glm::ivec3(chunk->worldPos.x * 256, 0, chunk->worldPos.y * 256);
+
+    out.type = block->getBlockId(worldPos, flags);
+    out.model = (block->getModelId(worldPos, flags) != 0);
+    out.special = block->needsAlphaBlending(worldPos);
+}
+
+/**
+ * Checks whether the block at the given chunk relative position is air. Positions one block
+ * outside the chunk are looked up in the neighboring chunks, except for those diagonally across
+ * from its corners; these are always considered to be air.
+ */
+bool Mesher::isAirAt(const std::shared_ptr<world::Chunk> &chunk, const ChunkMaps &maps, const glm::ivec3 &pos) {
+    if(pos.y < 0 || pos.y >= (int) world::Chunk::kMaxY) return true;
+
+    // diagonally adjacent chunks aren't loaded for meshing
+    if((pos.x < 0 || pos.x > 255) && (pos.z < 0 || pos.z > 255)) return true;
+
+    if(pos.x < 0) return this->isNeighborAir(maps, 0, pos.x + 256, pos.y, pos.z);
+    if(pos.x > 255) return this->isNeighborAir(maps, 1, pos.x - 256, pos.y, pos.z);
+    if(pos.z < 0) return this->isNeighborAir(maps, 2, pos.x, pos.y, pos.z + 256);
+    if(pos.z > 255) return this->isNeighborAir(maps, 3, pos.x, pos.y, pos.z - 256);
+
+    auto slice = chunk->slices[pos.y];
+    if(!slice) return true;
+    auto row = slice->rows[pos.z];
+    if(!row || row->typeMap >= maps.exposure.size()) return true;
+
+    return maps.exposure[row->typeMap][row->at(pos.x)];
+}
+
+/**
+ * Splits a quad into the fewest rectangles that cover all of its blocks, except those that are
+ * affected by a patch.
+ */
+void Mesher::splitQuad(const Quad &quad, const std::vector<PatchBlock> &affected, std::vector<Quad> &out) {
+    const auto face = quad.face;
+    const auto min = GlobuleMesh::toPlane(face, glm::ivec3(quad.pos));
+    const auto size = GlobuleMesh::toPlane(face, glm::ivec3(quad.size));
+    const int w = size.y, h = size.z;
+
+    // mark the blocks still covered by the quad
+    std::vector<bool> covered(w * h, true);
+
+    for(const auto &block : affected) {
+        const auto p = GlobuleMesh::toPlane(face, block.pos) - min;
+        if(p.x || p.y < 0 || p.y >= w || p.z < 0 || p.z >= h) continue;
+
+        covered[(p.z * w) + p.y] = false;
+    }
+
+    // then, cover them with rectangles
+    for(int v = 0; v < h; v++) {
+        for(int u = 0; u < w; u++) {
+            if(!covered[(v * w) + u]) continue;
+
+            int rw = 1, rh = 1;
+            while((u + rw) < w && covered[(v * w) + u + rw]) {
+                rw++;
+            }
+
+            for(; (v + rh) < h; rh++) {
+                for(int i = 0; i < rw; i++) {
+                    if(!covered[((v + rh) * w) + u + i]) goto extended;
+                }
+            }
+extended:;
+
+            for(int j = 0; j < rh; j++) {
+                for(int i = 0; i < rw; i++) {
+                    covered[((v + j) * w) + u + i] = false;
+                }
+            }
+
+            auto remnant = quad;
+            remnant.pos = glm::u8vec3(GlobuleMesh::toPos(face, min.x, min.y + u, min.z + v));
+            remnant.size = glm::u8vec3(GlobuleMesh::toPos(face, 1, rw, rh));
+            out.push_back(remnant);
+
+            u += (rw - 1);
+        }
+    }
+}
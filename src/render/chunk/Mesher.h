@@ -0,0 +1,297 @@
+/**
+ * Builds the vertex and index data of globules on the CPU.
+ */
+#ifndef RENDER_CHUNK_MESHER_H
+#define RENDER_CHUNK_MESHER_H
+
+#include "BlockAppearance.h"
+
+#include "world/chunk/Chunk.h"
+
+#include <memory>
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+namespace world {
+struct ChunkSlice;
+struct ChunkSliceRow;
+}
+
+namespace render::chunk {
+class GlobuleMesh;
+
+/**
+ * Turns the blocks of a globule into vertices and indices, ready to be uploaded into buffers.
+ *
+ * The mesher doesn't depend on any OpenGL or UI code: blocks are accessed through a block source,
+ * and chunks are read directly. This way, it can also be used (and benchmarked) without a window.
+ *
+ * Meshers keep their scratch buffers between globules, so they aren't thread safe; each thread
+ * should use its own. The chunk maps may be shared between threads, however.
+ */
+class Mesher {
+    public:
+        /// Vertices used to render blocks
+        struct BlockVertex {
+            constexpr static const uint16_t kPointFactor = 0x7F;
+
+            /// vertex position, each value is multiplied by kPointFactor
+            glm::i16vec3 p;
+            uint16_t blockId;
+            uint8_t face;
+            uint8_t vertexId;
+            /// texture repeat coordinate; the face's texture is tiled once per unit
+            glm::u8vec2 tile;
+            /// baked ambient occlusion, from 0 (fully occluded) to 3 (unoccluded)
+            uint8_t occlusion = 3;
+        };
+
+        /// A cube face, possibly merged across multiple blocks
+        struct Quad {
+            /// minimum corner of the covered blocks, relative to the chunk
+            glm::u8vec3 pos;
+            /// number of blocks covered along each axis; it's 1 along the face's normal
+            glm::u8vec3 size;
+            /// face index, as used by the vertex shader
+            uint8_t face;
+            /// whether the face needs alpha blending
+            bool special = false;
+            /// block data ID
+            uint16_t blockId;
+            /// ambient occlusion of the four corners, 2 bits each in vertex ID order
+            uint8_t occlusion = kUnoccluded;
+
+            /// occlusion value of a quad whose corners are all unoccluded
+            constexpr static const uint8_t kUnoccluded = 0xFF;
+        };
+
+        /**
+         * A cube face (or merged quad) in the compact output format. Rather than four vertices and
+         * six indices, each face is a single record; the vertex shader reads these out of a
+         * buffer texture, and expands each into two triangles.
+         */
+        struct FaceRecord {
+            /// chunk relative position of the minimum corner (8 bits each for X, Y, Z), then the
+            /// ambient occlusion of the corners in the top 8 bits
+            uint32_t position = 0;
+            /// block data ID in the low 16 bits, followed by the number of blocks along the
+            /// face's two edges minus one (6 bits each, see `GlobuleMesh::packQuad()`) and the
+            /// face index in bits 28-30. Unused records have a block data ID of 0.
+            uint32_t info = 0;
+        };
+
+        using ExposureMaps = std::vector<std::array<bool, 256>>;
+        using BlockMaps = std::vector<std::array<BlockAppearance *, 256>>;
+
+        /// Block lookup tables derived from a chunk's ID maps
+        struct ChunkMaps {
+            /// for each ID map, whether each 8-bit ID is air
+            ExposureMaps exposure;
+            /// for each ID map, the block instance for each 8-bit ID
+            BlockMaps blocks;
+
+            /// adjacent chunks, if loaded, in the order X-1, X+1, Z-1, Z+1
+            std::array<std::shared_ptr<world::Chunk>, 4> neighbors;
+            /// air maps for each of the neighboring chunks' ID maps
+            std::array<ExposureMaps, 4> neighborExposure;
+
+            /// number of IDs in use across the ID maps of the chunk, and of each neighbor, when
+            /// the tables were built; see `isCurrent()`
+            size_t usedIds = 0;
+            std::array<size_t, 4> neighborUsedIds{};
+        };
+
+        /**
+         * Mesh of a globule. The vectors are reused for the next globule, so they're only valid
+         * until the mesher is used again.
+         */
+        struct Result {
+            std::vector<BlockVertex> vertices;
+            std::vector<uint32_t> indices;
+            /// offset to the first index of the transparent drawing pass if any
+            size_t specialIdxOffset = 0;
+
+            /// cube faces, if the compact format is used; vertices are then only used for models
+            std::vector<FaceRecord> faces;
+            /// index of the first face record drawn in the transparent pass
+            size_t specialFaceOffset = 0;
+
+            /// layout of the cube faces in the vertex (or face record) buffer
+            std::shared_ptr<GlobuleMesh> mesh;
+
+            /// number of exposed cube faces
+            size_t numFaces = 0;
+            /// number of quads the cube faces were merged into
+            size_t numQuads = 0;
+            /// number of blocks drawn with a model
+            size_t numModels = 0;
+        };
+
+        /// offsets of a block and its six neighbors
+        static const std::array<glm::ivec3, 7> kBlockOffsets;
+        /// offsets of a block and all 26 blocks around it; these affect its ambient occlusion
+        static const std::array<glm::ivec3, 27> kNeighborhoodOffsets;
+
+    public:
+        Mesher(BlockSource *source, const bool greedyMeshing, const bool compactFaces = false,
+                const bool bakedOcclusion = false);
+        ~Mesher();
+
+        static void buildChunkMaps(BlockSource *, const std::shared_ptr<world::Chunk> &, const std::array<std::shared_ptr<world::Chunk>, 4> &, ChunkMaps &);
+        static bool isCurrent(const std::shared_ptr<world::Chunk> &, const std::array<std::shared_ptr<world::Chunk>, 4> &, const ChunkMaps &);
+
+        const Result &generate(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &, const ChunkMaps &);
+        bool patch(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &, const ChunkMaps &, GlobuleMesh &, const std::vector<glm::ivec3> &);
+
+    private:
+        /**
+         * Air maps of the Y layers at, immediately above, and below the current Y level. They only
+         * cover the globule, plus the blocks bordering it; each row of the globule is a 64-bit
+         * word, where bit N corresponds to the block at X = origin.x + N.
+         *
+         * This way, the exposed faces of an entire row are found with a few shifts and ANDs.
+         */
+        struct AirMap {
+            struct Layer {
+                /// air bits of the rows from Z = origin.z - 1 to origin.z + 64
+                std::array<uint64_t, 66> rows;
+                /// air bits of the columns X = origin.x - 1 and origin.x + 64; bit N is Z = origin.z + N
+                uint64_t left, right;
+
+                /// air bits of the blocks diagonally adjacent to the globule's corners; bit 0 is
+                /// (X, Z) = (-1, -1), then (64, -1), (-1, 64) and (64, 64), relative to the origin
+                uint8_t corners;
+
+                /// blocks in the globule's rows that are drawn, i.e. aren't air
+                std::array<uint64_t, 64> drawn;
+
+                /// Marks the entire layer as either air or solid, with nothing to draw.
+                void fill(const bool air) {
+                    const uint64_t value = air ? ~0ULL : 0;
+                    this->rows.fill(value);
+                    this->left = this->right = value;
+                    this->corners = air ? 0xF : 0;
+                    this->drawn.fill(0);
+                }
+
+                /// Whether the block at the given globule relative position (-1 to 64) is air.
+                inline bool isAir(const int x, const int z) const {
+                    if(x >= 0 && x < 64) {
+                        return (this->rows[z + 1] >> x) & 1;
+                    } else if(z >= 0 && z < 64) {
+                        return ((x < 0 ? this->left : this->right) >> z) & 1;
+                    }
+                    return (this->corners >> ((x < 0 ? 0 : 1) + (z < 0 ? 0 : 2))) & 1;
+                }
+            };
+
+            Layer above, current, below;
+        };
+
+        /**
+         * Cube blocks of a globule, collected for greedy meshing. Each cell holds the block data
+         * ID, whether the block needs alpha blending, and a mask of its exposed faces.
+         *
+         * Cells are indexed by globule relative position, as ((y * 64) + z) * 64 + x.
+         */
+        struct GreedyGrid {
+            /// number of Y layers in the grid
+            constexpr static const size_t kLayers = 64;
+
+            /// mask for the block data ID and alpha blending flag; faces only merge if these match
+            constexpr static const uint32_t kKeyMask = 0x1FFFF;
+            /// set if the block requires alpha blending
+            constexpr static const uint32_t kSpecial = (1 << 16);
+            /// bit position of the exposed face mask
+            constexpr static const size_t kFaceShift = 24;
+
+            std::vector<uint32_t> cells;
+            /// ambient occlusion of each exposed face of the cells, if it's baked
+            std::vector<std::array<uint8_t, 6>> occlusion;
+
+            GreedyGrid(const bool withOcclusion) {
+                this->cells.resize(kLayers * 64 * 64, 0);
+
+                if(withOcclusion) {
+                    this->occlusion.resize(this->cells.size());
+                }
+            }
+
+            inline uint32_t &at(const size_t x, const size_t y, const size_t z) {
+                return this->cells[(((y * 64) + z) * 64) + x];
+            }
+            inline std::array<uint8_t, 6> &occlusionAt(const size_t x, const size_t y, const size_t z) {
+                return this->occlusion[(((y * 64) + z) * 64) + x];
+            }
+        };
+
+        /// A block evaluated for patching
+        struct PatchBlock {
+            /// chunk relative position
+            glm::ivec3 pos;
+            /// exposed faces; bit N is set if face N is exposed
+            uint8_t faces = 0;
+            /// whether the block is drawn with a model rather than as a cube
+            bool model = false;
+            /// whether the block needs alpha blending
+            bool special = false;
+            /// block data ID
+            uint16_t type = 0;
+            /// ambient occlusion of each face
+            std::array<uint8_t, 6> occlusion;
+        };
+
+    private:
+        static void generateBlockIdMap(BlockSource *, const std::shared_ptr<world::Chunk> &, ExposureMaps &);
+
+        static size_t countUsedIds(const std::shared_ptr<world::Chunk> &);
+
+        void buildAirLayer(const std::shared_ptr<world::Chunk> &, const ChunkMaps &, const glm::ivec3 &, const int, AirMap::Layer &);
+        uint64_t rowAirMask(world::ChunkSliceRow *, const ExposureMaps &, const size_t, const BlockMaps * = nullptr, uint64_t * = nullptr);
+        uint64_t columnAirMask(world::ChunkSlice *, const ExposureMaps &, const size_t, const size_t);
+        bool isNeighborAir(const ChunkMaps &, const size_t, const size_t, const size_t, const size_t);
+        static BlockAppearance::BlockFlags flagsForFaces(const uint8_t);
+        template<typename F> static uint8_t faceOcclusion(const uint8_t, F &&);
+
+        void insertCubeQuads(std::vector<Quad> &, const size_t, const size_t, const size_t, const uint8_t, const uint16_t, const bool, const std::array<uint8_t, 6> &);
+        void insertGreedyQuads(GreedyGrid &, const glm::ivec3 &, const size_t, std::vector<Quad> &);
+        void insertModelVertices(std::vector<BlockVertex> &, std::vector<uint32_t> &, const size_t, const size_t, const size_t, const uint16_t, const BlockModel &);
+
+        void evaluateBlock(const std::shared_ptr<world::Chunk> &, const ChunkMaps &, PatchBlock &);
+        bool isAirAt(const std::shared_ptr<world::Chunk> &, const ChunkMaps &, const glm::ivec3 &);
+        void splitQuad(const Quad &, const std::vector<PatchBlock> &, std::vector<Quad> &);
+
+    private:
+        /// provides the block instances and models
+        BlockSource *source;
+        /// whether adjacent cube faces of the same type are merged into larger quads
+        bool greedyMeshing;
+        /// whether cube faces are output as face records, rather than vertices and indices
+        bool compactFaces;
+        /// whether ambient occlusion is computed for the corners of cube faces
+        bool bakedOcclusion;
+
+        /// output of the last generated globule
+        Result result;
+
+        /// alpha blended indices; they're appended to the regular indices at the end
+        std::vector<uint32_t> indicesSpecial;
+        /// cube faces of the globule
+        std::vector<Quad> quads;
+        /// vertices and indices of model blocks; they're placed after the cube faces
+        std::vector<BlockVertex> modelVertices;
+        std::vector<uint32_t> modelIndices, modelIndicesSpecial;
+
+        AirMap airMap;
+        /// only allocated if greedy meshing is enabled
+        std::unique_ptr<GreedyGrid> greedy;
+};
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "VertexGenerator.h"
 #include "VertexGeneratorData.h"
 #include "ChunkWorker.h"
+#include "GlobuleMesh.h"
 
 #include "world/chunk/Chunk.h"
 #include "world/chunk/ChunkSlice.h"
@@ -11,6 +12,7 @@
 
 #include "gui/MainWindow.h"
 #include "io/Format.h"
+#include "io/PrefsManager.h"
 #include "util/Thread.h"
 #include <Logging.h>
 
@@ -19,11 +21,17 @@
 #include <uuid.h>
 
 #include <algorithm>
+#include <span>
 
 using namespace render::chunk;
 
 VertexGenerator *VertexGenerator::gShared = nullptr;
 
+/// directions of the neighboring chunks, in the order they're stored in the chunk maps
+static const std::array<glm::ivec2, 4> kNeighborDirs = {
+    glm::ivec2(-1, 0), glm::ivec2(1, 0), glm::ivec2(0, -1), glm::ivec2(0, 1),
+};
+
 /**
  * Sets up the worker thread and background OpenGL queue.
  *
@@ -31,6 +39,10 @@ VertexGenerator *VertexGenerator::gShared = nullptr;
  * been created already.
  */
 VertexGenerator::VertexGenerator(gui::MainWindow *_window) : window(_window) {
+    this->greedyMeshing = io::PrefsManager::getBool("chunk.greedyMeshing", false);
+    this->compactFaces = io::PrefsManager::getBool("chunk.compactFaces", true);
+    this->bakedOcclusion = io::PrefsManager::getBool("gfx.bakedOcclusion", true);
+
     // start worker
     this->run = true;
     this->worker = std::make_unique<std::thread>(&VertexGenerator::workerMain, this);
@@ -151,6 +163,103 @@ void VertexGenerator::generate(std::shared_ptr<world::Chunk> &chunk, const uint6
 
 
 
+/**
+ * Kicks off vertex generation for the chunk at the given position, if it's being displayed.
+ */
+void VertexGenerator::generate(const glm::ivec2 &chunkPos, const uint64_t bits, const bool highPriority) {
+    auto chunk = this->getChunk(chunkPos);
+    if(chunk) {
+        this->generate(chunk, bits, highPriority);
+    }
+}
+
+/**
+ * Registers a displayed chunk. The border globules of any adjacent chunks are generated again, so
+ * their faces against this chunk can be culled.
+ */
+void VertexGenerator::addChunk(const std::shared_ptr<world::Chunk> &chunk) {
+    const auto pos = chunk->worldPos;
+
+    {
+        LOCK_GUARD(this->chunksLock, Chunks);
+        this->chunks[pos] = chunk;
+    }
+
+    for(const auto &dir : kNeighborDirs) {
+        auto neighbor = this->getChunk(pos + dir);
+        if(!neighbor) continue;
+
+        this->generate(neighbor, borderGlobules(-dir), false);
+    }
+}
+
+/**
+ * Removes a chunk that's no longer being displayed. The border globules of any adjacent chunks
+ * are generated again, so they get faces on the side the chunk was on.
+ *
+ * If a different chunk has since been registered at the same position, this does nothing.
+ */
+void VertexGenerator::removeChunk(const std::shared_ptr<world::Chunk> &chunk) {
+    const auto chunkPos = chunk->worldPos;
+
+    {
+        LOCK_GUARD(this->chunksLock, Chunks);
+
+        auto it = this->chunks.find(chunkPos);
+        if(it == this->chunks.end()) return;
+
+        // compare by owner, so that this works even if the registered chunk was deallocated
+        const auto &registered = it->second;
+        if(registered.owner_before(chunk) || chunk.owner_before(registered)) return;
+
+        this->chunks.erase(it);
+    }
+
+    {
+        LOCK_GUARD(this->meshesLock, Meshes);
+        std::erase_if(this->meshes, [&](const auto &item) {
+            return (item.first.first == chunkPos);
+        });
+    }
+
+    // drop lookup tables of the chunk, and those of neighbors that refer to it
+    {
+        LOCK_GUARD(this->chunkMapsLock, ChunkMaps);
+        this->chunkMaps.erase(chunkPos);
+
+        for(const auto &dir : kNeighborDirs) {
+            this->chunkMaps.erase(chunkPos + dir);
+        }
+    }
+
+    for(const auto &dir : kNeighborDirs) {
+        auto neighbor = this->getChunk(chunkPos + dir);
+        if(!neighbor) continue;
+
+        this->generate(neighbor, borderGlobules(-dir), false);
+    }
+}
+
+/**
+ * Gets the displayed chunk at the given position.
+ *
+ * @return Chunk, or `nullptr` if there's no chunk displayed there
+ */
+std::shared_ptr<world::Chunk> VertexGenerator::getChunk(const glm::ivec2 &chunkPos) {
+    LOCK_GUARD(this->chunksLock, Chunks);
+
+    auto it = this->chunks.find(chunkPos);
+    if(it == this->chunks.end()) return nullptr;
+
+    auto chunk = it->second.lock();
+    if(!chunk) {
+        this->chunks.erase(it);
+    }
+    return chunk;
+}
+
+
+
 /**
  * Main loop of the worker thread
  */
@@ -196,8 +305,14 @@ process:;
 
 /**
  * Performs generation of the given chunk's data.
+ *
+ * Each globule is meshed as a separate job, either on the chunk workers, or for high priority
+ * (user initiated) updates, on a dedicated pool so they don't wait behind chunk streaming. The
+ * block lookup tables are looked up once here, and shared by all of the chunk's globule jobs.
  */
 void VertexGenerator::workerGenerate(const GenerateRequest &req, const bool useChunkWorker) {
+    auto maps = this->getChunkMaps(req.chunk);
+
     // for each globule, queue generation in the background if needed
     for(size_t y = 0; y < 256; y += 64) {
         for(size_t z = 0; z < 256; z += 64) {
@@ -207,220 +322,200 @@ void VertexGenerator::workerGenerate(const GenerateRequest &req, const bool useC
                 const uint64_t bits = blockPosToBits(origin);
                 if((bits & req.globules) == 0) continue;
 
-                // bail if already processing it
-                if(!useChunkWorker) {
-                    LOCK_GUARD(this->inFlightLock, InFlight);
-                    std::pair<glm::ivec2, glm::ivec3> test(req.chunk->worldPos, origin);
-
-                    if(this->inFlight.contains(test)) {
-                        return;
-                    }
-
-                    this->inFlight.insert(std::move(test));
-                }
-
-                // handle generation
-                auto chunk = req.chunk;
-                auto fxn = [&, chunk, origin](const bool uiUpdate = false) -> void {
-                    try {
-                        this->workerGenerate(chunk, origin, uiUpdate);
-                    } catch(const std::exception &e) {
-                        Logging::error("Error generating globule: {}", e.what());
-                        throw;
-                    }
-                };
-
-                if(useChunkWorker) {
-                    ChunkWorker::pushWork(fxn);
-                } else {
-                    this->highPriorityWorkQueue.queueWorkItem(std::bind(fxn, true));
-                }
+                GlobuleWork work;
+                work.full = true;
+
+                this->queueGlobule(req.chunk, origin, !useChunkWorker, maps, work);
             }
         }
     }
 }
 
 /**
- * Generates vertices for the given globule using the CPU on the chunk worker queue.
+ * Queues a job to generate a single globule's vertices, or to patch them.
+ *
+ * Only one job per globule is in flight at a time. If the globule is requested again while its
+ * job is queued, the request is merged into that job, which will see the latest chunk data. Once
+ * it has started, the globule is instead processed again after its buffers have been delivered;
+ * this way, callbacks always receive the results for a globule in order, and no update is lost.
+ *
+ * @param maps Block lookup tables for the chunk, or `nullptr` to have the job build them
  */
-void VertexGenerator::workerGenerate(const std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &origin, const bool highPriority) {
-    using namespace world;
+void VertexGenerator::queueGlobule(const std::shared_ptr<world::Chunk> &chunk,
+        const glm::ivec3 &origin, const bool highPriority, const std::shared_ptr<ChunkMaps> &maps,
+        const GlobuleWork &work) {
+    {
+        LOCK_GUARD(this->inFlightLock, InFlight);
+        const std::pair<glm::ivec2, glm::ivec3> key(chunk->worldPos, origin);
 
-    PROFILE_SCOPE(GenerateGlobule);
-    // Logging::trace("Generating {} for {}", origin, (void *) chunk.get());
+        auto it = this->inFlight.find(key);
+        if(it != this->inFlight.end()) {
+            auto &info = it->second;
 
-    // counters
-    size_t numCulled = 0, numTotal = 0;
-    // get the chunk pos
-    const auto chunkPos = glm::ivec3(chunk->worldPos.x * 256, 0, chunk->worldPos.y * 256);
+            if(info.started || info.chunk != chunk) {
+                info.rerun = true;
+                info.rerunHighPriority |= highPriority;
+                info.rerunChunk = chunk;
+                info.rerunWork.merge(work);
+            } else {
+                info.work.merge(work);
+            }
+            return;
+        }
 
-    // convert the 8 bit block ID -> UUID maps into 8 bit ID -> block transparency
-    ExposureMaps exposureIdMaps;
-    this->generateBlockIdMap(chunk, exposureIdMaps);
+        InFlightInfo info;
+        info.chunk = chunk;
+        info.work = work;
+        this->inFlight.emplace(key, std::move(info));
+    }
 
-    // convert the 8 bit -> UUID maps to 8 bit -> block instance maps
-    std::vector<std::array<Block *, 256>> blockPtrMaps;
-    blockPtrMaps.reserve(chunk->sliceIdMaps.size());
+    // handle generation; if patching isn't possible, the whole globule is generated instead
+    auto fxn = [&, chunk, origin, maps]() -> void {
+        try {
+            const auto work = this->globuleStarted(chunk->worldPos, origin);
 
-    {
-        PROFILE_SCOPE(BuildBlockPtrMap);
-        for(const auto &map : chunk->sliceIdMaps) {
-            std::array<Block *, 256> list;
-            std::fill(list.begin(), list.end(), nullptr);
-
-            for(size_t i = 0; i < list.size(); i++) {
-                const auto &id = map.idMap[i];
-                if(id.is_nil() || BlockRegistry::isAirBlock(id)) {
-                    continue;
-                }
-
-                list[i] = BlockRegistry::getBlock(id);
+            if(work.full || !this->workerPatch(chunk, origin, work.blocks)) {
+                this->workerGenerate(chunk, origin, maps);
             }
-
-            blockPtrMaps.push_back(list);
+        } catch(const std::exception &e) {
+            Logging::error("Error generating globule: {}", e.what());
+            this->globuleDone(chunk->worldPos, origin);
+            throw;
         }
+    };
+
+    if(!highPriority) {
+        ChunkWorker::pushWork(fxn);
+    } else {
+        this->highPriorityWorkQueue.queueWorkItem(fxn);
     }
+}
 
-    // temporary index data buffer. we'll either take this as-is or convert to 16-bit later
-    std::vector<gl::GLuint> indices, indicesSpecial;
-    std::vector<BlockVertex> vertices;
+/**
+ * Marks a globule's job as started. From here on, any further requests for the globule require it
+ * to be processed again.
+ *
+ * @return Work the job should perform
+ */
+VertexGenerator::GlobuleWork VertexGenerator::globuleStarted(const glm::ivec2 &chunkPos, const glm::ivec3 &origin) {
+    LOCK_GUARD(this->inFlightLock, InFlight);
+    const std::pair<glm::ivec2, glm::ivec3> key(chunkPos, origin);
 
-    // initial air map filling
-    AirMap am;
-    am.below.reset();
-    this->buildAirMap(chunk->slices[origin.y], exposureIdMaps, am.current);
-    this->buildAirMap(chunk->slices[origin.y + 1], exposureIdMaps, am.above);
+    auto it = this->inFlight.find(key);
+    if(it == this->inFlight.end()) {
+        GlobuleWork work;
+        work.full = true;
+        return work;
+    }
+
+    it->second.started = true;
+    return std::move(it->second.work);
+}
+
+/**
+ * Removes the in-flight tag of a globule once its job has completed. If it was requested again
+ * in the meantime, a new job is queued.
+ */
+void VertexGenerator::globuleDone(const glm::ivec2 &chunkPos, const glm::ivec3 &origin) {
+    InFlightInfo info;
 
-    // update the actual instance buffer itself
     {
-        PROFILE_SCOPE(ProcessSlices);
-        const size_t yMax = std::min((size_t) origin.y + 64, Chunk::kMaxY-1);
-        for(size_t y = origin.y; y <= yMax; y++) {
-            // if there's no blocks at this Y level, check the next one
-            auto slice = chunk->slices[y];
-            if(!slice) {
-                goto nextRow;
-            }
+        LOCK_GUARD(this->inFlightLock, InFlight);
+        const std::pair<glm::ivec2, glm::ivec3> key(chunkPos, origin);
 
-            // iterate over each of the slice's rows
-            for(size_t z = origin.z; z < (origin.z + 64); z++) {
-                // skip empty rows
-                auto row = slice->rows[z];
-                if(!row) {
-                    continue;
-                }
-
-                // process each block in this row
-                const auto &map = chunk->sliceIdMaps[row->typeMap];
-                const auto &blockMap = blockPtrMaps[row->typeMap];
-
-                for(size_t x = origin.x; x < (origin.x + 64); x++) {
-                    bool visible = false;
-
-                    // update exposure map for this position if needed
-                    {
-                        const size_t airMapOff = ((z & 0xFF) << 8) | (x & 0xFF);
-
-                        // above or below
-                        if(am.above[airMapOff]) {
-                            visible = true;
-                            goto writeResult;
-                        }
-                        if(am.below[airMapOff]) {
-                            visible = true;
-                            goto writeResult;
-                        }
-
-                        // check adjacent faces
-                        for(int i = -1; i <= 1; i+=2) {
-                            // left or right
-                            if((x == origin.x && i == -1) || (x == (origin.x+63) && i == 1) || am.current[airMapOff + i]) {
-                                visible = true;
-                                goto writeResult;
-                            }
-                            // front or back
-                            if((z == origin.z && i == -1) || (z == (origin.z+63) && i == 1) || am.current[airMapOff + (i * 256)]) {
-                                visible = true;
-                                goto writeResult;
-                            }
-                        }
-
-        writeResult:;
-                    }
-
-                    // skip block if not exposed
-                    if(!visible) {
-                        numCulled++;
-                        continue;
-                    }
-
-                    // skip blocks to not draw (e.g. air)
-                    uint8_t temp = row->at(x);
-                    auto &block = blockMap[temp];
-                    const auto &id = map.idMap[temp];
-
-                    if(!block || BlockRegistry::isAirBlock(id)) {
-                        continue;
-                    }
-                    numTotal++;
-
-                    // figure out what edges are exposed
-                    Block::BlockFlags flags = Block::kFlagsNone;
-                    this->flagsForBlock(am, x, y, z, flags);
-
-                    // determine block data ID
-                    const auto worldPos = glm::ivec3(x, y, z) + chunkPos;
-                    const uint16_t type = block->getBlockId(worldPos, flags);
-
-                    // append the vertices for this block
-                    const uint16_t model = block->getModelId(worldPos, flags);
-
-                    const bool special = block->needsAlphaBlending(worldPos);
-
-                    if(model == 0) {
-                        this->insertCubeVertices(am, vertices, special ? indicesSpecial : indices,
-                                x, y, z, type);
-                    } else if(BlockRegistry::hasModel(model)) {
-                        const auto &modelData = BlockRegistry::getModel(model);
-                        this->insertModelVertices(am, vertices, special ? indicesSpecial : indices,
-                                x, y, z, type, modelData);
-
-                        block->blockWillDisplay(worldPos);
-                    } else {
-                        XASSERT(false, "Unknown model id ${:04x} for block {}", model, worldPos);
-                    }
-                }
-            }
+        auto it = this->inFlight.find(key);
+        if(it == this->inFlight.end()) return;
 
-            // set up for processing the next row
-    nextRow:;
-            am.below = std::move(am.current);
-            am.current = std::move(am.above);
+        info = std::move(it->second);
+        this->inFlight.erase(it);
+    }
 
-            if((y+2) < chunk->slices.size() && y != yMax) {
-                am.above.reset();
-                this->buildAirMap(chunk->slices[y+2], exposureIdMaps, am.above);
-            } else {
-                am.above.set();
-            }
+    if(info.rerun && this->run) {
+        this->queueGlobule(info.rerunChunk, origin, info.rerunHighPriority, nullptr,
+                info.rerunWork);
+    }
+}
+
+/**
+ * Gets the block lookup tables for all of the chunk's ID maps, including the air maps of any
+ * displayed neighboring chunks.
+ *
+ * The tables are cached per chunk, so that block edits (which may patch several globules each)
+ * don't have to build them again; they're only rebuilt once IDs have been added to any of the
+ * ID maps, or the neighboring chunks changed.
+ */
+std::shared_ptr<VertexGenerator::ChunkMaps> VertexGenerator::getChunkMaps(const std::shared_ptr<world::Chunk> &chunk) {
+    std::array<std::shared_ptr<world::Chunk>, 4> neighbors;
+
+    for(size_t i = 0; i < kNeighborDirs.size(); i++) {
+        neighbors[i] = this->getChunk(chunk->worldPos + kNeighborDirs[i]);
+    }
+
+    // use the cached tables, if they're for this chunk and still current
+    {
+        LOCK_GUARD(this->chunkMapsLock, ChunkMaps);
+
+        auto it = this->chunkMaps.find(chunk->worldPos);
+        if(it != this->chunkMaps.end() && it->second.first.lock() == chunk &&
+                Mesher::isCurrent(chunk, neighbors, *it->second.second)) {
+            return it->second.second;
         }
     }
 
-    // insert the special indices if needed
-    size_t specialStart = 0;
+    // otherwise, build them
+    auto maps = std::make_shared<ChunkMaps>();
+    Mesher::buildChunkMaps(&this->blockSource, chunk, neighbors, *maps);
 
-    if(indicesSpecial.size()) {
-        specialStart = indices.size();
-        indices.insert(indices.end(), indicesSpecial.begin(), indicesSpecial.end());
+    {
+        LOCK_GUARD(this->chunkMapsLock, ChunkMaps);
+        this->chunkMaps[chunk->worldPos] = std::make_pair(chunk, maps);
     }
 
+    return maps;
+}
+
+/**
+ * Gets the mesher of the calling worker thread; it's created the first time a thread generates a
+ * globule, and its buffers are reused for all further globules.
+ */
+Mesher &VertexGenerator::getMesher() {
+    static thread_local std::unique_ptr<Mesher> mesher = nullptr;
+    if(!mesher) {
+        mesher = std::make_unique<Mesher>(&this->blockSource, this->greedyMeshing,
+                this->compactFaces, this->bakedOcclusion);
+    }
+
+    return *mesher;
+}
+
+/**
+ * Generates vertices for the given globule using the CPU on the chunk worker queue.
+ *
+ * Vertices and indices are built in buffers private to the worker thread, which keep their
+ * capacity between globules; only the final, exactly sized copies are handed to the main thread.
+ * With compact faces, those only hold model blocks; cube faces are sent as face records.
+ */
+void VertexGenerator::workerGenerate(const std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &origin, const std::shared_ptr<ChunkMaps> &sharedMaps) {
+    // use the chunk's lookup tables, unless ID maps were added since they were built
+    std::shared_ptr<ChunkMaps> maps = sharedMaps;
+
+    if(!maps || maps->blocks.size() != chunk->sliceIdMaps.size()) {
+        maps = this->getChunkMaps(chunk);
+    }
+
+    const auto &out = this->getMesher().generate(chunk, origin, *maps);
+    const auto &indices = out.indices;
+    const auto &vertices = out.vertices;
+
     // convert indices to 16-bit quantity, if required
     BufferRequest req;
     req.chunkPos = chunk->worldPos;
     req.globuleOff = origin;
-    req.specialIdxOffset = specialStart;
+    req.specialIdxOffset = out.specialIdxOffset;
+    req.specialFaceOffset = out.specialFaceOffset;
+    req.mesh = out.mesh;
 
-    if(!indices.empty() && indices.size() < 65536) {
+    if(!indices.empty() && vertices.size() < 65536) {
         std::vector<gl::GLushort> shortIndices;
         shortIndices.resize(indices.size());
 
@@ -430,241 +525,113 @@ void VertexGenerator::workerGenerate(const std::shared_ptr<world::Chunk> &chunk,
 
         req.indices = std::move(shortIndices);
     } else {
-        req.indices = std::move(indices);
+        req.indices = std::vector<gl::GLuint>(indices.begin(), indices.end());
     }
 
-    req.vertices = std::move(vertices);
+    req.vertices.assign(vertices.begin(), vertices.end());
+    req.faces.assign(out.faces.begin(), out.faces.end());
 
     if(this->run) {
-        this->bufferReqs.enqueue(req);
+        this->bufferReqs.enqueue(std::move(req));
     }
 }
 
-
-
 /**
- * Generates the mapping of 8-bit block ids to whether they're air or not
+ * Queues patching of the meshes around a changed block. The faces of the block itself and its six
+ * neighbors are affected; these may be in different globules, or even adjacent chunks. With baked
+ * occlusion, the faces of all blocks surrounding it are affected instead.
  */
-void VertexGenerator::generateBlockIdMap(const std::shared_ptr<world::Chunk> &c, ExposureMaps &maps) {
-    maps.clear();
-    maps.reserve(c->sliceIdMaps.size());
-
-    // iterate over each input ID map...
-    for(const auto &map : c->sliceIdMaps) {
-        PROFILE_SCOPE(ProcessMap);
+void VertexGenerator::patch(std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &pos) {
+    std::vector<std::pair<std::shared_ptr<world::Chunk>, glm::ivec3>> globules;
 
-        // all blocks should be air by default
-        std::array<bool, 256> isAir;
-        std::fill(isAir.begin(), isAir.end(), true);
-
-        // then, check each of the UUIDs
-        for(size_t i = 0; i < map.idMap.size(); i++) {
-            const auto &uuid = map.idMap[i];
-
-            // skip if nil UUID
-            if(uuid.is_nil()) {
-                continue;
-            }
+    const std::span<const glm::ivec3> offsets = this->bakedOcclusion ?
+        std::span<const glm::ivec3>(Mesher::kNeighborhoodOffsets) :
+        std::span<const glm::ivec3>(Mesher::kBlockOffsets);
 
-            // query the block registry if this is an opaque block
-            isAir[i] = !world::BlockRegistry::isOpaqueBlock(uuid);
-        }
+    for(const auto &offset : offsets) {
+        auto p = pos + offset;
+        if(p.y < 0 || p.y >= (int) world::Chunk::kMaxY) continue;
 
-        maps.push_back(isAir);
-    }
-}
+        // find the chunk containing the block
+        glm::ivec2 chunkOff(0);
 
-/**
- * For a particular Y layer, generates a bitmap indicating whether the block at the given (Z, X)
- * position is air-like or not.
- *
- * Indices into the bitset are 16-bit 0xZZXX coordinates.
- *
- * We no longer go through all 256 rows/columns, but instead at least 64, and at most 66; one
- * extra on each end, if possible.
- */
-void VertexGenerator::buildAirMap(world::ChunkSlice *slice, const ExposureMaps &exposureMaps, std::bitset<256*256> &b) {
-    // if the slice is empty (e.g. nonexistent,) bail; the entire thing is air
-    if(!slice) {
-        b.set();
-        return;
-    }
+        if(p.x < 0) chunkOff.x = -1;
+        else if(p.x > 255) chunkOff.x = 1;
+        if(p.z < 0) chunkOff.y = -1;
+        else if(p.z > 255) chunkOff.y = 1;
 
-    // iterate over every row
-    for(size_t z = 0; z < 256; z++) {
-    // for(size_t z = std::max((int)this->position.z - 1, 0); z < std::min((int)this->position.z + 65, 256); z++) {
-        // ignore empty rows
-        const size_t zOff = ((z & 0xFF) << 8);
-        auto row = slice->rows[z];
+        auto target = chunk;
+        if(chunkOff != glm::ivec2(0)) {
+            target = this->getChunk(chunk->worldPos + chunkOff);
+            if(!target) continue;
 
-        if(!row) {
-            // fill the entire row anyways; not a lot of overhead here
-            for(size_t x = 0; x < 256; x++) {
-                b[zOff + x] = true;
-            }
-            continue;
+            p -= glm::ivec3(chunkOff.x * 256, 0, chunkOff.y * 256);
         }
 
-        // iterate each block in the row to determine if it's air or not
-        const auto &airMap = exposureMaps[row->typeMap];
-        for(size_t x = 0; x < 256; x++) {
-        // for(size_t x = std::max((int)this->position.x, 0); x < std::min((int)this->position.x + 65, 256); x++) {
-            const bool isAir = airMap[row->at(x)];
-            b[zOff + x] = isAir;
-        }
-    }
-}
+        // queue the globule, if it's not already
+        const auto origin = (p / glm::ivec3(64)) * glm::ivec3(64);
+        const std::pair<std::shared_ptr<world::Chunk>, glm::ivec3> globule(target, origin);
 
-/**
- * Calculates the flags for the given block. Currently, this is just the exposed edges.
- */
-void VertexGenerator::flagsForBlock(const AirMap &am, const size_t x, const size_t y, const size_t z, world::Block::BlockFlags &flags) {
-    using namespace world;
+        if(std::find(globules.begin(), globules.end(), globule) != globules.end()) continue;
+        globules.push_back(globule);
 
-    // calculate offsets into air map
-    const size_t airMapOff = ((z & 0xFF) << 8) | (x & 0xFF);
+        // the changed block, relative to the chunk containing the globule
+        GlobuleWork work;
+        work.blocks.push_back(pos - glm::ivec3(chunkOff.x * 256, 0, chunkOff.y * 256));
 
-    // is the left edge exposed?
-    if(x == 0 || am.current[airMapOff - 1]) {
-        flags |= Block::kExposedXMinus;
-    }
-    // is the right edge exposed?
-    if(x == 255 || am.current[airMapOff + 1]) {
-        flags |= Block::kExposedXPlus;
-    }
-    // is the bottom exposed?
-    if(y == 0 || am.below[airMapOff]) {
-        flags |= Block::kExposedYMinus;
-    }
-    // is the top exposed?
-    if((y + 1) >= 255 || am.above[airMapOff]) {
-        flags |= Block::kExposedYPlus;
-    }
-    // is the z-1 edge exposed?
-    if(z == 0 || am.current[airMapOff - 0x100]) {
-        flags |= Block::kExposedZMinus;
-    }
-    // is the z+1 edge exposed?
-    if(z == 255 || am.current[airMapOff + 0x100]) {
-        flags |= Block::kExposedZPlus;
+        this->queueGlobule(target, origin, true, nullptr, work);
     }
 }
 
 /**
- * For a visible (e.g. at least one exposed face) block at the given coordinates, insert the
- * necessary vertices to the vertex buffer.
+ * Patches the mesh of a globule after blocks have changed.
  *
- * Note that this works only for FULLY SOLID blocks, e.g. ones where they want to look like a
- * textured cube.
+ * All quads covering a face of an affected block (the changed blocks and their neighbors) are
+ * removed; the parts of them that cover other blocks are added back. Then, the current exposed
+ * faces of all affected blocks are added as new quads. Only the modified slots are sent to the
+ * main thread, to update that part of the vertex (or face record) buffer.
+ *
+ * @param blocks Chunk relative positions of the changed blocks; they may be outside the globule
+ *
+ * @return Whether the mesh was patched. If not, the globule needs to be generated entirely; this
+ * is the case if it has no mesh yet, if model blocks are involved, or if it ran out of free slots.
  */
-void VertexGenerator::insertCubeVertices(const AirMap &am, std::vector<BlockVertex> &vertices, std::vector<gl::GLuint> &indices, const size_t x, const size_t y, const size_t z, const uint16_t blockId) {
-    const size_t airMapOff = ((z & 0xFF) << 8) | (x & 0xFF);
-
-    const uint16_t f = BlockVertex::kPointFactor;
-    const glm::i16vec3 pos(x * f, y * f, z * f);
-
-    gl::GLuint iVtx = vertices.size();
+bool VertexGenerator::workerPatch(const std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &origin, const std::vector<glm::ivec3> &blocks) {
+    // get the globule's current mesh
+    std::shared_ptr<GlobuleMesh> mesh;
+    {
+        LOCK_GUARD(this->meshesLock, Meshes);
+        auto it = this->meshes.find(std::make_pair(chunk->worldPos, origin));
+        if(it == this->meshes.end()) return false;
 
-    // is the bottom exposed? (or bottom of globule)
-    if(y == 0 || (y % 64) == 0 || am.below[airMapOff]) {
-        vertices.insert(vertices.end(), {
-            {.p = pos + glm::i16vec3(0,0,0), .blockId = blockId, .face = (0x0), .vertexId = 0},
-            {.p = pos + glm::i16vec3(f,0,0), .blockId = blockId, .face = (0x0), .vertexId = 1},
-            {.p = pos + glm::i16vec3(f,0,f), .blockId = blockId, .face = (0x0), .vertexId = 2},
-            {.p = pos + glm::i16vec3(0,0,f), .blockId = blockId, .face = (0x0), .vertexId = 3},
-        });
-        indices.insert(indices.end(), 
-                {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
-        iVtx += 4;
-    }
-    // is the top exposed? (or top edge of globule)
-    if((y + 1) >= 255 || (y % 64) == 63 || am.above[airMapOff]) {
-        vertices.insert(vertices.end(), {
-            {.p = pos + glm::i16vec3(0,f,f), .blockId = blockId, .face = (0x1), .vertexId = 0},
-            {.p = pos + glm::i16vec3(f,f,f), .blockId = blockId, .face = (0x1), .vertexId = 1},
-            {.p = pos + glm::i16vec3(f,f,0), .blockId = blockId, .face = (0x1), .vertexId = 2},
-            {.p = pos + glm::i16vec3(0,f,0), .blockId = blockId, .face = (0x1), .vertexId = 3},
-        });
-        indices.insert(indices.end(), 
-                {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
-        iVtx += 4;
-    }
-    // is the left edge exposed?
-    if(x == 0 || am.current[airMapOff - 1]) {
-        vertices.insert(vertices.end(), {
-            {.p = pos + glm::i16vec3(0,0,f), .blockId = blockId, .face = (0x2), .vertexId = 0},
-            {.p = pos + glm::i16vec3(0,f,f), .blockId = blockId, .face = (0x2), .vertexId = 1},
-            {.p = pos + glm::i16vec3(0,f,0), .blockId = blockId, .face = (0x2), .vertexId = 2},
-            {.p = pos + glm::i16vec3(0,0,0), .blockId = blockId, .face = (0x2), .vertexId = 3},
-        });
-        indices.insert(indices.end(), 
-                {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
-        iVtx += 4;
-    }
-    // is the right edge exposed?
-    if(x == 255 || am.current[airMapOff + 1]) {
-        vertices.insert(vertices.end(), {
-            {.p = pos + glm::i16vec3(f,0,0), .blockId = blockId, .face = (0x3), .vertexId = 0},
-            {.p = pos + glm::i16vec3(f,f,0), .blockId = blockId, .face = (0x3), .vertexId = 1},
-            {.p = pos + glm::i16vec3(f,f,f), .blockId = blockId, .face = (0x3), .vertexId = 2},
-            {.p = pos + glm::i16vec3(f,0,f), .blockId = blockId, .face = (0x3), .vertexId = 3},
-        });
-        indices.insert(indices.end(), 
-                {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
-        iVtx += 4;
-    }
-    // is the z-1 edge exposed?
-    if(z == 0 || am.current[airMapOff - 0x100]) {
-        vertices.insert(vertices.end(), {
-            {.p = pos + glm::i16vec3(0,f,0), .blockId = blockId, .face = (0x4), .vertexId = 0},
-            {.p = pos + glm::i16vec3(f,f,0), .blockId = blockId, .face = (0x4), .vertexId = 1},
-            {.p = pos + glm::i16vec3(f,0,0), .blockId = blockId, .face = (0x4), .vertexId = 2},
-            {.p = pos + glm::i16vec3(0,0,0), .blockId = blockId, .face = (0x4), .vertexId = 3},
-        });
-        indices.insert(indices.end(), 
-                {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
-        iVtx += 4;
-    }
-    // is the z+1 edge exposed?
-    if(z == 255 || am.current[airMapOff + 0x100]) {
-        vertices.insert(vertices.end(), {
-            {.p = pos + glm::i16vec3(0,0,f), .blockId = blockId, .face = (0x5), .vertexId = 0},
-            {.p = pos + glm::i16vec3(f,0,f), .blockId = blockId, .face = (0x5), .vertexId = 1},
-            {.p = pos + glm::i16vec3(f,f,f), .blockId = blockId, .face = (0x5), .vertexId = 2},
-            {.p = pos + glm::i16vec3(0,f,f), .blockId = blockId, .face = (0x5), .vertexId = 3},
-        });
-        indices.insert(indices.end(), 
-                {iVtx, iVtx+1, iVtx+2, iVtx+2, iVtx+3, iVtx});
-        iVtx += 4;
+        mesh = it->second.mesh;
     }
-}
-
-void VertexGenerator::insertModelVertices(const AirMap &am, std::vector<BlockVertex> &vertices, std::vector<gl::GLuint> &indices, const size_t x, const size_t y, const size_t z, const uint16_t blockId, const world::BlockRegistry::Model &model) {
-    const uint16_t f = BlockVertex::kPointFactor;
-    const glm::i16vec3 origin(x * f, y * f, z * f);
 
-    gl::GLuint iVtx = vertices.size();
+    // update the quads of the affected blocks
+    const auto maps = this->getChunkMaps(chunk);
 
-    // create vertices
-    for(size_t i = 0; i < model.vertices.size(); i++) {
-        const auto &vtx = model.vertices[i];
-        const auto &faceInfo = model.faceVertIds[i];
+    if(!this->getMesher().patch(chunk, origin, *maps, *mesh, blocks)) {
+        return false;
+    }
 
-        const auto pos = origin + glm::i16vec3(vtx * glm::vec3(f));
+    // send the modified vertices to the main thread
+    BufferRequest req;
+    req.chunkPos = chunk->worldPos;
+    req.globuleOff = origin;
+    req.isPatch = true;
 
-        const BlockVertex vtxData = {
-            .p = pos, .blockId = blockId, .face = faceInfo.first, .vertexId = faceInfo.second
-        };
-        vertices.push_back(vtxData);
+    if(this->compactFaces) {
+        mesh->getChanges(req.facePatches);
+    } else {
+        mesh->getChanges(req.patches);
     }
 
-    // copy the indices
-    for(size_t i = 0; i < model.indices.size(); i++) {
-        indices.emplace_back(model.indices[i] + iVtx);
+    if(this->run) {
+        this->bufferReqs.enqueue(std::move(req));
     }
-}
-
 
+    return true;
+}
 
 /**
  * Runs a certain number of globule buffer filling operations on the main thread.
@@ -685,6 +652,13 @@ void VertexGenerator::copyBuffers() {
  * methods are invoked as well.
  */
 void VertexGenerator::workerGenBuffers(const BufferRequest &req) {
+    // patches just update part of the existing vertex buffer
+    if(req.isPatch) {
+        this->applyPatch(req);
+        this->globuleDone(req.chunkPos, req.globuleOff);
+        return;
+    }
+
     Buffer outBuf;
     outBuf.numVertices = req.vertices.size();
     outBuf.specialIdxOffset = req.specialIdxOffset;
@@ -703,6 +677,22 @@ void VertexGenerator::workerGenBuffers(const BufferRequest &req) {
         outBuf.buffer = buf;
     }
 
+    // and the face records; the globule reads them through a buffer texture
+    const auto faceSize = sizeof(FaceRecord) * req.faces.size();
+    if(faceSize) {
+        PROFILE_SCOPE(XferFaceBuf);
+
+        auto buf = std::make_shared<gfx::Buffer>(gfx::Buffer::Array, gfx::Buffer::StaticDraw);
+
+        buf->bind();
+        buf->replaceData(faceSize, req.faces.data());
+        buf->unbind();
+
+        outBuf.numFaces = req.faces.size();
+        outBuf.specialFaceOffset = req.specialFaceOffset;
+        outBuf.faceBuffer = buf;
+    }
+
     // then, the index data buffer
     {
         void const *ptr = nullptr;
@@ -737,11 +727,18 @@ void VertexGenerator::workerGenBuffers(const BufferRequest &req) {
         }
     }
 
-    // remove the in-flight tag if any
+    // keep the face layout around for patching, as long as the chunk is displayed
     {
-        LOCK_GUARD(this->inFlightLock, InFlight);
-        std::pair<glm::ivec2, glm::ivec3> test(req.chunkPos, req.globuleOff);
-        this->inFlight.erase(test);
+        const bool displayed = (this->getChunk(req.chunkPos) != nullptr);
+
+        LOCK_GUARD(this->meshesLock, Meshes);
+        const std::pair<glm::ivec2, glm::ivec3> key(req.chunkPos, req.globuleOff);
+
+        if(displayed && req.mesh && (outBuf.buffer || outBuf.faceBuffer)) {
+            this->meshes[key] = MeshInfo{req.mesh, outBuf.buffer, outBuf.faceBuffer};
+        } else {
+            this->meshes.erase(key);
+        }
     }
 
     // invoke the appropriate callbacks
@@ -768,5 +765,72 @@ void VertexGenerator::workerGenBuffers(const BufferRequest &req) {
             cb.callback(req.chunkPos, bufs);
         }
     }
+
+    // remove the in-flight tag; this may queue the globule again if it's changed since
+    this->globuleDone(req.chunkPos, req.globuleOff);
 }
 
+/**
+ * Updates the modified ranges of a globule's vertex or face record buffer.
+ */
+void VertexGenerator::applyPatch(const BufferRequest &req) {
+    PROFILE_SCOPE(XferVertexPatch);
+
+    std::shared_ptr<gfx::Buffer> buf, faceBuf;
+    {
+        LOCK_GUARD(this->meshesLock, Meshes);
+        auto it = this->meshes.find(std::make_pair(req.chunkPos, req.globuleOff));
+        if(it == this->meshes.end()) return;
+
+        buf = it->second.buffer;
+        faceBuf = it->second.faceBuffer;
+    }
+
+    if(buf && !req.patches.empty()) {
+        buf->bind();
+        for(const auto &[first, vertices] : req.patches) {
+            buf->replaceData(first * sizeof(BlockVertex), vertices.size() * sizeof(BlockVertex),
+                    vertices.data());
+        }
+        buf->unbind();
+    }
+
+    if(faceBuf && !req.facePatches.empty()) {
+        faceBuf->bind();
+        for(const auto &[first, faces] : req.facePatches) {
+            faceBuf->replaceData(first * sizeof(FaceRecord), faces.size() * sizeof(FaceRecord),
+                    faces.data());
+        }
+        faceBuf->unbind();
+    }
+}
+
+
+
+
+/**
+ * Gets the block instance for the given ID; air is never drawn.
+ */
+BlockAppearance *VertexGenerator::RegistrySource::getBlock(const uuids::uuid &id) {
+    if(world::BlockRegistry::isAirBlock(id)) {
+        return nullptr;
+    }
+    return world::BlockRegistry::getBlock(id);
+}
+
+/**
+ * Checks whether the block with the given ID is opaque.
+ */
+bool VertexGenerator::RegistrySource::isOpaqueBlock(const uuids::uuid &id) {
+    return world::BlockRegistry::isOpaqueBlock(id);
+}
+
+/**
+ * Gets a model registered with the block registry.
+ */
+const BlockModel *VertexGenerator::RegistrySource::getModel(const uint16_t id) {
+    if(!world::BlockRegistry::hasModel(id)) {
+        return nullptr;
+    }
+    return &world::BlockRegistry::getModel(id);
+}
@@ -1,13 +1,13 @@
 /**
- * Generates the vertex data for globules using geometry shaders and transform feedback on a
- * background work thread.
+ * Generates the vertex data for globules on background work threads, and turns it into buffers on
+ * the main thread.
  */
 #ifndef RENDER_CHUNK_VERTEXGENERATOR_H
 #define RENDER_CHUNK_VERTEXGENERATOR_H
 
+#include "Mesher.h"
+
 #include "world/chunk/Chunk.h"
-#include "world/block/Block.h"
-#include "world/block/BlockRegistry.h"
 
 #include "util/ThreadPool.h"
 
@@ -20,7 +20,6 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
-#include <bitset>
 #include <vector>
 #include <array>
 #include <cstddef>
@@ -30,6 +29,7 @@
 #include <blockingconcurrentqueue.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
 #include <glm/gtx/hash.hpp>
 
 namespace gui {
@@ -42,6 +42,7 @@ class Buffer;
 
 namespace render::chunk {
 class VertexGeneratorData;
+class GlobuleMesh;
 
 template<typename T> void hashCombine(std::size_t &seed, T const &key) {
   std::hash<T> hasher;
@@ -74,19 +75,19 @@ class VertexGenerator {
             gl::GLuint bytesPerIndex = 4;
             /// index buffer, if any
             std::shared_ptr<gfx::Buffer> indexBuffer = nullptr;
-        };
-
-        /// Vertices used to render blocks
-        struct BlockVertex {
-            constexpr static const uint16_t kPointFactor = 0x7F;
 
-            /// vertex position, each value is multiplied by kPointFactor
-            glm::i16vec3 p;
-            gl::GLushort blockId;
-            gl::GLubyte face;
-            gl::GLubyte vertexId;
+            /// number of face records, if the cube faces are drawn from face records
+            gl::GLuint numFaces = 0;
+            /// index of the first face record of the transparent drawing pass
+            gl::GLuint specialFaceOffset = 0;
+            /// buffer holding the face records, if any
+            std::shared_ptr<gfx::Buffer> faceBuffer = nullptr;
         };
 
+        using BlockVertex = Mesher::BlockVertex;
+        using Quad = Mesher::Quad;
+        using FaceRecord = Mesher::FaceRecord;
+
         using BufList = std::vector<std::pair<glm::ivec3, Buffer>>;
 
         /**
@@ -154,6 +155,55 @@ class VertexGenerator {
             return temp;
         }
 
+        /**
+         * Updates the meshes after a single block has changed. Rather than generating the
+         * affected globules again, the faces of the block and its neighbors are patched in place.
+         *
+         * @param pos Chunk relative position of the block
+         */
+        static void blockChanged(std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &pos) {
+            gShared->patch(chunk, pos);
+        }
+
+        /// Generates vertices for globules of the chunk at the given position, if it's displayed
+        static void update(const glm::ivec2 &chunkPos, const uint64_t bits, const bool highPriority = false) {
+            gShared->generate(chunkPos, bits, highPriority);
+        }
+
+        /**
+         * Registers a chunk that's being displayed, so that neighboring chunks can cull faces
+         * against it. Border globules of any adjacent chunks are generated again.
+         */
+        static void chunkLoaded(const std::shared_ptr<world::Chunk> &chunk) {
+            gShared->addChunk(chunk);
+        }
+        /**
+         * Removes a chunk that's no longer displayed. Border globules of any adjacent chunks are
+         * generated again, since they no longer have a neighbor to cull against.
+         */
+        static void chunkUnloaded(const std::shared_ptr<world::Chunk> &chunk) {
+            if(!gShared) return;
+            gShared->removeChunk(chunk);
+        }
+
+        /// Returns a bitmask of the globules on the side of a chunk facing in the given direction
+        static uint64_t borderGlobules(const glm::ivec2 &dir) {
+            uint64_t bits = 0;
+
+            for(int y = 0; y < 256; y += 64) {
+                for(int z = 0; z < 256; z += 64) {
+                    for(int x = 0; x < 256; x += 64) {
+                        if((dir.x < 0 && x == 0) || (dir.x > 0 && x == 192) ||
+                           (dir.y < 0 && z == 0) || (dir.y > 0 && z == 192)) {
+                            bits |= blockPosToBits(glm::ivec3(x, y, z));
+                        }
+                    }
+                }
+            }
+
+            return bits;
+        }
+
         /// Start of frame handler
         static void startOfFrame() {
             if(!gShared) return;
@@ -164,8 +214,6 @@ class VertexGenerator {
         static VertexGenerator *gShared;
 
     private:
-        using ExposureMaps = std::vector<std::array<bool, 256>>;
-
         /// Generation has completed and it needs to be turned into OpenGL buffers.
         struct BufferRequest {
             /// Chunk position for which the data is
@@ -178,6 +226,21 @@ class VertexGenerator {
 
             std::variant<std::vector<gl::GLushort>, std::vector<gl::GLuint>> indices;
             std::vector<BlockVertex> vertices;
+
+            /// index of the first face record of the transparent drawing pass
+            size_t specialFaceOffset = 0;
+            /// cube faces, if they're drawn from face records rather than vertices
+            std::vector<FaceRecord> faces;
+
+            /// layout of the cube faces in the vertex (or face record) buffer
+            std::shared_ptr<GlobuleMesh> mesh;
+
+            /// if set, only the given ranges of the existing vertex buffer are updated
+            bool isPatch = false;
+            /// ranges of vertices to update: index of the first vertex, and the new vertex data
+            std::vector<std::pair<size_t, std::vector<BlockVertex>>> patches;
+            /// ranges of face records to update, if the globule is drawn from face records
+            std::vector<std::pair<size_t, std::vector<FaceRecord>>> facePatches;
         };
 
         /// Request to generate globule data for the given chunk
@@ -200,13 +263,61 @@ class VertexGenerator {
             Callback callback;
         };
 
-        /*
-         * Data passed around when calculating the exposure map, as well as the block contents. It
-         * contains mostly a map of which blocks are "air" at, immediately above, and below the
-         * current Y level.
+        using ChunkMaps = Mesher::ChunkMaps;
+
+        /**
+         * Provides the mesher with blocks and models from the block registry. Air and unknown
+         * blocks aren't drawn.
          */
-        struct AirMap {
-            std::bitset<256*256> above, current, below;
+        struct RegistrySource: public BlockSource {
+            BlockAppearance *getBlock(const uuids::uuid &id) override;
+            bool isOpaqueBlock(const uuids::uuid &id) override;
+            const BlockModel *getModel(const uint16_t id) override;
+        };
+
+        /// Work to perform for a globule
+        struct GlobuleWork {
+            /// whether the entire globule is generated; otherwise, the blocks below are patched
+            bool full = false;
+            /// chunk relative positions of changed blocks
+            std::vector<glm::ivec3> blocks;
+
+            /// Combines another request into this one
+            void merge(const GlobuleWork &other) {
+                this->full |= other.full;
+
+                if(this->full) {
+                    this->blocks.clear();
+                } else {
+                    this->blocks.insert(this->blocks.end(), other.blocks.begin(), other.blocks.end());
+                }
+            }
+        };
+
+        /// State of a globule that's being generated
+        struct InFlightInfo {
+            /// chunk that the queued job will process
+            std::shared_ptr<world::Chunk> chunk;
+            /// work the queued job will perform
+            GlobuleWork work;
+            /// set once the job has started reading the chunk
+            bool started = false;
+
+            /// whether the globule needs to be processed again once the current job is done
+            bool rerun = false;
+            /// whether that is high priority
+            bool rerunHighPriority = false;
+            /// chunk to process the globule from again
+            std::shared_ptr<world::Chunk> rerunChunk;
+            /// work to perform then
+            GlobuleWork rerunWork;
+        };
+
+        /// Cube face layout and vertex (or face record) buffer of a displayed globule
+        struct MeshInfo {
+            std::shared_ptr<GlobuleMesh> mesh;
+            std::shared_ptr<gfx::Buffer> buffer;
+            std::shared_ptr<gfx::Buffer> faceBuffer;
         };
 
     private:
@@ -217,18 +328,27 @@ class VertexGenerator {
         void removeCallback(const uint32_t token);
 
         void generate(std::shared_ptr<world::Chunk> &chunk, const uint64_t globuleMask, const bool highPriority);
+        void generate(const glm::ivec2 &chunkPos, const uint64_t globuleMask, const bool highPriority);
+
+        void addChunk(const std::shared_ptr<world::Chunk> &chunk);
+        void removeChunk(const std::shared_ptr<world::Chunk> &chunk);
+        std::shared_ptr<world::Chunk> getChunk(const glm::ivec2 &chunkPos);
 
         void workerMain();
         void workerGenerate(const GenerateRequest &, const bool useChunkWorker);
-        void workerGenerate(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &, const bool highPriority = false);
+        void workerGenerate(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &, const std::shared_ptr<ChunkMaps> &);
         void workerGenBuffers(const BufferRequest &req);
 
-        void buildAirMap(world::ChunkSlice *, const ExposureMaps &, std::bitset<256*256> &);
-        void generateBlockIdMap(const std::shared_ptr<world::Chunk> &, ExposureMaps &);
-        void flagsForBlock(const AirMap &, const size_t, const size_t, const size_t, world::Block::BlockFlags &);
+        void queueGlobule(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &, const bool highPriority, const std::shared_ptr<ChunkMaps> &, const GlobuleWork &);
+        GlobuleWork globuleStarted(const glm::ivec2 &, const glm::ivec3 &);
+        void globuleDone(const glm::ivec2 &, const glm::ivec3 &);
 
-        void insertCubeVertices(const AirMap &, std::vector<BlockVertex> &, std::vector<gl::GLuint> &, const size_t, const size_t, const size_t, const uint16_t);
-        void insertModelVertices(const AirMap &, std::vector<BlockVertex> &, std::vector<gl::GLuint> &, const size_t, const size_t, const size_t, const uint16_t, const world::BlockRegistry::Model &);
+        std::shared_ptr<ChunkMaps> getChunkMaps(const std::shared_ptr<world::Chunk> &);
+        Mesher &getMesher();
+
+        void patch(std::shared_ptr<world::Chunk> &chunk, const glm::ivec3 &pos);
+        bool workerPatch(const std::shared_ptr<world::Chunk> &, const glm::ivec3 &, const std::vector<glm::ivec3> &);
+        void applyPatch(const BufferRequest &req);
 
         /// Enqueues a new item to the work queue
         void submitWorkItem(WorkItem &item) {
@@ -243,6 +363,15 @@ class VertexGenerator {
 
         std::atomic_bool run;
         std::unique_ptr<std::thread> worker;
+
+        /// whether adjacent cube faces of the same type are merged into larger quads
+        bool greedyMeshing = false;
+        /// whether cube faces are output as packed face records, rather than vertices and indices
+        bool compactFaces = true;
+        /// whether ambient occlusion of cube faces is computed when meshing
+        bool bakedOcclusion = true;
+        /// blocks and models used by the mesher
+        RegistrySource blockSource;
         moodycamel::BlockingConcurrentQueue<WorkItem> workQueue;
         moodycamel::ConcurrentQueue<WorkItem> highPriorityWork;
 
@@ -269,9 +398,24 @@ class VertexGenerator {
         /// buffers to be created
         moodycamel::ConcurrentQueue<BufferRequest> bufferReqs;
 
-        /// set containing the chunk world positions for which we're generating data
-        std::unordered_set<std::pair<glm::ivec2, glm::ivec3>, PairHash> inFlight;
-        /// lock protecting this set
+        /// chunks that are being displayed, by world position
+        std::unordered_map<glm::ivec2, std::weak_ptr<world::Chunk>> chunks;
+        /// lock protecting the displayed chunks
+        std::mutex chunksLock;
+
+        /// most recently built block lookup tables of each displayed chunk, and the chunk
+        std::unordered_map<glm::ivec2, std::pair<std::weak_ptr<world::Chunk>, std::shared_ptr<ChunkMaps>>> chunkMaps;
+        /// lock protecting the lookup tables
+        std::mutex chunkMapsLock;
+
+        /// face layouts of displayed globules, by chunk world position and globule offset
+        std::unordered_map<std::pair<glm::ivec2, glm::ivec3>, MeshInfo, PairHash> meshes;
+        /// lock protecting the face layouts
+        std::mutex meshesLock;
+
+        /// (chunk world position, globule offset) pairs for which we're generating data
+        std::unordered_map<std::pair<glm::ivec2, glm::ivec3>, InFlightInfo, PairHash> inFlight;
+        /// lock protecting this map
         std::mutex inFlightLock;
 
         using WorkFunc = std::function<void(void)>;
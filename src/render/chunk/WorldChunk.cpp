@@ -145,6 +145,9 @@ WorldChunk::~WorldChunk() {
         VertexGenerator::unregisterCallback(this->vtxGenCallbackToken);
         this->vtxGenCallbackToken = 0;
     }
+    if(this->chunk) {
+        VertexGenerator::chunkUnloaded(this->chunk);
+    }
 
     for(auto [key, globule] : this->globules) {
         delete globule;
@@ -246,6 +249,9 @@ void WorldChunk::setChunk(std::shared_ptr<world::Chunk> chunk) {
         VertexGenerator::unregisterCallback(this->vtxGenCallbackToken);
         this->vtxGenCallbackToken = 0;
     }
+    if(this->chunk) {
+        VertexGenerator::chunkUnloaded(this->chunk);
+    }
 
     // clear globule buffers if chunk is nullptr
     this->chunk = chunk;
@@ -262,6 +268,7 @@ void WorldChunk::setChunk(std::shared_ptr<world::Chunk> chunk) {
             std::bind(&WorldChunk::vtxGenCallback, this, _1, _2));
 
     // request generation of vertices for ALL globules in the chunk
+    VertexGenerator::chunkLoaded(chunk);
     VertexGenerator::update(chunk);
 
     // install new observer
@@ -299,59 +306,13 @@ void WorldChunk::blockDidChange(world::Chunk *, const glm::ivec3 &blockCoord, co
     // Logging::trace("Block {} changed, flags {}", blockCoord, hints);
 }
 /**
- * Marks a block as changed. This will cause the globule at the given coordinate to regenerate its
- * internal buffers.
- *
- * TODO: we should coalesce multiple update requests for the same globule.
+ * Marks a block as changed. The meshes of the globules containing the block and its neighbors,
+ * which may be in adjacent chunks, are patched.
  *
  * @note `pos` is relative to the origin of the chunk.
  */
 void WorldChunk::markBlockChanged(const glm::ivec3 &pos) {
-    // we want to update the globule that holds this chunk
-    const auto globuleOff = pos / glm::ivec3(kGlobuleSize);
-    const auto globuleOrigin = globuleOff * glm::ivec3(kGlobuleSize);
-
-    uint64_t bits = VertexGenerator::blockPosToBits(globuleOrigin);
-
-    // if the X coordinate is on an edge of the globule, update its neighbor
-    if(pos.x % 64 == 0) {
-        if(globuleOrigin.x >= 64) {
-            bits |= VertexGenerator::blockPosToBits(globuleOrigin - glm::ivec3(64, 0, 0));
-        } else {
-            // TODO: this globule is in an adjacent chunk
-        }
-    } else if(pos.x % 64 == 63) {
-        if(globuleOrigin.x < 192) {
-            bits |= VertexGenerator::blockPosToBits(globuleOrigin + glm::ivec3(0, 0, 64));
-        } else {
-            // TODO: this globule is in an adjacent chunk
-        }
-    }
-
-    // if the Y coordinate is on the edge of a globule, update its neighbor
-    if(pos.y % 64 == 0 && globuleOrigin.y >= 64) {
-        bits |= VertexGenerator::blockPosToBits(globuleOrigin - glm::ivec3(0, 64, 0));
-    } else if(pos.y % 64 == 63 && globuleOrigin.y < 192) {
-        bits |= VertexGenerator::blockPosToBits(globuleOrigin + glm::ivec3(0, 64, 0));
-    }
-
-    // if the Z coordinate is on an edge of the globule, update its neighbor
-    if(pos.z % 64 == 0) {
-        if(globuleOrigin.z >= 64) {
-            bits |= VertexGenerator::blockPosToBits(globuleOrigin - glm::ivec3(0, 0, 64));
-        } else {
-            // TODO: this globule is in an adjacent chunk
-        }
-    } else if(pos.z % 64 == 63) {
-        if(globuleOrigin.z < 192) {
-            bits |= VertexGenerator::blockPosToBits(globuleOrigin + glm::ivec3(0, 0, 64));
-        } else {
-            // TODO: this globule is in an adjacent chunk
-        }
-    }
-
-    // update all of the globules we requested
-    VertexGenerator::update(this->chunk, bits, true);
+    VertexGenerator::blockChanged(this->chunk, pos);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -602,10 +602,12 @@ bool ChunkLoader::updateDeferredChunks() {
             // regardless, store the chunk in the cache
             this->loadedChunks[pending.position] = std::get<ChunkPtr>(pending.data);
         }
-        // got an error?
+        // got an error? (expected if we cancelled the load)
         else if(std::holds_alternative<std::exception>(pending.data)) {
             const auto &e = std::get<std::exception>(pending.data);
-            Logging::error("Failed to load chunk {}: {}", pending.position, e.what());
+            if(!this->cancelledLoads.contains(pending.position)) {
+                Logging::error("Failed to load chunk {}: {}", pending.position, e.what());
+            }
         } else {
             XASSERT(false, "Invalid LoadChunkInfo data");
         }
@@ -613,6 +615,7 @@ bool ChunkLoader::updateDeferredChunks() {
         // regardless, remove it from the "currently loading" list
         this->currentlyLoading.erase(std::remove(this->currentlyLoading.begin(), 
                     this->currentlyLoading.end(), pending.position), this->currentlyLoading.end()); 
+        this->cancelledLoads.erase(pending.position);
     }
 
     // sort all chunks to display by distance, then create in increasing distance order
@@ -855,9 +858,26 @@ bool ChunkLoader::updateCenterChunk(const glm::vec3 &delta, const glm::vec3 &pos
     this->centerChunkPos = camChunk;
     this->loadChunk(camChunk);
 
+    this->cancelFarLoads();
+
     return true;
 }
 
+/**
+ * Cancels loading of any chunks that are now so far away that we'd release them from the cache
+ * right after they're loaded anyways.
+ */
+void ChunkLoader::cancelFarLoads() {
+    for(const auto &position : this->currentlyLoading) {
+        const auto offset = glm::abs(position - this->centerChunkPos);
+        if(std::max(offset.x, offset.y) <= (int) this->cacheReleaseDistance) continue;
+        if(this->cancelledLoads.contains(position)) continue;
+
+        this->source->cancelChunk(position);
+        this->cancelledLoads.insert(position);
+    }
+}
+
 /**
  * Requests a background load of the chunk at the given position.
  *
@@ -933,6 +953,9 @@ void ChunkLoader::draw(std::shared_ptr<gfx::RenderProgram> &program, const glm::
         this->lastProjView = projView;
     }
 
+    // globules bind their face records as they're drawn, for both color and shadow passes
+    program->setUniform1i("faceDataTex", chunk::Globule::kFaceDataTexUnit);
+
     // set up frustum for culling
     util::Frustum frust(projView);
 
@@ -137,6 +137,7 @@ class ChunkLoader {
         void removeLookAtSelection();
         void updateLookAtSelection(const glm::ivec2 chunkPos, const glm::ivec3 blockOff, const glm::mat4 &transform = glm::mat4(1));
 
+        void cancelFarLoads();
         bool updateCenterChunk(const glm::vec3 &delta, const glm::vec3 &camera);
         void loadChunk(const glm::ivec2 position);
 
@@ -252,6 +253,11 @@ class ChunkLoader {
          * List of all chunks we're currently loading.
          */
         std::vector<glm::ivec2> currentlyLoading;
+        /**
+         * Chunks in the loading list that moved out of range, and which we asked the world source
+         * to cancel. Their loads are expected to fail, so we won't complain when they do.
+         */
+        std::unordered_set<glm::ivec2> cancelledLoads;
         /**
          * List of chunks that should be deallocated.
          *
@@ -9,6 +9,7 @@
 #include <utility>
 #include <string>
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <uuid.h>
 
@@ -53,6 +54,8 @@ class ClientWorldSource: public AbstractWorldSource {
 
         /// player position changed; by default this does nothing
         virtual void playerMoved(const glm::vec3 &pos, const glm::vec3 &angle) {};
+        /// a requested chunk is no longer needed; by default this does nothing
+        virtual void cancelChunk(const glm::ivec2 &pos) {};
 
         /// sets the pause flag (when set, we don't update the thyme)
         virtual void setPaused(const bool paused) {
@@ -4,20 +4,31 @@
 #include "net/handlers/Chunk.h"
 #include "net/handlers/PlayerMovement.h"
 
+#include "io/PrefsManager.h"
+
 #include <io/Format.h>
+#include <io/PathHelper.h>
 #include <Logging.h>
 #include <util/Thread.h>
 
 #include <world/chunk/Chunk.h>
+#include <world/FileWorldReader.h>
 
 #include <mutils/time/profiler.h>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
 using namespace world;
 
 /**
  * Sets up the world source.
  *
- * The worker thread pool is initialized.
+ * The worker thread pool is initialized, and the chunk cache for this server is opened on it;
+ * that involves asking the server for its world id, which we don't want to wait for here.
  */
 RemoteSource::RemoteSource(std::shared_ptr<net::ServerConnection> _conn, const uuids::uuid &_id,
         const size_t numThreads) : ClientWorldSource(_id), server(_conn) {
@@ -25,6 +36,17 @@ RemoteSource::RemoteSource(std::shared_ptr<net::ServerConnection> _conn, const u
     this->pool = new util::ThreadPool<WorkItem>("RemoteSource", numThreads);
     _conn->setWorkPool(this->pool);
     _conn->setSource(this);
+
+    // open the chunk cache
+    if(io::PrefsManager::getBool("world.chunkCache", true)) {
+        this->pool->queueWorkItem([&] {
+            try {
+                this->openCache();
+            } catch(std::exception &e) {
+                Logging::error("Failed to open chunk cache: {}", e.what());
+            }
+        });
+    }
 }
 
 /**
@@ -35,6 +57,12 @@ RemoteSource::~RemoteSource() {
     this->pool->cleanup();
     delete this->pool;
 
+    // flush any outstanding cache writes
+    {
+        std::lock_guard<std::mutex> lg(this->cacheLock);
+        this->cache = nullptr;
+    }
+
     // close connection
     this->server->close();
 }
@@ -46,11 +74,113 @@ RemoteSource::~RemoteSource() {
  * we unsubscribe from them, which happens when the chunk is unloaded.
  */
 std::future<std::shared_ptr<Chunk>> RemoteSource::getChunk(int x, int z) {
-    // TODO: check cache
+    const glm::ivec2 pos(x, z); 
+
+    // check cache; we'll update the cached chunk with whatever slices changed
+    auto cached = this->readCachedChunk(pos);
 
     // make request
-    const glm::ivec2 pos(x, z); 
-    return this->server->getChunk(pos);
+    return this->server->getChunk(pos, cached);
+}
+
+/**
+ * Asks the server to drop a chunk request, if it hasn't started sending the chunk yet.
+ */
+void RemoteSource::cancelChunk(const glm::ivec2 &pos) {
+    this->server->cancelChunk(pos);
+}
+
+/**
+ * Opens the chunk cache file for the server we're connected to. It's identified by the host we
+ * connected to, and the world id the server pushes to us after authenticating.
+ */
+void RemoteSource::openCache() {
+    // get the world id
+    auto future = this->server->getWorldInfo("world.id");
+    if(future.wait_for(std::chrono::seconds(2)) != std::future_status::ready) {
+        Logging::warn("Timed out getting world id; chunk cache is disabled");
+        return;
+    }
+
+    const auto value = future.get();
+    if(!value || value->empty()) {
+        Logging::warn("Server did not provide a world id; chunk cache is disabled");
+        return;
+    }
+
+    std::string worldId;
+    worldId.resize(value->size());
+    memcpy(worldId.data(), value->data(), value->size());
+
+    // build a file name safe version of the host name
+    std::string host = this->server->host;
+    std::replace_if(host.begin(), host.end(), [](const char c) {
+        return !isalnum(c) && c != '.' && c != '-';
+    }, '_');
+
+    std::filesystem::path path(io::PathHelper::cacheDir());
+    path /= f("chunkcache-{}-{}.world", host, worldId);
+
+    Logging::debug("Chunk cache for {}: {}", this->server->host, path.string());
+    auto cache = std::make_shared<FileWorldReader>(path.string(), true);
+
+    std::lock_guard<std::mutex> lg(this->cacheLock);
+    this->cache = cache;
+}
+
+/**
+ * Gets the chunk cache, if it's been opened.
+ */
+std::shared_ptr<FileWorldReader> RemoteSource::getCache() {
+    std::lock_guard<std::mutex> lg(this->cacheLock);
+    return this->cache;
+}
+
+/**
+ * Reads a chunk from the cache, if we've got one.
+ */
+std::shared_ptr<Chunk> RemoteSource::readCachedChunk(const glm::ivec2 &pos) {
+    auto cache = this->getCache();
+    if(!cache) return nullptr;
+
+    try {
+        auto existsProm = cache->chunkExists(pos.x, pos.y);
+        if(!existsProm.get_future().get()) {
+            return nullptr;
+        }
+
+        auto chunkProm = cache->getChunk(pos.x, pos.y);
+        return chunkProm.get_future().get();
+    } catch(std::exception &e) {
+        Logging::error("Failed to read cached chunk {}: {}", pos, e.what());
+        return nullptr;
+    }
+}
+
+/**
+ * Writes the given chunk to the cache. This happens in the background.
+ */
+void RemoteSource::cacheChunk(const std::shared_ptr<Chunk> &chunk) {
+    if(!this->getCache()) return;
+
+    this->pool->queueWorkItem([&, chunk] {
+        this->writeCachedChunk(chunk);
+    });
+}
+
+/**
+ * Writes a chunk to the cache, and waits for the write to complete.
+ */
+void RemoteSource::writeCachedChunk(const std::shared_ptr<Chunk> &chunk) {
+    auto cache = this->getCache();
+    if(!cache) return;
+
+    try {
+        auto prom = cache->putChunk(chunk);
+        prom.get_future().get();
+    } catch(std::exception &e) {
+        Logging::error("Failed to cache chunk {}: {}", chunk->worldPos, e.what());
+    }
 }
 
 
@@ -159,6 +289,11 @@ void RemoteSource::flushDirtyChunksSync() {
  */
 void RemoteSource::forceChunkWriteIfDirtySync(std::shared_ptr<Chunk> &chunk) {
     this->server->didUnloadChunk(chunk);
+
+    // if blocks changed since we loaded it, update the cached copy so those slices are refetched
+    if(chunk->getVersion() == Chunk::kVersionUnknown) {
+        this->writeCachedChunk(chunk);
+    }
 }
 
 
@@ -7,10 +7,13 @@
 
 #include <atomic>
 #include <functional>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 
 namespace net {
@@ -18,6 +21,8 @@ class ServerConnection;
 }
 
 namespace world {
+class FileWorldReader;
+
 /**
  * A small wrapper around the raw server connection to enable getting chunks and all that fun
  * stuff.
@@ -37,6 +42,8 @@ class RemoteSource: public ClientWorldSource {
 
         /// Gets a chunk
         std::future<std::shared_ptr<Chunk>> getChunk(int x, int z) override;
+        /// Cancels a chunk request
+        void cancelChunk(const glm::ivec2 &pos) override;
 
         std::future<void> setPlayerInfo(const uuids::uuid &id, const std::string &key, const std::vector<char> &value) override;
         std::promise<std::vector<char>> getPlayerInfo(const uuids::uuid &id, const std::string &key) override;
@@ -80,12 +87,33 @@ class RemoteSource: public ClientWorldSource {
 
         std::optional<std::string> getErrorStr() const override;
 
+        /// Writes a chunk received from the server to the chunk cache
+        void cacheChunk(const std::shared_ptr<Chunk> &chunk);
+
     private:
         using WorkItem = std::function<void(void)>;
 
+    private:
+        void openCache();
+        std::shared_ptr<FileWorldReader> getCache();
+        std::shared_ptr<Chunk> readCachedChunk(const glm::ivec2 &pos);
+        void writeCachedChunk(const std::shared_ptr<Chunk> &chunk);
+
     private:
         std::shared_ptr<net::ServerConnection> server = nullptr;
 
+        /**
+         * On-disk cache of chunks received from this server, keyed by the server's host and world
+         * id. When we have a cached copy of a chunk, we send its slice versions to the server so
+         * that only changed slices are transferred.
+         *
+         * It's opened in the background once the server tells us its world id; until then, chunks
+         * are requested without cached slices.
+         */
+        std::shared_ptr<FileWorldReader> cache;
+        /// protects the cache pointer
+        std::mutex cacheLock;
+
         std::atomic_bool acceptRequests = true;
 
         /// thread pool
@@ -20,6 +20,7 @@
 #define WORLD_BLOCK_BLOCK_H
 
 #include "BlockRegistry.h"
+#include "render/chunk/BlockAppearance.h"
 
 #include <cstdint>
 #include <uuid.h>
@@ -38,22 +39,7 @@ class AbstractLight;
 namespace world {
 struct Chunk;
 
-class Block {
-    public:
-        enum BlockFlags: uint32_t {
-            kFlagsNone = 0,
-
-            /// exposed edges
-            kExposureMask       = 0x3F,
-
-            kExposedYPlus       = (1 << 0),
-            kExposedYMinus      = (1 << 1),
-            kExposedXPlus       = (1 << 2),
-            kExposedXMinus      = (1 << 3),
-            kExposedZPlus       = (1 << 4),
-            kExposedZMinus      = (1 << 5),
-        };
-
+class Block: public render::chunk::BlockAppearance {
     public:
         virtual ~Block() = default;
 
@@ -191,14 +177,6 @@ class Block {
         BlockRegistry::TextureId inventoryIcon;
 };
 
-// proper bitset OR for block flags. (XXX: extend if we ever use more than 32 bits)
-inline Block::BlockFlags operator|(Block::BlockFlags a, Block::BlockFlags b) {
-    return static_cast<Block::BlockFlags>(static_cast<uint32_t>(a) | static_cast<uint32_t>(b));
-}
-inline Block::BlockFlags operator|=(Block::BlockFlags &a, Block::BlockFlags b) {
-    return (Block::BlockFlags &) ((uint32_t &) a |= (uint32_t) b);
-}
-
 }
 
 #endif
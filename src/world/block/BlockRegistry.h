@@ -13,6 +13,8 @@
 #include <utility>
 #include <mutex>
 
+#include "render/chunk/BlockAppearance.h"
+
 #include <uuid.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -44,21 +46,8 @@ class BlockRegistry {
             kTypeInventory,
         };
 
-        /**
-         * Blocks can register custom models, which are just vertices whose coordinates are in the
-         * range of [0, 1], and an index buffer. Note that the bottom left corner of the block is
-         * at the origin.
-         *
-         * Each vertex position also must correspond to a face/vertex id pair. The faces are
-         * ordered as 0 = bottom, 1 = top, 2 = left, 3 = right, 4 = front, 5 = back.
-         *
-         * A maximum of about 60 vertices is suggested.
-         */
-        struct Model {
-            std::vector<glm::vec3> vertices;
-            std::vector<std::pair<uint8_t, uint8_t>> faceVertIds;
-            std::vector<uint8_t> indices;
-        };
+        /// Custom models that blocks can register; see `render::chunk::BlockModel`
+        using Model = render::chunk::BlockModel;
 
     public:
         // you should not call this